@@ -74,17 +74,16 @@ fi
 
 echo "Plugin will be installed to: $PLUGIN_INSTALL_DIR"
 
-# ソースディレクトリに移動
-cd src
-
-# プラグインのコンパイル
+# プラグインのコンパイル（ソースとMakefileは pyfreefem_ml/plugins に1つだけ置く）
+PLUGIN_SRC_DIR="$SCRIPT_DIR/../pyfreefem_ml/plugins"
 echo "Compiling mmap-semaphore plugin..."
-g++ -std=c++11 -fPIC -shared -o mmap-semaphore.so mmap-semaphore.cpp -I"$FREEFEM_INCLUDE" -lrt
+make -C "$PLUGIN_SRC_DIR" FF_INCLUDEPATH="$FREEFEM_INCLUDE" mmap-semaphore.so
 
 if [ $? -ne 0 ]; then
   echo "Error: Failed to compile the plugin"
   exit 1
 fi
+cd "$PLUGIN_SRC_DIR"
 
 echo "Plugin compiled successfully"
 
@@ -35,12 +35,16 @@ if platform.system() == 'Linux':
     from .shm_manager import SharedMemoryManager
     from .freefem_interface import FreeFEMInterface
     from .freefem_runner import FreeFEMRunner
+    from .freefem_worker import FreeFEMWorker
+    from .freefem_pool import FreeFEMWorkerPool
     
     # Linuxのみのシンボルをパッケージとしてエクスポート
     __linux_symbols__ = [
         "SharedMemoryManager", 
         "FreeFEMInterface",
         "FreeFEMRunner",
+        "FreeFEMWorker",
+        "FreeFEMWorkerPool",
     ]
 else:
     # Windows/macOSで未定義のシンボルを空にする
@@ -67,9 +71,15 @@ class PyFreeFEM:
     OSに応じて適切な実装（共有メモリまたはファイルIO）を選択します。
     Linux: 共有メモリ通信（FreeFEMRunner）
     Windows/macOS: ファイルIO通信（FreeFEMFileIO）
+    
+    実装はOSだけで決まり、run_script の戻り値とスクリプト側の書き方は変わりません。
+    transport='auto' の場合は、このホストで計測した転送時間（transport_tuning.py、
+    ~/.ff++ に保存）を使い、ファイルIOのバイナリ形式の入力を転送ごとに圧縮するかどうかを
+    入力の大きさで選びます（run_script の compress='auto'、テキスト形式の入出力は変わりません）。
+    共有メモリのセグメントをヒュージページで作るかどうかは FreeFEMInterface(transport_profile=True) で選べます。
     """
     
-    def __init__(self, freefem_path=None, debug=False, wsl_mode=False, **kwargs):
+    def __init__(self, freefem_path=None, debug=False, wsl_mode=False, transport=None, **kwargs):
         """
         初期化
         
@@ -77,11 +87,21 @@ class PyFreeFEM:
             freefem_path (str): FreeFEM実行ファイルのパス
             debug (bool): デバッグモードを有効にするかどうか
             wsl_mode (bool): WSL環境での実行モード（Windowsのみ有効）
+            transport (str, optional): 'auto' の場合はファイルIOで計測結果から圧縮するかどうかを選ぶ
             **kwargs: その他の実装固有の引数
         """
         self.system = platform.system()
         self.debug = debug
         self.wsl_mode = wsl_mode
+        self.transport_profile = None
+        if transport not in (None, 'auto'):
+            raise ValueError(f"未知の transport です: {transport}（None または 'auto'）")
+        
+        # 共有メモリの FreeFEMRunner では転送をスクリプト側のプラグイン関数が行うため、
+        # 計測結果はファイルIOでの圧縮の選択にだけ使う
+        if transport == 'auto' and self.system != 'Linux':
+            from .transport_tuning import load_profile
+            self.transport_profile = load_profile(debug=debug)
         
         if freefem_path is None:
             # デフォルトのFreeFEMパス
@@ -104,7 +124,8 @@ class PyFreeFEM:
             self.runner = FreeFEMFileIO(
                 freefem_path=freefem_path,
                 working_dir=working_dir,
-                debug=debug
+                debug=debug,
+                transport_profile=self.transport_profile
             )
         
         if debug:
@@ -139,6 +160,8 @@ class PyFreeFEM:
         if self.implementation == 'shm':
             return self.runner.run_script(script_path, **kwargs)
         else:
+            if self.transport_profile is not None:
+                kwargs.setdefault('compress', 'auto')
             return self.runner.run_script(script_path, input_data=input_data, **kwargs)
     
     def run_inline_script(self, script_content, input_data=None, **kwargs):
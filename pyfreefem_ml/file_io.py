@@ -7,7 +7,9 @@ FreeFEMファイル入出力モジュール
 共有メモリの代わりにファイル入出力を使用してFreeFEMとデータを交換するための機能を提供します。
 """
 
+import io
 import os
+import zlib
 import subprocess
 import numpy as np
 import platform
@@ -15,12 +17,282 @@ import tempfile
 from pathlib import Path
 from typing import Tuple, List, Dict, Any, Optional, Union
 
+# バイナリファイル形式（plugins/src/shm_binary_file.hpp の BinaryFileHeader と同一）
+# 64バイトのヘッダーの直後にリトルエンディアンの生データを置く
+BINARY_MAGIC = 0x42464650        # "PFFB"
+BINARY_VERSION = 1
+BINARY_VERSION_COMPRESSED = 2    # 圧縮形式（面ごとにzlibで圧縮したブロックの列）
+BINARY_MAX_NDIM = 4
+BINARY_DTYPE_FLOAT64 = 1         # shm_layout.py の DTYPE_FLOAT64 と同じ値
+BINARY_HEADER_DTYPE = np.dtype([
+    ('magic', '<u4'),
+    ('version', '<u4'),
+    ('dtype', '<u4'),
+    ('ndim', '<u4'),
+    ('shape', '<u8', (BINARY_MAX_NDIM,)),
+    ('data_offset', '<u8'),
+    ('nbytes', '<u8'),
+])
+BINARY_HEADER_SIZE = BINARY_HEADER_DTYPE.itemsize
+
+# 圧縮形式のデータ部（shm_binary_file.hpp の BinaryBlockInfo / BinaryBlockHeader と同一）
+# ブロックごとに8バイトの要素を8つの面（同じ位置のバイトの列）に並べ替え、面ごとに圧縮する
+BINARY_CODEC_ZLIB_SHUFFLE = 1
+BINARY_BLOCK_ELEMENTS = 1 << 17
+BINARY_SAMPLE_BYTES = 4096       # 面を圧縮するか判定する試し圧縮の大きさ
+BINARY_BLOCK_INFO_DTYPE = np.dtype([('codec', '<u4'), ('block_elements', '<u4')])
+BINARY_BLOCK_HEADER_DTYPE = np.dtype([('raw_bytes', '<u4'), ('stored_bytes', '<u4')])
+
+
+def _binary_data(array) -> np.ndarray:
+    """書き込む配列をリトルエンディアンの連続したfloat64配列に変換する"""
+    data = np.ascontiguousarray(array, dtype='<f8')
+    if data.ndim == 0:
+        data = data.reshape(1)
+    if data.ndim > BINARY_MAX_NDIM:
+        raise ValueError(f"バイナリファイルは{BINARY_MAX_NDIM}次元までです: {data.ndim}")
+    return data
+
+
+def _binary_header(data: np.ndarray, version: int) -> bytes:
+    """配列のヘッダーを作成する"""
+    header = np.zeros(1, dtype=BINARY_HEADER_DTYPE)
+    header['magic'] = BINARY_MAGIC
+    header['version'] = version
+    header['dtype'] = BINARY_DTYPE_FLOAT64
+    header['ndim'] = data.ndim
+    header['shape'][0, :data.ndim] = data.shape
+    header['data_offset'] = BINARY_HEADER_SIZE
+    header['nbytes'] = data.nbytes
+    return header.tobytes()
+
+
+def _compress_plane(plane: np.ndarray):
+    """1つの面の格納データ（小さくならない面は並べ替えたまま格納する）"""
+    n = plane.size
+    if n > BINARY_SAMPLE_BYTES:
+        sample = zlib.compress(plane[:BINARY_SAMPLE_BYTES], 1)
+        if len(sample) >= BINARY_SAMPLE_BYTES * 9 // 10:
+            return plane
+    compressed = zlib.compress(plane, 1)
+    return compressed if len(compressed) < n else plane
+
+
+def _iter_compressed_blocks(data: np.ndarray):
+    """圧縮形式のデータ部を順に生成する"""
+    info = np.zeros(1, dtype=BINARY_BLOCK_INFO_DTYPE)
+    info['codec'] = BINARY_CODEC_ZLIB_SHUFFLE
+    info['block_elements'] = BINARY_BLOCK_ELEMENTS
+    yield info.tobytes()
+    flat = data.reshape(-1)
+    record = np.zeros(1, dtype=BINARY_BLOCK_HEADER_DTYPE)
+    for first in range(0, flat.size, BINARY_BLOCK_ELEMENTS):
+        block = flat[first:first + BINARY_BLOCK_ELEMENTS]
+        planes = np.ascontiguousarray(block.view(np.uint8).reshape(block.size, 8).T)
+        for plane in planes:
+            stored = _compress_plane(plane)
+            record['raw_bytes'] = block.size
+            record['stored_bytes'] = len(stored) if isinstance(stored, bytes) else stored.size
+            yield record.tobytes()
+            yield stored
+
+
+def write_binary_stream(stream, array, compress: bool = False) -> None:
+    """
+    配列をバイナリファイル形式でストリーム（ファイルやパイプ）に書き込みます
+
+    Args:
+        stream: write() を持つバイナリストリーム
+        array: 書き込む配列（float64に変換され、1〜4次元であること）
+        compress: Trueの場合は圧縮形式で書き込む（ブロックごとに順に書き込むため、
+            配列全体の圧縮結果をメモリに保持しない）
+    """
+    data = _binary_data(array)
+    stream.write(_binary_header(data, BINARY_VERSION_COMPRESSED if compress else BINARY_VERSION))
+    if not compress:
+        stream.write(memoryview(data).cast('B'))
+        return
+    for chunk in _iter_compressed_blocks(data):
+        stream.write(chunk)
+
+
+def encode_binary_array(array, compress: bool = False) -> bytes:
+    """
+    配列をバイナリファイル形式のバイト列に変換します
+
+    Args:
+        array: 書き込む配列（float64に変換され、1〜4次元であること）
+        compress: Trueの場合は圧縮形式にする
+
+    Returns:
+        ヘッダーとデータを含むバイト列
+    """
+    if not compress:
+        data = _binary_data(array)
+        return _binary_header(data, BINARY_VERSION) + data.tobytes()
+    buffer = io.BytesIO()
+    write_binary_stream(buffer, array, compress=True)
+    return buffer.getvalue()
+
+
+def _parse_binary_header(buffer: bytes, source: str) -> Tuple[Tuple[int, ...], int, int]:
+    """バイナリファイルのヘッダーを検証し、形状・データ位置・バージョンを返す"""
+    if len(buffer) < BINARY_HEADER_SIZE:
+        raise ValueError(f"バイナリファイルのヘッダーが不足しています: {source}")
+    header = np.frombuffer(buffer, dtype=BINARY_HEADER_DTYPE, count=1)[0]
+    if header['magic'] != BINARY_MAGIC:
+        raise ValueError(f"バイナリファイルではありません: {source}")
+    if (header['version'] not in (BINARY_VERSION, BINARY_VERSION_COMPRESSED)
+            or header['dtype'] != BINARY_DTYPE_FLOAT64):
+        raise ValueError(f"対応していないバイナリファイルです: {source} "
+                         f"(バージョン: {header['version']}, データ型: {header['dtype']})")
+    ndim = int(header['ndim'])
+    if not 1 <= ndim <= BINARY_MAX_NDIM:
+        raise ValueError(f"バイナリファイルの次元数が不正です: {source} ({ndim})")
+    shape = tuple(int(n) for n in header['shape'][:ndim])
+    if int(np.prod(shape)) * 8 != int(header['nbytes']):
+        raise ValueError(f"バイナリファイルの形状とデータ量が一致しません: {source}")
+    return shape, int(header['data_offset']), int(header['version'])
+
+
+def _read_exact(stream, size: int, source: str) -> bytes:
+    """ストリームから size バイトを読み込む（パイプでは1回で読み切れない場合がある）"""
+    chunks = []
+    remaining = size
+    while remaining > 0:
+        chunk = stream.read(remaining)
+        if not chunk:
+            raise ValueError(f"バイナリファイルのデータが不足しています: {source}")
+        chunks.append(chunk)
+        remaining -= len(chunk)
+    return chunks[0] if len(chunks) == 1 else b''.join(chunks)
+
+
+def _read_compressed_blocks(stream, out: np.ndarray, source: str) -> None:
+    """圧縮形式のデータ部を展開して out（1次元のfloat64配列）に書き込む"""
+    info = np.frombuffer(_read_exact(stream, BINARY_BLOCK_INFO_DTYPE.itemsize, source),
+                         dtype=BINARY_BLOCK_INFO_DTYPE)[0]
+    block_elements = int(info['block_elements'])
+    if info['codec'] != BINARY_CODEC_ZLIB_SHUFFLE or block_elements == 0:
+        raise ValueError(f"対応していない圧縮形式です: {source} (codec: {info['codec']})")
+    for first in range(0, out.size, block_elements):
+        n = min(block_elements, out.size - first)
+        planes = out[first:first + n].view(np.uint8).reshape(n, 8)
+        for b in range(8):
+            record = np.frombuffer(_read_exact(stream, BINARY_BLOCK_HEADER_DTYPE.itemsize, source),
+                                   dtype=BINARY_BLOCK_HEADER_DTYPE)[0]
+            stored = int(record['stored_bytes'])
+            if record['raw_bytes'] != n or stored > n:
+                raise ValueError(f"圧縮形式のブロックが不正です: {source}")
+            plane = _read_exact(stream, stored, source)
+            if stored < n:
+                try:
+                    plane = zlib.decompress(plane)
+                except zlib.error as e:
+                    raise ValueError(f"圧縮形式のブロックを展開できません: {source} ({e})") from e
+                if len(plane) != n:
+                    raise ValueError(f"圧縮形式のブロックが不正です: {source}")
+            planes[:, b] = np.frombuffer(plane, dtype=np.uint8)
+
+
+def read_binary_stream(stream, source: str = "<stream>") -> np.ndarray:
+    """
+    バイナリファイル形式の配列をストリーム（ファイルやパイプ）から先頭から順に読み込みます
+
+    どちらの形式（圧縮形式を含む）も読み込め、ブロックごとに出力先の配列へ直接展開します。
+
+    Args:
+        stream: read() / readinto() を持つバイナリストリーム（ヘッダーの位置にあること）
+        source: エラーメッセージに表示する名前
+
+    Returns:
+        ヘッダーの形状を持つfloat64配列
+    """
+    shape, offset, version = _parse_binary_header(_read_exact(stream, BINARY_HEADER_SIZE, source), source)
+    if offset > BINARY_HEADER_SIZE:
+        _read_exact(stream, offset - BINARY_HEADER_SIZE, source)
+    out = np.empty(shape, dtype='<f8')
+    flat = out.reshape(-1)
+    if version == BINARY_VERSION_COMPRESSED:
+        _read_compressed_blocks(stream, flat, source)
+        return out
+    view = memoryview(flat).cast('B')
+    position = 0
+    while position < len(view):
+        count = stream.readinto(view[position:])
+        if not count:
+            raise ValueError(f"バイナリファイルのデータが不足しています: {source}")
+        position += count
+    return out
+
+
+def decode_binary_array(buffer: bytes) -> np.ndarray:
+    """
+    バイナリファイル形式のバイト列から配列を取り出します
+
+    Args:
+        buffer: ヘッダーとデータを含むバイト列
+
+    Returns:
+        ヘッダーの形状を持つfloat64配列（非圧縮形式の場合はコピーせず読み取り専用）
+    """
+    shape, offset, version = _parse_binary_header(buffer, "<bytes>")
+    if version == BINARY_VERSION_COMPRESSED:
+        return read_binary_stream(io.BytesIO(buffer), "<bytes>")
+    count = int(np.prod(shape))
+    if len(buffer) < offset + count * 8:
+        raise ValueError("バイナリファイルのデータが不足しています")
+    return np.frombuffer(buffer, dtype='<f8', count=count, offset=offset).reshape(shape)
+
+
+def write_binary_array(path: Union[str, Path], array, compress: bool = False) -> None:
+    """
+    配列をFreeFEMの readBinaryFile で読み込めるバイナリファイルに書き込みます
+
+    Args:
+        path: 書き込み先のファイル
+        array: 書き込む配列
+        compress: Trueの場合は圧縮形式で書き込む
+    """
+    path = Path(path)
+    temp_path = path.with_name(path.name + '.tmp')
+    with open(temp_path, 'wb') as f:
+        write_binary_stream(f, array, compress)
+    os.replace(temp_path, path)
+
+
+def load_binary_array(path: Union[str, Path], copy: bool = False) -> np.ndarray:
+    """
+    FreeFEMの writeBinaryFile / writeCompressedFile で書き込まれたバイナリファイルを読み込みます
+
+    Args:
+        path: 読み込むファイル
+        copy: Falseの場合は np.memmap でファイルを直接参照し、Trueの場合はメモリにコピーする
+            （圧縮形式のファイルは常に展開した配列を返す）
+
+    Returns:
+        ヘッダーの形状を持つfloat64配列
+    """
+    with open(path, 'rb') as f:
+        shape, offset, version = _parse_binary_header(f.read(BINARY_HEADER_SIZE), str(path))
+        if version == BINARY_VERSION_COMPRESSED:
+            f.seek(0)
+            return read_binary_stream(f, str(path))
+    if os.path.getsize(path) < offset + int(np.prod(shape)) * 8:
+        raise ValueError(f"バイナリファイルのデータが不足しています: {path}")
+    if int(np.prod(shape)) == 0:
+        # 空の配列は np.memmap で開けない
+        return np.zeros(shape)
+    array = np.memmap(path, dtype='<f8', mode='r', offset=offset, shape=shape)
+    return np.array(array) if copy else array
+
 class FreeFEMFileIO:
     """FreeFEMとファイル入出力を介して通信するクラス"""
     
     def __init__(self, freefem_path: Union[str, List[str]] = 'FreeFem++', 
                  working_dir: Optional[str] = None,
-                 debug: bool = False):
+                 debug: bool = False,
+                 transport_profile=None):
         """
         FreeFEMファイル入出力インターフェースの初期化
         
@@ -28,10 +300,14 @@ class FreeFEMFileIO:
             freefem_path: FreeFEMの実行パス（文字列またはコマンドリスト）
             working_dir: 作業ディレクトリ
             debug: デバッグモード
+            transport_profile: 転送方式の計測結果（transport_tuning.TransportProfile）。
+                run_script(compress='auto') で圧縮するかどうかの判断に使う
+                （省略時は ~/.ff++ に保存された結果があれば使う）
         """
         self.freefem_path = freefem_path
         self.working_dir = working_dir or os.getcwd()
         self.debug = debug
+        self.transport_profile = transport_profile
         self.is_windows = platform.system() == 'Windows'
         self.is_wsl_mode = isinstance(freefem_path, list) and len(freefem_path) > 1 and freefem_path[0] == 'wsl'
     
@@ -39,7 +315,9 @@ class FreeFEMFileIO:
                    input_data: Optional[np.ndarray] = None,
                    input_file: str = 'input.txt',
                    output_file: str = 'output.txt',
-                   metadata_file: Optional[str] = None) -> Tuple[bool, Optional[np.ndarray], str, str]:
+                   metadata_file: Optional[str] = None,
+                   binary: bool = False,
+                   compress: Union[bool, str] = False) -> Tuple[bool, Optional[np.ndarray], str, str]:
         """
         FreeFEMスクリプトを実行し、ファイル経由でデータを受け渡します
         
@@ -49,22 +327,56 @@ class FreeFEMFileIO:
             input_file: 入力ファイル名
             output_file: 出力ファイル名
             metadata_file: メタデータファイル名（配列形状情報など）
+            binary: Trueの場合は入出力にバイナリファイル形式を使用する
+                （スクリプト側は readBinaryFile / writeBinaryFile を使用し、
+                形状はファイルのヘッダーに含まれるためメタデータファイルは不要）
+            compress: Trueの場合は入力を圧縮形式のバイナリファイルで書き込む（binary=True を含意）。
+                readBinaryFile はどちらの形式も読み込み、出力は writeCompressedFile で書き込めば
+                圧縮形式、writeBinaryFile なら非圧縮で受け取る。WSLでは1本のパイプで順に送受信する。
+                'auto' の場合は binary=True のときだけ、計測結果で入力の大きさに対して zfile が
+                file より速ければ圧縮する（テキスト形式のスクリプトはそのまま）
         
         Returns:
             成功フラグ、出力配列、標準出力、標準エラー出力のタプル
         """
+        # 'auto' はスクリプト側の形式（binary）を変えない範囲でだけ選ぶ
+        if compress == 'auto':
+            compress = binary and self._should_compress(input_data)
+        binary = binary or compress
+        
         # WSL環境の場合は特別な処理が必要
         if self.is_windows and self.is_wsl_mode:
-            return self._run_script_wsl(script_path, input_data, input_file, output_file, metadata_file)
+            return self._run_script_wsl(script_path, input_data, input_file, output_file, metadata_file,
+                                        binary, compress)
         
         # 通常の処理（WSL以外）
-        return self._run_script_normal(script_path, input_data, input_file, output_file, metadata_file)
+        return self._run_script_normal(script_path, input_data, input_file, output_file, metadata_file,
+                                       binary, compress)
     
-    def _run_script_normal(self, script_path, input_data, input_file, output_file, metadata_file):
+    def _should_compress(self, input_data) -> bool:
+        """計測結果で入力を圧縮したほうが速いかどうか（計測結果がなければFalse）"""
+        if input_data is None:
+            return False
+        if self.transport_profile is None:
+            from .transport_tuning import read_profile
+            self.transport_profile = read_profile() or False
+        if not self.transport_profile:
+            return False
+        nbytes = np.asarray(input_data).size * 8
+        compress = self.transport_profile.fastest(nbytes, ('file', 'zfile')) == 'zfile'
+        if self.debug:
+            print(f"入力 {nbytes} バイト: {'圧縮形式' if compress else 'バイナリ形式'}で書き込みます")
+        return compress
+    
+    def _run_script_normal(self, script_path, input_data, input_file, output_file, metadata_file, binary=False,
+                           compress=False):
         """通常環境（WSL以外）での実行"""
         # 入力データがあればファイルに書き込む
         if input_data is not None:
-            np.savetxt(input_file, input_data)
+            if binary:
+                write_binary_array(input_file, input_data, compress)
+            else:
+                np.savetxt(input_file, input_data)
             if self.debug:
                 print(f"入力データをファイルに書き込みました: {input_file}")
         
@@ -105,8 +417,11 @@ class FreeFEMFileIO:
         # 出力ファイルを読み込む
         if os.path.exists(output_file):
             try:
+                if binary:
+                    # バイナリファイルはヘッダーの形状のまま直接参照する
+                    array = load_binary_array(output_file)
                 # メタデータファイルがある場合は読み込む（多次元配列用）
-                if metadata_file and os.path.exists(metadata_file):
+                elif metadata_file and os.path.exists(metadata_file):
                     array = self._load_with_metadata(output_file, metadata_file)
                 else:
                     # 単純な1次元配列として読み込む
@@ -126,7 +441,8 @@ class FreeFEMFileIO:
                 print(f"出力ファイルが見つかりません: {output_file}")
             return False, None, stdout, stderr
     
-    def _run_script_wsl(self, script_path, input_data, input_file, output_file, metadata_file):
+    def _run_script_wsl(self, script_path, input_data, input_file, output_file, metadata_file, binary=False,
+                        compress=False):
         """WSL環境での実行"""
         try:
             # WSLのホームディレクトリを取得
@@ -155,7 +471,21 @@ class FreeFEMFileIO:
                 print(f"スクリプトをWSLに書き込みました: {wsl_script_path}")
             
             # 入力データがあればWSLに書き込み
-            if input_data is not None:
+            if input_data is not None and binary:
+                # ブロックごとにパイプへ書き込み、全体のバイト列を作らない
+                wsl_input_path = f"{wsl_temp_dir}/{input_file}"
+                writer = subprocess.Popen(['wsl', 'bash', '-c', f"cat > {wsl_input_path}"], stdin=subprocess.PIPE)
+                try:
+                    write_binary_stream(writer.stdin, input_data, compress)
+                finally:
+                    writer.stdin.close()
+                if writer.wait() != 0:
+                    raise subprocess.CalledProcessError(writer.returncode, writer.args)
+                
+                if self.debug:
+                    form = "圧縮形式" if compress else "バイナリ形式"
+                    print(f"入力データをWSLに{form}で書き込みました: {wsl_input_path}")
+            elif input_data is not None:
                 data_string = ' '.join(str(x) for x in input_data.flatten())
                 wsl_input_path = f"{wsl_temp_dir}/{input_file}"
                 subprocess.run(['wsl', 'bash', '-c', f"echo '{data_string}' > {wsl_input_path}"], check=True)
@@ -194,8 +524,23 @@ class FreeFEMFileIO:
             # 出力ファイルをWSLから読み込む
             array = None
             try:
+                if binary:
+                    # バイナリファイルをパイプから順に読み込む（文字列への変換を行わず、
+                    # 圧縮形式はブロックごとに出力先の配列へ展開する）
+                    wsl_output_path = f"{wsl_temp_dir}/{output_file}"
+                    output_cmd = ['wsl', 'cat', wsl_output_path]
+                    reader = subprocess.Popen(output_cmd, stdout=subprocess.PIPE)
+                    try:
+                        array = read_binary_stream(reader.stdout, wsl_output_path)
+                    finally:
+                        reader.stdout.close()
+                    if reader.wait() != 0:
+                        raise subprocess.CalledProcessError(reader.returncode, output_cmd)
+                    
+                    if self.debug:
+                        print(f"WSLからバイナリ形式の配列データを読み込みました: 形状={array.shape}")
                 # メタデータファイルがある場合
-                if metadata_file:
+                elif metadata_file:
                     # メタデータを読み込む
                     wsl_metadata_path = f"{wsl_temp_dir}/{metadata_file}"
                     metadata_cmd = ['wsl', 'bash', '-c', f"cat {wsl_metadata_path}"]
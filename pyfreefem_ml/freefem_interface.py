@@ -22,6 +22,7 @@ import uuid
 if platform.system() == 'Linux':
     from .shm_manager import SharedMemoryManager
     from .plugin_installer import install_plugin, PluginInstaller
+    from . import transport_tuning
 else:
     # 非Linux環境でのプレースホルダー定義
     class DummyClass:
@@ -46,7 +47,8 @@ class FreeFEMInterface:
     Windows/macOSでは、代わりにfreefem_ml.PyFreeFEMクラスを使用してください。
     """
     
-    def __init__(self, shm_size=1024*1024, wsl_mode=False, debug=False, freefem_path=None, lib_dir=None, auto_install_plugin=True):
+    def __init__(self, shm_size=1024*1024, wsl_mode=False, debug=False, freefem_path=None, lib_dir=None, auto_install_plugin=True,
+                 transport_profile=None):
         """
         FreeFEMインターフェースを初期化
         
@@ -57,6 +59,10 @@ class FreeFEMInterface:
             freefem_path (str): FreeFEM実行ファイルのパス（デフォルト: 'FreeFem++'）
             lib_dir (str): FreeFEMライブラリディレクトリのパス
             auto_install_plugin (bool): プラグインの自動インストールを有効にするかどうか
+            transport_profile (TransportProfile or bool, optional): 転送方式の計測結果
+                （transport_tuning.py）。True の場合は ~/.ff++ に保存された結果を使い、なければ計測する。
+                shm_size の配列で posix-huge が速いホストでは、セグメントをヒュージページと
+                マッピング時の割り当てを指定して作成する（省略時は指定しない）
         """
         # 非Linux環境ではエラーを発生させる
         if platform.system() != 'Linux':
@@ -96,8 +102,20 @@ class FreeFEMInterface:
         if self.debug:
             print(f"初期化: SHM名={self.shm_name}, サイズ={self.shm_size}, ライブラリパス={self.lib_dir}")
         
+        # 計測結果に従ってセグメントのマッピング方法を選ぶ
+        if transport_profile is True:
+            transport_profile = transport_tuning.load_profile(debug=self.debug)
+        self.transport_profile = transport_profile or None
+        self.segment_transport = 'posix'
+        if self.transport_profile is not None:
+            self.segment_transport = (self.transport_profile.fastest(self.shm_size, transport_tuning.SEGMENT_TRANSPORTS)
+                                      or 'posix')
+        huge = self.segment_transport == 'posix-huge'
+        if self.debug and self.transport_profile is not None:
+            print(f"転送方式: {self.segment_transport}（計測: {self.transport_profile.method}）")
+        
         # 共有メモリマネージャの初期化
-        self.shm_manager = SharedMemoryManager(self.shm_name, self.shm_size)
+        self.shm_manager = SharedMemoryManager(self.shm_name, self.shm_size, hugepages=huge, populate=huge)
         
     def __del__(self):
         """デストラクタ - リソースのクリーンアップ"""
@@ -343,16 +361,28 @@ class FreeFEMInterface:
             name (str): 変数名
             array (numpy.ndarray or list): 書き込む配列
         """
-        # NumPy配列に変換
+        # NumPy配列に変換（float32はFreeFEM側で直接読めるため変換しない）
         if not isinstance(array, np.ndarray):
             array = np.array(array, dtype=np.float64)
-        elif array.dtype != np.float64:
+        elif array.dtype not in (np.float64, np.float32):
             array = array.astype(np.float64)
         
         self.shm_manager.write_array(name, array)
         if self.debug:
             print(f"配列書き込み: {name} = {array}")
     
+    def write_arrays(self, arrays):
+        """
+        複数の配列をまとめて共有メモリに書き込み、1回の通知で公開
+        （FreeFEM側は shmReadBatch でまとめて読み込む）
+        
+        Args:
+            arrays (dict): 変数名から配列への辞書
+        """
+        self.shm_manager.write_arrays(arrays)
+        if self.debug:
+            print(f"配列一括書き込み: {', '.join(arrays)}")
+    
     def write_int_array(self, array, name):
         """
         整数配列を共有メモリに書き込み
@@ -378,7 +408,7 @@ class FreeFEMInterface:
         if array.dtype != np.float64:
             array = array.astype(np.float64)
         
-        self.shm_manager.write_array(array, name)
+        self.shm_manager.write_array(name, array)
         if self.debug:
             shape_str = 'x'.join(str(s) for s in array.shape)
             print(f"浮動小数点配列書き込み: {name}, 形状={shape_str}")
@@ -425,6 +455,19 @@ class FreeFEMInterface:
             rows, cols = matrix.shape
             print(f"整数行列書き込み: {name}, 形状={rows}x{cols}")
     
+    def write_sparse_matrix(self, matrix, name):
+        """
+        疎行列をCSR形式で共有メモリに書き込み（FreeFEM側は shmReadMatrix で読み込む）
+        
+        Args:
+            matrix: scipy.sparse の行列
+            name (str): 変数名
+        """
+        self.shm_manager.write_sparse_matrix(name, matrix)
+        if self.debug:
+            rows, cols = matrix.shape
+            print(f"疎行列書き込み: {name}, 形状={rows}x{cols}, 非零要素数={matrix.nnz}")
+    
     # ==== データ読み取りメソッド ====
     
     def read_int(self, name):
@@ -472,21 +515,41 @@ class FreeFEMInterface:
             print(f"文字列読み込み: {name} = {value}")
         return value
     
-    def read_array(self, name):
+    def read_array(self, name, dtype=None):
         """
         配列を共有メモリから読み込み
         
+        FreeFEM側で writeSharedMemoryFloat32 により書き込まれた配列は
+        float32のまま返されるため、別途astypeで変換する必要はありません。
+        
         Args:
             name (str): 変数名
+            dtype (numpy.dtype, optional): 変換後のデータ型（省略時は格納時の型）
             
         Returns:
             numpy.ndarray: 読み込んだ配列
         """
-        array = self.shm_manager.read_array(name)
+        array = self.shm_manager.read_array(name, dtype=dtype)
         if self.debug:
             print(f"配列読み込み: {name} = {array}")
         return array
     
+    def read_arrays(self, names, dtype=None):
+        """
+        複数の配列をまとめて共有メモリから読み込み（FreeFEM側は shmWriteBatch でまとめて書き込む）
+        
+        Args:
+            names (list): 変数名のリスト
+            dtype (numpy.dtype, optional): 変換後のデータ型（省略時は格納時の型）
+            
+        Returns:
+            dict: 変数名から読み込んだ配列への辞書
+        """
+        arrays = self.shm_manager.read_arrays(names, dtype=dtype)
+        if self.debug:
+            print(f"配列一括読み込み: {', '.join(arrays)}")
+        return arrays
+    
     def read_int_array(self, name):
         """
         整数配列を共有メモリから読み込み
@@ -545,6 +608,26 @@ class FreeFEMInterface:
         
         return matrix
     
+    def read_sparse_matrix(self, name, copy=True):
+        """
+        FreeFEMが shmWriteMatrix で書き込んだ疎行列を読み込み
+        
+        Args:
+            name (str): 変数名
+            copy (bool): Falseの場合は共有メモリを直接指す行列を返す（コピーなし）
+            
+        Returns:
+            scipy.sparse.csr_matrix: 読み込んだ疎行列
+        """
+        if copy:
+            matrix = self.shm_manager.read_sparse_matrix(name)
+        else:
+            matrix = self.shm_manager.view_sparse_matrix(name)
+        if self.debug:
+            rows, cols = matrix.shape
+            print(f"疎行列読み込み: {name}, 形状={rows}x{cols}, 非零要素数={matrix.nnz}")
+        return matrix
+    
     def read_int_matrix(self, name):
         """
         整数行列を共有メモリから読み込み
@@ -0,0 +1,197 @@
+"""
+Python-FreeFEM共有データ通信ライブラリのワーカープールモジュール
+
+同じFreeFEMスクリプトを複数の常駐ワーカー（FreeFEMWorker）として起動し、
+独立した多数の評価（データセットの生成など）を並列に処理します。
+
+- 各ワーカーは専用の共有メモリセグメントを持ち、ワーカー間で共有する状態はありません
+- ワーカーのプロセスは1つずつ別のコアに固定します（sched_setaffinity）
+- ジョブの番号の範囲を最初にワーカーごとに等分し、自分の範囲を処理し終えたワーカーは
+  残りの最も多いワーカーから後半を奪います（ワークスティーリング）。評価時間に
+  ばらつきがあっても、最後まで全ワーカーが稼働します
+- 結果はあらかじめ確保した1つのNumPy配列の各行に、共有メモリから直接コピーします
+
+ワーカー側のスクリプトは FreeFEMWorker と同じ shmWaitCommand/shmPostResult のループです。
+"""
+
+import os
+import uuid
+import threading
+import numpy as np
+
+from .freefem_worker import FreeFEMWorker
+
+
+class FreeFEMWorkerPool:
+    """
+    常駐FreeFEMワーカーのプール
+
+    map() でパラメータのリストを受け取り、各ワーカーに割り当てて
+    結果を1つの配列に集めます。
+    """
+
+    def __init__(self, script_path, workers=None, freefem_path="FreeFem++", shm_size=1024*1024,
+                 timeout=60, env=None, pin=True, verbose=False):
+        """
+        初期化
+
+        Parameters
+        ----------
+        script_path : str
+            ワーカーとして実行するFreeFEMスクリプトのパス
+        workers : int, optional
+            ワーカー数（Noneの場合は使用できるコア数）
+        freefem_path : str, default="FreeFem++"
+            FreeFEM実行ファイルのパス
+        shm_size : int, default=1MB
+            各ワーカーの共有メモリセグメントの初期サイズ（バイト単位）。
+            1回の評価で受け渡す量以上にしておくと、評価中にセグメントが拡張されない
+        timeout : float, default=60
+            1回の評価のデフォルトタイムアウト時間（秒）
+        env : dict, optional
+            追加の環境変数
+        pin : bool, default=True
+            ワーカーのプロセスをコアに固定するかどうか
+        verbose : bool, default=False
+            FreeFEMの標準出力を表示するかどうか
+        """
+        self.cores = sorted(os.sched_getaffinity(0))
+        if workers is None:
+            workers = len(self.cores)
+        if workers < 1:
+            raise ValueError(f"ワーカー数は1以上である必要があります: {workers}")
+
+        prefix = f"freefem_pool_{uuid.uuid4().hex[:8]}"
+        self.workers = [
+            FreeFEMWorker(script_path, freefem_path=freefem_path, shm_name=f"{prefix}_{i}",
+                          shm_size=shm_size, timeout=timeout, env=env, verbose=verbose)
+            for i in range(workers)
+        ]
+        self.pin = pin
+        self.verbose = verbose
+        self._lock = threading.Lock()
+        self._ranges = []
+
+    def __enter__(self):
+        return self.start()
+
+    def __exit__(self, exc_type, exc_value, traceback):
+        self.stop()
+
+    def __len__(self):
+        return len(self.workers)
+
+    def start(self):
+        """
+        すべてのワーカーを起動し、コアに固定
+
+        Returns
+        -------
+        FreeFEMWorkerPool
+            自分自身（with文で使用するため）
+        """
+        try:
+            for i, worker in enumerate(self.workers):
+                worker.start()
+                if self.pin:
+                    core = self.cores[i % len(self.cores)]
+                    try:
+                        os.sched_setaffinity(worker.process.pid, {core})
+                    except OSError as e:
+                        print(f"警告: ワーカー {i} をコア {core} に固定できません ({e})")
+        except Exception:
+            self.stop()
+            raise
+        return self
+
+    def stop(self, timeout=10):
+        """
+        すべてのワーカーを停止して共有メモリを削除
+
+        Parameters
+        ----------
+        timeout : float, default=10
+            各ワーカーの終了を待つ時間（秒）
+        """
+        for worker in self.workers:
+            worker.stop(timeout)
+
+    def _next_job(self, index):
+        """ワーカー index が次に処理するジョブ番号を取得（無ければNone）"""
+        with self._lock:
+            own = self._ranges[index]
+            if own[0] >= own[1]:
+                # 残りの最も多いワーカーから後半を奪う
+                victim = max(self._ranges, key=lambda r: r[1] - r[0])
+                remaining = victim[1] - victim[0]
+                if remaining <= 0:
+                    return None
+                middle = victim[1] - remaining // 2 if remaining > 1 else victim[0]
+                own[0], own[1] = middle, victim[1]
+                victim[1] = middle
+            job = own[0]
+            own[0] += 1
+            return job
+
+    def map(self, jobs, output_key, out=None, output_shape=(), dtype=np.float64, timeout=None):
+        """
+        ジョブを並列に評価し、各ジョブの結果を1つの配列に集める
+
+        Parameters
+        ----------
+        jobs : sequence of dict
+            ジョブごとに共有メモリへ書き込む変数（FreeFEMWorker.call と同じ形式）
+        output_key : str
+            ワーカーが結果を書き込む配列の変数名
+        out : numpy.ndarray, optional
+            結果を書き込む配列（形状は (len(jobs), ...)、i行目がi番目のジョブの結果）
+        output_shape : tuple, default=()
+            out を省略した場合の1ジョブ分の結果の形状
+        dtype : numpy.dtype, default=float64
+            out を省略した場合のデータ型
+        timeout : float, optional
+            1回の評価のタイムアウト秒数
+
+        Returns
+        -------
+        numpy.ndarray
+            結果の配列（out を指定した場合は out）
+
+        Raises
+        ------
+        FreeFEMExecutionError
+            いずれかの評価が失敗した場合（最初の例外を送出し、残りのジョブは処理しない）
+        """
+        count = len(jobs)
+        if out is None:
+            out = np.empty((count,) + tuple(output_shape), dtype=dtype)
+        elif len(out) != count:
+            raise ValueError(f"出力先の行数がジョブ数と一致しません: {len(out)} != {count}")
+
+        # ジョブ番号の範囲をワーカーごとに等分する
+        n = len(self.workers)
+        self._ranges = [[count * i // n, count * (i + 1) // n] for i in range(n)]
+        errors = []
+
+        def run(index):
+            worker = self.workers[index]
+            try:
+                while not errors:
+                    job = self._next_job(index)
+                    if job is None:
+                        return
+                    worker.call(jobs[job], timeout)
+                    row = out[job:job + 1] if out.ndim == 1 else out[job]
+                    worker.shm.read_array(output_key, out=row)
+            except BaseException as e:
+                errors.append(e)
+
+        threads = [threading.Thread(target=run, args=(i,), name=f"freefem-pool-{i}") for i in range(n)]
+        for thread in threads:
+            thread.start()
+        for thread in threads:
+            thread.join()
+
+        if errors:
+            raise errors[0]
+        return out
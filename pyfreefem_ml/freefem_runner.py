@@ -10,8 +10,49 @@ import time
 import subprocess
 import tempfile
 import platform
+import mmap
+import glob
 from pathlib import Path
 from .errors import FreeFEMExecutionError, FileOperationError
+from .shm_layout import SEGMENT_VERSION
+
+# 共有メモリプラグインと、そのファイルに埋め込まれたバージョン（shm_implementation.cpp と一致させること）
+SHM_PLUGIN_NAME = "mmap-semaphore"
+SHM_PLUGIN_VERSION_TAG = b"pyfreefem-shm-plugin/"
+
+
+def read_plugin_version(path):
+    """
+    プラグインのファイルに埋め込まれたバージョンを読み取る（FreeFEMは起動しない）
+
+    プラグインはFreeFEM本体のシンボルを参照するため、FreeFEMの外では dlopen できません。
+    代わりにファイルをマッピングして pyfreefem_shm_plugin_version の文字列を探します。
+
+    Parameters
+    ----------
+    path : str
+        プラグインのファイルパス
+
+    Returns
+    -------
+    int or None
+        バージョン（セグメントのレイアウト）、埋め込まれていない場合はNone
+    """
+    with open(path, 'rb') as f:
+        if os.fstat(f.fileno()).st_size == 0:
+            return None
+        with mmap.mmap(f.fileno(), 0, access=mmap.ACCESS_READ) as data:
+            start = data.find(SHM_PLUGIN_VERSION_TAG)
+            if start < 0:
+                return None
+            start += len(SHM_PLUGIN_VERSION_TAG)
+            end = data.find(b"\0", start, start + 16)
+            if end < 0:
+                return None
+            try:
+                return int(data[start:end])
+            except ValueError:
+                return None
 
 class FreeFEMRunner:
     """
@@ -327,7 +368,74 @@ class FreeFEMRunner:
                 f"FreeFEMスクリプトの実行中にエラーが発生しました: {str(e)}",
                 script_path=script_path
             ) from e
-    
+
+    def start_worker(self, script_path, shm_size=1024*1024, env=None):
+        """
+        FreeFEMスクリプトを常駐ワーカーとして起動
+
+        スクリプトは shmWaitCommand/shmPostResult のループで処理を繰り返す必要があります。
+
+        Parameters
+        ----------
+        script_path : str
+            ワーカーとして実行するFreeFEMスクリプトのパス
+        shm_size : int, default=1MB
+            ワーカー用の共有メモリセグメントの初期サイズ（バイト単位）
+        env : dict, optional
+            環境変数の辞書
+
+        Returns
+        -------
+        FreeFEMWorker
+            起動済みのワーカー（call() で処理を依頼し、stop() で終了する）
+        """
+        if not self.freefem_path:
+            raise FreeFEMExecutionError(
+                "FreeFEM実行ファイルが設定されていません",
+                script_path=script_path
+            )
+
+        from .freefem_worker import FreeFEMWorker
+        worker = FreeFEMWorker(script_path, freefem_path=self.freefem_path, shm_size=shm_size,
+                               timeout=self.timeout, env=env, verbose=self.verbose)
+        return worker.start()
+
+    def start_pool(self, script_path, workers=None, shm_size=1024*1024, env=None, pin=True):
+        """
+        FreeFEMスクリプトを複数の常駐ワーカーとして起動
+
+        独立した多数の評価は map() で並列に処理できます（ワーカーごとに専用の共有メモリを使用）。
+
+        Parameters
+        ----------
+        script_path : str
+            ワーカーとして実行するFreeFEMスクリプトのパス
+        workers : int, optional
+            ワーカー数（Noneの場合は使用できるコア数）
+        shm_size : int, default=1MB
+            各ワーカーの共有メモリセグメントの初期サイズ（バイト単位）
+        env : dict, optional
+            環境変数の辞書
+        pin : bool, default=True
+            ワーカーのプロセスをコアに固定するかどうか
+
+        Returns
+        -------
+        FreeFEMWorkerPool
+            起動済みのプール（map() で処理を依頼し、stop() で終了する）
+        """
+        if not self.freefem_path:
+            raise FreeFEMExecutionError(
+                "FreeFEM実行ファイルが設定されていません",
+                script_path=script_path
+            )
+
+        from .freefem_pool import FreeFEMWorkerPool
+        pool = FreeFEMWorkerPool(script_path, workers=workers, freefem_path=self.freefem_path,
+                                 shm_size=shm_size, timeout=self.timeout, env=env, pin=pin,
+                                 verbose=self.verbose)
+        return pool.start()
+
     def create_temp_script(self, script_content, suffix=".edp"):
         """
         一時的なFreeFEMスクリプトファイルを作成
@@ -365,10 +473,53 @@ class FreeFEMRunner:
                 operation='write'
             ) from e
     
+    def find_plugin(self, plugin_name, plugin_dir=None):
+        """
+        FreeFEMが load で読み込むプラグインのファイルを探す
+
+        plugin_dir、環境変数 FFPP_LOADPATH、カレントディレクトリ、~/.ff++/lib、
+        FreeFEMのインストール先の lib/ff++/<バージョン>/lib の順に探します。
+
+        Parameters
+        ----------
+        plugin_name : str
+            プラグイン名（.soや.dllなどの拡張子は不要）
+        plugin_dir : str, optional
+            プラグインが配置されているディレクトリ
+
+        Returns
+        -------
+        str or None
+            見つかったファイルのパス、見つからない場合はNone
+        """
+        suffix = ".dll" if platform.system() == "Windows" else ".so"
+        dirs = [plugin_dir] if plugin_dir else []
+        for entry in os.environ.get("FFPP_LOADPATH", "").replace(";", os.pathsep).split(os.pathsep):
+            dirs.append(entry)
+        dirs += [os.getcwd(), os.path.expanduser("~/.ff++/lib")]
+        prefixes = ["/usr/local", "/usr"]
+        if self.freefem_path and os.path.isabs(self.freefem_path):
+            prefixes.insert(0, os.path.dirname(os.path.dirname(self.freefem_path)))
+        for prefix in prefixes:
+            dirs += sorted(glob.glob(os.path.join(prefix, "lib", "ff++", "*", "lib")), reverse=True)
+            dirs += sorted(glob.glob(os.path.join(prefix, "lib", "ff++", "*")), reverse=True)
+        
+        for directory in dirs:
+            if directory:
+                path = os.path.join(directory, plugin_name + suffix)
+                if os.path.isfile(path):
+                    return path
+        return None
+    
     def check_plugin_availability(self, plugin_name, plugin_dir=None):
         """
         FreeFEMプラグインが利用可能かどうかを確認
 
+        プラグインのファイルが見つかればFreeFEMを起動せずに判定します
+        （共有メモリプラグインは埋め込まれたバージョンがセグメントのレイアウトと
+        一致するかも確認します）。見つからない場合やWSL経由の場合のみ、
+        プラグインを読み込むだけのスクリプトをFreeFEMで実行して確認します。
+
         Parameters
         ----------
         plugin_name : str
@@ -386,6 +537,24 @@ class FreeFEMRunner:
         FreeFEMExecutionError
             FreeFEM実行エラーが発生した場合
         """
+        path = None if self._is_wsl_environment() else self.find_plugin(plugin_name, plugin_dir)
+        if path:
+            if plugin_name != SHM_PLUGIN_NAME:
+                return True
+            try:
+                version = read_plugin_version(path)
+            except OSError as e:
+                if self.verbose:
+                    print(f"プラグインチェック中にエラー: {str(e)}")
+                return False
+            if version != SEGMENT_VERSION:
+                print(f"警告: プラグイン {path} のバージョン（{version}）がセグメントのレイアウト"
+                      f"（{SEGMENT_VERSION}）と一致しません。プラグインを再ビルドしてください")
+                return False
+            if self.verbose:
+                print(f"プラグインを確認しました: {path}（バージョン {version}）")
+            return True
+        
         # テストスクリプトを作成
         test_script = f"""
         try {{
@@ -0,0 +1,295 @@
+"""
+Python-FreeFEM共有データ通信ライブラリの常駐ワーカーモジュール
+
+FreeFEMスクリプトを1度だけ起動して常駐させ、共有メモリ上のコマンドチャネルで
+繰り返し処理を依頼します。メッシュやプラグインの読み込みなど起動時の処理を
+呼び出しごとに繰り返さずに済みます。
+
+ワーカー側のスクリプトは次のような形になります::
+
+    load "mmap-semaphore"
+    mesh Th = square(100, 100);   // 起動時に1度だけ行う処理
+    while (shmWaitCommand() > 0) {
+        real[int] x(1);
+        readSharedMemory(getenv("FF_SHM_NAME"), "x", x);
+        ...                        // 1回分の処理
+        shmPostResult(0);
+    }
+"""
+
+import os
+import tempfile
+import subprocess
+import uuid
+import numpy as np
+
+from .shm_manager import SharedMemoryManager
+from . import shm_layout
+from . import shm_sync
+from .errors import FreeFEMExecutionError, FileOperationError
+
+# コマンドチャネルの予約エントリ（shm_transport.hpp と一致させること）
+WORKER_COMMAND_KEY = "__worker_cmd"
+WORKER_RESULT_KEY = "__worker_done"
+WORKER_RUN = 1
+WORKER_STOP = 2
+
+# call(scalars=...) が書き込むパラメータブロック（shmGetParams で読み込む）
+WORKER_PARAMS_KEY = "params"
+
+# プロセスの終了を確認する間隔（秒）
+POLL_INTERVAL = 0.5
+
+
+class FreeFEMWorker:
+    """
+    常駐FreeFEMワーカー
+
+    1つのFreeFEMプロセスと専用の共有メモリセグメントを保持し、
+    call() のたびにパラメータを書き込んでコマンドを送り、結果を待ちます。
+    """
+
+    def __init__(self, script_path, freefem_path="FreeFem++", shm_name=None,
+                 shm_size=1024*1024, timeout=60, env=None, verbose=False):
+        """
+        初期化
+
+        Parameters
+        ----------
+        script_path : str
+            ワーカーとして実行するFreeFEMスクリプトのパス
+        freefem_path : str, default="FreeFem++"
+            FreeFEM実行ファイルのパス
+        shm_name : str, optional
+            共有メモリセグメントの名前（Noneの場合は自動生成）
+        shm_size : int, default=1MB
+            共有メモリセグメントの初期サイズ（バイト単位）
+        timeout : float, default=60
+            1回の呼び出しのデフォルトタイムアウト時間（秒）
+        env : dict, optional
+            追加の環境変数
+        verbose : bool, default=False
+            FreeFEMの標準出力を表示するかどうか
+        """
+        if not os.path.exists(script_path):
+            raise FileOperationError(
+                "スクリプトファイルが見つかりません",
+                file_path=script_path,
+                operation='read'
+            )
+
+        self.script_path = script_path
+        self.freefem_path = freefem_path
+        self.shm_name = shm_name or f"freefem_worker_{uuid.uuid4().hex[:8]}"
+        self.shm_size = shm_size
+        self.timeout = timeout
+        self.env = env
+        self.verbose = verbose
+
+        self.shm = None
+        self.process = None
+        self._stderr = None
+        self._next_id = 1
+
+    def __enter__(self):
+        return self.start()
+
+    def __exit__(self, exc_type, exc_value, traceback):
+        self.stop()
+
+    def _prepare_env(self):
+        """ワーカー用の環境変数を準備"""
+        env = os.environ.copy()
+        if self.env:
+            env.update(self.env)
+        env['FF_SHM_NAME'] = self.shm_name
+        env['FF_SHM_SIZE'] = str(self.shm_size)
+
+        # プラグインパスが設定されていない場合はインストーラから取得する
+        if 'FF_LOADPATH' not in env:
+            try:
+                from .plugin_installer import PluginInstaller
+                env.update(PluginInstaller().setup_environment())
+            except Exception as e:
+                if self.verbose:
+                    print(f"警告: プラグインパスを設定できませんでした: {str(e)}")
+        return env
+
+    def start(self):
+        """
+        共有メモリセグメントを作成し、ワーカープロセスを起動
+
+        Returns
+        -------
+        FreeFEMWorker
+            自分自身（with文で使用するため）
+        """
+        if self.process is not None:
+            return self
+
+        self.shm = SharedMemoryManager(self.shm_name, self.shm_size)
+
+        # 標準出力は読まないのでパイプにしない（バッファが詰まって停止するのを防ぐ）
+        self._stderr = tempfile.TemporaryFile(mode='w+')
+        cmd = [self.freefem_path, "-v", "0", "-nw", self.script_path]
+        try:
+            self.process = subprocess.Popen(
+                cmd,
+                stdin=subprocess.DEVNULL,
+                stdout=None if self.verbose else subprocess.DEVNULL,
+                stderr=self._stderr,
+                env=self._prepare_env()
+            )
+        except Exception as e:
+            self._release()
+            raise FreeFEMExecutionError(
+                f"ワーカーの起動に失敗しました: {str(e)}",
+                script_path=self.script_path
+            ) from e
+
+        if self.verbose:
+            print(f"ワーカーを起動しました: PID {self.process.pid}, 共有メモリ '{self.shm_name}'")
+        return self
+
+    def is_alive(self):
+        """ワーカープロセスが動作中かどうか"""
+        return self.process is not None and self.process.poll() is None
+
+    def _read_stderr(self):
+        """ワーカーの標準エラー出力を取得"""
+        if self._stderr is None:
+            return ""
+        self._stderr.seek(0)
+        return self._stderr.read()
+
+    def _fail(self, message):
+        """ワーカーを停止して例外を送出"""
+        return_code = self.process.poll() if self.process is not None else None
+        stderr = self._read_stderr()
+        self._terminate()
+        self._release()
+        raise FreeFEMExecutionError(
+            message,
+            script_path=self.script_path,
+            return_code=return_code,
+            stderr=stderr
+        )
+
+    def _write_param(self, key, value):
+        """パラメータを型に応じて共有メモリに書き込み"""
+        if isinstance(value, (bool, int, np.integer)):
+            self.shm.write_int(key, int(value))
+        elif isinstance(value, (float, np.floating)):
+            self.shm.write_double(key, float(value))
+        elif isinstance(value, str):
+            self.shm.write_string(key, value)
+        else:
+            array = np.asarray(value)
+            if np.issubdtype(array.dtype, np.integer):
+                self.shm.write_int_array(key, array)
+            else:
+                self.shm.write_array(key, array)
+
+    def _send(self, op):
+        """コマンドを書き込み、そのIDと世代番号を返す"""
+        command_id = self._next_id
+        self._next_id += 1
+        self.shm.write_array(WORKER_COMMAND_KEY, [command_id, op], dtype=np.int64)
+        return command_id, self.shm.layout.find(WORKER_COMMAND_KEY).generation
+
+    def call(self, params=None, timeout=None, scalars=None):
+        """
+        ワーカーに1回分の処理を依頼して完了を待機
+
+        Parameters
+        ----------
+        params : dict, optional
+            処理前に共有メモリへ書き込む変数（int, float, str, 配列）
+        timeout : float, optional
+            タイムアウト秒数（Noneの場合はインスタンス作成時の設定を使用）
+        scalars : dict, optional
+            パラメータブロック "params" に書き込むスカラー（int, float, str）。
+            ワーカー側は shmGetParams(getenv("FF_SHM_NAME"), "params", "dt,n", dt, n) で
+            1回で読み込める。名前と種類が同じなら呼び出しごとにその場で更新される
+
+        Returns
+        -------
+        int
+            ワーカーが shmPostResult で返した状態値
+
+        Raises
+        ------
+        FreeFEMExecutionError
+            ワーカーが終了した、タイムアウトした、または負の状態値を返した場合
+        """
+        if not self.is_alive():
+            self._fail("ワーカーが起動していません")
+
+        for key, value in (params or {}).items():
+            self._write_param(key, value)
+        if scalars:
+            self.shm.write_params(WORKER_PARAMS_KEY, scalars)
+
+        command_id, generation = self._send(WORKER_RUN)
+
+        def done():
+            entry = self.shm.layout.find(WORKER_RESULT_KEY)
+            return entry is not None and entry.generation >= generation
+
+        # プロセスの異常終了を検出できるよう、短い間隔で区切って待機する
+        remaining = timeout or self.timeout
+        while not shm_sync.wait_until(self.shm.memory, done, min(remaining, POLL_INTERVAL)):
+            remaining -= POLL_INTERVAL
+            if not self.is_alive():
+                self._fail("ワーカーが処理中に終了しました")
+            if remaining <= 0:
+                self._fail(f"ワーカーの処理がタイムアウトしました（{timeout or self.timeout}秒）")
+
+        result_id, status = (int(v) for v in self.shm.read_int_array(WORKER_RESULT_KEY)[:2])
+        if result_id != command_id:
+            self._fail(f"コマンドIDが一致しません（送信: {command_id}, 結果: {result_id}）")
+        if status < 0:
+            raise FreeFEMExecutionError(
+                f"ワーカーがエラーを返しました（状態: {status}）",
+                script_path=self.script_path,
+                return_code=status,
+                stderr=self._read_stderr()
+            )
+        return status
+
+    def stop(self, timeout=10):
+        """
+        ワーカーに停止コマンドを送り、終了を待って共有メモリを削除
+
+        Parameters
+        ----------
+        timeout : float, default=10
+            終了を待つ時間（秒）。超えた場合は強制終了する
+        """
+        if self.process is not None:
+            if self.is_alive():
+                self._send(WORKER_STOP)
+            self._terminate(timeout)
+        self._release()
+
+    def _terminate(self, timeout=0):
+        """プロセスの終了を待ち、終了しなければ強制終了"""
+        if self.process is None:
+            return
+        try:
+            self.process.wait(timeout=timeout)
+        except subprocess.TimeoutExpired:
+            self.process.kill()
+            self.process.wait()
+        if self.verbose:
+            print(f"ワーカーが終了しました: 終了コード {self.process.returncode}")
+
+    def _release(self):
+        """共有メモリと一時ファイルを解放"""
+        if self.shm is not None:
+            self.shm.destroy()
+            self.shm = None
+        if self._stderr is not None:
+            self._stderr.close()
+            self._stderr = None
+        self.process = None
@@ -0,0 +1,277 @@
+#!/usr/bin/env python
+# -*- coding: utf-8 -*-
+
+"""
+bench_transfer.py
+Python側から共有メモリ転送の往復時間・帯域を計測するベンチマーク
+
+shm_bench.cpp と同じ計測を、Python側の実装（SharedMemoryManager / BufferedChannel /
+RingBuffer / file_io）を送信側として行います。エコー側には C++ の転送コアを直接使う
+`shm_bench --echo` を起動するため、FreeFEMを経由しない転送そのものの時間が得られます。
+出力の列は shm_bench と同じです。posix-huge は posix と同じエントリを、ヒュージページと
+マッピング時の割り当て（hugepages / populate）を指定したセグメントで送ります。
+
+measure() は transport_tuning.py の計測にも使われます（shm_bench がない場合は
+同じプロセス内で送受信します）。
+
+使い方:
+    make -C plugins bench-python BENCH_MAX_BYTES=4G
+    python plugins/bench/bench_transfer.py --transport posix,ring --max-bytes 16M --csv
+"""
+
+import os
+import io
+import sys
+import time
+import argparse
+import contextlib
+import subprocess
+import numpy as np
+from pathlib import Path
+
+# パッケージ（pyfreefem_ml）を含むディレクトリをパスに追加
+sys.path.insert(0, str(Path(__file__).resolve().parents[3]))
+
+from pyfreefem_ml import file_io
+from pyfreefem_ml import shm_sync
+from pyfreefem_ml.shm_manager import SharedMemoryManager, BufferedChannel, RingBuffer
+
+TRANSPORTS = ('posix', 'posix-huge', 'channel', 'ring', 'file', 'zfile')
+IDLE_TIMEOUT = 3600.0            # shm_bench.cpp の BENCH_IDLE_TIMEOUT_SEC と同じ
+TARGET_BYTES = 256 << 20         # shm_bench.cpp の BENCH_TARGET_BYTES と同じ
+MIN_ITERATIONS = 3
+MAX_ITERATIONS = 2000
+DEFAULT_BENCH = Path(__file__).resolve().parent / 'shm_bench'
+
+
+def _quiet():
+    """セグメントの解放メッセージを計測結果に混ぜない"""
+    return contextlib.redirect_stdout(io.StringIO())
+
+
+def _backoff(spins):
+    """通知のない転送方式の待機（shm_bench.cpp の bench_backoff と同じ）"""
+    if spins < shm_sync.SPIN_ITERATIONS:
+        return spins + 1
+    os.sched_yield()
+    return spins
+
+
+class PosixTransport:
+    """セグメント内のエントリ（世代番号が進むまでfutexで待機する）"""
+
+    mapping = {}
+
+    def __init__(self, name, elements, directory):
+        self.shm = SharedMemoryManager(name, size=2 * elements * 8 + (1 << 16), **self.mapping)
+        self.seen = {}
+
+    def send(self, key, array):
+        self.shm.write_array(key, array)
+
+    def receive(self, key):
+        seen = self.seen.get(key, 0)
+
+        def arrived():
+            entry = self.shm.layout.find(key)
+            return entry is not None and entry.generation > seen
+
+        if not shm_sync.wait_until(self.shm.memory, arrived, IDLE_TIMEOUT):
+            raise TimeoutError(f"'{key}' が届きません")
+        self.seen[key] = self.shm._get_var_info(key).generation
+        return self.shm.read_array(key)
+
+    def close(self):
+        with _quiet():
+            self.shm.destroy()
+
+
+class HugepagePosixTransport(PosixTransport):
+    """ヒュージページを使い、マッピング時にページを割り当てるセグメント（エコー側は posix と同じ）"""
+
+    mapping = {'hugepages': True, 'populate': True}
+    echo = 'posix'
+
+
+class ChannelTransport:
+    """多重バッファのチャネル（"ping" と "pong" の2つのチャネルを使う）"""
+
+    def __init__(self, name, elements, directory):
+        self.shm = SharedMemoryManager(name, size=6 * elements * 8 + (1 << 16))
+        self.channels = {key: BufferedChannel(self.shm, key, buffers=2) for key in ('ping', 'pong')}
+
+    def send(self, key, array):
+        if not self.channels[key].write(array, timeout=IDLE_TIMEOUT):
+            raise TimeoutError(f"チャネル '{key}' のバッファが返却されません")
+
+    def receive(self, key):
+        array = self.channels[key].read(timeout=IDLE_TIMEOUT)
+        if array is None:
+            raise TimeoutError(f"チャネル '{key}' のフレームが届きません")
+        return array
+
+    def close(self):
+        with _quiet():
+            self.shm.destroy()
+
+
+class RingTransport:
+    """SPSCリングバッファ（"<name>_ping" と "<name>_pong" の2つを使う）"""
+
+    def __init__(self, name, elements, directory):
+        self.rings = {key: RingBuffer(f"{name}_{key}", max(elements, 1), 2) for key in ('ping', 'pong')}
+
+    def send(self, key, array):
+        spins = 0
+        while not self.rings[key].push(array):
+            spins = _backoff(spins)
+
+    def receive(self, key):
+        spins = 0
+        while True:
+            array = self.rings[key].pop()
+            if array is not None:
+                return array
+            spins = _backoff(spins)
+
+    def close(self):
+        for ring in self.rings.values():
+            ring.destroy()
+
+
+class FileTransport:
+    """バイナリファイル（rename で公開されたファイルの出現をポーリングし、読んだら削除する）"""
+
+    compress = False
+
+    def __init__(self, name, elements, directory):
+        self.paths = {key: Path(directory) / f"{name}.{key}.bin" for key in ('ping', 'pong')}
+        self.close()
+
+    def send(self, key, array):
+        file_io.write_binary_array(self.paths[key], array, self.compress)
+
+    def receive(self, key):
+        path = self.paths[key]
+        spins = shm_sync.SPIN_ITERATIONS
+        while not path.exists():
+            spins = _backoff(spins)
+        array = file_io.load_binary_array(path, copy=True)
+        path.unlink()
+        return array
+
+    def close(self):
+        for path in self.paths.values():
+            with contextlib.suppress(FileNotFoundError):
+                path.unlink()
+
+
+class CompressedFileTransport(FileTransport):
+    """圧縮形式のバイナリファイル（それ以外は FileTransport と同じ）"""
+
+    compress = True
+
+
+TRANSPORT_CLASSES = {
+    'posix': PosixTransport,
+    'posix-huge': HugepagePosixTransport,
+    'channel': ChannelTransport,
+    'ring': RingTransport,
+    'file': FileTransport,
+    'zfile': CompressedFileTransport,
+}
+
+
+def measure(bench, transport, name, nbytes, directory, target_bytes=TARGET_BYTES):
+    """1つの大きさの往復時間を計測
+
+    Args:
+        bench: エコー側に使う shm_bench。None の場合はエコー側を起動せず、同じプロセス内で
+            送ったものを受け取る（1回の往復は書き込みと読み込みの1回ずつになる）
+        target_bytes: 計測回数の目安（計測で転送する合計の大きさ）
+
+    Returns:
+        tuple: (計測回数, 最小 [ns], 中央値 [ns])
+    """
+    elements = max(nbytes // 8, 1)
+    cls = TRANSPORT_CLASSES[transport]
+    channel = cls(name, elements, directory)
+    echo = None
+    if bench is not None:
+        echo = subprocess.Popen([str(bench), '--echo', getattr(cls, 'echo', transport), name,
+                                 '--dir', str(directory)])
+    reply = 'pong' if echo else 'ping'
+    try:
+        data = np.arange(elements, dtype=np.float64)
+        iterations = min(MAX_ITERATIONS, max(MIN_ITERATIONS, target_bytes // nbytes))
+        samples = []
+        # 1回目はページの割り当てとマッピングの拡張を含むため計測しない
+        for i in range(iterations + 1):
+            start = time.perf_counter_ns()
+            channel.send('ping', data)
+            echoed = channel.receive(reply)
+            end = time.perf_counter_ns()
+            if i > 0:
+                samples.append(end - start)
+        if echoed.size != elements or echoed[-1] != data[-1]:
+            raise RuntimeError(f"エコーされた配列が一致しません ({nbytes} バイト)")
+    finally:
+        if echo:
+            echo.terminate()
+            echo.wait()
+        channel.close()
+
+    samples.sort()
+    return len(samples), samples[0], samples[len(samples) // 2]
+
+
+def parse_bytes(text):
+    """'64M' のような大きさを解析"""
+    units = {'k': 1 << 10, 'm': 1 << 20, 'g': 1 << 30}
+    scale = units.get(text[-1:].lower(), 1)
+    value = float(text[:-1] if scale > 1 else text) * scale
+    if value < 1:
+        raise argparse.ArgumentTypeError(f"大きさの指定が不正です: {text}")
+    return int(value)
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Python側から共有メモリ転送の往復時間・帯域を計測します")
+    parser.add_argument('--transport', default=','.join(TRANSPORTS),
+                        help="計測する転送方式（カンマ区切り）")
+    parser.add_argument('--min-bytes', type=parse_bytes, default=1024)
+    parser.add_argument('--max-bytes', type=parse_bytes, default=64 << 20)
+    parser.add_argument('--dir', default='/tmp', help="file方式で使うディレクトリ")
+    parser.add_argument('--csv', action='store_true', help="CSV形式で出力する")
+    parser.add_argument('--bench', type=Path, default=DEFAULT_BENCH,
+                        help="エコー側に使う shm_bench（make -C plugins bench でビルドされる）")
+    args = parser.parse_args()
+
+    transports = args.transport.split(',')
+    for transport in transports:
+        if transport not in TRANSPORT_CLASSES:
+            parser.error(f"未知の転送方式です: {transport}")
+    if not args.bench.exists():
+        parser.error(f"shm_bench が見つかりません: {args.bench}")
+
+    if args.csv:
+        print("transport,bytes,iterations,min_us,median_us,gbps")
+    else:
+        print(f"{'transport':<10}{'bytes':>14}{'iters':>8}{'min [us]':>14}{'median [us]':>14}{'GB/s':>10}")
+    name = f"pyff_bench_py_{os.getpid()}"
+    for transport in transports:
+        nbytes = args.min_bytes
+        while nbytes <= args.max_bytes:
+            iterations, min_ns, median_ns = measure(args.bench, transport, name, nbytes, args.dir)
+            gbps = 2.0 * nbytes / median_ns
+            if args.csv:
+                print(f"{transport},{nbytes},{iterations},{min_ns / 1e3},{median_ns / 1e3},{gbps}")
+            else:
+                print(f"{transport:<10}{nbytes:>14}{iterations:>8}{min_ns / 1e3:>14.2f}"
+                      f"{median_ns / 1e3:>14.2f}{gbps:>10.2f}")
+            sys.stdout.flush()
+            nbytes *= 4
+
+
+if __name__ == '__main__':
+    main()
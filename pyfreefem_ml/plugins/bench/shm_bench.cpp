@@ -0,0 +1,440 @@
+// 共有メモリ転送のマイクロベンチマーク（FreeFEMを使わずに転送コアを直接呼び出す）
+//
+// 転送方式ごとに、エコー側の子プロセスとの往復（ping を送り、同じ配列が pong で返るまで）を
+// 配列の大きさを変えながら計測し、往復時間と実効帯域（往復で2回転送した合計バイト数 / 往復時間）を出力する。
+//   posix    セグメント内のエントリ（shm_begin_write / shm_acquire_entry、futexで通知）
+//   channel  多重バッファのチャネル（shm_channel_*）
+//   ring     SPSCリングバッファ（ring_push / ring_front、スピンとsched_yieldで待機）
+//   file     バイナリファイル（shm_binary_file.hpp の形式、一時ファイルの rename とポーリング）
+//   zfile    圧縮形式のバイナリファイル（バイト列の並べ替えとzlib、それ以外は file と同じ）
+//
+// 使い方:
+//   shm_bench [--transport posix,channel,ring,file,zfile] [--min-bytes 1K] [--max-bytes 64M] [--dir /tmp] [--csv]
+//   shm_bench --echo <transport> <name> [--dir /tmp]
+// --echo はエコー側だけを実行する（Python側のドライバー bench_transfer.py が起動する）。
+// 大きさは 1K から4倍ずつ --max-bytes まで計測する（4 GBまで計測する場合は --max-bytes 4G）。
+
+#include "shm_transport.hpp"
+#include "shm_stats.hpp"
+#include "shm_binary_file.hpp"
+
+#include <iostream>
+#include <iomanip>
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <map>
+#include <string>
+#include <vector>
+#include <signal.h>
+#include <sched.h>
+#include <unistd.h>
+#include <sys/wait.h>
+
+using namespace std;
+
+static const double BENCH_IDLE_TIMEOUT_SEC = 3600.0;    // エコー側が次の ping を待つ最大時間
+static const size_t BENCH_TARGET_BYTES = 256 << 20;     // 1つの大きさで往復させる目安のバイト数
+static const size_t BENCH_MIN_ITERATIONS = 3;
+static const size_t BENCH_MAX_ITERATIONS = 2000;
+
+static const char* const BENCH_TRANSPORTS[] = { "posix", "channel", "ring", "file", "zfile" };
+
+// 通知のない転送方式の待機：しばらくスピンし、到着しなければCPUを譲る
+// （コア数が少ない環境でスピンし続けると、相手のプロセスがタイムスライスの終わりまで動けない）
+static void bench_backoff(int* spins) {
+    if (++*spins < SHM_SPIN_ITERATIONS) {
+        shm_cpu_relax();
+    } else {
+        sched_yield();
+    }
+}
+
+// 1つの転送方式（計測側とエコー側で同じオブジェクトを使う）
+class Transport {
+public:
+    virtual ~Transport() {}
+    // 計測側：elements 要素の配列を転送できるよう共有メモリなどを作成する
+    virtual bool setup(size_t elements) = 0;
+    // 計測側：setup() で作成したものを削除する
+    virtual void teardown() = 0;
+    // 配列を key（"ping" または "pong"）として送る
+    virtual bool send(const char* key, const double* src, size_t elements) = 0;
+    // key として送られた次の配列を受け取る
+    virtual bool receive(const char* key, vector<double>* dst) = 0;
+};
+
+// セグメント内のエントリ（世代番号が進むまでfutexで待機する）
+class PosixTransport : public Transport {
+    string name;
+    map<string, uint64_t> seen;
+
+public:
+    explicit PosixTransport(const string& name) : name(name) {}
+
+    bool setup(size_t elements) {
+        seen.clear();
+        return shm_open_segment(name.c_str(), 2 * elements * sizeof(double)) >= 0;
+    }
+
+    void teardown() {
+        shm_destroy_segment(name.c_str());
+    }
+
+    bool send(const char* key, const double* src, size_t elements) {
+        ShmEntryRef ref;
+        if (!shm_begin_write(name.c_str(), key, SHM_DTYPE_FLOAT64, elements, &ref)) {
+            return false;
+        }
+        memcpy(shm_entry_data(ref), src, elements * sizeof(double));
+        shm_end_write(ref, elements);
+        return true;
+    }
+
+    bool receive(const char* key, vector<double>* dst) {
+        uint64_t& last = seen[key];
+        ShmEntryRef ref;
+        if (!shm_acquire_entry(name.c_str(), key, &ref, BENCH_IDLE_TIMEOUT_SEC)) {
+            return false;
+        }
+        SegmentEntry* entry = ref.entry;
+        if (!shm_wait_until(ref.header, [&]() {
+                return __atomic_load_n(&entry->generation, __ATOMIC_ACQUIRE) > last;
+            }, BENCH_IDLE_TIMEOUT_SEC)) {
+            return false;
+        }
+        // 送信側がセグメントを拡張している場合に備えて参照し直す
+        if (!shm_acquire_entry(name.c_str(), key, &ref, 0.0)) {
+            return false;
+        }
+        last = ref.entry->generation;
+        size_t elements = shm_entry_elements(ref);
+        dst->resize(elements);
+        memcpy(dst->data(), shm_entry_data(ref), elements * sizeof(double));
+        shm_end_read(ref, elements * sizeof(double));
+        return true;
+    }
+};
+
+// 多重バッファのチャネル（"ping" と "pong" の2つのチャネルを使う）
+class ChannelTransport : public Transport {
+    string name;
+
+public:
+    explicit ChannelTransport(const string& name) : name(name) {}
+
+    bool setup(size_t elements) {
+        return shm_open_segment(name.c_str(), 6 * elements * sizeof(double)) >= 0
+            && shm_channel_create(name.c_str(), "ping", 2)
+            && shm_channel_create(name.c_str(), "pong", 2);
+    }
+
+    void teardown() {
+        shm_destroy_segment(name.c_str());
+    }
+
+    bool send(const char* key, const double* src, size_t elements) {
+        ShmChannelRef ref;
+        if (!shm_channel_begin_write(name.c_str(), key, SHM_DTYPE_FLOAT64, elements, &ref, BENCH_IDLE_TIMEOUT_SEC)) {
+            return false;
+        }
+        memcpy(shm_entry_data(ref.buffer), src, elements * sizeof(double));
+        shm_channel_end_write(ref, elements);
+        return true;
+    }
+
+    bool receive(const char* key, vector<double>* dst) {
+        ShmChannelRef ref;
+        if (!shm_channel_acquire(name.c_str(), key, &ref, BENCH_IDLE_TIMEOUT_SEC)) {
+            return false;
+        }
+        size_t elements = shm_entry_elements(ref.buffer);
+        dst->resize(elements);
+        memcpy(dst->data(), shm_entry_data(ref.buffer), elements * sizeof(double));
+        shm_channel_release(ref, elements * sizeof(double));
+        return true;
+    }
+};
+
+// SPSCリングバッファ（"<name>_ping" と "<name>_pong" の2つを使い、空き・到着をスピンで待つ）
+class RingTransport : public Transport {
+    string name;
+
+    string ring_name(const char* key) const {
+        return name + "_" + key;
+    }
+
+public:
+    explicit RingTransport(const string& name) : name(name) {}
+
+    bool setup(size_t elements) {
+        long slot_elements = static_cast<long>(max<size_t>(elements, 1));
+        return ring_create(ring_name("ping").c_str(), slot_elements, 2)
+            && ring_create(ring_name("pong").c_str(), slot_elements, 2);
+    }
+
+    void teardown() {
+        shm_destroy_segment(ring_name("ping").c_str());
+        shm_destroy_segment(ring_name("pong").c_str());
+    }
+
+    bool send(const char* key, const double* src, size_t elements) {
+        string ring = ring_name(key);
+        int spins = 0;
+        while (!ring_push(ring.c_str(), src, elements, 1)) {
+            bench_backoff(&spins);
+        }
+        return true;
+    }
+
+    bool receive(const char* key, vector<double>* dst) {
+        string ring = ring_name(key);
+        size_t elements = 0;
+        const double* front;
+        int spins = 0;
+        while (!(front = ring_front(ring.c_str(), &elements))) {
+            bench_backoff(&spins);
+        }
+        dst->assign(front, front + elements);
+        ring_consume(ring.c_str());
+        return true;
+    }
+};
+
+// バイナリファイル（rename で公開されたファイルの出現をポーリングし、読んだら削除する）
+class FileTransport : public Transport {
+    string name;
+    string dir;
+    uint32_t version;
+
+    string path(const char* key) const {
+        return dir + "/" + name + "." + key + ".bin";
+    }
+
+public:
+    FileTransport(const string& name, const string& dir, uint32_t version)
+        : name(name), dir(dir), version(version) {}
+
+    bool setup(size_t) {
+        teardown();
+        return true;
+    }
+
+    void teardown() {
+        remove(path("ping").c_str());
+        remove(path("pong").c_str());
+    }
+
+    bool send(const char* key, const double* src, size_t elements) {
+        uint64_t shape[1] = { elements };
+        return binary_file_write(path(key), binary_file_header(shape, 1, elements, version), src);
+    }
+
+    bool receive(const char* key, vector<double>* dst) {
+        string file = path(key);
+        int spins = SHM_SPIN_ITERATIONS;
+        while (access(file.c_str(), F_OK) != 0) {
+            bench_backoff(&spins);
+        }
+        BinaryFileHeader header;
+        FILE* fp = binary_file_open(file, &header);
+        if (!fp) {
+            return false;
+        }
+        dst->resize(header.nbytes / sizeof(double));
+        bool ok = binary_file_read(fp, header, dst->data());
+        fclose(fp);
+        remove(file.c_str());
+        return ok;
+    }
+};
+
+static Transport* make_transport(const string& transport, const string& name, const string& dir) {
+    if (transport == "posix") {
+        return new PosixTransport(name);
+    }
+    if (transport == "channel") {
+        return new ChannelTransport(name);
+    }
+    if (transport == "ring") {
+        return new RingTransport(name);
+    }
+    if (transport == "file") {
+        return new FileTransport(name, dir, BINARY_FILE_VERSION);
+    }
+    if (transport == "zfile") {
+        return new FileTransport(name, dir, BINARY_FILE_VERSION_COMPRESSED);
+    }
+    cerr << "未知の転送方式です: " << transport << endl;
+    return NULL;
+}
+
+// エコー側：ping を受け取るたびに同じ配列を pong として送り返す
+static int run_echo(Transport* transport) {
+    vector<double> buffer;
+    while (transport->receive("ping", &buffer)) {
+        if (!transport->send("pong", buffer.data(), buffer.size())) {
+            return 1;
+        }
+    }
+    return 1;
+}
+
+// 1つの大きさの計測結果
+struct BenchResult {
+    size_t iterations;
+    double min_ns;
+    double median_ns;
+};
+
+// 計測側：エコー側の子プロセスを起動し、往復時間を計測する
+static bool measure(Transport* transport, size_t bytes, BenchResult* result) {
+    size_t elements = max<size_t>(bytes / sizeof(double), 1);
+    if (!transport->setup(elements)) {
+        return false;
+    }
+
+    pid_t child = fork();
+    if (child < 0) {
+        perror("fork");
+        transport->teardown();
+        return false;
+    }
+    if (child == 0) {
+        _exit(run_echo(transport));
+    }
+
+    vector<double> data(elements), echoed;
+    for (size_t i = 0; i < elements; i++) {
+        data[i] = static_cast<double>(i);
+    }
+    size_t iterations = min(BENCH_MAX_ITERATIONS, max(BENCH_MIN_ITERATIONS, BENCH_TARGET_BYTES / bytes));
+    vector<double> samples;
+    bool ok = true;
+    // 1回目はページの割り当てとマッピングの拡張を含むため計測しない
+    for (size_t i = 0; ok && i <= iterations; i++) {
+        uint64_t start_ns = shm_now_ns();
+        ok = transport->send("ping", data.data(), elements) && transport->receive("pong", &echoed);
+        uint64_t end_ns = shm_now_ns();
+        if (i > 0) {
+            samples.push_back(static_cast<double>(end_ns - start_ns));
+        }
+    }
+    if (ok && (echoed.size() != elements || echoed.back() != data.back())) {
+        cerr << "エコーされた配列が一致しません (" << bytes << " バイト)" << endl;
+        ok = false;
+    }
+
+    kill(child, SIGTERM);
+    waitpid(child, NULL, 0);
+    transport->teardown();
+    if (!ok) {
+        return false;
+    }
+
+    sort(samples.begin(), samples.end());
+    result->iterations = samples.size();
+    result->min_ns = samples.front();
+    result->median_ns = samples[samples.size() / 2];
+    return true;
+}
+
+// "64M" のような大きさを解析する（失敗した場合は0）
+static size_t parse_bytes(const char* text) {
+    char* end;
+    double value = strtod(text, &end);
+    switch (*end) {
+        case 'k': case 'K': value *= 1024.0; end++; break;
+        case 'm': case 'M': value *= 1024.0 * 1024.0; end++; break;
+        case 'g': case 'G': value *= 1024.0 * 1024.0 * 1024.0; end++; break;
+        default: break;
+    }
+    return (*end == '\0' && value >= 1.0) ? static_cast<size_t>(value) : 0;
+}
+
+static int usage() {
+    cerr << "使い方: shm_bench [--transport posix,channel,ring,file,zfile] [--min-bytes 1K] [--max-bytes 64M]"
+         << " [--dir /tmp] [--csv]\n"
+         << "        shm_bench --echo <transport> <name> [--dir /tmp]" << endl;
+    return 2;
+}
+
+int main(int argc, char** argv) {
+    vector<string> transports(BENCH_TRANSPORTS, BENCH_TRANSPORTS + sizeof(BENCH_TRANSPORTS) / sizeof(BENCH_TRANSPORTS[0]));
+    size_t min_bytes = 1024;
+    size_t max_bytes = 64 << 20;
+    string dir = "/tmp";
+    string echo_transport, echo_name;
+    bool csv = false;
+
+    for (int i = 1; i < argc; i++) {
+        string arg = argv[i];
+        if (arg == "--transport" && i + 1 < argc) {
+            transports.clear();
+            string list = argv[++i];
+            for (size_t start = 0, comma; start <= list.size(); start = comma + 1) {
+                comma = list.find(',', start);
+                if (comma == string::npos) {
+                    comma = list.size();
+                }
+                transports.push_back(list.substr(start, comma - start));
+            }
+        } else if (arg == "--min-bytes" && i + 1 < argc) {
+            min_bytes = parse_bytes(argv[++i]);
+        } else if (arg == "--max-bytes" && i + 1 < argc) {
+            max_bytes = parse_bytes(argv[++i]);
+        } else if (arg == "--dir" && i + 1 < argc) {
+            dir = argv[++i];
+        } else if (arg == "--csv") {
+            csv = true;
+        } else if (arg == "--echo" && i + 2 < argc) {
+            echo_transport = argv[++i];
+            echo_name = argv[++i];
+        } else {
+            return usage();
+        }
+    }
+    if (min_bytes == 0 || max_bytes < min_bytes) {
+        return usage();
+    }
+
+    if (!echo_transport.empty()) {
+        Transport* transport = make_transport(echo_transport, echo_name, dir);
+        return transport ? run_echo(transport) : 2;
+    }
+
+    if (csv) {
+        cout << "transport,bytes,iterations,min_us,median_us,gbps\n";
+    } else {
+        cout << left << setw(10) << "transport" << right << setw(14) << "bytes" << setw(8) << "iters"
+             << setw(14) << "min [us]" << setw(14) << "median [us]" << setw(10) << "GB/s" << "\n";
+    }
+    string name = "pyff_bench_" + to_string(getpid());
+    for (size_t t = 0; t < transports.size(); t++) {
+        Transport* transport = make_transport(transports[t], name, dir);
+        if (!transport) {
+            return 2;
+        }
+        for (size_t bytes = min_bytes; bytes <= max_bytes; bytes *= 4) {
+            BenchResult result = BenchResult();
+            if (!measure(transport, bytes, &result)) {
+                cerr << "計測に失敗しました: " << transports[t] << " (" << bytes << " バイト)" << endl;
+                delete transport;
+                return 1;
+            }
+            double gbps = 2.0 * bytes / result.median_ns;
+            if (csv) {
+                cout << transports[t] << "," << bytes << "," << result.iterations << "," << result.min_ns / 1e3
+                     << "," << result.median_ns / 1e3 << "," << gbps << "\n";
+            } else {
+                cout << left << setw(10) << transports[t] << right << setw(14) << bytes << setw(8) << result.iterations
+                     << fixed << setprecision(2) << setw(14) << result.min_ns / 1e3 << setw(14) << result.median_ns / 1e3
+                     << setw(10) << gbps << defaultfloat << "\n";
+            }
+            cout.flush();
+        }
+        delete transport;
+    }
+    return 0;
+}
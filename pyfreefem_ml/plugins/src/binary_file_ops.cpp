@@ -0,0 +1,130 @@
+// FreeFEM++ plugin for shared memory operations
+// 共有メモリを使用できない環境（WSLなど）向けに、配列をバイナリファイルで受け渡す演算子
+//
+// ファイルの形式は shm_binary_file.hpp を参照。テキスト形式（np.savetxt / np.loadtxt）と違い、
+// 文字列との変換を行わない。writeCompressedFile はブロックごとに圧縮した形式（バージョン2）で書き込み、
+// readBinaryFile はどちらの形式も読み込む。
+#include <iostream>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "ff++.hpp"
+#include "AFunction.hpp"
+#include "shm_implementation.hpp"
+#include "shm_binary_file.hpp"
+#include "shm_copy.hpp"
+
+using namespace std;
+
+// 配列をヘッダー付きでバイナリファイルに書き込む
+static bool write_binary_file(const string& path, const KN<double>* array, const uint64_t* shape, size_t ndim,
+                              uint32_t version) {
+    size_t elements = array->N();
+    BinaryFileHeader header = binary_file_header(shape, ndim, elements, version);
+
+    // ストライドがある配列（部分配列など）は連続な領域に詰めてから書き込む
+    const double* src = *array;
+    vector<double> packed;
+    if (array->step != 1 && elements > 0) {
+        packed.resize(elements);
+        shm_gather_f64(&packed[0], src, elements, array->step);
+        src = &packed[0];
+    }
+    return binary_file_write(path, header, src);
+}
+
+// 配列を1次元の形状で書き込む
+static long write_binary_file_1d(const string& path, const KN<double>* array, uint32_t version) {
+    uint64_t shape[1] = { static_cast<uint64_t>(array->N()) };
+    return write_binary_file(path, array, shape, 1, version) ? 1L : 0L;
+}
+
+// 配列を形状付きで書き込む（Python側ではその形状の配列になる）
+static long write_binary_file_shaped(const string& path, const KN<double>* array, const KN<long>* shape,
+                                     uint32_t version) {
+    size_t ndim = shape->N();
+    if (ndim < 1 || ndim > SHM_MAX_NDIM) {
+        cerr << "形状の次元数が不正です: " << ndim << " (1〜" << SHM_MAX_NDIM << ")" << endl;
+        return 0L;
+    }
+    uint64_t dims[SHM_MAX_NDIM];
+    uint64_t total = 1;
+    for (size_t i = 0; i < ndim; i++) {
+        long dim = (*shape)[i];
+        if (dim < 0) {
+            cerr << "形状に負の値があります: " << dim << endl;
+            return 0L;
+        }
+        dims[i] = static_cast<uint64_t>(dim);
+        total *= dims[i];
+    }
+    if (total != static_cast<uint64_t>(array->N())) {
+        cerr << "形状と配列の要素数が一致しません: " << total << " != " << array->N() << endl;
+        return 0L;
+    }
+    return write_binary_file(path, array, dims, ndim, version) ? 1L : 0L;
+}
+
+// 配列をバイナリファイルに書き込む（形状は1次元）
+long shm_write_binary_file(string* const& path, KN<double>* const& array) {
+    return write_binary_file_1d(*path, array, BINARY_FILE_VERSION);
+}
+
+// 配列を形状付きでバイナリファイルに書き込む
+long shm_write_binary_file_shaped(string* const& path, KN<double>* const& array, KN<long>* const& shape) {
+    return write_binary_file_shaped(*path, array, shape, BINARY_FILE_VERSION);
+}
+
+// 配列を圧縮形式のバイナリファイルに書き込む（形状は1次元）
+long shm_write_compressed_file(string* const& path, KN<double>* const& array) {
+    return write_binary_file_1d(*path, array, BINARY_FILE_VERSION_COMPRESSED);
+}
+
+// 配列を形状付きで圧縮形式のバイナリファイルに書き込む
+long shm_write_compressed_file_shaped(string* const& path, KN<double>* const& array, KN<long>* const& shape) {
+    return write_binary_file_shaped(*path, array, shape, BINARY_FILE_VERSION_COMPRESSED);
+}
+
+// バイナリファイルから配列を読み込む（多次元の場合は行優先で1次元に並べる）
+long shm_read_binary_file(string* const& path, KN<double>* const& array) {
+    BinaryFileHeader header;
+    FILE* fp = binary_file_open(*path, &header);
+    if (!fp) {
+        return 0L;
+    }
+
+    size_t elements = header.nbytes / sizeof(double);
+    array->resize(elements);
+    bool ok = true;
+    if (elements > 0) {
+        if (array->step == 1) {
+            ok = binary_file_read(fp, header, static_cast<double*>(*array));
+        } else {
+            vector<double> packed(elements);
+            ok = binary_file_read(fp, header, &packed[0]);
+            if (ok) {
+                shm_scatter_f64(*array, array->step, &packed[0], elements);
+            }
+        }
+    }
+    fclose(fp);
+    if (!ok) {
+        cerr << "バイナリファイルのデータが不足しているか、展開できません: " << *path << endl;
+        return 0L;
+    }
+    return 1L;
+}
+
+// バイナリファイルの演算子を登録する（shm_implementation.cpp の初期化関数から呼ばれる）
+void register_binary_file_operations() {
+    Global.Add("writeBinaryFile", "(", new OneOperator2_<long, string*, KN<double>*>(shm_write_binary_file));
+    Global.Add("writeBinaryFile", "(",
+               new OneOperator3_<long, string*, KN<double>*, KN<long>*>(shm_write_binary_file_shaped));
+    Global.Add("writeCompressedFile", "(",
+               new OneOperator2_<long, string*, KN<double>*>(shm_write_compressed_file));
+    Global.Add("writeCompressedFile", "(",
+               new OneOperator3_<long, string*, KN<double>*, KN<long>*>(shm_write_compressed_file_shaped));
+    Global.Add("readBinaryFile", "(", new OneOperator2_<long, string*, KN<double>*>(shm_read_binary_file));
+}
@@ -6,87 +6,19 @@
 #include <algorithm>
 #include "ff++.hpp"
 #include "AFunction.hpp"
+#include "shm_implementation.hpp"
+#include "shm_kernels.hpp"
 
-// 浮動小数点配列の読み書きに関する操作を実装するFreeFEMプラグイン
+// 浮動小数点配列に対する演算を実装する（shmWriteScaled 以外の共有メモリの読み書きは shm_implementation.cpp）
+//
+// 演算は shm_kernels.hpp のカーネル（SIMD化し、大きな配列はOpenMPで並列化）で行う。
+// 引数は KN_<double> のため、FEM関数の係数（u[]）や共有メモリのビュー（shmViewDoubleArray）に
+// そのまま適用でき、一時配列を確保しない。ビューを直接書き換えた場合は読み込み側に通知されないため、
+// 書き込み側で公開する配列には shmWriteScaled などの書き込み演算子を使うこと。
 
 using namespace Fem2D;
 using namespace std;
 
-// 共有メモリからdouble配列を読み取る関数
-class ShmReadDoubleArray : public OneOperator {
-public:
-    // コンストラクタ
-    ShmReadDoubleArray() : OneOperator(atype<KN<double>*>(), atype<string*>()) {}
-
-    // 実行メソッド
-    E_F0* code(const basicAC_F0& args) const {
-        return new ShmReadDoubleArrayCode(args[0]->CastTo(args[0]->left()));
-    }
-
-    // コード実装クラス
-    class ShmReadDoubleArrayCode : public E_F0 {
-    private:
-        Expression varname;
-    public:
-        ShmReadDoubleArrayCode(const E_F0* e) : varname(e) {}
-        
-        // evaluate関数の実装
-        AnyType operator()(Stack stack) const {
-            string* name = GetAny<string*>((*varname)(stack));
-            KN<double>* result = new KN<double>();
-            
-            // 外部関数によって共有メモリから配列を読み取る
-            // 共有メモリ読み取り処理をここに実装する予定
-            // 以下は仮実装
-            extern bool read_array_from_shared_memory(const char*, KN<double>*);
-            if (!read_array_from_shared_memory(name->c_str(), result)) {
-                cerr << "共有メモリからの配列読み取りに失敗: " << *name << endl;
-            }
-            
-            Add2StackOfPtr2Free(stack, result);
-            return SetAny<KN<double>*>(result);
-        }
-    };
-};
-
-// 共有メモリにdouble配列を書き込む関数
-class ShmWriteDoubleArray : public OneOperator {
-public:
-    // コンストラクタ
-    ShmWriteDoubleArray() : OneOperator(atype<long>(), atype<KN<double>*>(), atype<string*>()) {}
-
-    // 実行メソッド
-    E_F0* code(const basicAC_F0& args) const {
-        return new ShmWriteDoubleArrayCode(args[0]->CastTo(args[0]->left()), 
-                                        args[1]->CastTo(args[1]->left()));
-    }
-
-    // コード実装クラス
-    class ShmWriteDoubleArrayCode : public E_F0 {
-    private:
-        Expression array_expr, varname;
-    public:
-        ShmWriteDoubleArrayCode(const E_F0* a, const E_F0* n) : array_expr(a), varname(n) {}
-        
-        // evaluate関数の実装
-        AnyType operator()(Stack stack) const {
-            KN<double>* array = GetAny<KN<double>*>((*array_expr)(stack));
-            string* name = GetAny<string*>((*varname)(stack));
-            
-            // 外部関数によって共有メモリに配列を書き込む
-            // 共有メモリ書き込み処理をここに実装する予定
-            // 以下は仮実装
-            extern bool write_array_to_shared_memory(const char*, const KN<double>*);
-            if (!write_array_to_shared_memory(name->c_str(), array)) {
-                cerr << "共有メモリへの配列書き込みに失敗: " << *name << endl;
-                return SetAny<long>(0);
-            }
-            
-            return SetAny<long>(1);
-        }
-    };
-};
-
 // 浮動小数点配列に対する演算を行う関数
 class ScaleDoubleArray : public OneOperator {
 public:
@@ -113,11 +45,7 @@ public:
             
             // 新しい配列を作成して結果を格納
             KN<double>* result = new KN<double>(array->N());
-            
-            // 配列の各要素にスケール係数を掛ける
-            for (int i = 0; i < array->N(); i++) {
-                (*result)[i] = (*array)[i] * scale;
-            }
+            shm_kernel_scale_copy(*result, *array, array->N(), array->step, scale);
             
             Add2StackOfPtr2Free(stack, result);
             return SetAny<KN<double>*>(result);
@@ -125,12 +53,76 @@ public:
     };
 };
 
-// プラグインの初期化関数
-static void init() {
-    Global.Add("shmReadDoubleArray", "(", new ShmReadDoubleArray);
-    Global.Add("shmWriteDoubleArray", "(", new ShmWriteDoubleArray);
-    Global.Add("scaleDoubleArray", "(", new ScaleDoubleArray);
+// u <- a * u
+static long array_scale(KN_<double> const& u, double const& a) {
+    shm_kernel_scale(u, u.N(), u.step, a);
+    return 1L;
 }
 
-// FreeFEMプラグインの登録
-LOADFUNC(init); 
\ No newline at end of file
+// y <- y + a * x
+static long array_axpy(KN_<double> const& y, double const& a, KN_<double> const& x) {
+    if (x.N() != y.N()) {
+        cerr << "配列の要素数が一致しません: " << x.N() << " != " << y.N() << endl;
+        return 0L;
+    }
+    shm_kernel_axpy(y, y.step, a, x, x.step, y.N());
+    return 1L;
+}
+
+// u の各要素を [lo, hi] に収める
+static long array_clamp(KN_<double> const& u, double const& lo, double const& hi) {
+    if (lo > hi) {
+        cerr << "範囲の指定が不正です: [" << lo << ", " << hi << "]" << endl;
+        return 0L;
+    }
+    shm_kernel_clamp(u, u.N(), u.step, lo, hi);
+    return 1L;
+}
+
+// x と y の内積
+static double array_dot(KN_<double> const& x, KN_<double> const& y) {
+    if (x.N() != y.N()) {
+        cerr << "配列の要素数が一致しません: " << x.N() << " != " << y.N() << endl;
+        return 0.0;
+    }
+    return shm_kernel_dot(x, x.step, y, y.step, x.N());
+}
+
+// u のユークリッドノルム
+static double array_norm(KN_<double> const& u) {
+    return shm_kernel_norm(u, u.N(), u.step);
+}
+
+// u の最小値と最大値を1回の走査で求める
+static long array_minmax(KN_<double> const& u, double* const& min_value, double* const& max_value) {
+    if (u.N() == 0) {
+        cerr << "空の配列の最小値・最大値は求められません" << endl;
+        return 0L;
+    }
+    shm_kernel_minmax(u, u.N(), u.step, min_value, max_value);
+    return 1L;
+}
+
+// a * u を共有メモリのエントリに書き込む（一時配列を作らず、拡大縮小とコピーを1回の走査で行う）
+static long shm_write_scaled(string* const& segment, string* const& key, KN_<double> const& u, double const& a) {
+    ShmEntryRef ref;
+    if (!shm_begin_write(segment->c_str(), key->c_str(), SHM_DTYPE_FLOAT64, u.N(), &ref)) {
+        return 0L;
+    }
+    shm_kernel_scale_copy(static_cast<double*>(shm_entry_data(ref)), u, u.N(), u.step, a);
+    shm_end_write(ref, u.N());
+    return 1L;
+}
+
+// 配列演算の演算子を登録する（shm_implementation.cpp の初期化関数から呼ばれる）
+void register_double_array_operations() {
+    Global.Add("scaleDoubleArray", "(", new ScaleDoubleArray);
+    Global.Add("arrayScale", "(", new OneOperator2_<long, KN_<double>, double>(array_scale));
+    Global.Add("arrayAxpy", "(", new OneOperator3_<long, KN_<double>, double, KN_<double> >(array_axpy));
+    Global.Add("arrayClamp", "(", new OneOperator3_<long, KN_<double>, double, double>(array_clamp));
+    Global.Add("arrayDot", "(", new OneOperator2_<double, KN_<double>, KN_<double> >(array_dot));
+    Global.Add("arrayNorm", "(", new OneOperator1_<double, KN_<double> >(array_norm));
+    Global.Add("arrayMinMax", "(", new OneOperator3_<long, KN_<double>, double*, double*>(array_minmax));
+    Global.Add("shmWriteScaled", "(",
+               new OneOperator4_<long, string*, string*, KN_<double>, double>(shm_write_scaled));
+}
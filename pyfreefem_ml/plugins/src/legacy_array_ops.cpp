@@ -0,0 +1,243 @@
+// FreeFEM++ plugin for shared memory operations
+// 旧API（ArrayInfo形式）の演算子。データは shm_transport のセグメントに格納する
+//
+// 変数名は shm_resolve_segment() で格納先のセグメントに解決し、
+// セグメント内の同名のエントリとして読み書きする。Pythonから実行された場合は
+// FF_SHM_NAME のセグメントに入るため、SharedMemoryManager.read_array(name) で参照できる。
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "ff++.hpp"
+#include "AFunction.hpp"
+#include "shm_implementation.hpp"
+#include "shm_transport.hpp"
+#include "shm_copy.hpp"
+
+using namespace std;
+
+// 4引数の関数を3引数で扱うための構造体
+class ArrayInfo {
+public:
+    double size;    // 配列の要素数
+    double offset;  // エントリ先頭からのオフセット（バイト）
+
+    ArrayInfo() : size(0), offset(0) {}
+    ArrayInfo(double s, double o) : size(s), offset(o) {}
+};
+
+// ArrayInfoの範囲を要素単位に変換する（オフセットは要素境界に揃っている必要がある）
+static bool element_range(const string& name, const ArrayInfo* info, size_t itemsize,
+                          size_t* first, size_t* count) {
+    if (info->size < 0 || info->offset < 0) {
+        cerr << "ArrayInfoの値が不正です: " << name << endl;
+        return false;
+    }
+    size_t offset = static_cast<size_t>(info->offset);
+    if (offset % itemsize != 0) {
+        cerr << "オフセットが要素境界に揃っていません: " << name << " (オフセット: " << offset
+             << ", 要素サイズ: " << itemsize << ")" << endl;
+        return false;
+    }
+    *first = offset / itemsize;
+    *count = static_cast<size_t>(info->size);
+    return true;
+}
+
+// 書き込み先の領域を確保する
+// オフセット0はエントリ全体の書き込み、それ以外は既存エントリの一部の更新として扱う
+static bool begin_legacy_write(const string& name, uint32_t dtype, size_t first, size_t count,
+                               ShmEntryRef* ref, size_t* elements) {
+    string segment = shm_resolve_segment(name.c_str());
+    if (first == 0) {
+        *elements = count;
+        return shm_begin_write(segment.c_str(), name.c_str(), dtype, count, ref);
+    }
+
+    if (!shm_acquire_entry(segment.c_str(), name.c_str(), ref, 0.0)) {
+        cerr << "オフセット付きの書き込みには既存の変数が必要です: " << name << endl;
+        return false;
+    }
+    if (ref->entry->dtype != dtype) {
+        cerr << "データ型が一致しません: " << name << " (期待値: " << shm_dtype_name(dtype)
+             << ", 実際: " << shm_dtype_name(ref->entry->dtype) << ")" << endl;
+        return false;
+    }
+    *elements = shm_entry_elements(*ref);
+    if (first + count > *elements) {
+        cerr << "Write operation exceeds shared memory size: " << name << endl;
+        return false;
+    }
+    return true;
+}
+
+// 読み込み元のエントリを参照する（範囲の確認まで行う）
+static bool acquire_legacy_read(const string& name, size_t first, size_t count, ShmEntryRef* ref) {
+    string segment = shm_resolve_segment(name.c_str());
+    if (!shm_acquire_entry(segment.c_str(), name.c_str(), ref)) {
+        return false;
+    }
+    if (first + count > shm_entry_elements(*ref)) {
+        cerr << "Read operation exceeds shared memory size: " << name << endl;
+        return false;
+    }
+    return true;
+}
+
+// 共有メモリ作成（同じ名前には同じIDを返す）
+double shm_create(string* const& name, const double& size) {
+    string segment = shm_resolve_segment(name->c_str());
+    int id = shm_open_segment(segment.c_str(), size > 0 ? static_cast<size_t>(size) : 0);
+    return static_cast<double>(id);
+}
+
+// 共有メモリ破棄
+// Pythonが管理するセッションのセグメントに入っている場合は削除しない
+double shm_destroy(string* const& name) {
+    string segment = shm_resolve_segment(name->c_str());
+    if (segment != *name) {
+        return 1.0;
+    }
+    return shm_destroy_segment(segment.c_str()) ? 1.0 : 0.0;
+}
+
+// double配列の書き込み - 3引数バージョン
+double shm_write_array(string* const& name, KN<double>* const& data, ArrayInfo* const& info) {
+    size_t first, count, elements;
+    ShmEntryRef ref;
+    if (!element_range(*name, info, sizeof(double), &first, &count)) {
+        return 0.0;
+    }
+    if (count > static_cast<size_t>(data->N())) {
+        cerr << "配列の要素数が不足しています: " << *name << endl;
+        return 0.0;
+    }
+    if (!begin_legacy_write(*name, SHM_DTYPE_FLOAT64, first, count, &ref, &elements)) {
+        return 0.0;
+    }
+    double* dst = static_cast<double*>(shm_entry_data(ref)) + first;
+    shm_gather_f64(dst, static_cast<double*>(*data), count, data->step);
+    shm_end_write(ref, elements);
+    return 1.0;
+}
+
+// double配列の読み込み - 3引数バージョン
+double shm_read_array(string* const& name, KN<double>* const& data, ArrayInfo* const& info) {
+    size_t first, count;
+    ShmEntryRef ref;
+    if (!element_range(*name, info, sizeof(double), &first, &count)) {
+        return 0.0;
+    }
+    if (!acquire_legacy_read(*name, first, count, &ref)) {
+        return 0.0;
+    }
+    if (static_cast<size_t>(data->N()) < count) {
+        data->resize(count);
+    }
+
+    uint32_t dtype = ref.entry->dtype;
+    if (dtype == SHM_DTYPE_FLOAT64) {
+        const double* src = static_cast<const double*>(shm_entry_data(ref)) + first;
+        shm_scatter_f64(static_cast<double*>(*data), data->step, src, count);
+    } else if (dtype == SHM_DTYPE_FLOAT32) {
+        const float* src = static_cast<const float*>(shm_entry_data(ref)) + first;
+        shm_convert_f32_to_f64(static_cast<double*>(*data), data->step, src, count);
+    } else {
+        cerr << "データ型が一致しません: " << *name << " (期待値: float64, 実際: "
+             << shm_dtype_name(dtype) << ")" << endl;
+        return 0.0;
+    }
+    shm_end_read(ref, count * shm_dtype_size(dtype));
+    return 1.0;
+}
+
+// int配列の書き込み - 3引数バージョン（int32として格納する）
+double shm_write_int_array(string* const& name, KN<long>* const& data, ArrayInfo* const& info) {
+    size_t first, count, elements;
+    ShmEntryRef ref;
+    if (!element_range(*name, info, sizeof(int32_t), &first, &count)) {
+        return 0.0;
+    }
+    if (count > static_cast<size_t>(data->N())) {
+        cerr << "配列の要素数が不足しています: " << *name << endl;
+        return 0.0;
+    }
+    if (!begin_legacy_write(*name, SHM_DTYPE_INT32, first, count, &ref, &elements)) {
+        return 0.0;
+    }
+    int32_t* dst = static_cast<int32_t*>(shm_entry_data(ref)) + first;
+    shm_convert_i64_to_i32(dst, reinterpret_cast<const int64_t*>(static_cast<long*>(*data)), count, data->step);
+    shm_end_write(ref, elements);
+    return 1.0;
+}
+
+// int配列の読み込み - 3引数バージョン
+double shm_read_int_array(string* const& name, KN<long>* const& data, ArrayInfo* const& info) {
+    ShmEntryRef ref;
+    string segment = shm_resolve_segment(name->c_str());
+    if (!shm_acquire_entry(segment.c_str(), name->c_str(), &ref)) {
+        return 0.0;
+    }
+
+    // オフセットは格納されている整数型の要素サイズで解釈する
+    uint32_t dtype = ref.entry->dtype;
+    if (dtype != SHM_DTYPE_INT32 && dtype != SHM_DTYPE_INT64) {
+        cerr << "データ型が一致しません: " << *name << " (期待値: int32/int64, 実際: "
+             << shm_dtype_name(dtype) << ")" << endl;
+        return 0.0;
+    }
+    size_t first, count;
+    if (!element_range(*name, info, shm_dtype_size(dtype), &first, &count)) {
+        return 0.0;
+    }
+    if (first + count > shm_entry_elements(ref)) {
+        cerr << "Read operation exceeds shared memory size: " << *name << endl;
+        return 0.0;
+    }
+    if (static_cast<size_t>(data->N()) < count) {
+        data->resize(count);
+    }
+
+    int64_t* dst = reinterpret_cast<int64_t*>(static_cast<long*>(*data));
+    if (dtype == SHM_DTYPE_INT32) {
+        const int32_t* src = static_cast<const int32_t*>(shm_entry_data(ref)) + first;
+        shm_convert_i32_to_i64(dst, data->step, src, count);
+    } else {
+        const int64_t* src = static_cast<const int64_t*>(shm_entry_data(ref)) + first;
+        for (size_t i = 0; i < count; i++) {
+            dst[i * data->step] = src[i];
+        }
+    }
+    shm_end_read(ref, count * shm_dtype_size(dtype));
+    return 1.0;
+}
+
+// ArrayInfo構造体を作成する関数（スタックに登録し、式の評価後に解放される）
+ArrayInfo* create_array_info(Stack stack, const double& size, const double& offset) {
+    ArrayInfo* info = new ArrayInfo(size, offset);
+    Add2StackOfPtr2Free(stack, info);
+    return info;
+}
+
+// 旧APIの演算子を登録する（shm_implementation.cpp の初期化関数から呼ばれる）
+void register_legacy_array_operations() {
+    Dcl_Type<ArrayInfo*>();
+
+    // 共有メモリの作成・破棄
+    Global.Add("ShmCreate", "(", new OneOperator2_<double, string*, double>(shm_create));
+    Global.Add("ShmDestroy", "(", new OneOperator1_<double, string*>(shm_destroy));
+
+    // ArrayInfo構造体の作成
+    Global.Add("ArrayInfo", "(", new OneOperator2s_<ArrayInfo*, double, double>(create_array_info));
+
+    // 配列の読み書き (3引数バージョン)
+    // FreeFEM 4.10では、OneOperator3_は<R,A,B,C>の形式で使用する
+    Global.Add("ShmWriteArray", "(", new OneOperator3_<double, string*, KN<double>*, ArrayInfo*>(shm_write_array));
+    Global.Add("ShmReadArray", "(", new OneOperator3_<double, string*, KN<double>*, ArrayInfo*>(shm_read_array));
+    Global.Add("ShmWriteDoubleArray", "(", new OneOperator3_<double, string*, KN<double>*, ArrayInfo*>(shm_write_array));
+    Global.Add("ShmReadDoubleArray", "(", new OneOperator3_<double, string*, KN<double>*, ArrayInfo*>(shm_read_array));
+
+    // 整数配列の読み書き
+    Global.Add("ShmWriteIntArray", "(", new OneOperator3_<double, string*, KN<long>*, ArrayInfo*>(shm_write_int_array));
+    Global.Add("ShmReadIntArray", "(", new OneOperator3_<double, string*, KN<long>*, ArrayInfo*>(shm_read_int_array));
+}
@@ -0,0 +1,200 @@
+// FreeFEM++ plugin for shared memory operations
+// メッシュ（mesh / mesh3）と有限要素関数の自由度をセグメントに格納する演算子
+//
+// メッシュ <key> はセグメント内の次の4つのエントリとして格納する
+// （Python側の SharedMemoryManager.read_mesh と同一）
+//   <key>.vertices  float64  頂点座標（頂点数 x 次元、頂点ごとに連続）
+//   <key>.elements  int32    要素の頂点番号（要素数 x (次元 + 1)、0始まり）
+//   <key>.labels    int32    要素のラベル（領域番号、要素数）
+//   <key>           int64    [次元, 頂点数, 要素数, ハッシュ]
+// エントリは1回の通知でまとめて公開する。ハッシュは座標・接続・ラベルのビット列から求め、
+// セグメントに格納済みのメッシュと一致する場合はメッシュを書き込まない。反復ごとに
+// shmWriteFEFunction を呼び出しても、メッシュが変わらなければ転送されるのは自由度の配列だけになる。
+//
+//   shmWriteMesh(segment, key, Th)                       1: 書き込んだ, 2: 格納済みと同一, 0: 失敗
+//   shmWriteFEFunction(segment, key, u[], meshKey, Th)   u[] と（変わっていれば）メッシュを書き込む
+#include <iostream>
+#include <cstring>
+#include <string>
+#include <stdint.h>
+
+#include "ff++.hpp"
+#include "AFunction.hpp"
+#include "shm_implementation.hpp"
+#include "shm_transport.hpp"
+#include "shm_copy.hpp"
+
+using namespace Fem2D;
+using namespace std;
+
+enum MeshHeaderWord {
+    MESH_DIM = 0,
+    MESH_VERTICES = 1,
+    MESH_ELEMENTS = 2,
+    MESH_HASH = 3,
+    MESH_HEADER_WORDS = 4
+};
+
+static const size_t MESH_ENTRIES = 4;   // <key>, .vertices, .elements, .labels
+static const uint64_t MESH_HASH_MULTIPLIER = 0x9E3779B97F4A7C15ULL;
+
+static inline uint64_t mesh_hash_mix(uint64_t hash, uint64_t word) {
+    hash = (hash ^ word) * MESH_HASH_MULTIPLIER;
+    return hash ^ (hash >> 29);
+}
+
+static inline uint64_t mesh_double_bits(double value) {
+    uint64_t bits;
+    memcpy(&bits, &value, sizeof(bits));
+    return bits;
+}
+
+static inline void mesh_vertex_coordinates(const R2& p, double* xyz) {
+    xyz[0] = p.x;
+    xyz[1] = p.y;
+}
+
+static inline void mesh_vertex_coordinates(const R3& p, double* xyz) {
+    xyz[0] = p.x;
+    xyz[1] = p.y;
+    xyz[2] = p.z;
+}
+
+// 座標・接続・ラベルのハッシュ（メッシュを1回走査する。コピーよりも安価）
+template<int D, class M>
+static uint64_t mesh_hash(const M& Th) {
+    uint64_t hash = mesh_hash_mix(mesh_hash_mix(mesh_hash_mix(0, D), Th.nv), Th.nt);
+    double xyz[3];
+    for (int i = 0; i < Th.nv; i++) {
+        mesh_vertex_coordinates(Th(i), xyz);
+        for (int d = 0; d < D; d++) {
+            hash = mesh_hash_mix(hash, mesh_double_bits(xyz[d]));
+        }
+    }
+    for (int k = 0; k < Th.nt; k++) {
+        for (int j = 0; j <= D; j++) {
+            hash = mesh_hash_mix(hash, static_cast<uint64_t>(Th(Th[k][j])));
+        }
+        hash = mesh_hash_mix(hash, static_cast<uint64_t>(Th[k].lab));
+    }
+    return hash;
+}
+
+// 格納済みのメッシュが同じハッシュ・大きさで、すべてのエントリが書き込み済みかどうか
+static bool mesh_unchanged(const ShmEntryRef* refs, const ShmBatchItem* items, const int64_t* header) {
+    for (size_t i = 0; i < MESH_ENTRIES; i++) {
+        const SegmentEntry* entry = refs[i].entry;
+        if (entry->generation == 0 || entry->nbytes != items[i].elements * shm_dtype_size(items[i].dtype)) {
+            return false;
+        }
+    }
+    const int64_t* stored = static_cast<const int64_t*>(shm_entry_data(refs[0]));
+    return memcmp(stored, header, MESH_HEADER_WORDS * sizeof(int64_t)) == 0;
+}
+
+// メッシュ（と field が指定された場合は自由度の配列）を1回の通知で書き込む
+// メッシュが格納済みのものと同一の場合は自由度の配列だけを公開する
+template<int D, class M>
+static long write_mesh(const char* segment, const string& key, const M* Th,
+                       const char* field_key, const KN_<double>* field) {
+    if (!Th) {
+        cerr << "メッシュが定義されていません: " << key << endl;
+        return 0L;
+    }
+    if (key.size() + strlen(".vertices") >= SHM_NAME_LEN) {
+        cerr << "メッシュ名が長すぎます: " << key << endl;
+        return 0L;
+    }
+    if (static_cast<long>(Th->nv) > INT32_MAX || static_cast<long>(Th->nt) > INT32_MAX / (D + 1)) {
+        cerr << "メッシュが大きすぎます（int32の範囲を超えています）: " << key << endl;
+        return 0L;
+    }
+
+    size_t nv = static_cast<size_t>(Th->nv);
+    size_t nt = static_cast<size_t>(Th->nt);
+    int64_t header[MESH_HEADER_WORDS];
+    header[MESH_DIM] = D;
+    header[MESH_VERTICES] = static_cast<int64_t>(nv);
+    header[MESH_ELEMENTS] = static_cast<int64_t>(nt);
+    header[MESH_HASH] = static_cast<int64_t>(mesh_hash<D>(*Th));
+
+    string vertices_key = key + ".vertices";
+    string elements_key = key + ".elements";
+    string labels_key = key + ".labels";
+    ShmBatchItem items[MESH_ENTRIES + 1] = {
+        { key.c_str(), SHM_DTYPE_INT64, MESH_HEADER_WORDS },
+        { vertices_key.c_str(), SHM_DTYPE_FLOAT64, nv * D },
+        { elements_key.c_str(), SHM_DTYPE_INT32, nt * (D + 1) },
+        { labels_key.c_str(), SHM_DTYPE_INT32, nt },
+        { field_key, SHM_DTYPE_FLOAT64, field ? static_cast<size_t>(field->N()) : 0 }
+    };
+    size_t count = field ? MESH_ENTRIES + 1 : MESH_ENTRIES;
+    ShmEntryRef refs[MESH_ENTRIES + 1];
+    if (!shm_begin_write_batch(segment, items, count, refs)) {
+        return 0L;
+    }
+
+    if (field) {
+        const double* src = *field;
+        shm_gather_f64(static_cast<double*>(shm_entry_data(refs[MESH_ENTRIES])), src,
+                       items[MESH_ENTRIES].elements, field->step);
+    }
+    if (mesh_unchanged(refs, items, header)) {
+        // 確保したメッシュのエントリは既存の領域のままなので、公開しなくてよい
+        shm_end_write_batch(refs + MESH_ENTRIES, items + MESH_ENTRIES, count - MESH_ENTRIES);
+        return 2L;
+    }
+
+    double* vertices = static_cast<double*>(shm_entry_data(refs[1]));
+    int32_t* elements = static_cast<int32_t*>(shm_entry_data(refs[2]));
+    int32_t* labels = static_cast<int32_t*>(shm_entry_data(refs[3]));
+    double xyz[3];
+    for (size_t i = 0; i < nv; i++) {
+        mesh_vertex_coordinates((*Th)(static_cast<int>(i)), xyz);
+        for (int d = 0; d < D; d++) {
+            vertices[i * D + d] = xyz[d];
+        }
+    }
+    for (size_t k = 0; k < nt; k++) {
+        const int kk = static_cast<int>(k);
+        for (int j = 0; j <= D; j++) {
+            elements[k * (D + 1) + j] = static_cast<int32_t>((*Th)((*Th)[kk][j]));
+        }
+        labels[k] = static_cast<int32_t>((*Th)[kk].lab);
+    }
+    memcpy(shm_entry_data(refs[0]), header, sizeof(header));
+    shm_end_write_batch(refs, items, count);
+    return 1L;
+}
+
+// 2次元メッシュを書き込む
+long shm_write_mesh2(string* const& segment, string* const& key, pmesh const& Th) {
+    return write_mesh<2>(segment->c_str(), *key, Th, NULL, NULL);
+}
+
+// 3次元メッシュを書き込む
+long shm_write_mesh3(string* const& segment, string* const& key, pmesh3 const& Th) {
+    return write_mesh<3>(segment->c_str(), *key, Th, NULL, NULL);
+}
+
+// 有限要素関数の自由度を2次元メッシュとともに書き込む
+long shm_write_fe_function2(string* const& segment, string* const& key, KN_<double> const& u,
+                            string* const& mesh_key, pmesh const& Th) {
+    return write_mesh<2>(segment->c_str(), *mesh_key, Th, key->c_str(), &u);
+}
+
+// 有限要素関数の自由度を3次元メッシュとともに書き込む
+long shm_write_fe_function3(string* const& segment, string* const& key, KN_<double> const& u,
+                            string* const& mesh_key, pmesh3 const& Th) {
+    return write_mesh<3>(segment->c_str(), *mesh_key, Th, key->c_str(), &u);
+}
+
+// メッシュの演算子を登録する（shm_implementation.cpp の初期化関数から呼ばれる）
+void register_mesh_operations() {
+    Global.Add("shmWriteMesh", "(", new OneOperator3_<long, string*, string*, pmesh>(shm_write_mesh2));
+    Global.Add("shmWriteMesh", "(", new OneOperator3_<long, string*, string*, pmesh3>(shm_write_mesh3));
+    Global.Add("shmWriteFEFunction", "(",
+               new OneOperator5_<long, string*, string*, KN_<double>, string*, pmesh>(shm_write_fe_function2));
+    Global.Add("shmWriteFEFunction", "(",
+               new OneOperator5_<long, string*, string*, KN_<double>, string*, pmesh3>(shm_write_fe_function3));
+}
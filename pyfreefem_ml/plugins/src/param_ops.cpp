@@ -0,0 +1,196 @@
+// FreeFEM++ plugin for shared memory operations
+// 名前付きのスカラー（real / int / string）をまとめたパラメータブロックを1回で読み込む演算子
+//
+// パラメータブロック <key> はセグメント内の1つのuint8エントリで、Python側の
+// SharedMemoryManager.write_params が書き込む（形式は read_params と同一）
+//   [ParamBlockHeader (8バイト)] [ParamRecord (64バイト) x 個数] [文字列領域]
+// 値の種類と文字列の容量が変わらない限り、Python側は反復ごとに同じ領域をその場で書き換える。
+// コマンドライン引数（key=value と getARGV）や、スカラーごとのエントリは不要になる。
+//
+//   shmGetParams(segment, key, "dt,n,mode", dt, n, mode)   変数に値を代入する（1: 成功, 0: 失敗）
+#include <iostream>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <stdint.h>
+
+#include "ff++.hpp"
+#include "AFunction.hpp"
+#include "shm_implementation.hpp"
+#include "shm_transport.hpp"
+
+using namespace std;
+
+static const uint32_t PARAM_MAGIC = 0x534d5250;   // "PRMS"（リトルエンディアン）
+static const size_t PARAM_NAME_LEN = 40;
+
+// パラメータの種類
+enum ParamKind {
+    PARAM_DOUBLE = 1,
+    PARAM_INT = 2,
+    PARAM_STRING = 3
+};
+
+struct ParamBlockHeader {
+    uint32_t magic;              // PARAM_MAGIC
+    uint32_t count;              // パラメータの個数
+};
+
+// パラメータ1つ分（64バイト）
+struct ParamRecord {
+    char name[PARAM_NAME_LEN];   // パラメータ名（NUL終端）
+    uint32_t kind;               // ParamKind
+    uint32_t length;             // 文字列のバイト数（PARAM_STRING のみ）
+    uint64_t value;              // double のビット列、int64、または文字列のブロック先頭からの位置
+    uint64_t capacity;           // 文字列に確保したバイト数（その場で書き換えられる上限）
+};
+
+static_assert(sizeof(ParamBlockHeader) == 8, "ParamBlockHeader layout must match shm_manager.py");
+static_assert(sizeof(ParamRecord) == 64, "ParamRecord layout must match shm_manager.py");
+
+static const char* param_kind_name(uint32_t kind) {
+    switch (kind) {
+        case PARAM_DOUBLE: return "real";
+        case PARAM_INT: return "int";
+        case PARAM_STRING: return "string";
+        default: return "unknown";
+    }
+}
+
+// ブロック内のパラメータを名前で検索する（見つからない場合はNULL）
+static const ParamRecord* find_param(const uint8_t* block, size_t nbytes, const string& name) {
+    const ParamBlockHeader* header = reinterpret_cast<const ParamBlockHeader*>(block);
+    const ParamRecord* records = reinterpret_cast<const ParamRecord*>(block + sizeof(ParamBlockHeader));
+    for (uint32_t i = 0; i < header->count; i++) {
+        if (strncmp(records[i].name, name.c_str(), PARAM_NAME_LEN) == 0) {
+            const ParamRecord* record = &records[i];
+            if (record->kind == PARAM_STRING && record->value + record->length > nbytes) {
+                return NULL;
+            }
+            return record;
+        }
+    }
+    return NULL;
+}
+
+// 代入先の変数（kind が PARAM_DOUBLE なら double*、PARAM_INT なら long*、PARAM_STRING なら string**）
+struct ParamTarget {
+    uint32_t kind;
+    void* variable;
+};
+
+// パラメータブロックから名前ごとに値を読み込み、変数に代入する
+// real の変数には int のパラメータも代入できる。それ以外は種類が一致する必要がある
+static bool read_param_block(const char* segment, const char* key, const vector<string>& names,
+                             const vector<ParamTarget>& targets) {
+    ShmEntryRef ref;
+    if (!shm_acquire_entry(segment, key, &ref)) {
+        return false;
+    }
+    const uint8_t* block = static_cast<const uint8_t*>(shm_entry_data(ref));
+    const ParamBlockHeader* header = reinterpret_cast<const ParamBlockHeader*>(block);
+    size_t nbytes = ref.entry->nbytes;
+    if (ref.entry->dtype != SHM_DTYPE_UINT8 || nbytes < sizeof(ParamBlockHeader) || header->magic != PARAM_MAGIC
+        || nbytes < sizeof(ParamBlockHeader) + header->count * sizeof(ParamRecord)) {
+        cerr << "パラメータブロックではありません: " << segment << "/" << key << endl;
+        return false;
+    }
+
+    size_t copied = 0;
+    for (size_t i = 0; i < names.size(); i++) {
+        const ParamRecord* record = find_param(block, nbytes, names[i]);
+        if (!record) {
+            cerr << "パラメータが見つかりません: " << key << "/" << names[i] << endl;
+            return false;
+        }
+        uint32_t kind = targets[i].kind;
+        if (kind == PARAM_DOUBLE && record->kind == PARAM_DOUBLE) {
+            memcpy(targets[i].variable, &record->value, sizeof(double));
+        } else if (kind == PARAM_DOUBLE && record->kind == PARAM_INT) {
+            *static_cast<double*>(targets[i].variable) = static_cast<double>(static_cast<int64_t>(record->value));
+        } else if (kind == PARAM_INT && record->kind == PARAM_INT) {
+            *static_cast<long*>(targets[i].variable) = static_cast<long>(static_cast<int64_t>(record->value));
+        } else if (kind == PARAM_STRING && record->kind == PARAM_STRING) {
+            string** value = static_cast<string**>(targets[i].variable);
+            if (!*value) {
+                *value = new string;
+            }
+            (*value)->assign(reinterpret_cast<const char*>(block + record->value), record->length);
+        } else {
+            cerr << "パラメータの型が一致しません: " << key << "/" << names[i] << " (変数: "
+                 << param_kind_name(kind) << ", パラメータ: " << param_kind_name(record->kind) << ")" << endl;
+            return false;
+        }
+        copied += record->kind == PARAM_STRING ? record->length : sizeof(uint64_t);
+    }
+    shm_end_read(ref, copied);
+    return true;
+}
+
+// FreeFEMのプラグイン関数：パラメータブロックの読み込み
+class GetParamsCode : public E_F0mps {
+public:
+    Expression segment_name;
+    Expression key_name;
+    Expression param_names;
+    vector<Expression> variables;
+    vector<uint32_t> kinds;      // 代入先の変数の種類
+
+    GetParamsCode(const basicAC_F0& args) : segment_name(args[0]), key_name(args[1]), param_names(args[2]) {
+        for (int i = 3; i < args.size(); i++) {
+            if (args[i].left() == atype<double*>()) {
+                variables.push_back(to<double*>(args[i]));
+                kinds.push_back(PARAM_DOUBLE);
+            } else if (args[i].left() == atype<long*>()) {
+                variables.push_back(to<long*>(args[i]));
+                kinds.push_back(PARAM_INT);
+            } else if (args[i].left() == atype<string**>()) {
+                variables.push_back(to<string**>(args[i]));
+                kinds.push_back(PARAM_STRING);
+            } else {
+                CompileError("shmGetParams: 4番目以降の引数は real / int / string の変数である必要があります");
+            }
+        }
+    }
+
+    AnyType operator()(Stack stack) const {
+        string* segment = GetAny<string*>((*segment_name)(stack));
+        string* key = GetAny<string*>((*key_name)(stack));
+        string* names_text = GetAny<string*>((*param_names)(stack));
+        vector<string> names = split_batch_keys(names_text->c_str());
+        if (names.size() != variables.size()) {
+            cerr << "パラメータ名と変数の個数が一致しません: \"" << *names_text << "\" (" << names.size()
+                 << " 個のパラメータ名, " << variables.size() << " 個の変数)" << endl;
+            return 0L;
+        }
+
+        vector<ParamTarget> targets(variables.size());
+        for (size_t i = 0; i < variables.size(); i++) {
+            AnyType variable = (*variables[i])(stack);
+            targets[i].kind = kinds[i];
+            if (kinds[i] == PARAM_DOUBLE) {
+                targets[i].variable = GetAny<double*>(variable);
+            } else if (kinds[i] == PARAM_INT) {
+                targets[i].variable = GetAny<long*>(variable);
+            } else {
+                targets[i].variable = GetAny<string**>(variable);
+            }
+        }
+        return read_param_block(segment->c_str(), key->c_str(), names, targets) ? 1L : 0L;
+    }
+};
+
+class ShmGetParams : public OneOperator {
+public:
+    E_F0* code(const basicAC_F0& args) const {
+        return new GetParamsCode(args);
+    }
+
+    // 4番目以降の引数は real / int / string の変数（ellipse、型は code() で確認する）
+    ShmGetParams() : OneOperator(atype<long>(), ArrayOfaType(atype<string*>(), atype<string*>(), atype<string*>(), true)) {}
+};
+
+// パラメータブロックの演算子を登録する（shm_implementation.cpp の初期化関数から呼ばれる）
+void register_param_operations() {
+    Global.Add("shmGetParams", "(", new ShmGetParams);
+}
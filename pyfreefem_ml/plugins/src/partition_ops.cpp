@@ -0,0 +1,58 @@
+// FreeFEM++ plugin for shared memory operations
+// MPI並列実行（ff-mpirun）で各ランクが分割配列の自分の部分を受け渡す演算子
+//
+// 各ランクは自分専用のセグメント <segment>.r<ランク> を使うため、同じセグメントを
+// 複数のランクが奪い合わない（形式は shm_transport.hpp の SHM_PARTITION_SUFFIX を参照）。
+// Python側は RankSegments で全ランクの部分を大域配列に集め、または部分ごとに書き込む。
+//
+//   shmWritePartition(segment, key, u[], offset, n)  u[] を大域配列の [offset, offset + u.n) として書き込む
+//   shmReadPartition(segment, key, u[])               Python側が書き込んだこのランクの部分を読み込む
+//   shmRankSegment(segment)                            このランク専用のセグメント名（他の演算子に使える）
+#include <iostream>
+#include <string>
+
+#include "ff++.hpp"
+#include "AFunction.hpp"
+#include "shm_implementation.hpp"
+#include "shm_transport.hpp"
+
+using namespace std;
+
+// このランクの部分を書き込む
+long shm_write_partition_array(string* const& segment, string* const& key, KN_<double> const& u,
+                               long const& offset, long const& global_elements) {
+    if (offset < 0 || global_elements < 0) {
+        cerr << "分割配列の範囲が不正です: " << *key << " (offset: " << offset << ", 要素数: "
+             << global_elements << ")" << endl;
+        return 0L;
+    }
+    bool success = shm_write_partition(segment->c_str(), key->c_str(), u, u.N(), u.step,
+                                       static_cast<size_t>(offset), static_cast<size_t>(global_elements));
+    return success ? 1L : 0L;
+}
+
+// このランクの部分を読み込む（配列の大きさは書き込まれた部分に合わせる）
+long shm_read_partition_array(string* const& segment, string* const& key, KN<double>* const& u) {
+    long rank, ranks;
+    shm_mpi_rank(&rank, &ranks);
+    string rank_segment = shm_rank_segment(segment->c_str(), rank);
+    return read_array_from_segment(rank_segment.c_str(), key->c_str(), u) ? 1L : 0L;
+}
+
+// このランク専用のセグメント名を返す
+string* shm_rank_segment_name(Stack stack, string* const& segment) {
+    long rank, ranks;
+    shm_mpi_rank(&rank, &ranks);
+    string* name = new string(shm_rank_segment(segment->c_str(), rank));
+    Add2StackOfPtr2Free(stack, name);
+    return name;
+}
+
+// 分割配列の演算子を登録する（shm_implementation.cpp の初期化関数から呼ばれる）
+void register_partition_operations() {
+    Global.Add("shmWritePartition", "(",
+               new OneOperator5_<long, string*, string*, KN_<double>, long, long>(shm_write_partition_array));
+    Global.Add("shmReadPartition", "(",
+               new OneOperator3_<long, string*, string*, KN<double>*>(shm_read_partition_array));
+    Global.Add("shmRankSegment", "(", new OneOperator1s_<string*, string*>(shm_rank_segment_name));
+}
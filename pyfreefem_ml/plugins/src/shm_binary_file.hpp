@@ -0,0 +1,279 @@
+#ifndef SHM_BINARY_FILE_HPP
+#define SHM_BINARY_FILE_HPP
+
+// バイナリファイル形式（共有メモリを使用できない環境向けの受け渡し）。FreeFEMのヘッダーには依存しない。
+//
+// ファイルは64バイトのヘッダーの直後にリトルエンディアンの生データを置く形式で、
+// Python側（file_io.py の write_binary_array / load_binary_array）は np.memmap で直接開く。
+// 書き込みは一時ファイルに行ってから rename するため、読み込み側が途中の内容を見ることはない。
+// FreeFEMの演算子（binary_file_ops.cpp）とベンチマーク（plugins/bench）から使用する。
+//
+// バージョン2（圧縮形式）ではデータ部を BINARY_BLOCK_ELEMENTS 要素のブロックに分け、
+// 各ブロックのバイト列を8つの面（各要素の同じ位置のバイトを連続させたもの）に並べ替えて、面ごとにzlibで
+// 圧縮する。符号・指数部と上位の仮数部の面はよく圧縮され、ほぼ乱数の下位の仮数部の面は先頭
+// BINARY_SAMPLE_BYTES バイトの試し圧縮で見分けて圧縮せずに格納する。データ部の形式は
+//   BinaryBlockInfo, { BinaryBlockHeader, 格納データ } x (ブロック数 x 8)
+// で、圧縮していない面は stored_bytes == raw_bytes となる。
+// 先頭から順に読めるため、パイプ（WSLの cat など）越しにも1回の走査で展開できる。
+
+#include "shm_layout.hpp"
+
+#include <algorithm>
+#include <iostream>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <stdint.h>
+#include <zlib.h>
+
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ != __ORDER_LITTLE_ENDIAN__
+#error "binary file transport assumes a little-endian host"
+#endif
+
+static const uint32_t BINARY_FILE_MAGIC = 0x42464650;   // "PFFB"（リトルエンディアン）
+static const uint32_t BINARY_FILE_VERSION = 1;
+static const uint32_t BINARY_FILE_VERSION_COMPRESSED = 2;
+static const uint32_t BINARY_CODEC_ZLIB_SHUFFLE = 1;
+static const uint32_t BINARY_BLOCK_ELEMENTS = 1 << 17;   // 1 MiB
+static const size_t BINARY_SAMPLE_BYTES = 4096;           // 面を圧縮するか判定する試し圧縮の大きさ
+
+// バイナリファイルのヘッダー（64バイト、file_io.py の BINARY_HEADER_DTYPE と同一）
+struct BinaryFileHeader {
+    uint32_t magic;              // BINARY_FILE_MAGIC
+    uint32_t version;            // BINARY_FILE_VERSION
+    uint32_t dtype;              // ShmDType（現在は SHM_DTYPE_FLOAT64 のみ）
+    uint32_t ndim;               // 次元数（1〜SHM_MAX_NDIM）
+    uint64_t shape[SHM_MAX_NDIM];
+    uint64_t data_offset;        // ファイル先頭からのデータ位置
+    uint64_t nbytes;             // データのバイト数
+};
+
+static_assert(sizeof(BinaryFileHeader) == 64, "BinaryFileHeader layout must match file_io.py");
+
+// 圧縮形式のデータ部の先頭（file_io.py の BINARY_BLOCK_INFO_DTYPE と同一）
+struct BinaryBlockInfo {
+    uint32_t codec;              // BINARY_CODEC_ZLIB_SHUFFLE
+    uint32_t block_elements;     // 1ブロックの要素数（最後のブロックは短い）
+};
+
+// 圧縮形式の各ブロックの各面の先頭（file_io.py の BINARY_BLOCK_HEADER_DTYPE と同一）
+struct BinaryBlockHeader {
+    uint32_t raw_bytes;          // 展開後のバイト数（ブロックの要素数）
+    uint32_t stored_bytes;       // 続く格納データのバイト数（raw_bytes と等しければ圧縮していない）
+};
+
+// double配列のヘッダーを作成する（version に BINARY_FILE_VERSION_COMPRESSED を指定すると圧縮形式）
+inline BinaryFileHeader binary_file_header(const uint64_t* shape, size_t ndim, size_t elements,
+                                           uint32_t version = BINARY_FILE_VERSION) {
+    BinaryFileHeader header;
+    memset(&header, 0, sizeof(header));
+    header.magic = BINARY_FILE_MAGIC;
+    header.version = version;
+    header.dtype = SHM_DTYPE_FLOAT64;
+    header.ndim = static_cast<uint32_t>(ndim);
+    for (size_t i = 0; i < ndim; i++) {
+        header.shape[i] = shape[i];
+    }
+    header.data_offset = sizeof(header);
+    header.nbytes = elements * sizeof(double);
+    return header;
+}
+
+// 8バイトの要素のバイト列を、バイトの位置ごとに連続するよう並べ替える
+inline void binary_shuffle(uint8_t* dst, const double* src, size_t n) {
+    const uint8_t* bytes = reinterpret_cast<const uint8_t*>(src);
+    for (size_t b = 0; b < sizeof(double); b++) {
+        uint8_t* plane = dst + b * n;
+        for (size_t i = 0; i < n; i++) {
+            plane[i] = bytes[i * sizeof(double) + b];
+        }
+    }
+}
+
+// binary_shuffle() の逆変換
+inline void binary_unshuffle(double* dst, const uint8_t* src, size_t n) {
+    uint8_t* bytes = reinterpret_cast<uint8_t*>(dst);
+    for (size_t b = 0; b < sizeof(double); b++) {
+        const uint8_t* plane = src + b * n;
+        for (size_t i = 0; i < n; i++) {
+            bytes[i * sizeof(double) + b] = plane[i];
+        }
+    }
+}
+
+// in を out に圧縮する（面ごとの初期化を避けるため、ストリームは書き込み全体で使い回す）
+inline bool binary_deflate(z_stream* stream, const uint8_t* in, size_t n, std::vector<uint8_t>* out,
+                           size_t* stored) {
+    if (deflateReset(stream) != Z_OK) {
+        return false;
+    }
+    stream->next_in = const_cast<Bytef*>(in);
+    stream->avail_in = static_cast<uInt>(n);
+    stream->next_out = &(*out)[0];
+    stream->avail_out = static_cast<uInt>(out->size());
+    if (deflate(stream, Z_FINISH) != Z_STREAM_END) {
+        return false;
+    }
+    *stored = stream->total_out;
+    return true;
+}
+
+// 1つの面を圧縮して格納データを決める（小さくならない面は並べ替えたまま格納する）
+inline const uint8_t* binary_compress_plane(z_stream* stream, const uint8_t* plane, size_t n,
+                                            std::vector<uint8_t>* buffer, uint32_t* stored_bytes) {
+    *stored_bytes = static_cast<uint32_t>(n);
+    size_t stored;
+    size_t sample = std::min(n, BINARY_SAMPLE_BYTES);
+    if (n > sample && (!binary_deflate(stream, plane, sample, buffer, &stored) || stored >= sample * 9 / 10)) {
+        return plane;
+    }
+    if (!binary_deflate(stream, plane, n, buffer, &stored) || stored >= n) {
+        return plane;
+    }
+    *stored_bytes = static_cast<uint32_t>(stored);
+    return &(*buffer)[0];
+}
+
+// 圧縮形式のデータ部を書き込む
+inline bool binary_write_blocks(FILE* fp, const double* data, size_t elements) {
+    BinaryBlockInfo info = { BINARY_CODEC_ZLIB_SHUFFLE, BINARY_BLOCK_ELEMENTS };
+    if (fwrite(&info, sizeof(info), 1, fp) != 1) {
+        return false;
+    }
+    z_stream stream;
+    memset(&stream, 0, sizeof(stream));
+    if (deflateInit(&stream, Z_BEST_SPEED) != Z_OK) {
+        return false;
+    }
+    size_t block = std::min<size_t>(elements, BINARY_BLOCK_ELEMENTS);
+    std::vector<uint8_t> shuffled(block * sizeof(double));
+    std::vector<uint8_t> compressed(deflateBound(&stream, block));
+    bool ok = true;
+    for (size_t first = 0; ok && first < elements; first += BINARY_BLOCK_ELEMENTS) {
+        size_t n = std::min<size_t>(BINARY_BLOCK_ELEMENTS, elements - first);
+        binary_shuffle(&shuffled[0], data + first, n);
+        for (size_t b = 0; ok && b < sizeof(double); b++) {
+            BinaryBlockHeader record;
+            record.raw_bytes = static_cast<uint32_t>(n);
+            const uint8_t* out = binary_compress_plane(&stream, &shuffled[b * n], n, &compressed,
+                                                       &record.stored_bytes);
+            ok = fwrite(&record, sizeof(record), 1, fp) == 1
+                 && fwrite(out, 1, record.stored_bytes, fp) == record.stored_bytes;
+        }
+    }
+    deflateEnd(&stream);
+    return ok;
+}
+
+// ヘッダーと連続したデータを一時ファイルに書き込み、書き込み先に置き換える
+// （ヘッダーが圧縮形式の場合はデータ部を圧縮して書き込む）
+inline bool binary_file_write(const std::string& path, const BinaryFileHeader& header, const void* data) {
+    std::string temp_path = path + ".tmp";
+    FILE* fp = fopen(temp_path.c_str(), "wb");
+    if (!fp) {
+        std::cerr << "バイナリファイルを作成できません: " << temp_path << std::endl;
+        return false;
+    }
+    bool ok = fwrite(&header, sizeof(header), 1, fp) == 1;
+    if (ok && header.version == BINARY_FILE_VERSION_COMPRESSED) {
+        ok = binary_write_blocks(fp, static_cast<const double*>(data), header.nbytes / sizeof(double));
+    } else if (ok && header.nbytes > 0) {
+        ok = fwrite(data, 1, header.nbytes, fp) == header.nbytes;
+    }
+    ok = (fclose(fp) == 0) && ok;
+    if (!ok || rename(temp_path.c_str(), path.c_str()) != 0) {
+        std::cerr << "バイナリファイルの書き込みに失敗しました: " << path << std::endl;
+        remove(temp_path.c_str());
+        return false;
+    }
+    return true;
+}
+
+// バイナリファイルを開いてヘッダーを確認し、データの先頭に移動したファイルを返す（失敗した場合はNULL）
+inline FILE* binary_file_open(const std::string& path, BinaryFileHeader* header) {
+    FILE* fp = fopen(path.c_str(), "rb");
+    if (!fp) {
+        std::cerr << "バイナリファイルを開けません: " << path << std::endl;
+        return NULL;
+    }
+    if (fread(header, sizeof(*header), 1, fp) != 1 || header->magic != BINARY_FILE_MAGIC) {
+        std::cerr << "バイナリファイルの形式が不正です: " << path << std::endl;
+        fclose(fp);
+        return NULL;
+    }
+    if ((header->version != BINARY_FILE_VERSION && header->version != BINARY_FILE_VERSION_COMPRESSED)
+        || header->dtype != SHM_DTYPE_FLOAT64
+        || header->nbytes % sizeof(double) != 0) {
+        std::cerr << "対応していないバイナリファイルです: " << path << " (バージョン: " << header->version
+                  << ", データ型: " << shm_dtype_name(header->dtype) << ")" << std::endl;
+        fclose(fp);
+        return NULL;
+    }
+    if (fseek(fp, static_cast<long>(header->data_offset), SEEK_SET) != 0) {
+        std::cerr << "バイナリファイルのデータが不足しています: " << path << std::endl;
+        fclose(fp);
+        return NULL;
+    }
+    return fp;
+}
+
+// 1つの面を展開する（ストリームは読み込み全体で使い回す）
+inline bool binary_inflate(z_stream* stream, const uint8_t* in, size_t stored, uint8_t* plane, size_t n) {
+    if (inflateReset(stream) != Z_OK) {
+        return false;
+    }
+    stream->next_in = const_cast<Bytef*>(in);
+    stream->avail_in = static_cast<uInt>(stored);
+    stream->next_out = plane;
+    stream->avail_out = static_cast<uInt>(n);
+    return inflate(stream, Z_FINISH) == Z_STREAM_END && stream->total_out == n;
+}
+
+// 圧縮形式のデータ部を展開して dst（elements 要素の連続領域）に読み込む
+inline bool binary_read_blocks(FILE* fp, double* dst, size_t elements) {
+    BinaryBlockInfo info;
+    if (fread(&info, sizeof(info), 1, fp) != 1 || info.codec != BINARY_CODEC_ZLIB_SHUFFLE
+        || info.block_elements == 0) {
+        return false;
+    }
+    z_stream stream;
+    memset(&stream, 0, sizeof(stream));
+    if (inflateInit(&stream) != Z_OK) {
+        return false;
+    }
+    size_t block = std::min<size_t>(elements, info.block_elements);
+    std::vector<uint8_t> shuffled(block * sizeof(double));
+    std::vector<uint8_t> stored(block);
+    bool ok = true;
+    for (size_t first = 0; ok && first < elements; first += info.block_elements) {
+        size_t n = std::min<size_t>(info.block_elements, elements - first);
+        for (size_t b = 0; ok && b < sizeof(double); b++) {
+            BinaryBlockHeader record;
+            uint8_t* plane = &shuffled[b * n];
+            ok = fread(&record, sizeof(record), 1, fp) == 1 && record.raw_bytes == n && record.stored_bytes <= n;
+            if (ok && record.stored_bytes == n) {
+                ok = fread(plane, 1, n, fp) == n;
+            } else if (ok) {
+                ok = fread(&stored[0], 1, record.stored_bytes, fp) == record.stored_bytes
+                     && binary_inflate(&stream, &stored[0], record.stored_bytes, plane, n);
+            }
+        }
+        if (ok) {
+            binary_unshuffle(dst + first, &shuffled[0], n);
+        }
+    }
+    inflateEnd(&stream);
+    return ok;
+}
+
+// binary_file_open() で開いたファイルのデータ部を dst（header.nbytes バイトの連続領域）に読み込む
+inline bool binary_file_read(FILE* fp, const BinaryFileHeader& header, double* dst) {
+    size_t elements = header.nbytes / sizeof(double);
+    if (header.version == BINARY_FILE_VERSION_COMPRESSED) {
+        return binary_read_blocks(fp, dst, elements);
+    }
+    return elements == 0 || fread(dst, sizeof(double), elements, fp) == elements;
+}
+
+#endif // SHM_BINARY_FILE_HPP
@@ -0,0 +1,198 @@
+#ifndef SHM_COPY_HPP
+#define SHM_COPY_HPP
+
+// 配列転送用のコピー・型変換カーネル。FreeFEMのヘッダーには依存しない。
+//
+// KN_<double> はストライド（step）を持ちうるため、連続な場合はmemcpy、
+// ストライドがある場合はAVX2のgatherで読み出す。float32/int32への縮小変換は
+// コピーと同時に行い、ペイロードのバイト数を半分にする。
+//
+// x86ではビルドフラグに依存しないよう、AVX2版を target 属性で別にコンパイルし、
+// 実行時にCPUの対応を確認して切り替える。aarch64ではNEONを使用する
+// （NEONにはgatherが無いため、ストライドがある場合はスカラーで処理する）。
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+
+#if (defined(__x86_64__) || defined(__i386__)) && defined(__GNUC__)
+#include <immintrin.h>
+#define SHM_COPY_X86 1
+#elif defined(__aarch64__) && defined(__ARM_NEON)
+#include <arm_neon.h>
+#define SHM_COPY_NEON 1
+#endif
+
+#ifdef SHM_COPY_X86
+#define SHM_TARGET_AVX2 __attribute__((target("avx2")))
+
+inline bool shm_cpu_has_avx2() {
+    static const bool has_avx2 = __builtin_cpu_supports("avx2");
+    return has_avx2;
+}
+
+SHM_TARGET_AVX2 inline size_t shm_gather_f64_avx2(double* dst, const double* src, size_t n, long step) {
+    const __m256i index = _mm256_set_epi64x(3 * step, 2 * step, step, 0);
+    size_t i = 0;
+    for (; i + 4 <= n; i += 4) {
+        _mm256_storeu_pd(dst + i, _mm256_i64gather_pd(src + i * step, index, 8));
+    }
+    return i;
+}
+
+SHM_TARGET_AVX2 inline size_t shm_f64_to_f32_avx2(float* dst, const double* src, size_t n, long step) {
+    size_t i = 0;
+    if (step == 1) {
+        for (; i + 4 <= n; i += 4) {
+            _mm_storeu_ps(dst + i, _mm256_cvtpd_ps(_mm256_loadu_pd(src + i)));
+        }
+    } else {
+        const __m256i index = _mm256_set_epi64x(3 * step, 2 * step, step, 0);
+        for (; i + 4 <= n; i += 4) {
+            _mm_storeu_ps(dst + i, _mm256_cvtpd_ps(_mm256_i64gather_pd(src + i * step, index, 8)));
+        }
+    }
+    return i;
+}
+
+SHM_TARGET_AVX2 inline size_t shm_f32_to_f64_avx2(double* dst, const float* src, size_t n) {
+    size_t i = 0;
+    for (; i + 4 <= n; i += 4) {
+        _mm256_storeu_pd(dst + i, _mm256_cvtps_pd(_mm_loadu_ps(src + i)));
+    }
+    return i;
+}
+
+SHM_TARGET_AVX2 inline size_t shm_i64_to_i32_avx2(int32_t* dst, const int64_t* src, size_t n, long step) {
+    // 各64bit要素の下位32bitを先頭の128bitに集める
+    const __m256i pack = _mm256_setr_epi32(0, 2, 4, 6, 0, 0, 0, 0);
+    const __m256i index = _mm256_set_epi64x(3 * step, 2 * step, step, 0);
+    size_t i = 0;
+    for (; i + 4 <= n; i += 4) {
+        __m256i v = step == 1
+            ? _mm256_loadu_si256(reinterpret_cast<const __m256i*>(src + i))
+            : _mm256_i64gather_epi64(reinterpret_cast<const long long*>(src + i * step), index, 8);
+        v = _mm256_permutevar8x32_epi32(v, pack);
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i), _mm256_castsi256_si128(v));
+    }
+    return i;
+}
+
+SHM_TARGET_AVX2 inline size_t shm_i32_to_i64_avx2(int64_t* dst, const int32_t* src, size_t n) {
+    size_t i = 0;
+    for (; i + 4 <= n; i += 4) {
+        __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i));
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + i), _mm256_cvtepi32_epi64(v));
+    }
+    return i;
+}
+#endif // SHM_COPY_X86
+
+// ストライドを持つdouble配列を連続領域にコピーする（書き込み側）
+inline void shm_gather_f64(double* dst, const double* src, size_t n, long step) {
+    if (step == 1) {
+        memcpy(dst, src, n * sizeof(double));
+        return;
+    }
+    size_t i = 0;
+#ifdef SHM_COPY_X86
+    if (shm_cpu_has_avx2()) {
+        i = shm_gather_f64_avx2(dst, src, n, step);
+    }
+#endif
+    for (; i < n; i++) {
+        dst[i] = src[i * step];
+    }
+}
+
+// 連続領域のdouble配列をストライドを持つ配列にコピーする（読み込み側）
+// AVX2/NEONにはscatterが無いため、ストライドがある場合はスカラーで処理する
+inline void shm_scatter_f64(double* dst, long step, const double* src, size_t n) {
+    if (step == 1) {
+        memcpy(dst, src, n * sizeof(double));
+        return;
+    }
+    for (size_t i = 0; i < n; i++) {
+        dst[i * step] = src[i];
+    }
+}
+
+// double配列をfloat32に縮小しながらコピーする
+inline void shm_convert_f64_to_f32(float* dst, const double* src, size_t n, long step) {
+    size_t i = 0;
+#if defined(SHM_COPY_X86)
+    if (shm_cpu_has_avx2()) {
+        i = shm_f64_to_f32_avx2(dst, src, n, step);
+    }
+#elif defined(SHM_COPY_NEON)
+    if (step == 1) {
+        for (; i + 4 <= n; i += 4) {
+            float32x2_t lo = vcvt_f32_f64(vld1q_f64(src + i));
+            float32x2_t hi = vcvt_f32_f64(vld1q_f64(src + i + 2));
+            vst1q_f32(dst + i, vcombine_f32(lo, hi));
+        }
+    }
+#endif
+    for (; i < n; i++) {
+        dst[i] = static_cast<float>(src[i * step]);
+    }
+}
+
+// float32配列をdoubleに拡張しながらコピーする
+inline void shm_convert_f32_to_f64(double* dst, long step, const float* src, size_t n) {
+    size_t i = 0;
+    if (step == 1) {
+#if defined(SHM_COPY_X86)
+        if (shm_cpu_has_avx2()) {
+            i = shm_f32_to_f64_avx2(dst, src, n);
+        }
+#elif defined(SHM_COPY_NEON)
+        for (; i + 2 <= n; i += 2) {
+            vst1q_f64(dst + i, vcvt_f64_f32(vld1_f32(src + i)));
+        }
+#endif
+    }
+    for (; i < n; i++) {
+        dst[i * step] = src[i];
+    }
+}
+
+// 64bit整数配列をint32に縮小しながらコピーする（範囲外の値は下位32bitに切り詰める）
+inline void shm_convert_i64_to_i32(int32_t* dst, const int64_t* src, size_t n, long step) {
+    size_t i = 0;
+#if defined(SHM_COPY_X86)
+    if (shm_cpu_has_avx2()) {
+        i = shm_i64_to_i32_avx2(dst, src, n, step);
+    }
+#elif defined(SHM_COPY_NEON)
+    if (step == 1) {
+        for (; i + 2 <= n; i += 2) {
+            vst1_s32(dst + i, vmovn_s64(vld1q_s64(src + i)));
+        }
+    }
+#endif
+    for (; i < n; i++) {
+        dst[i] = static_cast<int32_t>(src[i * step]);
+    }
+}
+
+// int32配列を64bit整数に拡張しながらコピーする
+inline void shm_convert_i32_to_i64(int64_t* dst, long step, const int32_t* src, size_t n) {
+    size_t i = 0;
+    if (step == 1) {
+#if defined(SHM_COPY_X86)
+        if (shm_cpu_has_avx2()) {
+            i = shm_i32_to_i64_avx2(dst, src, n);
+        }
+#elif defined(SHM_COPY_NEON)
+        for (; i + 2 <= n; i += 2) {
+            vst1q_s64(dst + i, vmovl_s32(vld1_s32(src + i)));
+        }
+#endif
+    }
+    for (; i < n; i++) {
+        dst[i * step] = src[i];
+    }
+}
+
+#endif // SHM_COPY_HPP
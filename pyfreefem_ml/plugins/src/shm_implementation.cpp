@@ -1,254 +1,373 @@
 #include "shm_implementation.hpp"
+#include "shm_transport.hpp"
+#include "shm_copy.hpp"
 
 #include <iostream>
 #include <cstring>
 #include <string>
 #include <vector>
-#include <sys/mman.h>
-#include <sys/stat.h>
-#include <fcntl.h>
-#include <unistd.h>
-#include <semaphore.h>
-#include <errno.h>
+#include <stdint.h>
 
 // FreeFEMプラグイン用の共有メモリ実装
 
 using namespace Fem2D;
 using namespace std;
 
-// 共有メモリ構造体
-struct SharedMemoryData {
-    size_t size;           // データのサイズ（バイト単位）
-    size_t elements;       // 要素数（配列の場合）
-    char data_type[32];    // データ型の文字列表現（"int", "double", "double_array"など）
-    char semaphore_name[64]; // セマフォ名
-};
+// 転送処理そのものは shm_transport.cpp を参照
 
-// 共有メモリオブジェクトを管理するクラス
-class SharedMemoryManager {
-private:
-    static const int MAX_SHM_OBJECTS = 100;
-    static struct {
-        string name;
-        void* addr;
-        size_t size;
-        int fd;
-        bool in_use;
-    } shm_objects[MAX_SHM_OBJECTS];
-
-    // 空きスロットを検索
-    static int find_free_slot() {
-        for (int i = 0; i < MAX_SHM_OBJECTS; i++) {
-            if (!shm_objects[i].in_use) {
-                return i;
-            }
-        }
-        return -1;
+// 外部から呼び出される関数：リングバッファに配列を追加する
+bool ring_push_array(const char* name, const KN<double>* array) {
+    if (!array) {
+        cerr << "無効な配列ポインタです" << endl;
+        return false;
     }
+    return ring_push(name, *array, array->N(), array->step);
+}
 
-    // 名前からスロットを検索
-    static int find_slot_by_name(const string& name) {
-        for (int i = 0; i < MAX_SHM_OBJECTS; i++) {
-            if (shm_objects[i].in_use && shm_objects[i].name == name) {
-                return i;
-            }
-        }
-        return -1;
+// 外部から呼び出される関数：リングバッファから配列を取り出す
+bool ring_pop_array(const char* name, KN<double>* array) {
+    if (!array) {
+        cerr << "無効な配列ポインタです" << endl;
+        return false;
+    }
+    size_t elements;
+    const double* data_ptr = ring_front(name, &elements);
+    if (!data_ptr) {
+        return false;
     }
+    if (array->N() != (long)elements) {
+        array->resize(elements);
+    }
+    shm_scatter_f64(*array, array->step, data_ptr, elements);
+    ring_consume(name);
+    return true;
+}
 
-public:
-    // 共有メモリオブジェクトを作成または開く
-    static int create_or_open(const string& name, size_t size) {
-        int slot = find_slot_by_name(name);
-        if (slot >= 0) {
-            // 既に存在する場合は再利用
-            return slot;
-        }
+// 外部から呼び出される関数：セグメント内の名前付きエントリに配列を書き込む
+bool write_array_to_segment(const char* segment, const char* key, const KN<double>* array) {
+    if (!array) {
+        cerr << "無効な配列ポインタです" << endl;
+        return false;
+    }
 
-        slot = find_free_slot();
-        if (slot < 0) {
-            cerr << "共有メモリオブジェクトの最大数に達しました" << endl;
-            return -1;
-        }
+    const double* src = *array;
+    size_t elements = array->N();
+    long step = array->step;
+    ShmEntryRef ref;
+    if (!shm_begin_write(segment, key, SHM_DTYPE_FLOAT64, elements, &ref)) {
+        return false;
+    }
+    shm_gather_f64(static_cast<double*>(shm_entry_data(ref)), src, elements, step);
+    shm_end_write(ref, elements);
+    return true;
+}
 
-        // 共有メモリオブジェクトを開く
-        int fd = shm_open(name.c_str(), O_CREAT | O_RDWR, 0666);
-        if (fd < 0) {
-            cerr << "共有メモリのオープンに失敗: " << name << ", エラー: " << strerror(errno) << endl;
-            return -1;
-        }
+// 外部から呼び出される関数：double配列をfloat32に変換しながら書き込む
+bool write_float32_array_to_segment(const char* segment, const char* key, const KN<double>* array) {
+    if (!array) {
+        cerr << "無効な配列ポインタです" << endl;
+        return false;
+    }
 
-        // サイズを設定
-        if (ftruncate(fd, size) < 0) {
-            cerr << "共有メモリのサイズ設定に失敗: " << name << ", エラー: " << strerror(errno) << endl;
-            close(fd);
-            return -1;
-        }
+    const double* src = *array;
+    size_t elements = array->N();
+    long step = array->step;
+    ShmEntryRef ref;
+    if (!shm_begin_write(segment, key, SHM_DTYPE_FLOAT32, elements, &ref)) {
+        return false;
+    }
+    shm_convert_f64_to_f32(static_cast<float*>(shm_entry_data(ref)), src, elements, step);
+    shm_end_write(ref, elements);
+    return true;
+}
 
-        // メモリマッピング
-        void* addr = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
-        if (addr == MAP_FAILED) {
-            cerr << "メモリマッピングに失敗: " << name << ", エラー: " << strerror(errno) << endl;
-            close(fd);
-            return -1;
-        }
+// 外部から呼び出される関数：整数配列をint32に変換しながら書き込む
+bool write_int_array_to_segment(const char* segment, const char* key, const KN<long>* array) {
+    if (!array) {
+        cerr << "無効な配列ポインタです" << endl;
+        return false;
+    }
 
-        // スロットに情報を格納
-        shm_objects[slot].name = name;
-        shm_objects[slot].addr = addr;
-        shm_objects[slot].size = size;
-        shm_objects[slot].fd = fd;
-        shm_objects[slot].in_use = true;
+    const int64_t* src = reinterpret_cast<const int64_t*>(static_cast<const long*>(*array));
+    size_t elements = array->N();
+    long step = array->step;
+    ShmEntryRef ref;
+    if (!shm_begin_write(segment, key, SHM_DTYPE_INT32, elements, &ref)) {
+        return false;
+    }
+    shm_convert_i64_to_i32(static_cast<int32_t*>(shm_entry_data(ref)), src, elements, step);
+    shm_end_write(ref, elements);
+    return true;
+}
 
-        return slot;
+// 外部から呼び出される関数：セグメント内の名前付きエントリから配列を読み取る
+bool read_array_from_segment(const char* segment, const char* key, KN<double>* array) {
+    if (!array) {
+        cerr << "無効な配列ポインタです" << endl;
+        return false;
     }
 
-    // 共有メモリオブジェクトを閉じる
-    static void close(int slot) {
-        if (slot < 0 || slot >= MAX_SHM_OBJECTS || !shm_objects[slot].in_use) {
-            return;
-        }
+    ShmEntryRef ref;
+    if (!shm_acquire_entry(segment, key, &ref)) {
+        return false;
+    }
+    const SegmentEntry* entry = ref.entry;
+    if (entry->dtype != SHM_DTYPE_FLOAT64 && entry->dtype != SHM_DTYPE_FLOAT32) {
+        cerr << "データ型が一致しません: " << key << " (期待値: float64/float32, 実際: "
+             << shm_dtype_name(entry->dtype) << ")" << endl;
+        return false;
+    }
+    
+    // 配列サイズの設定
+    size_t elements = shm_entry_elements(ref);
+    array->resize(elements);
+    
+    // データをコピー（float32の場合はdoubleに拡張）
+    const void* data_ptr = shm_entry_data(ref);
+    if (entry->dtype == SHM_DTYPE_FLOAT64) {
+        shm_scatter_f64(*array, array->step, static_cast<const double*>(data_ptr), elements);
+    } else {
+        shm_convert_f32_to_f64(*array, array->step, static_cast<const float*>(data_ptr), elements);
+    }
+    shm_end_read(ref, entry->nbytes);
+    
+    return true;
+}
 
-        munmap(shm_objects[slot].addr, shm_objects[slot].size);
-        ::close(shm_objects[slot].fd);
-        shm_objects[slot].in_use = false;
+// 外部から呼び出される関数：セグメント内の名前付きエントリから整数配列を読み取る
+bool read_int_array_from_segment(const char* segment, const char* key, KN<long>* array) {
+    if (!array) {
+        cerr << "無効な配列ポインタです" << endl;
+        return false;
     }
 
-    // 共有メモリオブジェクトを削除
-    static void unlink(const string& name) {
-        shm_unlink(name.c_str());
+    ShmEntryRef ref;
+    if (!shm_acquire_entry(segment, key, &ref)) {
+        return false;
+    }
+    const SegmentEntry* entry = ref.entry;
+    if (entry->dtype != SHM_DTYPE_INT32 && entry->dtype != SHM_DTYPE_INT64) {
+        cerr << "データ型が一致しません: " << key << " (期待値: int32/int64, 実際: "
+             << shm_dtype_name(entry->dtype) << ")" << endl;
+        return false;
+    }
+    
+    size_t elements = shm_entry_elements(ref);
+    array->resize(elements);
+    
+    int64_t* dst = reinterpret_cast<int64_t*>(static_cast<long*>(*array));
+    const void* data_ptr = shm_entry_data(ref);
+    if (entry->dtype == SHM_DTYPE_INT32) {
+        shm_convert_i32_to_i64(dst, array->step, static_cast<const int32_t*>(data_ptr), elements);
+    } else {
+        const int64_t* src = static_cast<const int64_t*>(data_ptr);
+        for (size_t i = 0; i < elements; i++) {
+            dst[i * array->step] = src[i];
+        }
     }
+    shm_end_read(ref, entry->nbytes);
+    
+    return true;
+}
 
-    // スロットからアドレスを取得
-    static void* get_address(int slot) {
-        if (slot < 0 || slot >= MAX_SHM_OBJECTS || !shm_objects[slot].in_use) {
-            return NULL;
+// カンマ区切りのエントリ名を分割する（前後の空白は無視する）
+vector<string> split_batch_keys(const char* keys) {
+    vector<string> names;
+    string text(keys);
+    size_t begin = 0;
+    for (;;) {
+        size_t end = text.find(',', begin);
+        string name = text.substr(begin, end == string::npos ? string::npos : end - begin);
+        size_t first = name.find_first_not_of(" \t");
+        size_t last = name.find_last_not_of(" \t");
+        names.push_back(first == string::npos ? string() : name.substr(first, last - first + 1));
+        if (end == string::npos) {
+            return names;
         }
-        return shm_objects[slot].addr;
+        begin = end + 1;
     }
+}
 
-    // 名前からアドレスを取得
-    static void* get_address(const string& name) {
-        int slot = find_slot_by_name(name);
-        if (slot < 0) {
-            return NULL;
+// エントリ名と配列の個数を確認する
+static bool check_batch_keys(const vector<string>& names, size_t arrays, const char* keys) {
+    if (names.size() != arrays) {
+        cerr << "エントリ名と配列の個数が一致しません: \"" << keys << "\" (" << names.size()
+             << " 個のエントリ名, " << arrays << " 個の配列)" << endl;
+        return false;
+    }
+    for (size_t i = 0; i < names.size(); i++) {
+        if (names[i].empty()) {
+            cerr << "空のエントリ名があります: \"" << keys << "\"" << endl;
+            return false;
         }
-        return shm_objects[slot].addr;
     }
-};
+    return true;
+}
 
-// 静的メンバの初期化
-decltype(SharedMemoryManager::shm_objects) SharedMemoryManager::shm_objects = {};
+// 外部から呼び出される関数：複数の配列をまとめて書き込み、1回の通知で公開する
+bool write_arrays_to_segment(const char* segment, const char* keys, const vector<const KN<double>*>& arrays) {
+    vector<string> names = split_batch_keys(keys);
+    if (!check_batch_keys(names, arrays.size(), keys)) {
+        return false;
+    }
 
-// 外部から呼び出される関数：共有メモリに配列を書き込む
-bool write_array_to_shared_memory(const char* name, const KN<double>* array) {
-    if (!array) {
-        cerr << "無効な配列ポインタです" << endl;
+    vector<ShmBatchItem> items(arrays.size());
+    for (size_t i = 0; i < arrays.size(); i++) {
+        if (!arrays[i]) {
+            cerr << "無効な配列ポインタです: " << names[i] << endl;
+            return false;
+        }
+        items[i].key = names[i].c_str();
+        items[i].dtype = SHM_DTYPE_FLOAT64;
+        items[i].elements = arrays[i]->N();
+    }
+
+    vector<ShmEntryRef> refs(arrays.size());
+    if (!shm_begin_write_batch(segment, &items[0], items.size(), &refs[0])) {
         return false;
     }
+    for (size_t i = 0; i < arrays.size(); i++) {
+        shm_gather_f64(static_cast<double*>(shm_entry_data(refs[i])), *arrays[i], items[i].elements, arrays[i]->step);
+    }
+    shm_end_write_batch(&refs[0], &items[0], items.size());
+    return true;
+}
 
-    size_t elements = array->N();
-    size_t data_size = elements * sizeof(double);
-    size_t total_size = sizeof(SharedMemoryData) + data_size;
-    
-    // 共有メモリを作成または開く
-    string shm_name = string("/") + name;
-    int slot = SharedMemoryManager::create_or_open(shm_name, total_size);
-    if (slot < 0) {
+// 外部から呼び出される関数：複数のエントリがすべて書き込まれるまで待機し、まとめて読み取る
+bool read_arrays_from_segment(const char* segment, const char* keys, const vector<KN<double>*>& arrays) {
+    vector<string> names = split_batch_keys(keys);
+    if (!check_batch_keys(names, arrays.size(), keys)) {
         return false;
     }
-    
-    // 共有メモリ構造体にデータを書き込む
-    SharedMemoryData* shm_data = static_cast<SharedMemoryData*>(SharedMemoryManager::get_address(slot));
-    shm_data->size = data_size;
-    shm_data->elements = elements;
-    strcpy(shm_data->data_type, "double_array");
-    
-    // セマフォ名を設定
-    string sem_name = string("/sem_") + name;
-    strcpy(shm_data->semaphore_name, sem_name.c_str());
-    
-    // セマフォを作成または開く
-    sem_t* semaphore = sem_open(sem_name.c_str(), O_CREAT, 0666, 0);
-    if (semaphore == SEM_FAILED) {
-        cerr << "セマフォのオープンに失敗: " << sem_name << ", エラー: " << strerror(errno) << endl;
+
+    vector<const char*> key_ptrs(names.size());
+    for (size_t i = 0; i < names.size(); i++) {
+        if (!arrays[i]) {
+            cerr << "無効な配列ポインタです: " << names[i] << endl;
+            return false;
+        }
+        key_ptrs[i] = names[i].c_str();
+    }
+
+    vector<ShmEntryRef> refs(arrays.size());
+    if (!shm_acquire_batch(segment, &key_ptrs[0], key_ptrs.size(), &refs[0])) {
         return false;
     }
-    
-    // データ部分にdouble配列をコピー
-    double* data_ptr = reinterpret_cast<double*>(static_cast<char*>(SharedMemoryManager::get_address(slot)) + sizeof(SharedMemoryData));
-    for (size_t i = 0; i < elements; i++) {
-        data_ptr[i] = (*array)[i];
+    for (size_t i = 0; i < refs.size(); i++) {
+        uint32_t dtype = refs[i].entry->dtype;
+        if (dtype != SHM_DTYPE_FLOAT64 && dtype != SHM_DTYPE_FLOAT32) {
+            cerr << "データ型が一致しません: " << names[i] << " (期待値: float64/float32, 実際: "
+                 << shm_dtype_name(dtype) << ")" << endl;
+            return false;
+        }
     }
-    
-    // セマフォを解放して、データが利用可能であることを示す
-    sem_post(semaphore);
-    sem_close(semaphore);
-    
+
+    // データをコピー（float32の場合はdoubleに拡張）
+    size_t bytes = 0;
+    for (size_t i = 0; i < refs.size(); i++) {
+        KN<double>* array = arrays[i];
+        size_t elements = shm_entry_elements(refs[i]);
+        array->resize(elements);
+        const void* data_ptr = shm_entry_data(refs[i]);
+        if (refs[i].entry->dtype == SHM_DTYPE_FLOAT64) {
+            shm_scatter_f64(*array, array->step, static_cast<const double*>(data_ptr), elements);
+        } else {
+            shm_convert_f32_to_f64(*array, array->step, static_cast<const float*>(data_ptr), elements);
+        }
+        bytes += refs[i].entry->nbytes;
+    }
+    shm_end_read(refs[0], bytes);
     return true;
 }
 
-// 外部から呼び出される関数：共有メモリから配列を読み取る
-bool read_array_from_shared_memory(const char* name, KN<double>* array) {
+// 外部から呼び出される関数：セグメント内のエントリを直接指すビューを作成する
+KN_<double> view_array_in_segment(const char* segment, const char* key) {
+    ShmEntryRef ref;
+    if (!shm_acquire_entry(segment, key, &ref)) {
+        return KN_<double>();
+    }
+    if (ref.entry->dtype != SHM_DTYPE_FLOAT64) {
+        cerr << "ビューはfloat64のエントリにのみ作成できます: " << key << " ("
+             << shm_dtype_name(ref.entry->dtype) << ")" << endl;
+        return KN_<double>();
+    }
+
+    // スロットを参照中にして、ビューが有効な間はアンマップされないようにする
+    shm_pin_entry(ref);
+    shm_end_read(ref, 0);
+
+    double* data_ptr = static_cast<double*>(shm_entry_data(ref));
+    return KN_<double>(data_ptr, static_cast<long>(shm_entry_elements(ref)));
+}
+
+// 外部から呼び出される関数：多重バッファのチャネルに配列を1フレーム書き込む
+bool channel_write_array(const char* segment, const char* key, const KN<double>* array) {
     if (!array) {
         cerr << "無効な配列ポインタです" << endl;
         return false;
     }
-    
-    // 共有メモリを開く
-    string shm_name = string("/") + name;
-    
-    // 最初に小さなサイズで開き、実際のサイズを確認する
-    int slot = SharedMemoryManager::create_or_open(shm_name, sizeof(SharedMemoryData));
-    if (slot < 0) {
+
+    size_t elements = array->N();
+    ShmChannelRef ref;
+    if (!shm_channel_begin_write(segment, key, SHM_DTYPE_FLOAT64, elements, &ref)) {
         return false;
     }
-    
-    // 共有メモリ構造体からデータサイズを読み取る
-    SharedMemoryData* shm_data = static_cast<SharedMemoryData*>(SharedMemoryManager::get_address(slot));
-    
-    // セマフォを開く
-    sem_t* semaphore = sem_open(shm_data->semaphore_name, 0);
-    if (semaphore == SEM_FAILED) {
-        cerr << "セマフォのオープンに失敗: " << shm_data->semaphore_name << ", エラー: " << strerror(errno) << endl;
+    shm_gather_f64(static_cast<double*>(shm_entry_data(ref.buffer)), *array, elements, array->step);
+    shm_channel_end_write(ref, elements);
+    return true;
+}
+
+// 外部から呼び出される関数：多重バッファのチャネルから最新のフレームを読み取る
+bool channel_read_array(const char* segment, const char* key, KN<double>* array) {
+    if (!array) {
+        cerr << "無効な配列ポインタです" << endl;
         return false;
     }
-    
-    // セマフォを待機（データが利用可能になるまで）
-    struct timespec ts;
-    clock_gettime(CLOCK_REALTIME, &ts);
-    ts.tv_sec += 10; // 10秒のタイムアウト
-    if (sem_timedwait(semaphore, &ts) < 0) {
-        cerr << "セマフォ待機中にタイムアウトまたはエラー: " << strerror(errno) << endl;
-        sem_close(semaphore);
+
+    ShmChannelRef ref;
+    if (!shm_channel_acquire(segment, key, &ref)) {
         return false;
     }
-    
-    // データ型の確認
-    if (strcmp(shm_data->data_type, "double_array") != 0) {
-        cerr << "データ型が一致しません: " << shm_data->data_type << " (期待値: double_array)" << endl;
-        sem_post(semaphore); // セマフォを戻す
-        sem_close(semaphore);
+    uint32_t dtype = ref.buffer.entry->dtype;
+    if (dtype != SHM_DTYPE_FLOAT64 && dtype != SHM_DTYPE_FLOAT32) {
+        shm_channel_release(ref, 0);
+        cerr << "データ型が一致しません: " << key << " (期待値: float64/float32, 実際: "
+             << shm_dtype_name(dtype) << ")" << endl;
         return false;
     }
-    
-    // 配列サイズの設定
-    size_t elements = shm_data->elements;
+
+    size_t elements = shm_entry_elements(ref.buffer);
     array->resize(elements);
-    
-    // データをコピー
-    double* data_ptr = reinterpret_cast<double*>(static_cast<char*>(SharedMemoryManager::get_address(slot)) + sizeof(SharedMemoryData));
-    for (size_t i = 0; i < elements; i++) {
-        (*array)[i] = data_ptr[i];
+    const void* data_ptr = shm_entry_data(ref.buffer);
+    if (dtype == SHM_DTYPE_FLOAT64) {
+        shm_scatter_f64(*array, array->step, static_cast<const double*>(data_ptr), elements);
+    } else {
+        shm_convert_f32_to_f64(*array, array->step, static_cast<const float*>(data_ptr), elements);
     }
-    
-    // セマフォを解放して、データが読み取られたことを示す
-    sem_post(semaphore);
-    sem_close(semaphore);
-    
+    shm_channel_release(ref, ref.buffer.entry->nbytes);
     return true;
 }
 
+// 外部から呼び出される関数：共有メモリに配列を書き込む（セグメント名をキーとして使用）
+bool write_array_to_shared_memory(const char* name, const KN<double>* array) {
+    return write_array_to_segment(name, name, array);
+}
+
+// 外部から呼び出される関数：共有メモリから配列を読み取る（セグメント名をキーとして使用）
+bool read_array_from_shared_memory(const char* name, KN<double>* array) {
+    return read_array_from_segment(name, name, array);
+}
+
+// 外部から呼び出される関数：共有メモリのデータ領域を直接指すビューを作成する
+KN_<double> view_array_in_shared_memory(const char* name) {
+    return view_array_in_segment(name, name);
+}
+
+// 外部から呼び出される関数：ビューの参照を解放する
+bool release_array_view(const char* name) {
+    return shm_unpin_segment(name);
+}
+
 // FreeFEMのプラグイン関数：共有メモリへの書き込み実装
 class WriteArrayCode : public E_F0mps {
 public:
@@ -295,11 +414,726 @@ E_F0* ShmReadDoubleArray::code(const basicAC_F0& args) const {
 
 ShmReadDoubleArray::ShmReadDoubleArray() : OneOperator(atype<long>(), atype<string*>(), atype<KN<double>*>()) {}
 
-// プラグインの初期化関数
-static void init_shared_memory_operations() {
-    Global.Add("writeSharedMemory", "(", new ShmWriteDoubleArray);
-    Global.Add("readSharedMemory", "(", new ShmReadDoubleArray);
+// FreeFEMのプラグイン関数：セグメント内エントリへの書き込み実装
+class WriteSegmentArrayCode : public E_F0mps {
+public:
+    Expression segment_name;
+    Expression key_name;
+    Expression array_expr;
+    
+    WriteSegmentArrayCode(const basicAC_F0& args) : segment_name(args[0]), key_name(args[1]), array_expr(args[2]) {}
+    
+    AnyType operator()(Stack stack) const {
+        string* segment = GetAny<string*>((*segment_name)(stack));
+        string* key = GetAny<string*>((*key_name)(stack));
+        KN<double>* array = GetAny<KN<double>*>((*array_expr)(stack));
+        
+        bool success = write_array_to_segment(segment->c_str(), key->c_str(), array);
+        return success ? 1L : 0L;
+    }
+};
+
+E_F0* ShmWriteSegmentArray::code(const basicAC_F0& args) const {
+    return new WriteSegmentArrayCode(args);
+}
+
+ShmWriteSegmentArray::ShmWriteSegmentArray() : OneOperator(atype<long>(), atype<string*>(), atype<string*>(), atype<KN<double>*>()) {}
+
+// FreeFEMのプラグイン関数：セグメント内エントリからの読み取り実装
+class ReadSegmentArrayCode : public E_F0mps {
+public:
+    Expression segment_name;
+    Expression key_name;
+    Expression array_expr;
+    
+    ReadSegmentArrayCode(const basicAC_F0& args) : segment_name(args[0]), key_name(args[1]), array_expr(args[2]) {}
+    
+    AnyType operator()(Stack stack) const {
+        string* segment = GetAny<string*>((*segment_name)(stack));
+        string* key = GetAny<string*>((*key_name)(stack));
+        KN<double>* array = GetAny<KN<double>*>((*array_expr)(stack));
+        
+        bool success = read_array_from_segment(segment->c_str(), key->c_str(), array);
+        return success ? 1L : 0L;
+    }
+};
+
+E_F0* ShmReadSegmentArray::code(const basicAC_F0& args) const {
+    return new ReadSegmentArrayCode(args);
+}
+
+ShmReadSegmentArray::ShmReadSegmentArray() : OneOperator(atype<long>(), atype<string*>(), atype<string*>(), atype<KN<double>*>()) {}
+
+// FreeFEMのプラグイン関数：複数エントリへの一括書き込み実装
+class WriteBatchCode : public E_F0mps {
+public:
+    Expression segment_name;
+    Expression key_names;
+    vector<Expression> array_exprs;
+    
+    WriteBatchCode(const basicAC_F0& args) : segment_name(args[0]), key_names(args[1]) {
+        for (int i = 2; i < args.size(); i++) {
+            array_exprs.push_back(to<KN<double>*>(args[i]));
+        }
+    }
+    
+    AnyType operator()(Stack stack) const {
+        string* segment = GetAny<string*>((*segment_name)(stack));
+        string* keys = GetAny<string*>((*key_names)(stack));
+        vector<const KN<double>*> arrays(array_exprs.size());
+        for (size_t i = 0; i < array_exprs.size(); i++) {
+            arrays[i] = GetAny<KN<double>*>((*array_exprs[i])(stack));
+        }
+        
+        bool success = write_arrays_to_segment(segment->c_str(), keys->c_str(), arrays);
+        return success ? 1L : 0L;
+    }
+};
+
+E_F0* ShmWriteBatch::code(const basicAC_F0& args) const {
+    return new WriteBatchCode(args);
 }
 
-// FreeFEMプラグインのエントリポイント
+// 3番目以降の引数はすべて配列（ellipse）
+ShmWriteBatch::ShmWriteBatch()
+    : OneOperator(atype<long>(), ArrayOfaType(atype<string*>(), atype<string*>(), atype<KN<double>*>(), true)) {}
+
+// FreeFEMのプラグイン関数：複数エントリからの一括読み取り実装
+class ReadBatchCode : public E_F0mps {
+public:
+    Expression segment_name;
+    Expression key_names;
+    vector<Expression> array_exprs;
+    
+    ReadBatchCode(const basicAC_F0& args) : segment_name(args[0]), key_names(args[1]) {
+        for (int i = 2; i < args.size(); i++) {
+            array_exprs.push_back(to<KN<double>*>(args[i]));
+        }
+    }
+    
+    AnyType operator()(Stack stack) const {
+        string* segment = GetAny<string*>((*segment_name)(stack));
+        string* keys = GetAny<string*>((*key_names)(stack));
+        vector<KN<double>*> arrays(array_exprs.size());
+        for (size_t i = 0; i < array_exprs.size(); i++) {
+            arrays[i] = GetAny<KN<double>*>((*array_exprs[i])(stack));
+        }
+        
+        bool success = read_arrays_from_segment(segment->c_str(), keys->c_str(), arrays);
+        return success ? 1L : 0L;
+    }
+};
+
+E_F0* ShmReadBatch::code(const basicAC_F0& args) const {
+    return new ReadBatchCode(args);
+}
+
+ShmReadBatch::ShmReadBatch()
+    : OneOperator(atype<long>(), ArrayOfaType(atype<string*>(), atype<string*>(), atype<KN<double>*>(), true)) {}
+
+// FreeFEMのプラグイン関数：float32への変換付き書き込み実装
+class WriteSegmentFloat32Code : public E_F0mps {
+public:
+    Expression segment_name;
+    Expression key_name;
+    Expression array_expr;
+    
+    WriteSegmentFloat32Code(const basicAC_F0& args) : segment_name(args[0]), key_name(args[1]), array_expr(args[2]) {}
+    
+    AnyType operator()(Stack stack) const {
+        string* segment = GetAny<string*>((*segment_name)(stack));
+        string* key = GetAny<string*>((*key_name)(stack));
+        KN<double>* array = GetAny<KN<double>*>((*array_expr)(stack));
+        
+        bool success = write_float32_array_to_segment(segment->c_str(), key->c_str(), array);
+        return success ? 1L : 0L;
+    }
+};
+
+E_F0* ShmWriteSegmentFloat32::code(const basicAC_F0& args) const {
+    return new WriteSegmentFloat32Code(args);
+}
+
+ShmWriteSegmentFloat32::ShmWriteSegmentFloat32() : OneOperator(atype<long>(), atype<string*>(), atype<string*>(), atype<KN<double>*>()) {}
+
+// FreeFEMのプラグイン関数：整数配列の書き込み実装（int32として格納）
+class WriteSegmentIntArrayCode : public E_F0mps {
+public:
+    Expression segment_name;
+    Expression key_name;
+    Expression array_expr;
+    
+    WriteSegmentIntArrayCode(const basicAC_F0& args) : segment_name(args[0]), key_name(args[1]), array_expr(args[2]) {}
+    
+    AnyType operator()(Stack stack) const {
+        string* segment = GetAny<string*>((*segment_name)(stack));
+        string* key = GetAny<string*>((*key_name)(stack));
+        KN<long>* array = GetAny<KN<long>*>((*array_expr)(stack));
+        
+        bool success = write_int_array_to_segment(segment->c_str(), key->c_str(), array);
+        return success ? 1L : 0L;
+    }
+};
+
+E_F0* ShmWriteSegmentIntArray::code(const basicAC_F0& args) const {
+    return new WriteSegmentIntArrayCode(args);
+}
+
+ShmWriteSegmentIntArray::ShmWriteSegmentIntArray() : OneOperator(atype<long>(), atype<string*>(), atype<string*>(), atype<KN<long>*>()) {}
+
+// FreeFEMのプラグイン関数：整数配列の読み取り実装
+class ReadSegmentIntArrayCode : public E_F0mps {
+public:
+    Expression segment_name;
+    Expression key_name;
+    Expression array_expr;
+    
+    ReadSegmentIntArrayCode(const basicAC_F0& args) : segment_name(args[0]), key_name(args[1]), array_expr(args[2]) {}
+    
+    AnyType operator()(Stack stack) const {
+        string* segment = GetAny<string*>((*segment_name)(stack));
+        string* key = GetAny<string*>((*key_name)(stack));
+        KN<long>* array = GetAny<KN<long>*>((*array_expr)(stack));
+        
+        bool success = read_int_array_from_segment(segment->c_str(), key->c_str(), array);
+        return success ? 1L : 0L;
+    }
+};
+
+E_F0* ShmReadSegmentIntArray::code(const basicAC_F0& args) const {
+    return new ReadSegmentIntArrayCode(args);
+}
+
+ShmReadSegmentIntArray::ShmReadSegmentIntArray() : OneOperator(atype<long>(), atype<string*>(), atype<string*>(), atype<KN<long>*>()) {}
+
+// FreeFEMのプラグイン関数：共有メモリのゼロコピービュー
+class ViewArrayCode : public E_F0mps {
+public:
+    Expression shm_name;
+    
+    ViewArrayCode(const basicAC_F0& args) : shm_name(args[0]) {}
+    
+    AnyType operator()(Stack stack) const {
+        string* name = GetAny<string*>((*shm_name)(stack));
+        return SetAny<KN_<double> >(view_array_in_shared_memory(name->c_str()));
+    }
+};
+
+class ViewSegmentArrayCode : public E_F0mps {
+public:
+    Expression segment_name;
+    Expression key_name;
+    
+    ViewSegmentArrayCode(const basicAC_F0& args) : segment_name(args[0]), key_name(args[1]) {}
+    
+    AnyType operator()(Stack stack) const {
+        string* segment = GetAny<string*>((*segment_name)(stack));
+        string* key = GetAny<string*>((*key_name)(stack));
+        return SetAny<KN_<double> >(view_array_in_segment(segment->c_str(), key->c_str()));
+    }
+};
+
+E_F0* ShmViewDoubleArray::code(const basicAC_F0& args) const {
+    return new ViewArrayCode(args);
+}
+
+ShmViewDoubleArray::ShmViewDoubleArray() : OneOperator(atype<KN_<double> >(), atype<string*>()) {}
+
+E_F0* ShmViewSegmentArray::code(const basicAC_F0& args) const {
+    return new ViewSegmentArrayCode(args);
+}
+
+ShmViewSegmentArray::ShmViewSegmentArray() : OneOperator(atype<KN_<double> >(), atype<string*>(), atype<string*>()) {}
+
+// FreeFEMのプラグイン関数：ビューの解放
+class ReleaseViewCode : public E_F0mps {
+public:
+    Expression shm_name;
+    
+    ReleaseViewCode(const basicAC_F0& args) : shm_name(args[0]) {}
+    
+    AnyType operator()(Stack stack) const {
+        string* name = GetAny<string*>((*shm_name)(stack));
+        
+        bool success = release_array_view(name->c_str());
+        return success ? 1L : 0L;
+    }
+};
+
+E_F0* ShmReleaseView::code(const basicAC_F0& args) const {
+    return new ReleaseViewCode(args);
+}
+
+ShmReleaseView::ShmReleaseView() : OneOperator(atype<long>(), atype<string*>()) {}
+
+// FreeFEMのプラグイン関数：リングバッファの作成
+class RingCreateCode : public E_F0mps {
+public:
+    Expression shm_name;
+    Expression elements_expr;
+    Expression count_expr;
+    
+    RingCreateCode(const basicAC_F0& args) : shm_name(args[0]), elements_expr(args[1]), count_expr(args[2]) {}
+    
+    AnyType operator()(Stack stack) const {
+        string* name = GetAny<string*>((*shm_name)(stack));
+        long elements = GetAny<long>((*elements_expr)(stack));
+        long count = GetAny<long>((*count_expr)(stack));
+        
+        bool success = ring_create(name->c_str(), elements, count);
+        return success ? 1L : 0L;
+    }
+};
+
+E_F0* ShmRingCreate::code(const basicAC_F0& args) const {
+    return new RingCreateCode(args);
+}
+
+ShmRingCreate::ShmRingCreate() : OneOperator(atype<long>(), atype<string*>(), atype<long>(), atype<long>()) {}
+
+// FreeFEMのプラグイン関数：リングバッファへの追加
+class RingPushCode : public E_F0mps {
+public:
+    Expression shm_name;
+    Expression array_expr;
+    
+    RingPushCode(const basicAC_F0& args) : shm_name(args[0]), array_expr(args[1]) {}
+    
+    AnyType operator()(Stack stack) const {
+        string* name = GetAny<string*>((*shm_name)(stack));
+        KN<double>* array = GetAny<KN<double>*>((*array_expr)(stack));
+        
+        bool success = ring_push_array(name->c_str(), array);
+        return success ? 1L : 0L;
+    }
+};
+
+E_F0* ShmRingPush::code(const basicAC_F0& args) const {
+    return new RingPushCode(args);
+}
+
+ShmRingPush::ShmRingPush() : OneOperator(atype<long>(), atype<string*>(), atype<KN<double>*>()) {}
+
+// FreeFEMのプラグイン関数：リングバッファからの取り出し
+class RingPopCode : public E_F0mps {
+public:
+    Expression shm_name;
+    Expression array_expr;
+    
+    RingPopCode(const basicAC_F0& args) : shm_name(args[0]), array_expr(args[1]) {}
+    
+    AnyType operator()(Stack stack) const {
+        string* name = GetAny<string*>((*shm_name)(stack));
+        KN<double>* array = GetAny<KN<double>*>((*array_expr)(stack));
+        
+        bool success = ring_pop_array(name->c_str(), array);
+        return success ? 1L : 0L;
+    }
+};
+
+E_F0* ShmRingPop::code(const basicAC_F0& args) const {
+    return new RingPopCode(args);
+}
+
+ShmRingPop::ShmRingPop() : OneOperator(atype<long>(), atype<string*>(), atype<KN<double>*>()) {}
+
+// FreeFEMのプラグイン関数：多重バッファのチャネルの作成
+class ChannelCreateCode : public E_F0mps {
+public:
+    Expression segment_name;
+    Expression key_name;
+    Expression buffers_expr;
+    
+    ChannelCreateCode(const basicAC_F0& args) : segment_name(args[0]), key_name(args[1]), buffers_expr(args[2]) {}
+    
+    AnyType operator()(Stack stack) const {
+        string* segment = GetAny<string*>((*segment_name)(stack));
+        string* key = GetAny<string*>((*key_name)(stack));
+        long buffers = GetAny<long>((*buffers_expr)(stack));
+        
+        bool success = shm_channel_create(segment->c_str(), key->c_str(), buffers);
+        return success ? 1L : 0L;
+    }
+};
+
+E_F0* ShmChannelCreate::code(const basicAC_F0& args) const {
+    return new ChannelCreateCode(args);
+}
+
+ShmChannelCreate::ShmChannelCreate() : OneOperator(atype<long>(), atype<string*>(), atype<string*>(), atype<long>()) {}
+
+// FreeFEMのプラグイン関数：多重バッファのチャネルへの書き込み
+class ChannelWriteCode : public E_F0mps {
+public:
+    Expression segment_name;
+    Expression key_name;
+    Expression array_expr;
+    
+    ChannelWriteCode(const basicAC_F0& args) : segment_name(args[0]), key_name(args[1]), array_expr(args[2]) {}
+    
+    AnyType operator()(Stack stack) const {
+        string* segment = GetAny<string*>((*segment_name)(stack));
+        string* key = GetAny<string*>((*key_name)(stack));
+        KN<double>* array = GetAny<KN<double>*>((*array_expr)(stack));
+        
+        bool success = channel_write_array(segment->c_str(), key->c_str(), array);
+        return success ? 1L : 0L;
+    }
+};
+
+E_F0* ShmChannelWrite::code(const basicAC_F0& args) const {
+    return new ChannelWriteCode(args);
+}
+
+ShmChannelWrite::ShmChannelWrite() : OneOperator(atype<long>(), atype<string*>(), atype<string*>(), atype<KN<double>*>()) {}
+
+// FreeFEMのプラグイン関数：多重バッファのチャネルからの読み取り
+class ChannelReadCode : public E_F0mps {
+public:
+    Expression segment_name;
+    Expression key_name;
+    Expression array_expr;
+    
+    ChannelReadCode(const basicAC_F0& args) : segment_name(args[0]), key_name(args[1]), array_expr(args[2]) {}
+    
+    AnyType operator()(Stack stack) const {
+        string* segment = GetAny<string*>((*segment_name)(stack));
+        string* key = GetAny<string*>((*key_name)(stack));
+        KN<double>* array = GetAny<KN<double>*>((*array_expr)(stack));
+        
+        bool success = channel_read_array(segment->c_str(), key->c_str(), array);
+        return success ? 1L : 0L;
+    }
+};
+
+E_F0* ShmChannelRead::code(const basicAC_F0& args) const {
+    return new ChannelReadCode(args);
+}
+
+ShmChannelRead::ShmChannelRead() : OneOperator(atype<long>(), atype<string*>(), atype<string*>(), atype<KN<double>*>()) {}
+
+// FreeFEMのプラグイン関数：通知シーケンスの取得
+class SequenceCode : public E_F0mps {
+public:
+    Expression shm_name;
+    
+    SequenceCode(const basicAC_F0& args) : shm_name(args[0]) {}
+    
+    AnyType operator()(Stack stack) const {
+        string* name = GetAny<string*>((*shm_name)(stack));
+        
+        return segment_sequence(name->c_str());
+    }
+};
+
+E_F0* ShmSequence::code(const basicAC_F0& args) const {
+    return new SequenceCode(args);
+}
+
+ShmSequence::ShmSequence() : OneOperator(atype<long>(), atype<string*>()) {}
+
+// 非同期書き込みのコピー元の検査（空の配列はデータ領域を持たないため受け付けない）
+static bool valid_async_source(const KN<double>* array) {
+    if (!array) {
+        cerr << "無効な配列ポインタです" << endl;
+        return false;
+    }
+    if (array->N() <= 0) {
+        cerr << "空の配列は非同期書き込みできません" << endl;
+        return false;
+    }
+    return true;
+}
+
+// FreeFEMのプラグイン関数：非同期書き込みの開始（セグメント名をキーとして使用）
+class WriteAsyncCode : public E_F0mps {
+public:
+    Expression shm_name;
+    Expression array_expr;
+    
+    WriteAsyncCode(const basicAC_F0& args) : shm_name(args[0]), array_expr(args[1]) {}
+    
+    AnyType operator()(Stack stack) const {
+        string* name = GetAny<string*>((*shm_name)(stack));
+        KN<double>* array = GetAny<KN<double>*>((*array_expr)(stack));
+        if (!valid_async_source(array)) {
+            return 0L;
+        }
+        
+        return shm_write_async(name->c_str(), name->c_str(), *array, array->N(), array->step);
+    }
+};
+
+E_F0* ShmWriteAsync::code(const basicAC_F0& args) const {
+    return new WriteAsyncCode(args);
+}
+
+ShmWriteAsync::ShmWriteAsync() : OneOperator(atype<long>(), atype<string*>(), atype<KN<double>*>()) {}
+
+// FreeFEMのプラグイン関数：セグメント内エントリへの非同期書き込みの開始
+class WriteSegmentAsyncCode : public E_F0mps {
+public:
+    Expression segment_name;
+    Expression key_name;
+    Expression array_expr;
+    
+    WriteSegmentAsyncCode(const basicAC_F0& args) : segment_name(args[0]), key_name(args[1]), array_expr(args[2]) {}
+    
+    AnyType operator()(Stack stack) const {
+        string* segment = GetAny<string*>((*segment_name)(stack));
+        string* key = GetAny<string*>((*key_name)(stack));
+        KN<double>* array = GetAny<KN<double>*>((*array_expr)(stack));
+        if (!valid_async_source(array)) {
+            return 0L;
+        }
+        
+        return shm_write_async(segment->c_str(), key->c_str(), *array, array->N(), array->step);
+    }
+};
+
+E_F0* ShmWriteSegmentAsync::code(const basicAC_F0& args) const {
+    return new WriteSegmentAsyncCode(args);
+}
+
+ShmWriteSegmentAsync::ShmWriteSegmentAsync() : OneOperator(atype<long>(), atype<string*>(), atype<string*>(), atype<KN<double>*>()) {}
+
+// FreeFEMのプラグイン関数：非同期書き込みの完了待ち
+class WaitAsyncCode : public E_F0mps {
+public:
+    Expression handle_expr;
+    
+    WaitAsyncCode(const basicAC_F0& args) : handle_expr(args[0]) {}
+    
+    AnyType operator()(Stack stack) const {
+        long handle = GetAny<long>((*handle_expr)(stack));
+        
+        bool success = shm_wait_async(handle);
+        return success ? 1L : 0L;
+    }
+};
+
+E_F0* ShmWaitAsync::code(const basicAC_F0& args) const {
+    return new WaitAsyncCode(args);
+}
+
+ShmWaitAsync::ShmWaitAsync() : OneOperator(atype<long>(), atype<long>()) {}
+
+// FreeFEMのプラグイン関数：差分転送による書き込み（ブロックの要素数は省略可能）
+class WriteDeltaCode : public E_F0mps {
+public:
+    Expression segment_name;
+    Expression key_name;
+    Expression array_expr;
+    Expression block_expr;
+    
+    WriteDeltaCode(const basicAC_F0& args) : segment_name(args[0]), key_name(args[1]), array_expr(args[2]),
+                                             block_expr(args.size() > 3 ? Expression(args[3]) : 0) {}
+    
+    AnyType operator()(Stack stack) const {
+        string* segment = GetAny<string*>((*segment_name)(stack));
+        string* key = GetAny<string*>((*key_name)(stack));
+        KN<double>* array = GetAny<KN<double>*>((*array_expr)(stack));
+        long block_elements = block_expr ? GetAny<long>((*block_expr)(stack))
+                                         : static_cast<long>(SHM_DELTA_BLOCK_ELEMENTS);
+        if (block_elements <= 0) {
+            cerr << "ブロックの要素数は1以上である必要があります: " << block_elements << endl;
+            return -1L;
+        }
+        
+        return shm_write_delta(segment->c_str(), key->c_str(), *array, array->N(), array->step,
+                               static_cast<size_t>(block_elements));
+    }
+};
+
+E_F0* ShmWriteDelta::code(const basicAC_F0& args) const {
+    return new WriteDeltaCode(args);
+}
+
+ShmWriteDelta::ShmWriteDelta() : OneOperator(atype<long>(), atype<string*>(), atype<string*>(), atype<KN<double>*>()) {}
+
+E_F0* ShmWriteDeltaBlocks::code(const basicAC_F0& args) const {
+    return new WriteDeltaCode(args);
+}
+
+ShmWriteDeltaBlocks::ShmWriteDeltaBlocks()
+    : OneOperator(atype<long>(), atype<string*>(), atype<string*>(), atype<KN<double>*>(), atype<long>()) {}
+
+// FreeFEMのプラグイン関数：転送統計の出力
+class StatsCode : public E_F0mps {
+public:
+    Expression shm_name;
+    
+    StatsCode(const basicAC_F0& args) : shm_name(args[0]) {}
+    
+    AnyType operator()(Stack stack) const {
+        string* name = GetAny<string*>((*shm_name)(stack));
+        
+        bool success = shm_dump_stats(name->c_str(), cout);
+        return success ? 1L : 0L;
+    }
+};
+
+E_F0* ShmStats::code(const basicAC_F0& args) const {
+    return new StatsCode(args);
+}
+
+ShmStats::ShmStats() : OneOperator(atype<long>(), atype<string*>()) {}
+
+// 常駐ワーカーのセッションのセグメント名（FF_SHM_NAME）を取得する
+static bool session_segment(string* segment) {
+    *segment = shm_resolve_segment("");
+    if (segment->empty()) {
+        cerr << "環境変数 FF_SHM_NAME が設定されていません" << endl;
+        return false;
+    }
+    return true;
+}
+
+// FreeFEMのプラグイン関数：常駐ワーカーのコマンド待ち
+class WaitCommandCode : public E_F0mps {
+public:
+    Expression shm_name;
+    
+    WaitCommandCode(const basicAC_F0& args, bool session) : shm_name(session ? Expression(0) : Expression(args[0])) {}
+    
+    AnyType operator()(Stack stack) const {
+        string segment;
+        if (shm_name) {
+            segment = *GetAny<string*>((*shm_name)(stack));
+        } else if (!session_segment(&segment)) {
+            return -1L;
+        }
+        
+        return shm_wait_command(segment.c_str());
+    }
+};
+
+E_F0* ShmWaitCommand::code(const basicAC_F0& args) const {
+    return new WaitCommandCode(args, false);
+}
+
+ShmWaitCommand::ShmWaitCommand() : OneOperator(atype<long>(), atype<string*>()) {}
+
+E_F0* ShmWaitSessionCommand::code(const basicAC_F0& args) const {
+    return new WaitCommandCode(args, true);
+}
+
+ShmWaitSessionCommand::ShmWaitSessionCommand() : OneOperator(atype<long>()) {}
+
+// FreeFEMのプラグイン関数：常駐ワーカーの結果の返却
+class PostResultCode : public E_F0mps {
+public:
+    Expression shm_name;
+    Expression status_expr;
+    
+    PostResultCode(const basicAC_F0& args, bool session)
+        : shm_name(session ? Expression(0) : Expression(args[0])), status_expr(args[session ? 0 : 1]) {}
+    
+    AnyType operator()(Stack stack) const {
+        string segment;
+        if (shm_name) {
+            segment = *GetAny<string*>((*shm_name)(stack));
+        } else if (!session_segment(&segment)) {
+            return 0L;
+        }
+        long status = GetAny<long>((*status_expr)(stack));
+        
+        bool success = shm_post_result(segment.c_str(), status);
+        return success ? 1L : 0L;
+    }
+};
+
+E_F0* ShmPostResult::code(const basicAC_F0& args) const {
+    return new PostResultCode(args, false);
+}
+
+ShmPostResult::ShmPostResult() : OneOperator(atype<long>(), atype<string*>(), atype<long>()) {}
+
+E_F0* ShmPostSessionResult::code(const basicAC_F0& args) const {
+    return new PostResultCode(args, true);
+}
+
+ShmPostSessionResult::ShmPostSessionResult() : OneOperator(atype<long>(), atype<long>()) {}
+
+// FreeFEMのプラグイン関数：セグメントの更新待ち
+class WaitUpdateCode : public E_F0mps {
+public:
+    Expression shm_name;
+    Expression seen_expr;
+    
+    WaitUpdateCode(const basicAC_F0& args) : shm_name(args[0]), seen_expr(args[1]) {}
+    
+    AnyType operator()(Stack stack) const {
+        string* name = GetAny<string*>((*shm_name)(stack));
+        long seen = GetAny<long>((*seen_expr)(stack));
+        
+        return wait_segment_update(name->c_str(), seen);
+    }
+};
+
+E_F0* ShmWaitUpdate::code(const basicAC_F0& args) const {
+    return new WaitUpdateCode(args);
+}
+
+ShmWaitUpdate::ShmWaitUpdate() : OneOperator(atype<long>(), atype<string*>(), atype<long>()) {}
+
+// FreeFEMのプラグイン関数：変数の削除（領域はセグメント内で再利用される）
+static long shm_delete(string* const& segment, string* const& key) {
+    return shm_delete_variable(segment->c_str(), key->c_str()) ? 1L : 0L;
+}
+
+// プラグインの初期化関数
+static void init_shared_memory_operations() {
+    Global.Add("writeSharedMemory", "(", new ShmWriteDoubleArray);
+    Global.Add("readSharedMemory", "(", new ShmReadDoubleArray);
+    Global.Add("writeSharedMemory", "(", new ShmWriteSegmentArray);
+    Global.Add("readSharedMemory", "(", new ShmReadSegmentArray);
+    Global.Add("writeSharedMemory", "(", new ShmWriteSegmentIntArray);
+    Global.Add("readSharedMemory", "(", new ShmReadSegmentIntArray);
+    Global.Add("shmWriteBatch", "(", new ShmWriteBatch);
+    Global.Add("shmReadBatch", "(", new ShmReadBatch);
+    Global.Add("writeSharedMemoryFloat32", "(", new ShmWriteSegmentFloat32);
+    Global.Add("shmViewDoubleArray", "(", new ShmViewDoubleArray);
+    Global.Add("shmViewDoubleArray", "(", new ShmViewSegmentArray);
+    Global.Add("shmReleaseView", "(", new ShmReleaseView);
+    Global.Add("ringCreate", "(", new ShmRingCreate);
+    Global.Add("ringPush", "(", new ShmRingPush);
+    Global.Add("ringPop", "(", new ShmRingPop);
+    Global.Add("channelCreate", "(", new ShmChannelCreate);
+    Global.Add("channelWrite", "(", new ShmChannelWrite);
+    Global.Add("channelRead", "(", new ShmChannelRead);
+    Global.Add("shmWriteAsync", "(", new ShmWriteAsync);
+    Global.Add("shmWriteAsync", "(", new ShmWriteSegmentAsync);
+    Global.Add("shmWait", "(", new ShmWaitAsync);
+    Global.Add("shmWriteDelta", "(", new ShmWriteDelta);
+    Global.Add("shmWriteDelta", "(", new ShmWriteDeltaBlocks);
+    Global.Add("shmSequence", "(", new ShmSequence);
+    Global.Add("shmWaitUpdate", "(", new ShmWaitUpdate);
+    Global.Add("shmStats", "(", new ShmStats);
+    Global.Add("shmDelete", "(", new OneOperator2_<long, string*, string*>(shm_delete));
+    Global.Add("shmWaitCommand", "(", new ShmWaitCommand);
+    Global.Add("shmWaitCommand", "(", new ShmWaitSessionCommand);
+    Global.Add("shmPostResult", "(", new ShmPostResult);
+    Global.Add("shmPostResult", "(", new ShmPostSessionResult);
+
+    // 同じプラグインに含まれる他の演算子
+    register_legacy_array_operations();
+    register_double_array_operations();
+    register_sparse_matrix_operations();
+    register_binary_file_operations();
+    register_partition_operations();
+    register_mesh_operations();
+    register_param_operations();
+    register_snapshot_operations();
+}
+
+// プラグインのバージョン（末尾の数字はセグメントのレイアウト SHM_SEGMENT_VERSION）
+// Python側の FreeFEMRunner.check_plugin_availability がFreeFEMを起動せずにファイルから読み取る
+// SHM_SEGMENT_VERSION を上げた場合はこの文字列も更新すること（static_assert で検出する）
+static_assert(SHM_SEGMENT_VERSION == 3, "update pyfreefem_shm_plugin_version to the new SHM_SEGMENT_VERSION");
+extern "C" __attribute__((used, visibility("default")))
+const char pyfreefem_shm_plugin_version[] = "pyfreefem-shm-plugin/3";
+
+// FreeFEMプラグインのエントリポイント（mmap-semaphore.so 全体で1つだけ）
+// 演算子の登録だけを行い、出力やセグメントの作成は行わない
 LOADFUNC(init_shared_memory_operations) 
\ No newline at end of file
@@ -2,6 +2,9 @@
 #define SHM_IMPLEMENTATION_HPP
 
 #include "ff++.hpp"
+#include "shm_transport.hpp"
+
+#include <vector>
 
 using namespace Fem2D;
 
@@ -23,10 +26,137 @@ bool write_array_to_shared_memory(const char* name, const KN<double>* array);
  */
 bool read_array_from_shared_memory(const char* name, KN<double>* array);
 
+/**
+ * 共有メモリセグメント内の名前付きエントリにdouble配列を書き込む
+ * セグメントのレイアウトは shm_layout.hpp を参照
+ * @param segment 共有メモリセグメントの名前
+ * @param key セグメント内のエントリ名
+ * @param array 書き込む配列
+ * @return 成功した場合はtrue、失敗した場合はfalse
+ */
+bool write_array_to_segment(const char* segment, const char* key, const KN<double>* array);
+
+/**
+ * 共有メモリセグメント内の名前付きエントリからdouble配列を読み取る
+ * @param segment 共有メモリセグメントの名前
+ * @param key セグメント内のエントリ名
+ * @param array 読み取った値を格納する配列
+ * @return 成功した場合はtrue、失敗した場合はfalse
+ */
+bool read_array_from_segment(const char* segment, const char* key, KN<double>* array);
+
+/**
+ * 複数のdouble配列をセグメント内のエントリにまとめて書き込み、1回の通知で公開する
+ * @param segment 共有メモリセグメントの名前
+ * @param keys エントリ名をカンマ区切りで並べた文字列（例: "rho,ux,uy"）
+ * @param arrays 書き込む配列（keys と同じ順序・同じ個数）
+ * @return 成功した場合はtrue、失敗した場合はfalse
+ */
+bool write_arrays_to_segment(const char* segment, const char* keys, const std::vector<const KN<double>*>& arrays);
+
+/**
+ * 複数のエントリがすべて書き込まれるまで待機し、double配列にまとめて読み取る
+ * @param segment 共有メモリセグメントの名前
+ * @param keys エントリ名をカンマ区切りで並べた文字列
+ * @param arrays 読み取った値を格納する配列（keys と同じ順序・同じ個数）
+ * @return 成功した場合はtrue、失敗した場合はfalse
+ */
+bool read_arrays_from_segment(const char* segment, const char* keys, const std::vector<KN<double>*>& arrays);
+
+/**
+ * カンマ区切りのエントリ名を分割する（前後の空白は無視する）
+ * @param keys エントリ名をカンマ区切りで並べた文字列（例: "rho,ux,uy"）
+ * @return 分割したエントリ名（空の名前もそのまま含む）
+ */
+std::vector<std::string> split_batch_keys(const char* keys);
+
+/**
+ * double配列をfloat32に変換しながらセグメント内のエントリに書き込む
+ * @param segment 共有メモリセグメントの名前
+ * @param key セグメント内のエントリ名
+ * @param array 書き込む配列
+ * @return 成功した場合はtrue、失敗した場合はfalse
+ */
+bool write_float32_array_to_segment(const char* segment, const char* key, const KN<double>* array);
+
+/**
+ * 整数配列をint32に変換しながらセグメント内のエントリに書き込む
+ * @param segment 共有メモリセグメントの名前
+ * @param key セグメント内のエントリ名
+ * @param array 書き込む配列（int32の範囲外の値は切り詰められる）
+ * @return 成功した場合はtrue、失敗した場合はfalse
+ */
+bool write_int_array_to_segment(const char* segment, const char* key, const KN<long>* array);
+
+/**
+ * セグメント内のint32/int64エントリから整数配列を読み取る
+ * @param segment 共有メモリセグメントの名前
+ * @param key セグメント内のエントリ名
+ * @param array 読み取った値を格納する配列
+ * @return 成功した場合はtrue、失敗した場合はfalse
+ */
+bool read_int_array_from_segment(const char* segment, const char* key, KN<long>* array);
+
+/**
+ * 共有メモリセグメント内のエントリを直接指すdouble配列ビューを作成する（コピーなし）
+ * @param segment 共有メモリセグメントの名前
+ * @param key セグメント内のエントリ名
+ * @return データ領域を指すビュー、失敗した場合は空のビュー
+ */
+KN_<double> view_array_in_segment(const char* segment, const char* key);
+
+/**
+ * 共有メモリのデータ領域を直接指すdouble配列ビューを作成する（コピーなし）
+ * ビューが有効な間、対応するスロットはアンマップされない
+ * @param name 共有メモリの名前
+ * @return データ領域を指すビュー、失敗した場合は空のビュー
+ */
+KN_<double> view_array_in_shared_memory(const char* name);
+
+/**
+ * view_array_in_shared_memoryで作成したビューの参照を解放する
+ * @param name 共有メモリの名前
+ * @return 成功した場合はtrue、失敗した場合はfalse
+ */
+bool release_array_view(const char* name);
+
+/**
+ * リングバッファに配列を1スロット分追加する（満杯の場合はブロックせずに失敗）
+ * @param name 共有メモリの名前
+ * @param array 追加する配列
+ * @return 成功した場合はtrue、満杯または失敗した場合はfalse
+ */
+bool ring_push_array(const char* name, const KN<double>* array);
+
+/**
+ * リングバッファから配列を1スロット分取り出す（空の場合はブロックせずに失敗）
+ * @param name 共有メモリの名前
+ * @param array 取り出した値を格納する配列
+ * @return 成功した場合はtrue、空または失敗した場合はfalse
+ */
+bool ring_pop_array(const char* name, KN<double>* array);
+
+/**
+ * 多重バッファのチャネルに配列を1フレーム書き込む（読み込み側が読んでいないバッファに書き込む）
+ * @param segment 共有メモリセグメントの名前
+ * @param key チャネル名（shm_channel_create()で作成済みであること）
+ * @param array 書き込む配列
+ * @return 成功した場合はtrue、失敗した場合はfalse
+ */
+bool channel_write_array(const char* segment, const char* key, const KN<double>* array);
+
+/**
+ * 多重バッファのチャネルから最新のフレームを読み取る（未読のフレームが公開されるまで待機）
+ * @param segment 共有メモリセグメントの名前
+ * @param key チャネル名
+ * @param array 読み取った値を格納する配列
+ * @return 成功した場合はtrue、タイムアウトまたは失敗した場合はfalse
+ */
+bool channel_read_array(const char* segment, const char* key, KN<double>* array);
+
 // FreeFEMのプラグインで使用する関数宣言：配列書き込み
 class ShmWriteDoubleArray : public OneOperator {
 public:
-    const int c_args[2] = {STRING_ARG, ARRAY_ARG};
     E_F0* code(const basicAC_F0& args) const;
     ShmWriteDoubleArray();
 };
@@ -34,12 +164,216 @@ public:
 // FreeFEMのプラグインで使用する関数宣言：配列読み取り
 class ShmReadDoubleArray : public OneOperator {
 public:
-    const int c_args[2] = {STRING_ARG, ARRAY_ARG};
     E_F0* code(const basicAC_F0& args) const;
     ShmReadDoubleArray();
 };
 
-// プラグインの初期化関数
-static void init_shared_memory_operations();
+// FreeFEMのプラグインで使用する関数宣言：セグメント内エントリの書き込み・読み取り
+class ShmWriteSegmentArray : public OneOperator {
+public:
+    E_F0* code(const basicAC_F0& args) const;
+    ShmWriteSegmentArray();
+};
+
+class ShmReadSegmentArray : public OneOperator {
+public:
+    E_F0* code(const basicAC_F0& args) const;
+    ShmReadSegmentArray();
+};
+
+// FreeFEMのプラグインで使用する関数宣言：複数エントリの一括書き込み・読み取り
+// shmWriteBatch(segment, "rho,ux,uy", rho, ux, uy) のように配列を可変個受け取る
+class ShmWriteBatch : public OneOperator {
+public:
+    E_F0* code(const basicAC_F0& args) const;
+    ShmWriteBatch();
+};
+
+class ShmReadBatch : public OneOperator {
+public:
+    E_F0* code(const basicAC_F0& args) const;
+    ShmReadBatch();
+};
+
+// FreeFEMのプラグインで使用する関数宣言：型変換付きの書き込み・読み取り
+class ShmWriteSegmentFloat32 : public OneOperator {
+public:
+    E_F0* code(const basicAC_F0& args) const;
+    ShmWriteSegmentFloat32();
+};
+
+class ShmWriteSegmentIntArray : public OneOperator {
+public:
+    E_F0* code(const basicAC_F0& args) const;
+    ShmWriteSegmentIntArray();
+};
+
+class ShmReadSegmentIntArray : public OneOperator {
+public:
+    E_F0* code(const basicAC_F0& args) const;
+    ShmReadSegmentIntArray();
+};
+
+// FreeFEMのプラグインで使用する関数宣言：ゼロコピービュー
+class ShmViewDoubleArray : public OneOperator {
+public:
+    E_F0* code(const basicAC_F0& args) const;
+    ShmViewDoubleArray();
+};
+
+class ShmViewSegmentArray : public OneOperator {
+public:
+    E_F0* code(const basicAC_F0& args) const;
+    ShmViewSegmentArray();
+};
+
+// FreeFEMのプラグインで使用する関数宣言：ビューの解放
+class ShmReleaseView : public OneOperator {
+public:
+    E_F0* code(const basicAC_F0& args) const;
+    ShmReleaseView();
+};
+
+// FreeFEMのプラグインで使用する関数宣言：リングバッファ
+class ShmRingCreate : public OneOperator {
+public:
+    E_F0* code(const basicAC_F0& args) const;
+    ShmRingCreate();
+};
+
+class ShmRingPush : public OneOperator {
+public:
+    E_F0* code(const basicAC_F0& args) const;
+    ShmRingPush();
+};
+
+class ShmRingPop : public OneOperator {
+public:
+    E_F0* code(const basicAC_F0& args) const;
+    ShmRingPop();
+};
+
+// FreeFEMのプラグインで使用する関数宣言：多重バッファのチャネル
+class ShmChannelCreate : public OneOperator {
+public:
+    E_F0* code(const basicAC_F0& args) const;
+    ShmChannelCreate();
+};
+
+class ShmChannelWrite : public OneOperator {
+public:
+    E_F0* code(const basicAC_F0& args) const;
+    ShmChannelWrite();
+};
+
+class ShmChannelRead : public OneOperator {
+public:
+    E_F0* code(const basicAC_F0& args) const;
+    ShmChannelRead();
+};
+
+// FreeFEMのプラグインで使用する関数宣言：非同期書き込み
+// 配列は shmWait(handle) が戻るまで変更しないこと（u[] などの名前付き配列を渡す）
+class ShmWriteAsync : public OneOperator {
+public:
+    E_F0* code(const basicAC_F0& args) const;
+    ShmWriteAsync();
+};
+
+class ShmWriteSegmentAsync : public OneOperator {
+public:
+    E_F0* code(const basicAC_F0& args) const;
+    ShmWriteSegmentAsync();
+};
+
+class ShmWaitAsync : public OneOperator {
+public:
+    E_F0* code(const basicAC_F0& args) const;
+    ShmWaitAsync();
+};
+
+// FreeFEMのプラグインで使用する関数宣言：差分転送
+// shmWriteDelta(segment, key, x[, blockElements]) は書き込んだブロック数（失敗時は-1）を返す
+class ShmWriteDelta : public OneOperator {
+public:
+    E_F0* code(const basicAC_F0& args) const;
+    ShmWriteDelta();
+};
+
+class ShmWriteDeltaBlocks : public OneOperator {
+public:
+    E_F0* code(const basicAC_F0& args) const;
+    ShmWriteDeltaBlocks();
+};
+
+// FreeFEMのプラグインで使用する関数宣言：更新の通知と待機
+class ShmSequence : public OneOperator {
+public:
+    E_F0* code(const basicAC_F0& args) const;
+    ShmSequence();
+};
+
+class ShmWaitUpdate : public OneOperator {
+public:
+    E_F0* code(const basicAC_F0& args) const;
+    ShmWaitUpdate();
+};
+
+// FreeFEMのプラグイン関数宣言：常駐ワーカーのコマンドチャネル
+// 引数の無い版は環境変数 FF_SHM_NAME のセグメントを使用する
+class ShmWaitCommand : public OneOperator {
+public:
+    E_F0* code(const basicAC_F0& args) const;
+    ShmWaitCommand();
+};
+
+class ShmWaitSessionCommand : public OneOperator {
+public:
+    E_F0* code(const basicAC_F0& args) const;
+    ShmWaitSessionCommand();
+};
+
+class ShmPostResult : public OneOperator {
+public:
+    E_F0* code(const basicAC_F0& args) const;
+    ShmPostResult();
+};
+
+class ShmPostSessionResult : public OneOperator {
+public:
+    E_F0* code(const basicAC_F0& args) const;
+    ShmPostSessionResult();
+};
+
+// FreeFEMのプラグイン関数宣言：転送統計の出力
+class ShmStats : public OneOperator {
+public:
+    E_F0* code(const basicAC_F0& args) const;
+    ShmStats();
+};
+
+// 旧API（ArrayInfo形式）の演算子を登録する（legacy_array_ops.cpp）
+void register_legacy_array_operations();
+
+// 配列演算の演算子を登録する（double_array_ops.cpp）
+void register_double_array_operations();
+
+// 疎行列（CSR形式）の演算子を登録する（sparse_matrix_ops.cpp）
+void register_sparse_matrix_operations();
+
+// バイナリファイルの演算子を登録する（binary_file_ops.cpp）
+void register_binary_file_operations();
+
+// MPI並列実行の分割配列の演算子を登録する（partition_ops.cpp）
+void register_partition_operations();
+
+// メッシュと有限要素関数の演算子を登録する（mesh_ops.cpp）
+void register_mesh_operations();
+
+// パラメータブロックの演算子を登録する（param_ops.cpp）
+void register_param_operations();
+
+// スナップショットファイルの演算子を登録する（snapshot_ops.cpp）
+void register_snapshot_operations();
 
 #endif // SHM_IMPLEMENTATION_HPP 
\ No newline at end of file
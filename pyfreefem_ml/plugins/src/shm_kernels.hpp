@@ -0,0 +1,133 @@
+#ifndef SHM_KERNELS_HPP
+#define SHM_KERNELS_HPP
+
+// double配列の要素ごとの演算・集計カーネル。FreeFEMのヘッダーには依存しない。
+//
+// KN_<double> はストライド（step）を持ちうるため、各カーネルは連続な場合とストライドがある場合の
+// ループを分け、連続な場合はSIMD化する。要素数が SHM_KERNEL_PARALLEL_MIN 以上の場合は
+// OpenMPのスレッドで分割する（-fopenmp でビルドした場合。-fopenmp-simd の場合はSIMD化のみ）。
+// 共有メモリのビュー（shmViewDoubleArray）に対してもコピーや一時配列なしで適用できる。
+//
+// 集計（内積・ノルム・最小最大）はスレッド数とSIMD幅によって加算順序が変わるため、
+// 結果は逐次ループと最後の数ビットが異なりうる。
+
+#include <stddef.h>
+#include <math.h>
+#include <limits>
+
+static const size_t SHM_KERNEL_PARALLEL_MIN = 1 << 16;   // スレッドで分割する最小の要素数
+
+#define SHM_KERNEL_PRAGMA(x) _Pragma(#x)
+#ifdef _OPENMP
+#define SHM_KERNEL_FOR(n, clauses) \
+    SHM_KERNEL_PRAGMA(omp parallel for simd if ((n) >= SHM_KERNEL_PARALLEL_MIN) clauses)
+#else
+#define SHM_KERNEL_FOR(n, clauses) SHM_KERNEL_PRAGMA(omp simd clauses)
+#endif
+
+// x <- a * x
+inline void shm_kernel_scale(double* x, size_t n, long step, double a) {
+    if (step == 1) {
+        SHM_KERNEL_FOR(n, )
+        for (size_t i = 0; i < n; i++) {
+            x[i] *= a;
+        }
+        return;
+    }
+    SHM_KERNEL_FOR(n, )
+    for (size_t i = 0; i < n; i++) {
+        x[i * step] *= a;
+    }
+}
+
+// y <- y + a * x
+inline void shm_kernel_axpy(double* y, long y_step, double a, const double* x, long x_step, size_t n) {
+    if (y_step == 1 && x_step == 1) {
+        SHM_KERNEL_FOR(n, )
+        for (size_t i = 0; i < n; i++) {
+            y[i] += a * x[i];
+        }
+        return;
+    }
+    SHM_KERNEL_FOR(n, )
+    for (size_t i = 0; i < n; i++) {
+        y[i * y_step] += a * x[i * x_step];
+    }
+}
+
+// x <- min(max(x, lo), hi)
+inline void shm_kernel_clamp(double* x, size_t n, long step, double lo, double hi) {
+    if (step == 1) {
+        SHM_KERNEL_FOR(n, )
+        for (size_t i = 0; i < n; i++) {
+            double v = x[i] < lo ? lo : x[i];
+            x[i] = v > hi ? hi : v;
+        }
+        return;
+    }
+    SHM_KERNEL_FOR(n, )
+    for (size_t i = 0; i < n; i++) {
+        double v = x[i * step] < lo ? lo : x[i * step];
+        x[i * step] = v > hi ? hi : v;
+    }
+}
+
+// 連続領域 dst に a * src をコピーする（共有メモリへの書き込みと拡大縮小を1回の走査で行う）
+inline void shm_kernel_scale_copy(double* dst, const double* src, size_t n, long step, double a) {
+    if (step == 1) {
+        SHM_KERNEL_FOR(n, )
+        for (size_t i = 0; i < n; i++) {
+            dst[i] = a * src[i];
+        }
+        return;
+    }
+    SHM_KERNEL_FOR(n, )
+    for (size_t i = 0; i < n; i++) {
+        dst[i] = a * src[i * step];
+    }
+}
+
+// x と y の内積
+inline double shm_kernel_dot(const double* x, long x_step, const double* y, long y_step, size_t n) {
+    double sum = 0.0;
+    if (x_step == 1 && y_step == 1) {
+        SHM_KERNEL_FOR(n, reduction(+:sum))
+        for (size_t i = 0; i < n; i++) {
+            sum += x[i] * y[i];
+        }
+        return sum;
+    }
+    SHM_KERNEL_FOR(n, reduction(+:sum))
+    for (size_t i = 0; i < n; i++) {
+        sum += x[i * x_step] * y[i * y_step];
+    }
+    return sum;
+}
+
+// x のユークリッドノルム
+inline double shm_kernel_norm(const double* x, size_t n, long step) {
+    return sqrt(shm_kernel_dot(x, step, x, step, n));
+}
+
+// x の最小値と最大値（要素が無い場合は +inf / -inf、NaNは無視する）
+inline void shm_kernel_minmax(const double* x, size_t n, long step, double* min_value, double* max_value) {
+    double lo = std::numeric_limits<double>::infinity();
+    double hi = -lo;
+    if (step == 1) {
+        SHM_KERNEL_FOR(n, reduction(min:lo) reduction(max:hi))
+        for (size_t i = 0; i < n; i++) {
+            lo = x[i] < lo ? x[i] : lo;
+            hi = x[i] > hi ? x[i] : hi;
+        }
+    } else {
+        SHM_KERNEL_FOR(n, reduction(min:lo) reduction(max:hi))
+        for (size_t i = 0; i < n; i++) {
+            lo = x[i * step] < lo ? x[i * step] : lo;
+            hi = x[i * step] > hi ? x[i * step] : hi;
+        }
+    }
+    *min_value = lo;
+    *max_value = hi;
+}
+
+#endif // SHM_KERNELS_HPP
@@ -0,0 +1,450 @@
+#ifndef SHM_LAYOUT_HPP
+#define SHM_LAYOUT_HPP
+
+// C++プラグインとPython（shm_layout.py）で共有する共有メモリセグメントの
+// バイナリレイアウト定義。FreeFEMのヘッダーには依存しない。
+//
+// セグメント構成:
+//   [SegmentHeader (64バイト)] [SegmentEntry x SHM_MAX_ENTRIES]
+//   [SegmentStats x SHM_STATS_SIDES] [SegmentArena (256バイト)] [ペイロード...]
+// 各ペイロードは64バイト境界に配置される。エントリ表は名前のハッシュ値で
+// 開番地法により引くため、変数の検索はO(1)で済む。
+//
+// ペイロード領域は2の冪の大きさのブロック単位で割り当てる（SegmentArena）。
+// 解放したブロック（削除した変数や、大きくなった変数の古い領域）は大きさごとの
+// 空きリストに戻り、次に同じ大きさを割り当てるときにO(1)で再利用される。
+// 空きリストは言語間で共有するため、操作はアリーナのロックを取って行う。
+// ロックを保持したままプロセスが終了した場合に備え、ロックの待機には期限を設ける
+// （SHM_ARENA_LOCK_TIMEOUT_SEC。操作は数十命令で終わるため、通常は期限に達しない）。
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+#include <sched.h>
+#include <time.h>
+#include <iostream>
+
+static const uint32_t SHM_SEGMENT_MAGIC = 0x53464650;   // "PFFS"（リトルエンディアン）
+static const uint32_t SHM_SEGMENT_VERSION = 3;
+static const uint32_t SHM_MAX_ENTRIES = 256;            // 2の冪
+static const size_t SHM_NAME_LEN = 48;
+static const size_t SHM_MAX_NDIM = 4;
+static const size_t SHM_ALIGNMENT = 64;
+static const size_t SHM_STATS_BUCKETS = 32;             // レイテンシのヒストグラムの区間数
+static const size_t SHM_ARENA_CLASSES = 30;             // ブロックの大きさの種類（64バイトから32GiBまで）
+static const double SHM_ARENA_LOCK_TIMEOUT_SEC = 5.0;   // アリーナのロックを待つ最大時間（秒）
+
+// エントリのデータ型
+enum ShmDType {
+    SHM_DTYPE_NONE = 0,     // 未使用エントリ
+    SHM_DTYPE_FLOAT64 = 1,
+    SHM_DTYPE_FLOAT32 = 2,
+    SHM_DTYPE_INT64 = 3,
+    SHM_DTYPE_INT32 = 4,
+    SHM_DTYPE_UINT8 = 5,
+    SHM_DTYPE_STRING = 6,   // UTF-8バイト列（shape[0]がバイト数）
+    SHM_DTYPE_DELETED = 255 // 削除済みエントリ（検索は次の要素へ進み、登録時に再利用する）
+};
+
+// エントリ表の1要素（128バイト）
+struct SegmentEntry {
+    char name[SHM_NAME_LEN];     // 変数名（NUL終端）
+    uint64_t name_hash;          // shm_name_hash(name)
+    uint32_t dtype;              // ShmDType
+    uint32_t ndim;               // 次元数（0はスカラー）
+    uint64_t shape[SHM_MAX_NDIM];
+    uint64_t offset;             // セグメント先頭からのペイロード位置（64バイト境界）
+    uint64_t nbytes;             // 現在のペイロードのバイト数
+    uint64_t capacity;           // 確保済みのペイロード領域（ブロック）のバイト数
+    uint64_t generation;         // 書き込みごとに増加する世代番号
+};
+
+// セグメントヘッダー（64バイト）
+struct SegmentHeader {
+    uint32_t magic;              // SHM_SEGMENT_MAGIC
+    uint32_t version;            // SHM_SEGMENT_VERSION
+    uint64_t segment_size;       // セグメント全体のバイト数
+    uint32_t entry_count;        // 使用中のエントリ数
+    uint32_t max_entries;        // エントリ表の大きさ（SHM_MAX_ENTRIES）
+    uint64_t data_offset;        // ペイロード領域の開始位置
+    uint64_t data_end;           // 空きリストに無い場合に次に割り当てるペイロード位置
+    uint64_t generation;         // セグメント全体の世代番号
+    uint32_t seq;                // 通知シーケンス（書き込み完了ごとに+1、futexの待機対象）
+    uint32_t waiters;            // seq で待機中のプロセス数
+    uint32_t map_flags;          // ShmMapFlags（作成側が設定し、マッピングするすべてのプロセスが従う）
+    uint32_t numa_node;          // ページを割り当てるNUMAノード + 1（0は指定なし）
+};
+
+// セグメントのマッピング方法（SegmentHeader::map_flags、shm_mapping.hpp を参照）
+enum ShmMapFlags {
+    SHM_MAP_HUGEPAGE = 1,        // madvise(MADV_HUGEPAGE) で透過的ヒュージページを使う
+    SHM_MAP_POPULATE = 2         // マッピング時にページを割り当てておく（初回アクセスのページフォルトを避ける）
+};
+
+static const uint64_t SHM_HUGEPAGE_SIZE = 2 * 1024 * 1024;
+
+// 転送統計の記録元（記録元ごとに別の統計ブロックを持ち、言語間で同じ値を更新しない）
+enum ShmStatsSide {
+    SHM_STATS_FREEFEM = 0,
+    SHM_STATS_PYTHON = 1,
+    SHM_STATS_SIDES = 2
+};
+
+// 転送統計（320バイト）。エントリ表の直後に記録元ごとに置く
+// latency_hist[i] は [2^i, 2^(i+1)) ナノ秒の呼び出し回数（i=0 は2ナノ秒未満を含む）
+struct SegmentStats {
+    uint64_t write_calls;
+    uint64_t read_calls;
+    uint64_t bytes_written;
+    uint64_t bytes_read;
+    uint64_t wait_ns;            // 同期（データの到着待ち）に費やした時間
+    uint64_t copy_ns;            // データのコピー・型変換に費やした時間
+    uint64_t latency_min_ns;     // 1回の読み書きの最短時間（0は未記録）
+    uint64_t latency_max_ns;
+    uint64_t latency_hist[SHM_STATS_BUCKETS];
+};
+
+// ペイロード領域のアリーナ（256バイト）。転送統計の直後に置く
+// 大きさ (SHM_ALIGNMENT << c) の空きブロックは free_head[c] から、ブロック先頭の
+// 8バイトに書いた次のブロックの位置でつながる（0は終端）
+struct SegmentArena {
+    uint32_t lock;               // 0: 空き, 1: 操作中（shm_arena_lock() を参照）
+    uint32_t reserved;
+    uint64_t free_bytes;         // 空きリストにあるブロックの合計バイト数
+    uint64_t free_head[SHM_ARENA_CLASSES];
+};
+
+static_assert(sizeof(SegmentArena) == 256, "SegmentArena layout must match shm_layout.py");
+static_assert(sizeof(SegmentStats) == 320, "SegmentStats layout must match shm_layout.py");
+static_assert(sizeof(SegmentEntry) == 128, "SegmentEntry layout must match shm_layout.py");
+static_assert(sizeof(SegmentHeader) == 64, "SegmentHeader layout must match shm_layout.py");
+
+// 64バイト境界への切り上げ
+inline uint64_t shm_align(uint64_t value) {
+    return (value + SHM_ALIGNMENT - 1) & ~(uint64_t)(SHM_ALIGNMENT - 1);
+}
+
+// 転送統計ブロックの位置
+inline uint64_t shm_stats_offset() {
+    return sizeof(SegmentHeader) + SHM_MAX_ENTRIES * sizeof(SegmentEntry);
+}
+
+// アリーナの位置
+inline uint64_t shm_arena_offset() {
+    return shm_stats_offset() + SHM_STATS_SIDES * sizeof(SegmentStats);
+}
+
+// エントリ表・転送統計・アリーナを含むヘッダー部分のバイト数
+inline uint64_t shm_table_size() {
+    return shm_align(shm_arena_offset() + sizeof(SegmentArena));
+}
+
+// nbytes を格納するブロックの大きさの種類（SHM_ALIGNMENT << c >= nbytes となる最小の c）
+inline uint32_t shm_block_class(uint64_t nbytes) {
+    uint32_t c = 0;
+    while (c + 1 < SHM_ARENA_CLASSES && (SHM_ALIGNMENT << c) < nbytes) {
+        c++;
+    }
+    return c;
+}
+
+// nbytes を格納するブロックのバイト数（最大の種類を超える場合は64バイト境界に切り上げた大きさ）
+inline uint64_t shm_block_size(uint64_t nbytes) {
+    uint64_t size = (uint64_t)SHM_ALIGNMENT << shm_block_class(nbytes);
+    return size >= nbytes ? size : shm_align(nbytes);
+}
+
+// データ型ごとの要素サイズ
+inline size_t shm_dtype_size(uint32_t dtype) {
+    switch (dtype) {
+        case SHM_DTYPE_FLOAT64: return 8;
+        case SHM_DTYPE_FLOAT32: return 4;
+        case SHM_DTYPE_INT64: return 8;
+        case SHM_DTYPE_INT32: return 4;
+        case SHM_DTYPE_UINT8: return 1;
+        case SHM_DTYPE_STRING: return 1;
+        default: return 0;
+    }
+}
+
+// データ型の名前（エラーメッセージ用）
+inline const char* shm_dtype_name(uint32_t dtype) {
+    switch (dtype) {
+        case SHM_DTYPE_FLOAT64: return "float64";
+        case SHM_DTYPE_FLOAT32: return "float32";
+        case SHM_DTYPE_INT64: return "int64";
+        case SHM_DTYPE_INT32: return "int32";
+        case SHM_DTYPE_UINT8: return "uint8";
+        case SHM_DTYPE_STRING: return "string";
+        default: return "none";
+    }
+}
+
+// 変数名のハッシュ（FNV-1a 64bit、Python側と同一）
+inline uint64_t shm_name_hash(const char* name) {
+    uint64_t hash = 0xcbf29ce484222325ULL;
+    for (const unsigned char* p = reinterpret_cast<const unsigned char*>(name); *p; p++) {
+        hash ^= *p;
+        hash *= 0x100000001b3ULL;
+    }
+    return hash;
+}
+
+inline SegmentEntry* shm_entries(SegmentHeader* header) {
+    return reinterpret_cast<SegmentEntry*>(header + 1);
+}
+
+inline SegmentStats* shm_stats(SegmentHeader* header, int side) {
+    return reinterpret_cast<SegmentStats*>(reinterpret_cast<char*>(header) + shm_stats_offset()) + side;
+}
+
+inline SegmentArena* shm_arena(SegmentHeader* header) {
+    return reinterpret_cast<SegmentArena*>(reinterpret_cast<char*>(header) + shm_arena_offset());
+}
+
+inline void* shm_payload(SegmentHeader* header, const SegmentEntry* entry) {
+    return reinterpret_cast<char*>(header) + entry->offset;
+}
+
+// セグメントヘッダーが有効かどうか
+inline bool shm_segment_valid(const SegmentHeader* header) {
+    return header->magic == SHM_SEGMENT_MAGIC && header->version == SHM_SEGMENT_VERSION
+        && header->max_entries == SHM_MAX_ENTRIES;
+}
+
+// 新しいセグメントのヘッダーを初期化する（既に有効な場合は何もしない）
+inline void shm_segment_init(SegmentHeader* header, uint64_t segment_size) {
+    if (shm_segment_valid(header)) {
+        return;
+    }
+    memset(header, 0, shm_table_size());
+    header->version = SHM_SEGMENT_VERSION;
+    header->segment_size = segment_size;
+    header->entry_count = 0;
+    header->max_entries = SHM_MAX_ENTRIES;
+    header->data_offset = shm_table_size();
+    header->data_end = header->data_offset;
+    header->generation = 0;
+    header->magic = SHM_SEGMENT_MAGIC;
+}
+
+// 名前でエントリを検索する（見つからない場合はNULL）
+inline SegmentEntry* shm_find_entry(SegmentHeader* header, const char* name) {
+    uint64_t hash = shm_name_hash(name);
+    SegmentEntry* entries = shm_entries(header);
+    for (uint32_t probe = 0; probe < SHM_MAX_ENTRIES; probe++) {
+        SegmentEntry* entry = &entries[(hash + probe) & (SHM_MAX_ENTRIES - 1)];
+        if (entry->dtype == SHM_DTYPE_NONE) {
+            return NULL;
+        }
+        if (entry->dtype != SHM_DTYPE_DELETED && entry->name_hash == hash
+            && strncmp(entry->name, name, SHM_NAME_LEN) == 0) {
+            return entry;
+        }
+    }
+    return NULL;
+}
+
+inline double shm_arena_clock() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+// アリーナのロックを取る（操作は数十命令で終わるため、スピンしてから譲る）
+// Python側（shm_layout.ArenaLock）も同じ語を比較交換で取る
+// SHM_ARENA_LOCK_TIMEOUT_SEC 以内に取れない場合は、保持したプロセスが終了したとみなしてfalseを返す
+inline bool shm_arena_lock(SegmentArena* arena) {
+    double deadline = 0.0;
+    for (unsigned spins = 0;; spins++) {
+        uint32_t expected = 0;
+        if (__atomic_compare_exchange_n(&arena->lock, &expected, 1, false, __ATOMIC_ACQUIRE, __ATOMIC_RELAXED)) {
+            return true;
+        }
+        if (spins >= 64) {
+            double now = shm_arena_clock();
+            if (deadline == 0.0) {
+                deadline = now + SHM_ARENA_LOCK_TIMEOUT_SEC;
+            } else if (now > deadline) {
+                std::cerr << "アリーナのロックを取得できません（保持していたプロセスが終了した可能性があります。"
+                          << "セグメントを作り直してください）" << std::endl;
+                return false;
+            }
+            sched_yield();
+        }
+    }
+}
+
+inline void shm_arena_unlock(SegmentArena* arena) {
+    __atomic_store_n(&arena->lock, 0, __ATOMIC_RELEASE);
+}
+
+// 名前でエントリを検索し、無ければ空きエントリ（削除済みのものを優先）を確保する
+// （表が満杯の場合とロックを取れない場合はNULL）
+// 既存のエントリはロックなしで引き、新しく確保する場合だけアリーナのロックを取って探し直す。
+// Python側（shm_layout.SegmentLayout.find_or_insert）も同じロックで確保するため、
+// 同じ空きエントリを両側から同時に確保することはない
+inline SegmentEntry* shm_find_or_insert_entry(SegmentHeader* header, const char* name, uint32_t dtype) {
+    if (strlen(name) >= SHM_NAME_LEN || dtype == SHM_DTYPE_NONE || dtype == SHM_DTYPE_DELETED) {
+        return NULL;
+    }
+    SegmentEntry* found = shm_find_entry(header, name);
+    if (found) {
+        return found;
+    }
+    SegmentArena* arena = shm_arena(header);
+    if (!shm_arena_lock(arena)) {
+        return NULL;
+    }
+    uint64_t hash = shm_name_hash(name);
+    SegmentEntry* entries = shm_entries(header);
+    SegmentEntry* vacant = NULL;
+    for (uint32_t probe = 0; probe < SHM_MAX_ENTRIES; probe++) {
+        SegmentEntry* entry = &entries[(hash + probe) & (SHM_MAX_ENTRIES - 1)];
+        if (entry->dtype == SHM_DTYPE_DELETED) {
+            if (!vacant) {
+                vacant = entry;
+            }
+            continue;
+        }
+        if (entry->dtype == SHM_DTYPE_NONE) {
+            if (!vacant) {
+                vacant = entry;
+            }
+            break;
+        }
+        if (entry->name_hash == hash && strncmp(entry->name, name, SHM_NAME_LEN) == 0) {
+            shm_arena_unlock(arena);
+            return entry;
+        }
+    }
+    if (vacant) {
+        // ロックなしで検索している側の探索を途切れさせないよう、dtype は最後に書き換える
+        memset(vacant->name, 0, SHM_NAME_LEN);
+        strncpy(vacant->name, name, SHM_NAME_LEN - 1);
+        vacant->name_hash = hash;
+        vacant->ndim = 0;
+        memset(vacant->shape, 0, sizeof(vacant->shape));
+        vacant->offset = 0;
+        vacant->nbytes = 0;
+        vacant->capacity = 0;
+        vacant->generation = 0;
+        __atomic_store_n(&vacant->dtype, dtype, __ATOMIC_RELEASE);
+        __atomic_fetch_add(&header->entry_count, 1, __ATOMIC_RELAXED);
+    }
+    shm_arena_unlock(arena);
+    return vacant;
+}
+
+// 拡張後のセグメントサイズを記録する（縮小はしない。data_end と同じくロックを保持して更新する）
+inline bool shm_grow_segment_size(SegmentHeader* header, uint64_t segment_size) {
+    SegmentArena* arena = shm_arena(header);
+    if (!shm_arena_lock(arena)) {
+        return false;
+    }
+    if (segment_size > header->segment_size) {
+        header->segment_size = segment_size;
+    }
+    shm_arena_unlock(arena);
+    return true;
+}
+
+// ブロックを空きリストに戻す（ロックを保持して呼ぶ）
+inline void shm_arena_push(SegmentHeader* header, uint64_t offset, uint64_t size) {
+    SegmentArena* arena = shm_arena(header);
+    uint32_t c = shm_block_class(size);
+    if (((uint64_t)SHM_ALIGNMENT << c) != size) {
+        // 最大の種類を超える大きさのブロックは再利用しない
+        return;
+    }
+    memcpy(reinterpret_cast<char*>(header) + offset, &arena->free_head[c], sizeof(uint64_t));
+    arena->free_head[c] = offset;
+    arena->free_bytes += size;
+}
+
+// size バイトのブロックを割り当てる（空きリストに無ければデータ領域の末尾から。ロックを保持して呼ぶ）
+// セグメントに収まらない場合は0
+inline uint64_t shm_arena_pop(SegmentHeader* header, uint64_t size) {
+    SegmentArena* arena = shm_arena(header);
+    uint32_t c = shm_block_class(size);
+    uint64_t offset = arena->free_head[c];
+    if (offset != 0 && ((uint64_t)SHM_ALIGNMENT << c) == size) {
+        memcpy(&arena->free_head[c], reinterpret_cast<char*>(header) + offset, sizeof(uint64_t));
+        arena->free_bytes -= size;
+        return offset;
+    }
+    offset = shm_align(header->data_end);
+    if (offset + size > header->segment_size) {
+        return 0;
+    }
+    header->data_end = offset + size;
+    return offset;
+}
+
+// エントリのペイロード領域を確保する。容量が足りていれば既存の領域を再利用し、
+// 足りなければ新しいブロックを割り当てて古いブロックを空きリストに戻す。
+// セグメントに収まらない場合と、ロックを取れない場合（*locked を false にする）はfalse
+inline bool shm_reserve_payload(SegmentHeader* header, SegmentEntry* entry, uint64_t nbytes, bool* locked = NULL) {
+    if (locked) {
+        *locked = true;
+    }
+    if (entry->capacity >= nbytes && entry->offset != 0) {
+        return true;
+    }
+    SegmentArena* arena = shm_arena(header);
+    uint64_t capacity = shm_block_size(nbytes);
+    if (!shm_arena_lock(arena)) {
+        if (locked) {
+            *locked = false;
+        }
+        return false;
+    }
+    uint64_t offset = shm_arena_pop(header, capacity);
+    if (offset != 0 && entry->offset != 0) {
+        shm_arena_push(header, entry->offset, entry->capacity);
+    }
+    shm_arena_unlock(arena);
+    if (offset == 0) {
+        return false;
+    }
+    entry->offset = offset;
+    entry->capacity = capacity;
+    return true;
+}
+
+// エントリを削除し、ペイロードのブロックを空きリストに戻す
+// （見つからない場合と、ロックを取れない場合はfalse。後者ではエントリは残る）
+// エントリの確保と同じくアリーナのロックを保持して削除する
+inline bool shm_delete_entry(SegmentHeader* header, const char* name) {
+    SegmentArena* arena = shm_arena(header);
+    if (!shm_arena_lock(arena)) {
+        return false;
+    }
+    SegmentEntry* entry = shm_find_entry(header, name);
+    if (!entry) {
+        shm_arena_unlock(arena);
+        return false;
+    }
+    if (entry->offset != 0) {
+        shm_arena_push(header, entry->offset, entry->capacity);
+    }
+    __atomic_store_n(&entry->dtype, static_cast<uint32_t>(SHM_DTYPE_DELETED), __ATOMIC_RELEASE);
+    memset(entry->name, 0, SHM_NAME_LEN);
+    entry->name_hash = 0;
+    entry->ndim = 0;
+    memset(entry->shape, 0, sizeof(entry->shape));
+    entry->offset = 0;
+    entry->nbytes = 0;
+    entry->capacity = 0;
+    entry->generation = 0;
+    __atomic_fetch_sub(&header->entry_count, 1, __ATOMIC_RELAXED);
+    shm_arena_unlock(arena);
+    return true;
+}
+
+// 1エントリだけを持つセグメントに必要なバイト数
+inline uint64_t shm_segment_size_for(uint64_t nbytes) {
+    return shm_table_size() + shm_block_size(nbytes);
+}
+
+#endif // SHM_LAYOUT_HPP
@@ -0,0 +1,52 @@
+#ifndef SHM_LOG_HPP
+#define SHM_LOG_HPP
+
+// 共有メモリプラグインの診断ログ。FreeFEMのヘッダーには依存しない。
+//
+// 出力先はstderr（FreeFEMのstdoutはPython側がパイプで読むため使わない）。
+// 実行時のレベルは環境変数 PYFF_SHM_LOG で指定する。
+//   0: 出力しない（既定）
+//   1: セグメントの作成・拡張・削除など、まれにしか起きない操作
+//   2: 読み書きの1回ごと
+// コンパイル時の上限は SHM_LOG_MAX_LEVEL で決まり、-DNDEBUG のビルドでは0になる。
+// 上限を超えるレベルのログ呼び出しは引数の評価も含めて完全に取り除かれる。
+// エラーはログレベルに関係なく、これまで通り cerr に出力する。
+
+#include <iostream>
+#include <cstdlib>
+
+enum ShmLogLevel {
+    SHM_LOG_OFF = 0,
+    SHM_LOG_INFO = 1,
+    SHM_LOG_DEBUG = 2
+};
+
+#ifndef SHM_LOG_MAX_LEVEL
+#ifdef NDEBUG
+#define SHM_LOG_MAX_LEVEL 0
+#else
+#define SHM_LOG_MAX_LEVEL 2
+#endif
+#endif
+
+// 環境変数 PYFF_SHM_LOG から実行時のログレベルを取得する（初回のみ読み込む）
+inline int shm_log_level() {
+    static const int level = []() {
+        const char* value = getenv("PYFF_SHM_LOG");
+        return value ? atoi(value) : static_cast<int>(SHM_LOG_OFF);
+    }();
+    return level;
+}
+
+#if SHM_LOG_MAX_LEVEL > 0
+#define SHM_LOG(level, message)                                              \
+    do {                                                                     \
+        if ((level) <= SHM_LOG_MAX_LEVEL && shm_log_level() >= (level)) {    \
+            std::cerr << "[shm] " << message << '\n';                        \
+        }                                                                    \
+    } while (0)
+#else
+#define SHM_LOG(level, message) ((void)0)
+#endif
+
+#endif // SHM_LOG_HPP
@@ -0,0 +1,113 @@
+#ifndef SHM_MAPPING_HPP
+#define SHM_MAPPING_HPP
+
+// セグメントのマッピング方法（ヒュージページ・事前割り当て・NUMAノード）の適用。
+// Python側（shm_mapping.py）と同じ手順を実装する。FreeFEMのヘッダーには依存しない。
+//
+// 方法はセグメントを作成した側が SegmentHeader::map_flags / numa_node に記録し、
+// セグメントをマッピング・拡張するすべてのプロセスが同じ手順を自分のマッピングに適用する。
+//   1. SHM_MAP_HUGEPAGE: madvise(MADV_HUGEPAGE)（/dev/shm の tmpfs では shmem_enabled が
+//      advise 以上の場合に透過的ヒュージページになる。MAP_HUGETLB は tmpfs のファイルには使えない）
+//   2. numa_node: mbind(MPOL_BIND)（tmpfs のページはファイル側に方針が記録されるため、
+//      どのプロセスが最初に触れても指定したノードに割り当てられる）
+//   3. SHM_MAP_POPULATE: MADV_POPULATE_WRITE（未対応のカーネルでは各ページを読んで割り当てる）
+// 方針はページが割り当てられる前に設定する必要があるため、この順に適用する。
+// いずれも失敗しても転送自体は行えるため、警告を出して続行する。
+//
+// セグメントを作成する側は、環境変数 PYFF_SHM_HUGEPAGE / PYFF_SHM_POPULATE（1で有効）と
+// PYFF_SHM_NUMA_NODE（ノード番号）から方法を決める（Pythonが作成した場合はPython側の指定に従う）。
+
+#include "shm_layout.hpp"
+
+#include <iostream>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <errno.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#ifdef __linux__
+#include <sys/syscall.h>
+#endif
+
+static const int SHM_MPOL_BIND = 2;            // linux/mempolicy.h の MPOL_BIND
+static const long SHM_MAX_NUMA_NODES = 1024;
+
+inline size_t shm_page_size() {
+    static const size_t page = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+    return page;
+}
+
+// マッピングの大きさの単位（ヒュージページを使う場合は2 MiB）
+inline size_t shm_mapping_granularity(uint32_t flags) {
+    return (flags & SHM_MAP_HUGEPAGE) ? SHM_HUGEPAGE_SIZE : shm_page_size();
+}
+
+// 環境変数から新しく作成するセグメントのマッピング方法を読み込む
+inline void shm_mapping_options_from_env(uint32_t* flags, uint32_t* numa_node) {
+    const char* hugepage = getenv("PYFF_SHM_HUGEPAGE");
+    const char* populate = getenv("PYFF_SHM_POPULATE");
+    const char* node = getenv("PYFF_SHM_NUMA_NODE");
+    *flags = 0;
+    if (hugepage && atoi(hugepage) > 0) {
+        *flags |= SHM_MAP_HUGEPAGE;
+    }
+    if (populate && atoi(populate) > 0) {
+        *flags |= SHM_MAP_POPULATE;
+    }
+    *numa_node = 0;
+    if (node && *node) {
+        long value = atol(node);
+        if (value >= 0 && value < SHM_MAX_NUMA_NODES) {
+            *numa_node = static_cast<uint32_t>(value + 1);
+        } else {
+            std::cerr << "NUMAノードの指定が不正です: " << node << std::endl;
+        }
+    }
+}
+
+// マッピングの [from, size) の範囲にマッピング方法を適用する
+inline void shm_apply_mapping(void* addr, size_t size, size_t from, uint32_t flags, uint32_t numa_node,
+                              const std::string& name) {
+    size_t page = shm_page_size();
+    from = from / page * page;
+    if (from >= size) {
+        return;
+    }
+    char* start = static_cast<char*>(addr) + from;
+    size_t length = size - from;
+
+#ifdef MADV_HUGEPAGE
+    if ((flags & SHM_MAP_HUGEPAGE) && madvise(start, length, MADV_HUGEPAGE) != 0) {
+        std::cerr << "ヒュージページを設定できません: " << name << ", エラー: " << strerror(errno) << std::endl;
+    }
+#endif
+
+#ifdef __linux__
+    if (numa_node > 0 && numa_node <= SHM_MAX_NUMA_NODES) {
+        const size_t bits = 8 * sizeof(unsigned long);
+        unsigned long mask[SHM_MAX_NUMA_NODES / (8 * sizeof(unsigned long))] = { 0 };
+        mask[(numa_node - 1) / bits] |= 1UL << ((numa_node - 1) % bits);
+        if (syscall(SYS_mbind, start, length, SHM_MPOL_BIND, mask, SHM_MAX_NUMA_NODES + 1, 0) != 0) {
+            std::cerr << "NUMAノード " << numa_node - 1 << " に割り当てられません: " << name
+                      << ", エラー: " << strerror(errno) << std::endl;
+        }
+    }
+#endif
+
+    if (flags & SHM_MAP_POPULATE) {
+#ifdef MADV_POPULATE_WRITE
+        if (madvise(start, length, MADV_POPULATE_WRITE) == 0) {
+            return;
+        }
+#endif
+        // 読み込みのページフォルトでもtmpfsのページは割り当てられる（内容は変更しない）
+        volatile const char* bytes = start;
+        for (size_t offset = 0; offset < length; offset += page) {
+            (void)bytes[offset];
+        }
+    }
+}
+
+#endif // SHM_MAPPING_HPP
@@ -0,0 +1,252 @@
+#ifndef SHM_SNAPSHOT_HPP
+#define SHM_SNAPSHOT_HPP
+
+// 追記専用のスナップショットファイル（非定常計算の履歴の保存と、随伴計算での再生）。
+// FreeFEMのヘッダーには依存しない。
+//
+// ファイルは64バイトのヘッダーの後、SNAPSHOT_DATA_OFFSET から同じ要素数のdouble配列を
+// stride バイトおきに並べる（stride は SNAPSHOT_ALIGNMENT の倍数）。i番目の位置は
+//   data_offset + i * stride
+// で決まり、RAMより大きな履歴でも番号で直接読める。追記はデータを pwrite してから
+// ヘッダーの count を更新するため、count 以降の途中まで書かれた内容は読まれない（書き込み側は1つ）。
+//
+// 読み込みはファイル全体の読み取り専用マッピングを通して行い、読む向きに合わせてカーネルに通知する。
+//   前向き: MADV_SEQUENTIAL（カーネルの先読み）
+//   後ろ向き: MADV_RANDOM（前向きの先読みを止める）
+// どちらの向きでも、これから読む SNAPSHOT_PREFETCH_BYTES 分を MADV_WILLNEED で先読みする。
+// 読み終えたスナップショットは MADV_DONTNEED と POSIX_FADV_DONTNEED でページキャッシュから外し、
+// 履歴全体がメモリに溜まらないようにする。
+// Python側（snapshot_store.py の SnapshotStore）も同じ形式・同じ手順で読み書きする。
+
+#include "shm_layout.hpp"
+#include "shm_mapping.hpp"
+
+#include <algorithm>
+#include <iostream>
+#include <cstddef>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <errno.h>
+#include <fcntl.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+static const uint32_t SNAPSHOT_FILE_MAGIC = 0x4e534650;   // "PFSN"（リトルエンディアン）
+static const uint32_t SNAPSHOT_FILE_VERSION = 1;
+static const uint64_t SNAPSHOT_DATA_OFFSET = 4096;
+static const uint64_t SNAPSHOT_ALIGNMENT = 4096;             // stride の単位（ページ境界で先読み・解放できる）
+static const size_t SNAPSHOT_PREFETCH_BYTES = 32 << 20;      // 先読みする大きさ（少なくとも1つ分）
+
+// スナップショットファイルのヘッダー（64バイト、snapshot_store.py の HEADER と同一）
+struct SnapshotFileHeader {
+    uint32_t magic;              // SNAPSHOT_FILE_MAGIC
+    uint32_t version;            // SNAPSHOT_FILE_VERSION
+    uint32_t dtype;              // ShmDType（現在は SHM_DTYPE_FLOAT64 のみ）
+    uint32_t reserved0;
+    uint64_t elements;           // 1つのスナップショットの要素数
+    uint64_t stride;             // スナップショットの間隔（バイト）
+    uint64_t count;              // 書き込み済みのスナップショット数
+    uint64_t data_offset;        // 最初のスナップショットの位置
+    uint64_t reserved[2];
+};
+
+static_assert(sizeof(SnapshotFileHeader) == 64, "SnapshotFileHeader layout must match snapshot_store.py");
+
+// 開いているスナップショットファイル
+struct SnapshotStore {
+    std::string path;
+    int fd;
+    bool writable;
+    SnapshotFileHeader header;
+    const char* map;             // 読み込み用のマッピング（未作成ならNULL）
+    size_t mapped;               // マッピングの大きさ
+    long last;                   // 最後に読んだ番号（-1: まだ読んでいない）
+    int direction;               // 読む向き（1: 前向き, -1: 後ろ向き, 0: 未設定）
+};
+
+inline uint64_t snapshot_stride(uint64_t elements) {
+    uint64_t bytes = std::max<uint64_t>(elements * sizeof(double), 1);
+    return (bytes + SNAPSHOT_ALIGNMENT - 1) / SNAPSHOT_ALIGNMENT * SNAPSHOT_ALIGNMENT;
+}
+
+inline bool snapshot_header_valid(const SnapshotFileHeader& header) {
+    return header.magic == SNAPSHOT_FILE_MAGIC && header.version == SNAPSHOT_FILE_VERSION
+           && header.dtype == SHM_DTYPE_FLOAT64 && header.stride >= header.elements * sizeof(double)
+           && header.stride % SNAPSHOT_ALIGNMENT == 0 && header.data_offset % SNAPSHOT_ALIGNMENT == 0;
+}
+
+// ヘッダーを読み直す（他のプロセスが追記した count を反映する）
+inline bool snapshot_read_header(SnapshotStore* store) {
+    SnapshotFileHeader header;
+    if (pread(store->fd, &header, sizeof(header), 0) != static_cast<ssize_t>(sizeof(header))
+        || !snapshot_header_valid(header)) {
+        std::cerr << "スナップショットファイルの形式が不正です: " << store->path << std::endl;
+        return false;
+    }
+    store->header = header;
+    return true;
+}
+
+// スナップショットファイルを開く
+// writable の場合は存在しなければ elements 要素のファイルを作成し、存在すれば要素数を確認する
+inline bool snapshot_open(const std::string& path, bool writable, uint64_t elements, SnapshotStore* store) {
+    store->path = path;
+    store->writable = writable;
+    store->map = NULL;
+    store->mapped = 0;
+    store->last = -1;
+    store->direction = 0;
+    store->fd = open(path.c_str(), writable ? O_RDWR | O_CREAT : O_RDONLY, 0644);
+    if (store->fd < 0) {
+        std::cerr << "スナップショットファイルを開けません: " << path << ", エラー: " << strerror(errno) << std::endl;
+        return false;
+    }
+
+    struct stat st;
+    if (fstat(store->fd, &st) == 0 && st.st_size == 0 && writable) {
+        // 新しいファイル：最初の追記の要素数で形式を決める
+        memset(&store->header, 0, sizeof(store->header));
+        store->header.magic = SNAPSHOT_FILE_MAGIC;
+        store->header.version = SNAPSHOT_FILE_VERSION;
+        store->header.dtype = SHM_DTYPE_FLOAT64;
+        store->header.elements = elements;
+        store->header.stride = snapshot_stride(elements);
+        store->header.data_offset = SNAPSHOT_DATA_OFFSET;
+        if (pwrite(store->fd, &store->header, sizeof(store->header), 0) != static_cast<ssize_t>(sizeof(store->header))) {
+            std::cerr << "スナップショットファイルに書き込めません: " << path << ", エラー: " << strerror(errno) << std::endl;
+            close(store->fd);
+            return false;
+        }
+        return true;
+    }
+    if (!snapshot_read_header(store)) {
+        close(store->fd);
+        return false;
+    }
+    if (writable && store->header.elements != elements) {
+        std::cerr << "スナップショットの要素数が一致しません: " << path << " (ファイル: " << store->header.elements
+                  << ", 配列: " << elements << ")" << std::endl;
+        close(store->fd);
+        return false;
+    }
+    return true;
+}
+
+inline void snapshot_close(SnapshotStore* store) {
+    if (store->map) {
+        munmap(const_cast<char*>(store->map), store->mapped);
+        store->map = NULL;
+    }
+    close(store->fd);
+}
+
+// スナップショットを1つ追記し、その番号を返す（失敗した場合は-1）
+inline long snapshot_append(SnapshotStore* store, const double* data) {
+    const SnapshotFileHeader& header = store->header;
+    uint64_t offset = header.data_offset + header.count * header.stride;
+    size_t nbytes = header.elements * sizeof(double);
+    const char* src = reinterpret_cast<const char*>(data);
+    for (size_t written = 0; written < nbytes;) {
+        ssize_t n = pwrite(store->fd, src + written, nbytes - written, offset + written);
+        if (n <= 0) {
+            std::cerr << "スナップショットを追記できません: " << store->path << ", エラー: " << strerror(errno) << std::endl;
+            return -1;
+        }
+        written += static_cast<size_t>(n);
+    }
+    // 要素数が stride に満たない分もファイルの長さに含め、次の位置までをページ境界に揃える
+    if (ftruncate(store->fd, offset + header.stride) != 0) {
+        std::cerr << "スナップショットファイルを拡張できません: " << store->path << ", エラー: " << strerror(errno) << std::endl;
+        return -1;
+    }
+
+    // データの後に count を更新する（読み込み側は count までしか読まない）
+    uint64_t count = header.count + 1;
+    if (pwrite(store->fd, &count, sizeof(count), offsetof(SnapshotFileHeader, count))
+        != static_cast<ssize_t>(sizeof(count))) {
+        std::cerr << "スナップショットファイルのヘッダーを更新できません: " << store->path << std::endl;
+        return -1;
+    }
+    store->header.count = count;
+    return static_cast<long>(count - 1);
+}
+
+// マッピング内の [begin, end) を含むページに madvise を適用する（範囲外は切り詰める）
+inline void snapshot_advise(const SnapshotStore* store, uint64_t begin, uint64_t end, int advice) {
+    size_t page = shm_page_size();
+    begin = begin / page * page;
+    end = std::min<uint64_t>((end + page - 1) / page * page, store->mapped);
+    if (begin < end) {
+        madvise(const_cast<char*>(store->map) + begin, end - begin, advice);
+    }
+}
+
+// index 番目を読む前に、向きに合わせて先読みと読み終えた分の解放を行う
+inline void snapshot_prefetch(SnapshotStore* store, long index) {
+    const SnapshotFileHeader& header = store->header;
+    int direction = (store->last >= 0 && index < store->last) ? -1 : 1;
+    if (direction != store->direction) {
+        snapshot_advise(store, 0, store->mapped, direction > 0 ? MADV_SEQUENTIAL : MADV_RANDOM);
+        store->direction = direction;
+    }
+
+    long window = static_cast<long>(std::max<uint64_t>(SNAPSHOT_PREFETCH_BYTES / header.stride, 1));
+    long first = direction > 0 ? index : std::max(index - window, 0L);
+    long last = direction > 0 ? std::min(index + window, static_cast<long>(header.count) - 1) : index;
+    snapshot_advise(store, header.data_offset + first * header.stride,
+                    header.data_offset + (last + 1) * header.stride, MADV_WILLNEED);
+
+    // 読み終えたスナップショットはマッピングとページキャッシュの両方から外す
+    if (store->last >= 0 && store->last != index) {
+        uint64_t begin = header.data_offset + store->last * header.stride;
+        snapshot_advise(store, begin, begin + header.stride, MADV_DONTNEED);
+#ifdef POSIX_FADV_DONTNEED
+        posix_fadvise(store->fd, begin, header.stride, POSIX_FADV_DONTNEED);
+#endif
+    }
+    store->last = index;
+}
+
+// index 番目のスナップショットの先頭を返す（範囲外の場合はNULL）
+// マッピングが count に追いついていなければヘッダーを読み直してマッピングし直す
+inline const double* snapshot_data(SnapshotStore* store, long index) {
+    if (index < 0) {
+        std::cerr << "スナップショットの番号が不正です: " << store->path << " (" << index << ")" << std::endl;
+        return NULL;
+    }
+    if (static_cast<uint64_t>(index) >= store->header.count && !snapshot_read_header(store)) {
+        return NULL;
+    }
+    const SnapshotFileHeader& header = store->header;
+    if (static_cast<uint64_t>(index) >= header.count) {
+        std::cerr << "スナップショットの番号が範囲外です: " << store->path << " (" << index << ", 個数: "
+                  << header.count << ")" << std::endl;
+        return NULL;
+    }
+
+    size_t required = header.data_offset + header.count * header.stride;
+    if (required > store->mapped) {
+        if (store->map) {
+            munmap(const_cast<char*>(store->map), store->mapped);
+            store->map = NULL;
+        }
+        void* addr = mmap(NULL, required, PROT_READ, MAP_SHARED, store->fd, 0);
+        if (addr == MAP_FAILED) {
+            std::cerr << "スナップショットファイルのマッピングに失敗: " << store->path << ", エラー: "
+                      << strerror(errno) << std::endl;
+            store->mapped = 0;
+            return NULL;
+        }
+        store->map = static_cast<const char*>(addr);
+        store->mapped = required;
+        store->direction = 0;
+    }
+
+    snapshot_prefetch(store, index);
+    return reinterpret_cast<const double*>(store->map + header.data_offset + index * header.stride);
+}
+
+#endif // SHM_SNAPSHOT_HPP
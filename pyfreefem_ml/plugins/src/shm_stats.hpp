@@ -0,0 +1,79 @@
+#ifndef SHM_STATS_HPP
+#define SHM_STATS_HPP
+
+// セグメント内の転送統計（SegmentStats）の記録と集計。FreeFEMのヘッダーには依存しない。
+//
+// 統計はセグメントのヘッダー部に置かれるため、Python側（shm_layout.py）は
+// 追加の呼び出しなしにマッピングから直接読める。同じ記録元の複数プロセス
+// （MPIの各ランクなど）が同時に更新してもよいよう、__atomic 組み込み関数で加算する。
+
+#include "shm_layout.hpp"
+
+#include <stdint.h>
+#include <time.h>
+
+inline uint64_t shm_now_ns() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return static_cast<uint64_t>(ts.tv_sec) * 1000000000ULL + static_cast<uint64_t>(ts.tv_nsec);
+}
+
+// レイテンシのヒストグラムの区間（floor(log2(ns))、上限は最後の区間）
+inline size_t shm_stats_bucket(uint64_t ns) {
+    size_t bucket = ns > 1 ? 63 - __builtin_clzll(ns) : 0;
+    return bucket < SHM_STATS_BUCKETS ? bucket : SHM_STATS_BUCKETS - 1;
+}
+
+inline void shm_stats_update_min(uint64_t* target, uint64_t value) {
+    uint64_t current = __atomic_load_n(target, __ATOMIC_RELAXED);
+    while ((current == 0 || value < current)
+           && !__atomic_compare_exchange_n(target, &current, value, true, __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+    }
+}
+
+inline void shm_stats_update_max(uint64_t* target, uint64_t value) {
+    uint64_t current = __atomic_load_n(target, __ATOMIC_RELAXED);
+    while (value > current
+           && !__atomic_compare_exchange_n(target, &current, value, true, __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+    }
+}
+
+// 1回の読み書きを記録する
+inline void shm_stats_record(SegmentStats* stats, bool write, uint64_t bytes,
+                             uint64_t wait_ns, uint64_t copy_ns, uint64_t latency_ns) {
+    if (write) {
+        __atomic_fetch_add(&stats->write_calls, 1, __ATOMIC_RELAXED);
+        __atomic_fetch_add(&stats->bytes_written, bytes, __ATOMIC_RELAXED);
+    } else {
+        __atomic_fetch_add(&stats->read_calls, 1, __ATOMIC_RELAXED);
+        __atomic_fetch_add(&stats->bytes_read, bytes, __ATOMIC_RELAXED);
+    }
+    __atomic_fetch_add(&stats->wait_ns, wait_ns, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&stats->copy_ns, copy_ns, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&stats->latency_hist[shm_stats_bucket(latency_ns)], 1, __ATOMIC_RELAXED);
+    shm_stats_update_min(&stats->latency_min_ns, latency_ns);
+    shm_stats_update_max(&stats->latency_max_ns, latency_ns);
+}
+
+// ヒストグラムから分位点を求める（該当する区間の上端、記録が無ければ0）
+inline uint64_t shm_stats_percentile(const SegmentStats* stats, double q) {
+    uint64_t total = 0;
+    for (size_t i = 0; i < SHM_STATS_BUCKETS; i++) {
+        total += stats->latency_hist[i];
+    }
+    if (total == 0) {
+        return 0;
+    }
+    uint64_t rank = static_cast<uint64_t>(q * static_cast<double>(total - 1)) + 1;
+    uint64_t seen = 0;
+    for (size_t i = 0; i < SHM_STATS_BUCKETS; i++) {
+        seen += stats->latency_hist[i];
+        if (seen >= rank) {
+            uint64_t upper = 2ULL << i;
+            return upper < stats->latency_max_ns ? upper : stats->latency_max_ns;
+        }
+    }
+    return stats->latency_max_ns;
+}
+
+#endif // SHM_STATS_HPP
@@ -0,0 +1,118 @@
+#ifndef SHM_SYNC_HPP
+#define SHM_SYNC_HPP
+
+// セグメントヘッダーの通知シーケンス（SegmentHeader::seq）による待機/通知。
+// Python側（shm_sync.py）と同じプロトコルを実装する。FreeFEMのヘッダーには依存しない。
+//
+// 書き込み側: データとエントリを書き終えた後に shm_notify() で seq を進め、
+//             待機者がいる場合だけ futex で起こす（待機者がいなければシステムコールなし）。
+// 読み込み側: shm_wait_until() で条件を確認し、満たされなければ seq が変わるまで
+//             短くスピンしてから futex で待機する。タイムアウトは CLOCK_MONOTONIC 基準。
+//
+// SegmentHeader はPythonと共有するPOD構造体のため、std::atomic ではなく
+// __atomic 組み込み関数で seq/waiters を操作する。
+
+#include "shm_layout.hpp"
+
+#include <stdint.h>
+#include <limits.h>
+#include <time.h>
+#include <errno.h>
+#ifdef __linux__
+#include <unistd.h>
+#include <sys/syscall.h>
+#include <linux/futex.h>
+#endif
+
+static const int SHM_SPIN_ITERATIONS = 2000;       // ブロックする前のスピン回数
+static const double SHM_WAIT_TIMEOUT_SEC = 10.0;   // 既定のタイムアウト（秒）
+
+inline void shm_cpu_relax() {
+#if defined(__x86_64__) || defined(__i386__)
+    __builtin_ia32_pause();
+#elif defined(__aarch64__)
+    __asm__ __volatile__("yield");
+#endif
+}
+
+inline double shm_monotonic_now() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+inline uint32_t shm_load_seq(const SegmentHeader* header) {
+    return __atomic_load_n(&header->seq, __ATOMIC_ACQUIRE);
+}
+
+// seq が expected のままなら最大 timeout 秒だけ眠る（起床理由は問わない）
+inline void shm_futex_wait(SegmentHeader* header, uint32_t expected, double timeout) {
+#ifdef __linux__
+    struct timespec ts;
+    ts.tv_sec = static_cast<time_t>(timeout);
+    ts.tv_nsec = static_cast<long>((timeout - ts.tv_sec) * 1e9);
+    // 他プロセスと共有するアドレスのため FUTEX_PRIVATE_FLAG は付けない
+    syscall(SYS_futex, &header->seq, FUTEX_WAIT, expected, &ts, NULL, 0);
+#else
+    // futexの無い環境では短い間隔でポーリングする
+    struct timespec ts = {0, 100000};
+    (void)header; (void)expected; (void)timeout;
+    nanosleep(&ts, NULL);
+#endif
+}
+
+// 書き込みの完了を通知する（データとエントリの更新後に呼ぶ）
+inline void shm_notify(SegmentHeader* header) {
+    __atomic_add_fetch(&header->seq, 1, __ATOMIC_SEQ_CST);
+#ifdef __linux__
+    if (__atomic_load_n(&header->waiters, __ATOMIC_SEQ_CST) != 0) {
+        syscall(SYS_futex, &header->seq, FUTEX_WAKE, INT_MAX, NULL, NULL, 0);
+    }
+#endif
+}
+
+// ready() が真になるまで待機する。タイムアウトした場合はfalse
+// ready() はヘッダーとエントリ表だけを参照すること（ペイロードは再マッピング前の可能性がある）
+template <class Ready>
+inline bool shm_wait_until(SegmentHeader* header, Ready ready, double timeout = SHM_WAIT_TIMEOUT_SEC) {
+    double deadline = shm_monotonic_now() + timeout;
+    for (;;) {
+        uint32_t seen = shm_load_seq(header);
+        if (ready()) {
+            return true;
+        }
+
+        // 書き込み側が直後に通知する場合に備えて短くスピンする
+        bool changed = false;
+        for (int i = 0; i < SHM_SPIN_ITERATIONS; i++) {
+            if (shm_load_seq(header) != seen) {
+                changed = true;
+                break;
+            }
+            shm_cpu_relax();
+        }
+        if (changed) {
+            continue;
+        }
+
+        double remaining = deadline - shm_monotonic_now();
+        if (remaining <= 0) {
+            return ready();
+        }
+
+        // waiters を増やしてから seq を再確認することで通知の取りこぼしを防ぐ
+        __atomic_add_fetch(&header->waiters, 1, __ATOMIC_SEQ_CST);
+        if (__atomic_load_n(&header->seq, __ATOMIC_SEQ_CST) == seen) {
+            shm_futex_wait(header, seen, remaining);
+        }
+        __atomic_sub_fetch(&header->waiters, 1, __ATOMIC_SEQ_CST);
+    }
+}
+
+// seq が seen から変わるまで待機し、新しい seq を返す。タイムアウトした場合は-1
+inline long shm_wait_for_update(SegmentHeader* header, uint32_t seen, double timeout = SHM_WAIT_TIMEOUT_SEC) {
+    bool updated = shm_wait_until(header, [&]() { return shm_load_seq(header) != seen; }, timeout);
+    return updated ? static_cast<long>(shm_load_seq(header)) : -1L;
+}
+
+#endif // SHM_SYNC_HPP
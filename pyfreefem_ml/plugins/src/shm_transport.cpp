@@ -0,0 +1,1637 @@
+#include "shm_transport.hpp"
+#include "shm_sync.hpp"
+#include "shm_copy.hpp"
+#include "shm_log.hpp"
+#include "shm_stats.hpp"
+#include "shm_mapping.hpp"
+
+#include <iostream>
+#include <cstring>
+#include <cstdlib>
+#include <string>
+#include <vector>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <errno.h>
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <map>
+#include <mutex>
+#include <thread>
+#include <stdint.h>
+
+// 共有メモリ転送のコア実装（FreeFEMに依存しない部分）
+
+using namespace std;
+
+// セグメントのバイナリレイアウト（SegmentHeader/SegmentEntry）は shm_layout.hpp を参照
+
+// 共有メモリオブジェクトを管理するクラス
+class SharedMemoryManager {
+private:
+    struct Slot {
+        string name;
+        uint64_t hash;     // shm_name_hash(name)
+        void* addr;
+        size_t size;
+        int fd;
+        dev_t dev;         // マッピングしたオブジェクト（名前が作り直されたことの検出に使う）
+        ino_t ino;
+        uint32_t magic;    // 名前がこのオブジェクトを指すと最後に確かめたときの先頭の語（0は未確認）
+        bool in_use;
+        int pinned;        // このスロットを参照しているゼロコピービューの数
+    };
+
+    // スロット本体（インデックスは解放後も安定しており、空きはfree_slotsで再利用する）
+    static vector<Slot> shm_objects;
+    static vector<int> free_slots;
+
+    // 名前ハッシュによる開番地法のインデックス（要素はスロット番号、EMPTY/DELETEDは空き）
+    enum { INDEX_EMPTY = -1, INDEX_DELETED = -2 };
+    static vector<int> name_index;
+    static size_t index_used;      // 使用中＋削除済みのインデックス要素数
+
+    static bool valid_slot(int slot) {
+        return slot >= 0 && slot < (int)shm_objects.size() && shm_objects[slot].in_use;
+    }
+
+    // インデックスを指定サイズ（2の冪）で再構築する
+    static void rebuild_index(size_t capacity) {
+        name_index.assign(capacity, INDEX_EMPTY);
+        index_used = 0;
+        for (int i = 0; i < (int)shm_objects.size(); i++) {
+            if (shm_objects[i].in_use) {
+                size_t mask = capacity - 1;
+                size_t pos = shm_objects[i].hash & mask;
+                while (name_index[pos] != INDEX_EMPTY) {
+                    pos = (pos + 1) & mask;
+                }
+                name_index[pos] = i;
+                index_used++;
+            }
+        }
+    }
+
+    // 空きスロットを取得（無ければ末尾に追加する）
+    static int find_free_slot() {
+        if (!free_slots.empty()) {
+            int slot = free_slots.back();
+            free_slots.pop_back();
+            return slot;
+        }
+        shm_objects.push_back(Slot());
+        shm_objects.back().in_use = false;
+        return (int)shm_objects.size() - 1;
+    }
+
+    // 名前からインデックス上の位置を検索（見つからない場合は-1）
+    static long find_index_pos(const string& name, uint64_t hash) {
+        if (name_index.empty()) {
+            return -1;
+        }
+        size_t mask = name_index.size() - 1;
+        for (size_t pos = hash & mask, probe = 0; probe < name_index.size(); pos = (pos + 1) & mask, probe++) {
+            int slot = name_index[pos];
+            if (slot == INDEX_EMPTY) {
+                return -1;
+            }
+            if (slot != INDEX_DELETED && shm_objects[slot].hash == hash && shm_objects[slot].name == name) {
+                return (long)pos;
+            }
+        }
+        return -1;
+    }
+
+    // 名前からスロットを検索
+    static int find_slot_by_name(const string& name) {
+        long pos = find_index_pos(name, shm_name_hash(name.c_str()));
+        return pos < 0 ? -1 : name_index[pos];
+    }
+
+    // スロットをインデックスに登録する（負荷率が1/2を超える場合は倍に拡張）
+    static void index_insert(int slot) {
+        if ((index_used + 1) * 2 > name_index.size()) {
+            rebuild_index(max<size_t>(16, name_index.size() * 2));
+        }
+        size_t mask = name_index.size() - 1;
+        size_t pos = shm_objects[slot].hash & mask;
+        while (name_index[pos] != INDEX_EMPTY && name_index[pos] != INDEX_DELETED) {
+            pos = (pos + 1) & mask;
+        }
+        if (name_index[pos] == INDEX_EMPTY) {
+            index_used++;
+        }
+        name_index[pos] = slot;
+    }
+
+    // スロットをインデックスから削除する
+    static void index_remove(int slot) {
+        long pos = find_index_pos(shm_objects[slot].name, shm_objects[slot].hash);
+        if (pos >= 0) {
+            name_index[pos] = INDEX_DELETED;
+        }
+    }
+
+    // マッピングの単位（ページまたはヒュージページ）への切り上げ
+    static size_t page_align(int slot, size_t size) {
+        size_t unit = shm_mapping_granularity(map_flags(slot));
+        return (size + unit - 1) / unit * unit;
+    }
+
+    // セグメントヘッダーに記録されたマッピング方法（セグメントでなければ0）
+    static uint32_t map_flags(int slot) {
+        const SegmentHeader* header = static_cast<const SegmentHeader*>(shm_objects[slot].addr);
+        if (shm_objects[slot].size < sizeof(SegmentHeader) || !shm_segment_valid(header)) {
+            return 0;
+        }
+        return header->map_flags;
+    }
+
+    // マッピングの from バイト目以降にヘッダーに記録されたマッピング方法を適用する
+    static void apply_mapping(int slot, size_t from) {
+        const SegmentHeader* header = static_cast<const SegmentHeader*>(shm_objects[slot].addr);
+        if (shm_objects[slot].size < sizeof(SegmentHeader) || !shm_segment_valid(header)
+            || (header->map_flags == 0 && header->numa_node == 0)) {
+            return;
+        }
+        shm_apply_mapping(shm_objects[slot].addr, shm_objects[slot].size, from,
+                          header->map_flags, header->numa_node, shm_objects[slot].name);
+    }
+
+    // スロットに新しいマッピングを登録する
+    static int register_slot(const string& name, int fd, size_t size) {
+        // メモリマッピング
+        void* addr = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        if (addr == MAP_FAILED) {
+            cerr << "メモリマッピングに失敗: " << name << ", エラー: " << strerror(errno) << endl;
+            ::close(fd);
+            return -1;
+        }
+
+        // スロットに情報を格納
+        int slot = find_free_slot();
+        shm_objects[slot].name = name;
+        shm_objects[slot].hash = shm_name_hash(name.c_str());
+        shm_objects[slot].addr = addr;
+        shm_objects[slot].size = size;
+        shm_objects[slot].fd = fd;
+        shm_objects[slot].pinned = 0;
+        struct stat st;
+        bool known = fstat(fd, &st) == 0;
+        shm_objects[slot].dev = known ? st.st_dev : 0;
+        shm_objects[slot].ino = known ? st.st_ino : 0;
+        shm_objects[slot].magic = first_word(slot);
+        index_insert(slot);
+        shm_objects[slot].in_use = true;
+        apply_mapping(slot, 0);
+
+        SHM_LOG(SHM_LOG_INFO, "map " << name << " (" << size << " bytes, slot " << slot << ")");
+        return slot;
+    }
+
+    // マッピングをnew_sizeバイトに付け替える（ファイルサイズは呼び出し側で確保済み）
+    // ビュー参照中のスロットはアドレスを動かせないため、その場で拡張できる場合のみ成功する
+    static bool remap(int slot, size_t new_size) {
+        void* old_addr = shm_objects[slot].addr;
+        size_t old_size = shm_objects[slot].size;
+        bool pinned = shm_objects[slot].pinned > 0;
+
+#ifdef __linux__
+        void* addr = mremap(old_addr, old_size, new_size, pinned ? 0 : MREMAP_MAYMOVE);
+#else
+        void* addr = MAP_FAILED;
+        errno = EBUSY;
+        if (!pinned) {
+            addr = mmap(NULL, new_size, PROT_READ | PROT_WRITE, MAP_SHARED, shm_objects[slot].fd, 0);
+            if (addr != MAP_FAILED) {
+                munmap(old_addr, old_size);
+            }
+        }
+#endif
+        if (addr == MAP_FAILED) {
+            cerr << "共有メモリの再マッピングに失敗: " << shm_objects[slot].name
+                 << (pinned ? "（ビュー参照中）" : "") << ", エラー: " << strerror(errno) << endl;
+            return false;
+        }
+
+        SHM_LOG(SHM_LOG_INFO, "remap " << shm_objects[slot].name << " " << old_size << " -> " << new_size << " bytes");
+        shm_objects[slot].addr = addr;
+        shm_objects[slot].size = new_size;
+        apply_mapping(slot, old_size);
+        return true;
+    }
+
+    // 名前が現在指している共有メモリオブジェクトの状態を取得する
+    static bool stat_name(const string& name, struct stat* st) {
+#ifdef __linux__
+        return ::stat(("/dev/shm" + name).c_str(), st) == 0;
+#else
+        int fd = shm_open(name.c_str(), O_RDONLY, 0);
+        if (fd < 0) {
+            return false;
+        }
+        bool ok = fstat(fd, st) == 0;
+        ::close(fd);
+        return ok;
+#endif
+    }
+
+    // マッピング先頭の語（セグメントとリングバッファのmagic）
+    static uint32_t first_word(int slot) {
+        if (shm_objects[slot].size < sizeof(uint32_t)) {
+            return 0;
+        }
+        return __atomic_load_n(static_cast<const uint32_t*>(shm_objects[slot].addr), __ATOMIC_ACQUIRE);
+    }
+
+    // キャッシュ済みのスロットを名前で探す
+    // 他のプロセスがセグメントを削除して同じ名前で作り直した場合、古いマッピングは削除済みの
+    // オブジェクトを指したままになるため、名前の指すオブジェクトが変わっていればスロットを捨てる
+    // 削除する側は先に先頭のmagicを消す（retire）ため、magicが確認時から変わっていなければ
+    // システムコールなしでスロットを返し、変わっていた場合だけ名前を stat して確かめ直す
+    static int find_current_slot(const string& name) {
+        int slot = find_slot_by_name(name);
+        if (slot < 0) {
+            return -1;
+        }
+        uint32_t magic = first_word(slot);
+        if (magic != 0 && magic == shm_objects[slot].magic) {
+            return slot;
+        }
+        struct stat st;
+        if (stat_name(name, &st) && st.st_dev == shm_objects[slot].dev && st.st_ino == shm_objects[slot].ino) {
+            shm_objects[slot].magic = magic;
+            return slot;
+        }
+        SHM_LOG(SHM_LOG_INFO, "stale mapping " << name << " (slot " << slot << ")");
+        if (shm_objects[slot].pinned > 0) {
+            // ビューが古い領域を指しているためアンマップせず、名前の対応だけを外す
+            // （マッピングはプロセスの終了まで残る）
+            index_remove(slot);
+            shm_objects[slot].name.clear();
+            shm_objects[slot].hash = shm_name_hash("");
+        } else {
+            close(slot);
+        }
+        return -1;
+    }
+
+public:
+    // 共有メモリオブジェクトを作成または開く
+    // キャッシュ済みのスロットが要求サイズを満たす場合はマッピングを再利用する
+    // （システムコールは発行しない。find_current_slot を参照）
+    static int create_or_open(const string& name, size_t size) {
+        int slot = find_current_slot(name);
+        if (slot >= 0) {
+            if (size > shm_objects[slot].size && !grow(slot, size)) {
+                return -1;
+            }
+            return slot;
+        }
+
+        // 共有メモリオブジェクトを開く
+        int fd = shm_open(name.c_str(), O_CREAT | O_RDWR, 0666);
+        if (fd < 0) {
+            cerr << "共有メモリのオープンに失敗: " << name << ", エラー: " << strerror(errno) << endl;
+            return -1;
+        }
+
+        // サイズを設定（他プロセスが作成した既存セグメントを縮めないよう、不足時のみ拡張）
+        struct stat st;
+        if (fstat(fd, &st) == 0 && (size_t)st.st_size >= size) {
+            size = st.st_size;
+        } else if (ftruncate(fd, size) < 0) {
+            cerr << "共有メモリのサイズ設定に失敗: " << name << ", エラー: " << strerror(errno) << endl;
+            ::close(fd);
+            return -1;
+        }
+
+        return register_slot(name, fd, size);
+    }
+
+    // 既存の共有メモリオブジェクトを実サイズ全体でマッピングして開く
+    // キャッシュ済みの場合はそのまま返す（拡張の検出はrefreshで行う）
+    static int open_whole(const string& name) {
+        int slot = find_current_slot(name);
+        if (slot >= 0) {
+            return slot;
+        }
+
+        int fd = shm_open(name.c_str(), O_RDWR, 0666);
+        if (fd < 0) {
+            cerr << "共有メモリのオープンに失敗: " << name << ", エラー: " << strerror(errno) << endl;
+            return -1;
+        }
+
+        struct stat st;
+        if (fstat(fd, &st) < 0 || (size_t)st.st_size < sizeof(SegmentHeader)) {
+            cerr << "共有メモリのサイズが不正です: " << name << endl;
+            ::close(fd);
+            return -1;
+        }
+
+        return register_slot(name, fd, st.st_size);
+    }
+
+    // 書き込み側：容量をrequiredバイト以上に拡張する
+    // 再拡張の回数を抑えるため、現在の容量の2倍以上に幾何級数的に拡張する
+    static bool grow(int slot, size_t required) {
+        if (!valid_slot(slot)) {
+            return false;
+        }
+        if (required <= shm_objects[slot].size) {
+            return true;
+        }
+
+        size_t new_size = page_align(slot, max(required, shm_objects[slot].size * 2));
+
+        // 他プロセスが既にさらに拡張している場合はそのサイズに合わせる
+        struct stat st;
+        if (fstat(shm_objects[slot].fd, &st) == 0 && (size_t)st.st_size > new_size) {
+            new_size = st.st_size;
+        } else if (ftruncate(shm_objects[slot].fd, new_size) < 0) {
+            cerr << "共有メモリの拡張に失敗: " << shm_objects[slot].name << ", エラー: " << strerror(errno) << endl;
+            return false;
+        }
+
+        return remap(slot, new_size);
+    }
+
+    // 読み取り側：ヘッダーに記録されたサイズがマッピングより大きければ再マッピングする
+    // 拡張されていなければシステムコールは発行しない
+    static bool refresh(int slot, size_t advertised_size) {
+        if (!valid_slot(slot)) {
+            return false;
+        }
+        if (advertised_size <= shm_objects[slot].size) {
+            return true;
+        }
+
+        struct stat st;
+        if (fstat(shm_objects[slot].fd, &st) < 0 || (size_t)st.st_size < advertised_size) {
+            cerr << "共有メモリのサイズがヘッダーと一致しません: " << shm_objects[slot].name << endl;
+            return false;
+        }
+        return remap(slot, st.st_size);
+    }
+
+    // ビューの参照カウントを増減する（参照中のスロットはアンマップしない）
+    static void pin(int slot) {
+        if (valid_slot(slot)) {
+            shm_objects[slot].pinned++;
+        }
+    }
+
+    static void unpin(int slot) {
+        if (valid_slot(slot) && shm_objects[slot].pinned > 0) {
+            shm_objects[slot].pinned--;
+        }
+    }
+
+    // 新しく初期化したセグメントに環境変数で指定されたマッピング方法を記録し、適用する
+    static void init_mapping(int slot) {
+        SegmentHeader* header = static_cast<SegmentHeader*>(shm_objects[slot].addr);
+        shm_mapping_options_from_env(&header->map_flags, &header->numa_node);
+        apply_mapping(slot, 0);
+    }
+
+    // スロットのファイル記述子を取得
+    static int get_fd(int slot) {
+        if (!valid_slot(slot)) {
+            return -1;
+        }
+        return shm_objects[slot].fd;
+    }
+
+    // スロットのマッピングサイズを取得
+    static size_t get_size(int slot) {
+        if (!valid_slot(slot)) {
+            return 0;
+        }
+        return shm_objects[slot].size;
+    }
+
+    // 名前からスロット番号を取得
+    static int find(const string& name) {
+        return find_slot_by_name(name);
+    }
+
+    // 共有メモリオブジェクトを閉じる
+    static void close(int slot) {
+        if (!valid_slot(slot)) {
+            return;
+        }
+        if (shm_objects[slot].pinned > 0) {
+            // KN_<double>ビューがこの領域を指しているためアンマップしない
+            return;
+        }
+
+        SHM_LOG(SHM_LOG_INFO, "unmap " << shm_objects[slot].name);
+        munmap(shm_objects[slot].addr, shm_objects[slot].size);
+        ::close(shm_objects[slot].fd);
+        index_remove(slot);
+        shm_objects[slot].in_use = false;
+        shm_objects[slot].name.clear();
+        free_slots.push_back(slot);
+    }
+
+    // 削除する前に先頭のmagicを消し、他のプロセスにキャッシュされたマッピングに
+    // 名前の指すオブジェクトを確かめ直させる（find_current_slot を参照）
+    static void retire(const string& name) {
+        int fd = shm_open(name.c_str(), O_RDWR, 0);
+        if (fd < 0) {
+            return;
+        }
+        struct stat st;
+        const uint32_t zero = 0;
+        if (fstat(fd, &st) == 0 && (size_t)st.st_size >= sizeof(zero)
+            && pwrite(fd, &zero, sizeof(zero), 0) != (ssize_t)sizeof(zero)) {
+            cerr << "共有メモリの無効化に失敗: " << name << ", エラー: " << strerror(errno) << endl;
+        }
+        ::close(fd);
+    }
+
+    // 共有メモリオブジェクトを削除
+    static void unlink(const string& name) {
+        retire(name);
+        shm_unlink(name.c_str());
+    }
+
+    // スロットからアドレスを取得
+    static void* get_address(int slot) {
+        if (!valid_slot(slot)) {
+            return NULL;
+        }
+        return shm_objects[slot].addr;
+    }
+
+    // 名前からアドレスを取得
+    static void* get_address(const string& name) {
+        int slot = find_slot_by_name(name);
+        if (slot < 0) {
+            return NULL;
+        }
+        return shm_objects[slot].addr;
+    }
+};
+
+// 静的メンバの初期化
+vector<SharedMemoryManager::Slot> SharedMemoryManager::shm_objects;
+vector<int> SharedMemoryManager::free_slots;
+vector<int> SharedMemoryManager::name_index;
+size_t SharedMemoryManager::index_used = 0;
+
+// SPSCリングバッファのヘッダー（Python側のRingBufferと同一レイアウト）
+// head/tailは別々のキャッシュラインに置き、生産者と消費者の偽共有を避ける
+static const uint32_t RING_MAGIC = 0x52494e47; // "RING"
+static const uint32_t RING_VERSION = 1;
+static const size_t RING_CACHE_LINE = 64;
+
+struct alignas(64) RingBufferHeader {
+    uint32_t magic;            // RING_MAGIC
+    uint32_t version;          // RING_VERSION
+    uint64_t slot_elements;    // 1スロットあたりの最大要素数（double）
+    uint64_t slot_count;       // スロット数（2の冪）
+    uint64_t slot_stride;      // 1スロットのバイト数（64バイト境界）
+    alignas(64) std::atomic<uint64_t> head; // 次に書き込む位置（生産者のみ更新）
+    alignas(64) std::atomic<uint64_t> tail; // 次に読み取る位置（消費者のみ更新）
+};
+
+static_assert(sizeof(RingBufferHeader) == 3 * RING_CACHE_LINE, "RingBufferHeader layout must match shm_manager.py");
+
+// 各スロットの先頭には実際の要素数を置き、その後にdouble配列を格納する
+struct RingSlotHeader {
+    uint64_t elements;
+    uint64_t reserved;
+};
+
+// 共有メモリ上のリングバッファを操作するクラス
+// 高速パスではシステムコールを発行せず、アトミックなhead/tailのみで同期する
+class RingBuffer {
+public:
+    static size_t slot_stride(size_t slot_elements) {
+        size_t bytes = sizeof(RingSlotHeader) + slot_elements * sizeof(double);
+        return (bytes + RING_CACHE_LINE - 1) & ~(RING_CACHE_LINE - 1);
+    }
+
+    static size_t segment_size(size_t slot_elements, size_t slot_count) {
+        return sizeof(RingBufferHeader) + slot_stride(slot_elements) * slot_count;
+    }
+
+    // リングバッファを作成する（既存の場合はヘッダーを検証して再利用）
+    static RingBufferHeader* create(const string& name, size_t slot_elements, size_t slot_count) {
+        if (slot_count == 0 || (slot_count & (slot_count - 1)) != 0) {
+            cerr << "リングバッファのスロット数は2の冪である必要があります: " << slot_count << endl;
+            return NULL;
+        }
+
+        int slot = SharedMemoryManager::create_or_open(name, segment_size(slot_elements, slot_count));
+        if (slot < 0) {
+            return NULL;
+        }
+
+        RingBufferHeader* ring = static_cast<RingBufferHeader*>(SharedMemoryManager::get_address(slot));
+        if (ring->magic == RING_MAGIC) {
+            if (ring->slot_elements != slot_elements || ring->slot_count != slot_count) {
+                cerr << "既存のリングバッファと構成が一致しません: " << name << endl;
+                return NULL;
+            }
+            return ring;
+        }
+
+        ring->version = RING_VERSION;
+        ring->slot_elements = slot_elements;
+        ring->slot_count = slot_count;
+        ring->slot_stride = slot_stride(slot_elements);
+        ring->head.store(0, std::memory_order_relaxed);
+        ring->tail.store(0, std::memory_order_relaxed);
+        // magicは最後に公開する
+        std::atomic_thread_fence(std::memory_order_release);
+        ring->magic = RING_MAGIC;
+        return ring;
+    }
+
+    // 既存のリングバッファに接続する（マッピングはスロットにキャッシュされる）
+    static RingBufferHeader* attach(const string& name) {
+        int slot = SharedMemoryManager::find(name);
+        if (slot < 0) {
+            slot = SharedMemoryManager::open_whole(name);
+        }
+        if (slot < 0) {
+            return NULL;
+        }
+
+        RingBufferHeader* ring = static_cast<RingBufferHeader*>(SharedMemoryManager::get_address(slot));
+        if (ring->magic != RING_MAGIC || ring->version != RING_VERSION) {
+            cerr << "リングバッファではありません: " << name << endl;
+            return NULL;
+        }
+        if (segment_size(ring->slot_elements, ring->slot_count) > SharedMemoryManager::get_size(slot)) {
+            cerr << "リングバッファのマッピングサイズが不足しています: " << name << endl;
+            return NULL;
+        }
+        return ring;
+    }
+
+    static RingSlotHeader* slot_at(RingBufferHeader* ring, uint64_t index) {
+        char* base = reinterpret_cast<char*>(ring) + sizeof(RingBufferHeader);
+        return reinterpret_cast<RingSlotHeader*>(base + (index & (ring->slot_count - 1)) * ring->slot_stride);
+    }
+
+    // 生産者側：満杯の場合はfalseを返す（ブロックしない）
+    static bool push(RingBufferHeader* ring, const double* src, size_t elements, long step) {
+        if (elements > ring->slot_elements) {
+            cerr << "配列がリングバッファのスロットより大きいです: " << elements << " > " << ring->slot_elements << endl;
+            return false;
+        }
+
+        uint64_t head = ring->head.load(std::memory_order_relaxed);
+        uint64_t tail = ring->tail.load(std::memory_order_acquire);
+        if (head - tail >= ring->slot_count) {
+            return false;
+        }
+
+        RingSlotHeader* slot = slot_at(ring, head);
+        shm_gather_f64(reinterpret_cast<double*>(slot + 1), src, elements, step);
+        slot->elements = elements;
+
+        ring->head.store(head + 1, std::memory_order_release);
+        return true;
+    }
+
+    // 消費者側：先頭スロットを返す。空の場合はNULL（ブロックしない）
+    static RingSlotHeader* front(RingBufferHeader* ring) {
+        uint64_t tail = ring->tail.load(std::memory_order_relaxed);
+        uint64_t head = ring->head.load(std::memory_order_acquire);
+        if (tail == head) {
+            return NULL;
+        }
+        return slot_at(ring, tail);
+    }
+
+    // 消費者側：先頭スロットを返却する
+    static void consume(RingBufferHeader* ring) {
+        uint64_t tail = ring->tail.load(std::memory_order_relaxed);
+        ring->tail.store(tail + 1, std::memory_order_release);
+    }
+};
+
+// 外部から呼び出される関数：リングバッファを作成する
+bool ring_create(const char* name, long slot_elements, long slot_count) {
+    if (slot_elements <= 0 || slot_count <= 0) {
+        cerr << "リングバッファのサイズが不正です" << endl;
+        return false;
+    }
+    return RingBuffer::create(string("/") + name, slot_elements, slot_count) != NULL;
+}
+
+// 外部から呼び出される関数：リングバッファに配列を追加する
+bool ring_push(const char* name, const double* src, size_t elements, long step) {
+    RingBufferHeader* ring = RingBuffer::attach(string("/") + name);
+    if (!ring) {
+        return false;
+    }
+    return RingBuffer::push(ring, src, elements, step);
+}
+
+// 外部から呼び出される関数：リングバッファの先頭スロットを参照する
+const double* ring_front(const char* name, size_t* elements) {
+    RingBufferHeader* ring = RingBuffer::attach(string("/") + name);
+    if (!ring) {
+        return NULL;
+    }
+    RingSlotHeader* slot = RingBuffer::front(ring);
+    if (!slot) {
+        return NULL;
+    }
+    *elements = slot->elements;
+    return reinterpret_cast<const double*>(slot + 1);
+}
+
+// 外部から呼び出される関数：先頭スロットを返却する
+void ring_consume(const char* name) {
+    RingBufferHeader* ring = RingBuffer::attach(string("/") + name);
+    if (ring) {
+        RingBuffer::consume(ring);
+    }
+}
+
+// セグメントヘッダーを初期化する（新しく作成した場合はマッピング方法も記録する）
+// アリーナのロックを取れない場合はfalse
+static bool init_segment_header(int slot) {
+    SegmentHeader* header = static_cast<SegmentHeader*>(SharedMemoryManager::get_address(slot));
+    if (!shm_segment_valid(header)) {
+        shm_segment_init(header, SharedMemoryManager::get_size(slot));
+        SharedMemoryManager::init_mapping(slot);
+    }
+    return shm_grow_segment_size(header, SharedMemoryManager::get_size(slot));
+}
+
+// 外部から呼び出される関数：セグメントを作成または開き、ヘッダーを初期化する
+int shm_open_segment(const char* segment, size_t data_bytes) {
+    string shm_name = string("/") + segment;
+    int slot = SharedMemoryManager::create_or_open(shm_name, shm_segment_size_for(data_bytes));
+    if (slot < 0 || !init_segment_header(slot)) {
+        return -1;
+    }
+    return slot;
+}
+
+// 書き込み用にセグメントを作成または開き、ヘッダーを初期化する
+static SegmentHeader* open_segment_for_write(const char* segment, size_t data_bytes, int* slot_out) {
+    // 共有メモリを作成または開く
+    string shm_name = string("/") + segment;
+    int slot = SharedMemoryManager::create_or_open(shm_name, shm_segment_size_for(data_bytes));
+    if (slot < 0) {
+        return NULL;
+    }
+
+    // 他プロセスがセグメントを拡張していればマッピングを追従させる
+    SegmentHeader* header = static_cast<SegmentHeader*>(SharedMemoryManager::get_address(slot));
+    if (shm_segment_valid(header)) {
+        if (!SharedMemoryManager::refresh(slot, header->segment_size)) {
+            return NULL;
+        }
+        header = static_cast<SegmentHeader*>(SharedMemoryManager::get_address(slot));
+    }
+
+    if (!init_segment_header(slot)) {
+        return NULL;
+    }
+    *slot_out = slot;
+    return header;
+}
+
+// エントリを確保してペイロード領域を予約する
+// 容量不足の場合は reserve_bytes 以上の空きができるようセグメントを拡張する（*header が移動しうる）
+static SegmentEntry* reserve_entry(const char* segment, int slot, SegmentHeader** header,
+                                   const char* key, uint32_t dtype, size_t data_size, size_t reserve_bytes) {
+    SegmentEntry* entry = shm_find_or_insert_entry(*header, key, dtype);
+    if (!entry) {
+        cerr << "エントリを確保できません（表が満杯か名前が長すぎるか、ロックを取得できません）: " << key << endl;
+        return NULL;
+    }
+    if (entry->dtype != dtype) {
+        cerr << "データ型が一致しません: " << key << " (期待値: " << shm_dtype_name(dtype)
+             << ", 実際: " << shm_dtype_name(entry->dtype) << ")" << endl;
+        return NULL;
+    }
+    bool locked = true;
+    if (!shm_reserve_payload(*header, entry, data_size, &locked)) {
+        if (!locked) {
+            return NULL;
+        }
+        // 容量不足の場合はセグメントを拡張してから再確保する（マッピングが移動しうる）
+        uint64_t required = shm_align((*header)->data_end) + max<uint64_t>(shm_block_size(data_size), reserve_bytes);
+        if (!SharedMemoryManager::grow(slot, required)) {
+            return NULL;
+        }
+        *header = static_cast<SegmentHeader*>(SharedMemoryManager::get_address(slot));
+        if (!shm_grow_segment_size(*header, SharedMemoryManager::get_size(slot))) {
+            return NULL;
+        }
+        entry = shm_find_entry(*header, key);
+        if (!entry || !shm_reserve_payload(*header, entry, data_size)) {
+            cerr << "共有メモリの容量が不足しています: " << segment << " (必要: " << data_size << " バイト)" << endl;
+            return NULL;
+        }
+    }
+    return entry;
+}
+
+// 処理中の非同期書き込みのうち、指定したエントリへのものが公開されるまで待つ（AsyncWriter を参照）
+static void wait_async_writes(const char* segment, const ShmBatchItem* items, size_t count);
+static bool begin_write_batch(const char* segment, const ShmBatchItem* items, size_t count, ShmEntryRef* refs);
+
+// 外部から呼び出される関数：セグメント内の名前付きエントリに書き込む領域を確保する
+bool shm_begin_write(const char* segment, const char* key, uint32_t dtype, size_t elements, ShmEntryRef* ref) {
+    ShmBatchItem item = { key, dtype, elements };
+    return shm_begin_write_batch(segment, &item, 1, ref);
+}
+
+// 外部から呼び出される関数：書き込んだエントリを公開し、待機中の読み込み側に通知する
+void shm_end_write(const ShmEntryRef& ref, size_t elements) {
+    ShmBatchItem item = { ref.entry->name, ref.entry->dtype, elements };
+    shm_end_write_batch(&ref, &item, 1);
+}
+
+// 外部から呼び出される関数：複数のエントリに書き込む領域をまとめて確保する
+// 同じエントリへの非同期書き込みが処理中であれば、その公開を待ってから確保する
+// （バックグラウンドのコピー中にペイロードが付け替えられて解放されるのを防ぐ）
+bool shm_begin_write_batch(const char* segment, const ShmBatchItem* items, size_t count, ShmEntryRef* refs) {
+    wait_async_writes(segment, items, count);
+    return begin_write_batch(segment, items, count, refs);
+}
+
+static bool begin_write_batch(const char* segment, const ShmBatchItem* items, size_t count, ShmEntryRef* refs) {
+    uint64_t start_ns = shm_now_ns();
+
+    // 拡張を1回で済ませるため、ペイロードの合計を先に求める
+    size_t total_bytes = 0;
+    for (size_t i = 0; i < count; i++) {
+        for (size_t k = 0; k < i; k++) {
+            if (strncmp(items[i].key, items[k].key, SHM_NAME_LEN) == 0) {
+                cerr << "同じエントリが複数回指定されています: " << items[i].key << endl;
+                return false;
+            }
+        }
+        total_bytes += shm_block_size(items[i].elements * shm_dtype_size(items[i].dtype));
+    }
+
+    int slot;
+    SegmentHeader* header = open_segment_for_write(segment, total_bytes, &slot);
+    if (!header) {
+        return false;
+    }
+
+    size_t remaining = total_bytes;
+    for (size_t i = 0; i < count; i++) {
+        size_t data_size = items[i].elements * shm_dtype_size(items[i].dtype);
+        if (!reserve_entry(segment, slot, &header, items[i].key, items[i].dtype, data_size, remaining)) {
+            return false;
+        }
+        remaining -= shm_block_size(data_size);
+    }
+
+    // 途中でマッピングが移動している場合があるため、最終的なヘッダーからエントリを引き直す
+    uint64_t ready_ns = shm_now_ns();
+    for (size_t i = 0; i < count; i++) {
+        refs[i].slot = slot;
+        refs[i].header = header;
+        refs[i].entry = shm_find_entry(header, items[i].key);
+        refs[i].start_ns = start_ns;
+        refs[i].ready_ns = ready_ns;
+        refs[i].wait_ns = 0;
+    }
+    return true;
+}
+
+// 外部から呼び出される関数：まとめて書き込んだエントリを公開し、1回だけ通知する
+void shm_end_write_batch(const ShmEntryRef* refs, const ShmBatchItem* items, size_t count) {
+    if (count == 0) {
+        return;
+    }
+    SegmentHeader* header = refs[0].header;
+    uint64_t bytes = 0;
+    for (size_t i = 0; i < count; i++) {
+        SegmentEntry* entry = refs[i].entry;
+        entry->ndim = 1;
+        entry->shape[0] = items[i].elements;
+        entry->nbytes = items[i].elements * shm_dtype_size(entry->dtype);
+        bytes += entry->nbytes;
+    }
+    // データのコピーが世代番号より先に見えるようにする
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+    for (size_t i = 0; i < count; i++) {
+        refs[i].entry->generation++;
+        SHM_LOG(SHM_LOG_DEBUG, "write " << refs[i].entry->name << ": " << items[i].elements << " x "
+                << shm_dtype_name(refs[i].entry->dtype) << " (generation " << refs[i].entry->generation << ")");
+    }
+    // 非同期書き込みのスレッドからも更新されるため、セグメント全体の世代番号は不可分に進める
+    __atomic_fetch_add(&header->generation, 1, __ATOMIC_RELAXED);
+
+    uint64_t end_ns = shm_now_ns();
+    shm_stats_record(shm_stats(header, SHM_STATS_FREEFEM), true, bytes,
+                     0, end_ns - refs[0].ready_ns, end_ns - refs[0].start_ns);
+
+    shm_notify(header);
+}
+
+// 外部から呼び出される関数：エントリが一度でも書き込まれるまで待機してから参照する
+bool shm_acquire_entry(const char* segment, const char* key, ShmEntryRef* ref, double timeout) {
+    return shm_acquire_batch(segment, &key, 1, ref, timeout);
+}
+
+// 外部から呼び出される関数：複数のエントリがすべて書き込まれるまで待機してから参照する
+bool shm_acquire_batch(const char* segment, const char* const* keys, size_t count, ShmEntryRef* refs,
+                       double timeout) {
+    uint64_t start_ns = shm_now_ns();
+    string shm_name = string("/") + segment;
+
+    // データ領域まで含めてセグメント全体をマッピングする
+    int slot = SharedMemoryManager::open_whole(shm_name);
+    if (slot < 0) {
+        return false;
+    }
+
+    SegmentHeader* header = static_cast<SegmentHeader*>(SharedMemoryManager::get_address(slot));
+    if (!shm_segment_valid(header)) {
+        cerr << "共有メモリのフォーマットが不正です: " << segment << endl;
+        return false;
+    }
+
+    // すべてのエントリが書き込まれるまで待機する（既に書き込み済みならすぐに戻る）
+    // 確認済みのエントリは数え直さないため、起床のたびに調べるのは未着のエントリだけ
+    size_t arrived = 0;
+    uint64_t wait_start_ns = shm_now_ns();
+    bool ready = shm_wait_until(header, [&]() {
+        while (arrived < count) {
+            const SegmentEntry* found = shm_find_entry(header, keys[arrived]);
+            if (!found || __atomic_load_n(&found->generation, __ATOMIC_ACQUIRE) == 0) {
+                return false;
+            }
+            arrived++;
+        }
+        return true;
+    }, timeout);
+    uint64_t wait_ns = shm_now_ns() - wait_start_ns;
+    if (!ready) {
+        cerr << "データの待機中にタイムアウトしました: " << segment << "/" << keys[arrived] << endl;
+        return false;
+    }
+    
+    // 書き込み側がセグメントを拡張していれば遅延して再マッピングする
+    if (!SharedMemoryManager::refresh(slot, header->segment_size)) {
+        return false;
+    }
+    header = static_cast<SegmentHeader*>(SharedMemoryManager::get_address(slot));
+
+    // エントリの確認（データ型は呼び出し側で確認する）
+    uint64_t ready_ns = shm_now_ns();
+    for (size_t i = 0; i < count; i++) {
+        SegmentEntry* entry = shm_find_entry(header, keys[i]);
+        const char* error = NULL;
+        if (!entry) {
+            error = "エントリが見つかりません";
+        } else if (entry->offset + entry->nbytes > SharedMemoryManager::get_size(slot)) {
+            error = "エントリが共有メモリの範囲外です";
+        }
+        if (error) {
+            cerr << error << ": " << keys[i] << endl;
+            return false;
+        }
+
+        refs[i].slot = slot;
+        refs[i].header = header;
+        refs[i].entry = entry;
+        refs[i].start_ns = start_ns;
+        refs[i].ready_ns = ready_ns;
+        refs[i].wait_ns = wait_ns;
+        SHM_LOG(SHM_LOG_DEBUG, "read " << segment << "/" << keys[i] << ": " << shm_entry_elements(refs[i]) << " x "
+                << shm_dtype_name(entry->dtype) << " (generation " << entry->generation << ")");
+    }
+    return true;
+}
+
+// 外部から呼び出される関数：読み込みを終え、転送統計に記録する
+void shm_end_read(const ShmEntryRef& ref, size_t bytes) {
+    uint64_t end_ns = shm_now_ns();
+    shm_stats_record(shm_stats(ref.header, SHM_STATS_FREEFEM), false, bytes,
+                     ref.wait_ns, end_ns - ref.ready_ns, end_ns - ref.start_ns);
+}
+
+// 外部から呼び出される関数：旧APIの変数名を格納先のセグメント名に解決する
+string shm_resolve_segment(const char* name) {
+    const char* session = getenv("FF_SHM_NAME");
+    if (session && *session) {
+        return string(session);
+    }
+    return string(name);
+}
+
+// 外部から呼び出される関数：エントリを参照中にする
+void shm_pin_entry(const ShmEntryRef& ref) {
+    SharedMemoryManager::pin(ref.slot);
+}
+
+// 外部から呼び出される関数：ビューの参照を1つ解放する
+bool shm_unpin_segment(const char* segment) {
+    int slot = SharedMemoryManager::find(string("/") + segment);
+    if (slot < 0) {
+        return false;
+    }
+    SharedMemoryManager::unpin(slot);
+    return true;
+}
+
+// 外部から呼び出される関数：セグメントをアンマップして削除する
+bool shm_destroy_segment(const char* segment) {
+    string shm_name = string("/") + segment;
+    int slot = SharedMemoryManager::find(shm_name);
+    if (slot >= 0) {
+        SharedMemoryManager::close(slot);
+    }
+    SharedMemoryManager::retire(shm_name);
+    if (shm_unlink(shm_name.c_str()) < 0) {
+        cerr << "共有メモリの削除に失敗: " << segment << ", エラー: " << strerror(errno) << endl;
+        return false;
+    }
+    SHM_LOG(SHM_LOG_INFO, "unlink " << shm_name);
+    return true;
+}
+
+// 通知シーケンスを参照するためにセグメントを開く
+static SegmentHeader* open_segment_header(const char* segment, int* slot_out = NULL) {
+    string shm_name = string("/") + segment;
+    int slot = SharedMemoryManager::open_whole(shm_name);
+    if (slot < 0) {
+        return NULL;
+    }
+    if (slot_out) {
+        *slot_out = slot;
+    }
+    SegmentHeader* header = static_cast<SegmentHeader*>(SharedMemoryManager::get_address(slot));
+    if (!shm_segment_valid(header)) {
+        cerr << "共有メモリのフォーマットが不正です: " << segment << endl;
+        return NULL;
+    }
+    // キャッシュ済みのマッピングは他プロセスの拡張に追従していない場合がある
+    // （拡張されていなければサイズを比べるだけで、システムコールは発行しない）
+    if (!SharedMemoryManager::refresh(slot, header->segment_size)) {
+        return NULL;
+    }
+    return static_cast<SegmentHeader*>(SharedMemoryManager::get_address(slot));
+}
+
+// 外部から呼び出される関数：セグメントの通知シーケンスを取得する
+long segment_sequence(const char* segment) {
+    SegmentHeader* header = open_segment_header(segment);
+    return header ? static_cast<long>(shm_load_seq(header)) : -1L;
+}
+
+// 外部から呼び出される関数：通知シーケンスがseenから変わるまで待機する
+long wait_segment_update(const char* segment, long seen) {
+    SegmentHeader* header = open_segment_header(segment);
+    if (!header) {
+        return -1L;
+    }
+    long seq = shm_wait_for_update(header, static_cast<uint32_t>(seen));
+    if (seq < 0) {
+        cerr << "更新の待機中にタイムアウトしました: " << segment << endl;
+    }
+    return seq;
+}
+
+// 外部から呼び出される関数：エントリを削除し、領域を再利用できるようにする
+bool shm_delete_variable(const char* segment, const char* key) {
+    ShmBatchItem item = { key, SHM_DTYPE_FLOAT64, 0 };
+    wait_async_writes(segment, &item, 1);
+    int slot;
+    SegmentHeader* header = open_segment_header(segment, &slot);
+    if (!header) {
+        return false;
+    }
+    SegmentEntry* entry = shm_find_entry(header, key);
+    if (!entry) {
+        cerr << "変数が見つかりません: " << segment << "/" << key << endl;
+        return false;
+    }
+    // 空きリストへの連結はブロックの先頭に書き込むため、ヘッダーを読んだ後に他プロセスが
+    // 拡張して割り当てたブロックであれば、マッピングを追従させてから削除する
+    if (entry->offset + entry->capacity > SharedMemoryManager::get_size(slot)) {
+        if (!SharedMemoryManager::refresh(slot, header->segment_size)) {
+            return false;
+        }
+        header = static_cast<SegmentHeader*>(SharedMemoryManager::get_address(slot));
+    }
+    if (!shm_delete_entry(header, key)) {
+        return false;
+    }
+    __atomic_fetch_add(&header->generation, 1, __ATOMIC_RELAXED);
+    SHM_LOG(SHM_LOG_DEBUG, "delete " << key);
+    shm_notify(header);
+    return true;
+}
+
+// 1つの記録元の統計を出力する
+static void dump_side_stats(ostream& out, const char* label, const SegmentStats* stats) {
+    out << "  " << label << ": write " << stats->write_calls << " calls / " << stats->bytes_written << " bytes"
+        << ", read " << stats->read_calls << " calls / " << stats->bytes_read << " bytes\n"
+        << "    wait " << stats->wait_ns / 1000 << " us, copy " << stats->copy_ns / 1000 << " us"
+        << ", latency min " << stats->latency_min_ns << " ns, max " << stats->latency_max_ns << " ns"
+        << ", p99 <= " << shm_stats_percentile(stats, 0.99) << " ns\n";
+}
+
+// 外部から呼び出される関数：セグメントの転送統計を出力する
+bool shm_dump_stats(const char* segment, ostream& out) {
+    SegmentHeader* header = open_segment_header(segment);
+    if (!header) {
+        return false;
+    }
+    out << "shm stats: " << segment << "\n";
+    dump_side_stats(out, "freefem", shm_stats(header, SHM_STATS_FREEFEM));
+    dump_side_stats(out, "python", shm_stats(header, SHM_STATS_PYTHON));
+    out.flush();
+    return true;
+}
+
+// 未処理のコマンドがあるか（エントリ表だけを参照する）
+static bool worker_command_pending(SegmentHeader* header) {
+    const SegmentEntry* command = shm_find_entry(header, SHM_WORKER_COMMAND_KEY);
+    if (!command) {
+        return false;
+    }
+    const SegmentEntry* result = shm_find_entry(header, SHM_WORKER_RESULT_KEY);
+    uint64_t done = result ? __atomic_load_n(&result->generation, __ATOMIC_ACQUIRE) : 0;
+    return __atomic_load_n(&command->generation, __ATOMIC_ACQUIRE) > done;
+}
+
+// 書き込み済みのコマンドを読み込む（[コマンドID, 操作]）
+static bool read_worker_command(const char* segment, int64_t* id, int64_t* op) {
+    ShmEntryRef ref;
+    if (!shm_acquire_entry(segment, SHM_WORKER_COMMAND_KEY, &ref, 0.0)) {
+        return false;
+    }
+    if (ref.entry->dtype != SHM_DTYPE_INT64 || shm_entry_elements(ref) < 2) {
+        cerr << "コマンドの形式が不正です: " << segment << "/" << SHM_WORKER_COMMAND_KEY << endl;
+        return false;
+    }
+    const int64_t* values = static_cast<const int64_t*>(shm_entry_data(ref));
+    *id = values[0];
+    *op = values[1];
+    shm_end_read(ref, 2 * sizeof(int64_t));
+    return true;
+}
+
+// 外部から呼び出される関数：常駐ワーカーへの次のコマンドを待機する
+long shm_wait_command(const char* segment) {
+    // 起動時の親プロセス（Python側のランナー）が終了したら待機をやめる
+    static const pid_t parent = getppid();
+
+    SegmentHeader* header = open_segment_header(segment);
+    if (!header) {
+        return -1L;
+    }
+    while (!shm_wait_until(header, [&]() { return worker_command_pending(header); })) {
+        if (getppid() != parent) {
+            cerr << "親プロセスが終了したため、コマンドの待機を中止します: " << segment << endl;
+            return -1L;
+        }
+    }
+
+    int64_t id, op;
+    if (!read_worker_command(segment, &id, &op)) {
+        return -1L;
+    }
+    SHM_LOG(SHM_LOG_INFO, "command " << id << " (op " << op << ") on " << segment);
+    if (op == SHM_WORKER_STOP) {
+        return 0L;
+    }
+    if (op != SHM_WORKER_RUN || id <= 0) {
+        cerr << "不明なコマンドです: " << segment << " (ID: " << id << ", 操作: " << op << ")" << endl;
+        return -1L;
+    }
+    return static_cast<long>(id);
+}
+
+// 外部から呼び出される関数：処理中のコマンドの結果を書き込む
+bool shm_post_result(const char* segment, long status) {
+    SegmentHeader* header = open_segment_header(segment);
+    if (!header) {
+        return false;
+    }
+    if (!worker_command_pending(header)) {
+        cerr << "結果を返すコマンドがありません: " << segment << endl;
+        return false;
+    }
+
+    int64_t id, op;
+    if (!read_worker_command(segment, &id, &op)) {
+        return false;
+    }
+
+    ShmEntryRef ref;
+    if (!shm_begin_write(segment, SHM_WORKER_RESULT_KEY, SHM_DTYPE_INT64, 2, &ref)) {
+        return false;
+    }
+    int64_t* values = static_cast<int64_t*>(shm_entry_data(ref));
+    values[0] = id;
+    values[1] = status;
+    shm_end_write(ref, 2);
+    return true;
+}
+
+// 制御用エントリの4語（[面数, 公開済み, 読み込み中, 読み終えた]）
+static int64_t* channel_words(SegmentHeader* header, const SegmentEntry* control) {
+    return static_cast<int64_t*>(shm_payload(header, control));
+}
+
+static string channel_buffer_name(const char* key, uint64_t index) {
+    return string(key) + "." + to_string(index);
+}
+
+// チャネルの制御用エントリを開く
+static SegmentEntry* open_channel(const char* segment, const char* key, SegmentHeader** header) {
+    *header = open_segment_header(segment);
+    if (!*header) {
+        return NULL;
+    }
+    SegmentEntry* control = shm_find_entry(*header, key);
+    if (!control || control->generation == 0 || control->dtype != SHM_DTYPE_INT64
+        || control->nbytes < SHM_CHANNEL_WORDS * sizeof(int64_t)) {
+        cerr << "多重バッファのチャネルではありません: " << segment << "/" << key << endl;
+        return NULL;
+    }
+    int64_t buffers = channel_words(*header, control)[SHM_CHANNEL_BUFFERS];
+    if (buffers < 2 || buffers > SHM_CHANNEL_MAX_BUFFERS) {
+        cerr << "チャネルの面数が不正です: " << segment << "/" << key << " (" << buffers << ")" << endl;
+        return NULL;
+    }
+    return control;
+}
+
+// 外部から呼び出される関数：多重バッファのチャネルを作成する
+bool shm_channel_create(const char* segment, const char* key, long buffers) {
+    if (buffers < 2 || buffers > SHM_CHANNEL_MAX_BUFFERS) {
+        cerr << "チャネルの面数は2から" << SHM_CHANNEL_MAX_BUFFERS << "である必要があります: " << buffers << endl;
+        return false;
+    }
+    if (strlen(key) + 3 > SHM_NAME_LEN) {
+        cerr << "チャネル名が長すぎます: " << key << endl;
+        return false;
+    }
+
+    int slot = shm_open_segment(segment, 0);
+    if (slot < 0) {
+        return false;
+    }
+    SegmentHeader* header = static_cast<SegmentHeader*>(SharedMemoryManager::get_address(slot));
+    SegmentEntry* control = shm_find_entry(header, key);
+    if (control && control->generation > 0) {
+        if (control->dtype == SHM_DTYPE_INT64 && control->nbytes >= SHM_CHANNEL_WORDS * sizeof(int64_t)
+            && channel_words(header, control)[SHM_CHANNEL_BUFFERS] == buffers) {
+            return true;
+        }
+        cerr << "既存のチャネルと構成が一致しません: " << segment << "/" << key << endl;
+        return false;
+    }
+
+    ShmEntryRef ref;
+    if (!shm_begin_write(segment, key, SHM_DTYPE_INT64, SHM_CHANNEL_WORDS, &ref)) {
+        return false;
+    }
+    int64_t* words = static_cast<int64_t*>(shm_entry_data(ref));
+    memset(words, 0, SHM_CHANNEL_WORDS * sizeof(int64_t));
+    words[SHM_CHANNEL_BUFFERS] = buffers;
+    shm_end_write(ref, SHM_CHANNEL_WORDS);
+    SHM_LOG(SHM_LOG_INFO, "channel " << segment << "/" << key << " (" << buffers << " buffers)");
+    return true;
+}
+
+// 外部から呼び出される関数：次のフレームを書き込むバッファを確保する
+bool shm_channel_begin_write(const char* segment, const char* key, uint32_t dtype, size_t elements,
+                             ShmChannelRef* ref, double timeout) {
+    uint64_t start_ns = shm_now_ns();
+    SegmentHeader* header;
+    SegmentEntry* control = open_channel(segment, key, &header);
+    if (!control) {
+        return false;
+    }
+    int64_t* words = channel_words(header, control);
+    uint64_t buffers = static_cast<uint64_t>(words[SHM_CHANNEL_BUFFERS]);
+    uint64_t frame = static_cast<uint64_t>(__atomic_load_n(&words[SHM_CHANNEL_PUBLISHED], __ATOMIC_RELAXED)) + 1;
+    uint64_t index = frame % buffers;
+
+    // 前回の公開済みフレーム数のストアを、読み込み中のフレームのロードより先に見せる
+    // （shm_channel_acquire() の読み込み中のフレームのストアと再確認の組と対になる）
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+    uint64_t wait_start_ns = shm_now_ns();
+    bool available = shm_wait_until(header, [&]() {
+        int64_t held = __atomic_load_n(&words[SHM_CHANNEL_ACQUIRED], __ATOMIC_ACQUIRE);
+        return held == 0 || static_cast<uint64_t>(held) % buffers != index;
+    }, timeout);
+    if (!available) {
+        cerr << "読み込み側がバッファを返却しないため書き込めません: " << segment << "/" << key << endl;
+        return false;
+    }
+    uint64_t wait_ns = shm_now_ns() - wait_start_ns;
+
+    if (!shm_begin_write(segment, channel_buffer_name(key, index).c_str(), dtype, elements, &ref->buffer)) {
+        return false;
+    }
+    // バッファの確保でセグメントが拡張された場合に備えて探し直す
+    ref->control = shm_find_entry(ref->buffer.header, key);
+    ref->frame = frame;
+    ref->buffer.start_ns = start_ns;
+    ref->buffer.wait_ns = wait_ns;
+    return true;
+}
+
+// 外部から呼び出される関数：書き込んだバッファをフレームとして公開する
+void shm_channel_end_write(const ShmChannelRef& ref, size_t elements) {
+    shm_end_write(ref.buffer, elements);
+    int64_t* words = channel_words(ref.buffer.header, ref.control);
+    __atomic_store_n(&words[SHM_CHANNEL_PUBLISHED], static_cast<int64_t>(ref.frame), __ATOMIC_RELEASE);
+    shm_notify(ref.buffer.header);
+}
+
+// 外部から呼び出される関数：最新のフレームのバッファを参照する
+bool shm_channel_acquire(const char* segment, const char* key, ShmChannelRef* ref, double timeout) {
+    uint64_t start_ns = shm_now_ns();
+    SegmentHeader* header;
+    SegmentEntry* control = open_channel(segment, key, &header);
+    if (!control) {
+        return false;
+    }
+    int64_t* words = channel_words(header, control);
+    uint64_t buffers = static_cast<uint64_t>(words[SHM_CHANNEL_BUFFERS]);
+
+    uint64_t wait_start_ns = shm_now_ns();
+    bool ready = shm_wait_until(header, [&]() {
+        return __atomic_load_n(&words[SHM_CHANNEL_PUBLISHED], __ATOMIC_ACQUIRE)
+            > __atomic_load_n(&words[SHM_CHANNEL_CONSUMED], __ATOMIC_RELAXED);
+    }, timeout);
+    if (!ready) {
+        cerr << "フレームの待機中にタイムアウトしました: " << segment << "/" << key << endl;
+        return false;
+    }
+    uint64_t wait_ns = shm_now_ns() - wait_start_ns;
+
+    // 読み込み中のフレームを宣言してから公開済みフレーム数を再確認する。書き込み側が
+    // 同じバッファへの書き込みを始めうるほど進んでいれば、より新しいフレームで宣言し直す
+    uint64_t frame;
+    for (;;) {
+        frame = static_cast<uint64_t>(__atomic_load_n(&words[SHM_CHANNEL_PUBLISHED], __ATOMIC_ACQUIRE));
+        __atomic_store_n(&words[SHM_CHANNEL_ACQUIRED], static_cast<int64_t>(frame), __ATOMIC_RELAXED);
+        __atomic_thread_fence(__ATOMIC_SEQ_CST);
+        uint64_t published = static_cast<uint64_t>(__atomic_load_n(&words[SHM_CHANNEL_PUBLISHED], __ATOMIC_ACQUIRE));
+        if (published < frame + buffers - 1) {
+            break;
+        }
+    }
+
+    if (!shm_acquire_entry(segment, channel_buffer_name(key, frame % buffers).c_str(), &ref->buffer, 0.0)) {
+        // shm_acquire_entry() がマッピングを移動させている場合があるため、制御用のエントリを探し直す
+        control = open_channel(segment, key, &header);
+        if (control) {
+            __atomic_store_n(&channel_words(header, control)[SHM_CHANNEL_ACQUIRED], 0, __ATOMIC_RELEASE);
+        }
+        return false;
+    }
+    ref->control = shm_find_entry(ref->buffer.header, key);
+    ref->frame = frame;
+    ref->buffer.start_ns = start_ns;
+    ref->buffer.wait_ns += wait_ns;
+    return true;
+}
+
+// 外部から呼び出される関数：参照したバッファを返却する
+void shm_channel_release(const ShmChannelRef& ref, size_t bytes) {
+    shm_end_read(ref.buffer, bytes);
+    int64_t* words = channel_words(ref.buffer.header, ref.control);
+    __atomic_store_n(&words[SHM_CHANNEL_CONSUMED], static_cast<int64_t>(ref.frame), __ATOMIC_RELAXED);
+    // データのコピーを終えてから返却する
+    __atomic_store_n(&words[SHM_CHANNEL_ACQUIRED], 0, __ATOMIC_RELEASE);
+    shm_notify(ref.buffer.header);
+}
+
+// 非同期書き込み
+// コピー元は投入時にジョブ専用のバッファへ詰めてコピーするため、呼び出し側は戻った直後から
+// 配列を変更・解放してよい。書き込み先の確保（begin_write_batch）と完了の待機は呼び出し側の
+// スレッドで行い、バックグラウンドの1スレッドはペイロードへのコピーと公開（shm_end_write）だけを行う。
+// 公開されるまでは、このプロセスからの同じエントリへの書き込み・削除を待たせる。
+// SharedMemoryManager はスレッドセーフではないため、バックグラウンド側はジョブごとに
+// 同じ共有メモリを別にマッピングして使う。呼び出し側のマッピングが拡張・移動しても影響しない。
+class AsyncWriter {
+private:
+    struct Job {
+        string segment;
+        string key;
+        ShmEntryRef ref;           // ジョブ専用のマッピング上のエントリ
+        size_t mapped_size;
+        vector<double> data;       // 投入時に詰めてコピーした配列
+        bool done;
+    };
+
+    std::mutex mutex;
+    std::condition_variable work_ready;
+    std::condition_variable work_done;
+    deque<Job*> queue;
+    map<long, Job*> jobs;          // ハンドルから未回収のジョブへの対応
+    long next_handle;
+    bool stopping;
+    std::thread worker;
+
+    void run() {
+        std::unique_lock<std::mutex> lock(mutex);
+        for (;;) {
+            work_ready.wait(lock, [this]() { return stopping || !queue.empty(); });
+            if (queue.empty()) {
+                return;
+            }
+            Job* job = queue.front();
+            queue.pop_front();
+            lock.unlock();
+
+            size_t elements = job->data.size();
+            if (elements > 0) {
+                memcpy(shm_entry_data(job->ref), &job->data[0], elements * sizeof(double));
+            }
+            shm_end_write(job->ref, elements);
+            munmap(job->ref.header, job->mapped_size);
+            vector<double>().swap(job->data);
+
+            lock.lock();
+            job->done = true;
+            work_done.notify_all();
+        }
+    }
+
+    // 同じエントリへの未公開のジョブがあるかどうか（ロックを保持して呼ぶ）
+    bool pending(const char* segment, const char* key) const {
+        for (map<long, Job*>::const_iterator it = jobs.begin(); it != jobs.end(); ++it) {
+            const Job* job = it->second;
+            if (!job->done && job->segment == segment && strncmp(job->key.c_str(), key, SHM_NAME_LEN) == 0) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    // 同じエントリへの書き込みが処理中であれば公開されるまで待つ（ロックを保持して呼ぶ）
+    // 待機中に wait() がジョブを解放しうるため、起床のたびに探し直す
+    void wait_same_entry(std::unique_lock<std::mutex>& lock, const char* segment, const char* key) {
+        work_done.wait(lock, [this, segment, key]() { return !pending(segment, key); });
+    }
+
+public:
+    AsyncWriter() : next_handle(1), stopping(false) {}
+
+    // 終了時は未処理の書き込みをすべて終えてからスレッドを止める
+    ~AsyncWriter() {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopping = true;
+        }
+        work_ready.notify_all();
+        if (worker.joinable()) {
+            worker.join();
+        }
+        for (map<long, Job*>::iterator it = jobs.begin(); it != jobs.end(); ++it) {
+            delete it->second;
+        }
+    }
+
+    long submit(const char* segment, const char* key, const double* src, size_t elements, long step) {
+        // コピー元はロックの外で詰めてコピーする
+        vector<double> data(elements);
+        if (elements > 0) {
+            shm_gather_f64(&data[0], src, elements, step);
+        }
+
+        std::unique_lock<std::mutex> lock(mutex);
+        wait_same_entry(lock, segment, key);
+
+        ShmEntryRef ref;
+        ShmBatchItem item = { key, SHM_DTYPE_FLOAT64, elements };
+        if (!begin_write_batch(segment, &item, 1, &ref)) {
+            return 0;
+        }
+        size_t size = SharedMemoryManager::get_size(ref.slot);
+        void* addr = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, SharedMemoryManager::get_fd(ref.slot), 0);
+        if (addr == MAP_FAILED) {
+            cerr << "非同期書き込み用のメモリマッピングに失敗: " << segment << ", エラー: " << strerror(errno) << endl;
+            return 0;
+        }
+
+        Job* job = new Job();
+        job->segment = segment;
+        job->key = key;
+        job->ref = ref;
+        job->ref.header = static_cast<SegmentHeader*>(addr);
+        job->ref.entry = reinterpret_cast<SegmentEntry*>(static_cast<char*>(addr)
+                         + (reinterpret_cast<char*>(ref.entry) - reinterpret_cast<char*>(ref.header)));
+        job->mapped_size = size;
+        job->data.swap(data);
+        job->done = false;
+
+        if (!worker.joinable()) {
+            worker = std::thread(&AsyncWriter::run, this);
+        }
+        long handle = next_handle++;
+        jobs[handle] = job;
+        queue.push_back(job);
+        work_ready.notify_one();
+        return handle;
+    }
+
+    bool wait(long handle) {
+        std::unique_lock<std::mutex> lock(mutex);
+        map<long, Job*>::iterator it = jobs.find(handle);
+        if (it == jobs.end()) {
+            cerr << "非同期書き込みのハンドルが不正です（完了済みか存在しません）: " << handle << endl;
+            return false;
+        }
+        Job* job = it->second;
+        work_done.wait(lock, [job]() { return job->done; });
+        jobs.erase(it);
+        delete job;
+        return true;
+    }
+
+    // 指定したエントリへの処理中の書き込みがすべて公開されるまで待つ
+    void wait_entries(const char* segment, const ShmBatchItem* items, size_t count) {
+        std::unique_lock<std::mutex> lock(mutex);
+        if (jobs.empty()) {
+            return;
+        }
+        for (size_t i = 0; i < count; i++) {
+            wait_same_entry(lock, segment, items[i].key);
+        }
+    }
+};
+static AsyncWriter async_writer;
+
+static void wait_async_writes(const char* segment, const ShmBatchItem* items, size_t count) {
+    async_writer.wait_entries(segment, items, count);
+}
+
+// 外部から呼び出される関数：double配列の非同期書き込みを開始する
+long shm_write_async(const char* segment, const char* key, const double* src, size_t elements, long step) {
+    return async_writer.submit(segment, key, src, elements, step);
+}
+
+// 外部から呼び出される関数：非同期書き込みの完了を待つ
+bool shm_wait_async(long handle) {
+    return async_writer.wait(handle);
+}
+
+// ブロックのチェックサム（要素のビット列の重み付き和、Python側の DeltaArray と同一）
+static uint64_t delta_block_checksum(const double* block, size_t n) {
+    uint64_t sum = 0;
+    for (size_t i = 0; i < n; i++) {
+        uint64_t bits;
+        memcpy(&bits, &block[i], sizeof(bits));
+        sum += bits * (SHM_DELTA_CHECKSUM_MULTIPLIER * (2 * i + 1));
+    }
+    return sum;
+}
+
+// 外部から呼び出される関数：double配列を差分転送で書き込む
+long shm_write_delta(const char* segment, const char* key, const double* src, size_t elements, long step,
+                     size_t block_elements) {
+    if (block_elements == 0) {
+        cerr << "ブロックの要素数は1以上である必要があります: " << key << endl;
+        return -1;
+    }
+    if (strlen(key) + strlen(SHM_DELTA_SUFFIX) >= SHM_NAME_LEN) {
+        cerr << "差分転送の変数名が長すぎます: " << key << endl;
+        return -1;
+    }
+
+    string meta_key = string(key) + SHM_DELTA_SUFFIX;
+    size_t blocks = (elements + block_elements - 1) / block_elements;
+    size_t meta_words = SHM_DELTA_WORDS + 2 * blocks;
+    ShmBatchItem items[2] = {
+        { key, SHM_DTYPE_FLOAT64, elements },
+        { meta_key.c_str(), SHM_DTYPE_INT64, meta_words }
+    };
+    ShmEntryRef refs[2];
+    if (!shm_begin_write_batch(segment, items, 2, refs)) {
+        return -1;
+    }
+
+    // 前回の差分転送の後に構成が変わったか、他の書き込みがあった場合は全ブロックを書き込む
+    SegmentEntry* data = refs[0].entry;
+    SegmentEntry* meta = refs[1].entry;
+    int64_t* words = static_cast<int64_t*>(shm_entry_data(refs[1]));
+    int64_t* generations = words + SHM_DELTA_WORDS;
+    uint64_t* checksums = reinterpret_cast<uint64_t*>(generations + blocks);
+    bool full = meta->generation == 0 || meta->nbytes != meta_words * sizeof(int64_t)
+                || data->nbytes != elements * sizeof(double)
+                || words[SHM_DELTA_BLOCK] != static_cast<int64_t>(block_elements)
+                || words[SHM_DELTA_ELEMENTS] != static_cast<int64_t>(elements)
+                || words[SHM_DELTA_GENERATION] != static_cast<int64_t>(data->generation);
+
+    int64_t generation = static_cast<int64_t>(data->generation) + 1;
+    double* dst = static_cast<double*>(shm_entry_data(refs[0]));
+    vector<double> packed(step != 1 ? min(block_elements, elements) : 0);
+    long written = 0;
+    for (size_t b = 0; b < blocks; b++) {
+        size_t first = b * block_elements;
+        size_t n = min(block_elements, elements - first);
+        const double* block = src + first * step;
+        if (step != 1) {
+            shm_gather_f64(&packed[0], block, n, step);
+            block = &packed[0];
+        }
+        uint64_t checksum = delta_block_checksum(block, n);
+        if (full || checksums[b] != checksum) {
+            memcpy(dst + first, block, n * sizeof(double));
+            checksums[b] = checksum;
+            generations[b] = generation;
+            written++;
+        }
+    }
+    words[SHM_DELTA_BLOCK] = static_cast<int64_t>(block_elements);
+    words[SHM_DELTA_ELEMENTS] = static_cast<int64_t>(elements);
+    words[SHM_DELTA_BLOCKS] = static_cast<int64_t>(blocks);
+    words[SHM_DELTA_GENERATION] = generation;
+
+    shm_end_write_batch(refs, items, 2);
+    SHM_LOG(SHM_LOG_DEBUG, "delta " << key << ": " << written << "/" << blocks << " blocks");
+    return written;
+}
+
+// 外部から呼び出される関数：MPIのランクとランク数を取得する
+bool shm_mpi_rank(long* rank, long* ranks) {
+    static const char* const variables[][2] = {
+        { "OMPI_COMM_WORLD_RANK", "OMPI_COMM_WORLD_SIZE" },
+        { "PMI_RANK", "PMI_SIZE" },
+        { "MV2_COMM_WORLD_RANK", "MV2_COMM_WORLD_SIZE" },
+        { "SLURM_PROCID", "SLURM_NTASKS" }
+    };
+    for (size_t i = 0; i < sizeof(variables) / sizeof(variables[0]); i++) {
+        const char* rank_value = getenv(variables[i][0]);
+        const char* ranks_value = getenv(variables[i][1]);
+        if (rank_value && *rank_value && ranks_value && *ranks_value) {
+            *rank = atol(rank_value);
+            *ranks = atol(ranks_value);
+            if (*rank >= 0 && *rank < *ranks) {
+                return true;
+            }
+        }
+    }
+    *rank = 0;
+    *ranks = 1;
+    return false;
+}
+
+// 外部から呼び出される関数：ランク専用のセグメント名を返す
+string shm_rank_segment(const char* segment, long rank) {
+    return string(segment) + SHM_RANK_SEPARATOR + to_string(rank);
+}
+
+// 外部から呼び出される関数：このランクが担当する部分を書き込む
+bool shm_write_partition(const char* segment, const char* key, const double* src, size_t elements, long step,
+                         size_t offset, size_t global_elements) {
+    if (strlen(key) + strlen(SHM_PARTITION_SUFFIX) >= SHM_NAME_LEN) {
+        cerr << "分割配列の変数名が長すぎます: " << key << endl;
+        return false;
+    }
+    if (offset > global_elements || elements > global_elements - offset) {
+        cerr << "分割配列の範囲が大域配列を超えています: " << key << " [" << offset << ", "
+             << offset + elements << ") / " << global_elements << endl;
+        return false;
+    }
+
+    long rank, ranks;
+    shm_mpi_rank(&rank, &ranks);
+    string rank_segment = shm_rank_segment(segment, rank);
+    string part_key = string(key) + SHM_PARTITION_SUFFIX;
+    ShmBatchItem items[2] = {
+        { key, SHM_DTYPE_FLOAT64, elements },
+        { part_key.c_str(), SHM_DTYPE_INT64, SHM_PARTITION_WORDS }
+    };
+    ShmEntryRef refs[2];
+    if (!shm_begin_write_batch(rank_segment.c_str(), items, 2, refs)) {
+        return false;
+    }
+
+    shm_gather_f64(static_cast<double*>(shm_entry_data(refs[0])), src, elements, step);
+    int64_t* words = static_cast<int64_t*>(shm_entry_data(refs[1]));
+    words[SHM_PARTITION_RANK] = rank;
+    words[SHM_PARTITION_RANKS] = ranks;
+    words[SHM_PARTITION_OFFSET] = static_cast<int64_t>(offset);
+    words[SHM_PARTITION_ELEMENTS] = static_cast<int64_t>(elements);
+    words[SHM_PARTITION_GLOBAL] = static_cast<int64_t>(global_elements);
+
+    shm_end_write_batch(refs, items, 2);
+    SHM_LOG(SHM_LOG_DEBUG, "partition " << key << " rank " << rank << "/" << ranks << ": ["
+            << offset << ", " << offset + elements << ")");
+    return true;
+}
@@ -0,0 +1,423 @@
+#ifndef SHM_TRANSPORT_HPP
+#define SHM_TRANSPORT_HPP
+
+// 共有メモリ転送のコアライブラリ。FreeFEMのヘッダーには依存しない。
+//
+// すべての転送は POSIX共有メモリ /dev/shm/<segment> 上の shm_layout.hpp 形式の
+// セグメントに名前付きエントリとして格納する（Python側の SharedMemoryManager と同一）。
+// FreeFEMの演算子（shm_implementation.cpp, legacy_array_ops.cpp）やベンチマークは
+// この層を経由してデータを読み書きする。
+
+#include "shm_layout.hpp"
+#include "shm_sync.hpp"
+
+#include <stddef.h>
+#include <iosfwd>
+#include <string>
+
+// 書き込み・読み込み中のエントリへの参照
+struct ShmEntryRef {
+    int slot;                  // SharedMemoryManagerのスロット番号
+    SegmentHeader* header;     // セグメント先頭（マッピングが移動すると無効になる）
+    SegmentEntry* entry;
+    uint64_t start_ns;         // 転送統計用：呼び出しの開始時刻
+    uint64_t ready_ns;         // 転送統計用：コピーを開始できた時刻
+    uint64_t wait_ns;          // 転送統計用：データの到着待ちに費やした時間
+};
+
+inline void* shm_entry_data(const ShmEntryRef& ref) {
+    return shm_payload(ref.header, ref.entry);
+}
+
+inline size_t shm_entry_elements(const ShmEntryRef& ref) {
+    size_t itemsize = shm_dtype_size(ref.entry->dtype);
+    return itemsize ? ref.entry->nbytes / itemsize : 0;
+}
+
+/**
+ * 旧API（ArrayInfo形式の演算子）の変数名を格納先のセグメント名に解決する
+ * 環境変数 FF_SHM_NAME（Pythonがスクリプト実行時に設定）があればそのセグメント、
+ * 無ければ変数名と同名のセグメントを使用する
+ * @param name 変数名
+ * @return セグメント名
+ */
+std::string shm_resolve_segment(const char* name);
+
+/**
+ * セグメントを作成または開き、ヘッダーを初期化する
+ * @param segment 共有メモリセグメントの名前
+ * @param data_bytes データ領域として最低限確保するバイト数
+ * @return セグメントのスロット番号（同じセグメントには同じ値）、失敗した場合は-1
+ */
+int shm_open_segment(const char* segment, size_t data_bytes);
+
+/**
+ * セグメント内のエントリに書き込む領域を確保する（必要に応じてセグメントを作成・拡張）
+ * 確保した領域にデータを書き込んだ後、shm_end_write()で公開すること
+ * @param segment 共有メモリセグメントの名前
+ * @param key セグメント内のエントリ名
+ * @param dtype エントリのデータ型（既存エントリと一致する必要がある）
+ * @param elements 要素数
+ * @param ref 確保したエントリへの参照
+ * @return 成功した場合はtrue、失敗した場合はfalse
+ */
+bool shm_begin_write(const char* segment, const char* key, uint32_t dtype, size_t elements, ShmEntryRef* ref);
+
+/**
+ * shm_begin_write()で確保したエントリを公開し、待機中の読み込み側に通知する
+ * @param ref 書き込んだエントリへの参照
+ * @param elements 書き込んだ要素数
+ */
+void shm_end_write(const ShmEntryRef& ref, size_t elements);
+
+/**
+ * セグメント内のエントリが一度でも書き込まれるまで待機してから参照する
+ * データ型の確認は呼び出し側で行う
+ * @param segment 共有メモリセグメントの名前
+ * @param key セグメント内のエントリ名
+ * 読み終えたら shm_end_read() を呼ぶこと（転送統計に記録される）
+ * @param ref 見つかったエントリへの参照
+ * @param timeout 待機する最大時間（秒、0の場合は待機しない）
+ * @return 成功した場合はtrue、タイムアウトまたは失敗した場合はfalse
+ */
+bool shm_acquire_entry(const char* segment, const char* key, ShmEntryRef* ref,
+                       double timeout = SHM_WAIT_TIMEOUT_SEC);
+
+/**
+ * shm_acquire_entry()で参照したエントリの読み込みを終え、転送統計に記録する
+ * @param ref 読み込んだエントリへの参照
+ * @param bytes コピーしたバイト数（ゼロコピービューの場合は0）
+ */
+void shm_end_read(const ShmEntryRef& ref, size_t bytes);
+
+// 一括転送する配列の1要素
+struct ShmBatchItem {
+    const char* key;           // セグメント内のエントリ名
+    uint32_t dtype;            // エントリのデータ型
+    size_t elements;           // 要素数
+};
+
+/**
+ * 複数のエントリに書き込む領域をまとめて確保する（セグメントの拡張は多くとも1回）
+ * 確保した領域にデータを書き込んだ後、shm_end_write_batch()でまとめて公開すること
+ * @param segment 共有メモリセグメントの名前
+ * @param items 書き込むエントリ（同じエントリ名を複数含まないこと）
+ * @param count エントリ数
+ * @param refs 確保したエントリへの参照（count要素）
+ * @return 成功した場合はtrue、失敗した場合はfalse
+ */
+bool shm_begin_write_batch(const char* segment, const ShmBatchItem* items, size_t count, ShmEntryRef* refs);
+
+/**
+ * shm_begin_write_batch()で確保したエントリをまとめて公開し、読み込み側に1回だけ通知する
+ * 転送統計には1回の書き込みとして記録される
+ * @param refs 書き込んだエントリへの参照
+ * @param items 書き込んだエントリ（elements は書き込んだ要素数）
+ * @param count エントリ数
+ */
+void shm_end_write_batch(const ShmEntryRef* refs, const ShmBatchItem* items, size_t count);
+
+/**
+ * 複数のエントリがすべて一度でも書き込まれるまで待機してから参照する
+ * 読み終えたら refs[0] について shm_end_read() を合計バイト数で1回だけ呼ぶこと
+ * @param segment 共有メモリセグメントの名前
+ * @param keys セグメント内のエントリ名（count要素）
+ * @param count エントリ数
+ * @param refs 見つかったエントリへの参照（count要素）
+ * @param timeout 待機する最大時間（秒、0の場合は待機しない）
+ * @return 成功した場合はtrue、タイムアウトまたは失敗した場合はfalse
+ */
+bool shm_acquire_batch(const char* segment, const char* const* keys, size_t count, ShmEntryRef* refs,
+                       double timeout = SHM_WAIT_TIMEOUT_SEC);
+
+/**
+ * エントリを参照中にして、ゼロコピービューが有効な間はアンマップされないようにする
+ * @param ref 参照するエントリ
+ */
+void shm_pin_entry(const ShmEntryRef& ref);
+
+/**
+ * shm_pin_entry()による参照を1つ解放する
+ * @param segment 共有メモリセグメントの名前
+ * @return 成功した場合はtrue、失敗した場合はfalse
+ */
+bool shm_unpin_segment(const char* segment);
+
+/**
+ * セグメントをアンマップし、/dev/shm から削除する
+ * @param segment 共有メモリセグメントの名前
+ * @return 成功した場合はtrue、失敗した場合はfalse
+ */
+bool shm_destroy_segment(const char* segment);
+
+/**
+ * セグメント内のエントリを削除し、ペイロードの領域を空きリストに戻す
+ * （同じ大きさの種類の次の割り当てで再利用される）
+ * @param segment 共有メモリセグメントの名前
+ * @param key 変数名
+ * @return 削除した場合はtrue、変数が存在しない場合はfalse
+ */
+bool shm_delete_variable(const char* segment, const char* key);
+
+/**
+ * セグメントの通知シーケンス（書き込み完了ごとに増加）を取得する
+ * @param segment 共有メモリセグメントの名前
+ * @return 現在のシーケンス値、失敗した場合は-1
+ */
+long segment_sequence(const char* segment);
+
+/**
+ * 通知シーケンスがseenから変わるまで待機する（スピン後にfutexでブロック）
+ * @param segment 共有メモリセグメントの名前
+ * @param seen 最後に確認したシーケンス値
+ * @return 新しいシーケンス値、タイムアウトまたは失敗した場合は-1
+ */
+long wait_segment_update(const char* segment, long seen);
+
+/**
+ * セグメントの転送統計（FreeFEM側とPython側）を出力する
+ * @param segment 共有メモリセグメントの名前
+ * @param out 出力先
+ * @return 成功した場合はtrue、失敗した場合はfalse
+ */
+bool shm_dump_stats(const char* segment, std::ostream& out);
+
+// 常駐ワーカーのコマンドチャネル（セッションのセグメント内の予約エントリ）
+//   SHM_WORKER_COMMAND_KEY: int64 [コマンドID, 操作]  Pythonが書き込む
+//   SHM_WORKER_RESULT_KEY:  int64 [コマンドID, 状態]  ワーカーが書き込む
+// コマンドとその結果は1対1に交互に書き込まれるため、コマンドの世代番号が
+// 結果の世代番号より大きければ未処理のコマンドがある
+#define SHM_WORKER_COMMAND_KEY "__worker_cmd"
+#define SHM_WORKER_RESULT_KEY "__worker_done"
+
+enum ShmWorkerOp {
+    SHM_WORKER_RUN = 1,
+    SHM_WORKER_STOP = 2
+};
+
+/**
+ * 常駐ワーカーへの次のコマンドを待機する（親プロセスが終了するまで待ち続ける）
+ * @param segment 共有メモリセグメントの名前
+ * @return 実行するコマンドのID（正の値）、停止コマンドの場合は0、失敗した場合は-1
+ */
+long shm_wait_command(const char* segment);
+
+/**
+ * 処理中のコマンドの結果を書き込み、Python側に通知する
+ * @param segment 共有メモリセグメントの名前
+ * @param status 処理結果（0以上は成功、負の値は失敗を表す）
+ * @return 成功した場合はtrue、失敗した場合はfalse
+ */
+bool shm_post_result(const char* segment, long status);
+
+// 多重バッファのチャネル（2面または3面のバッファを交互に使い、書き込みと読み込みを重ねる）
+//   <key>:   int64 [面数, 公開済みフレーム数, 読み込み中のフレーム, 読み終えたフレーム]
+//   <key>.i: i番目のバッファ（フレーム f は f % 面数 番目に書き込まれる）
+// 公開済みフレーム数は書き込み側だけが、残りの2語は読み込み側だけが更新する。
+// 読み込み側は常に最新のフレームを読み、書き込み側は読み込み中のバッファだけを避ける
+static const long SHM_CHANNEL_MAX_BUFFERS = 3;
+
+enum ShmChannelWord {
+    SHM_CHANNEL_BUFFERS = 0,
+    SHM_CHANNEL_PUBLISHED = 1,
+    SHM_CHANNEL_ACQUIRED = 2,
+    SHM_CHANNEL_CONSUMED = 3,
+    SHM_CHANNEL_WORDS = 4
+};
+
+// 書き込み・読み込み中のチャネルのバッファへの参照
+struct ShmChannelRef {
+    ShmEntryRef buffer;        // バッファのエントリ
+    SegmentEntry* control;     // 制御用のエントリ
+    uint64_t frame;            // 書き込み・読み込み中のフレーム番号（1から始まる）
+};
+
+/**
+ * 多重バッファのチャネルを作成する（同じ構成のチャネルが既にあればそれを使用する）
+ * @param segment 共有メモリセグメントの名前
+ * @param key チャネル名（バッファのエントリ名に ".i" が付くため SHM_NAME_LEN - 3 文字未満）
+ * @param buffers バッファの面数（2または3）
+ * @return 成功した場合はtrue、失敗した場合はfalse
+ */
+bool shm_channel_create(const char* segment, const char* key, long buffers);
+
+/**
+ * 次のフレームを書き込むバッファを確保する（読み込み側が同じバッファを読み終えるまで待機）
+ * 書き込んだ後、shm_channel_end_write()で公開すること
+ * @param segment 共有メモリセグメントの名前
+ * @param key チャネル名
+ * @param dtype バッファのデータ型
+ * @param elements 要素数
+ * @param ref 確保したバッファへの参照
+ * @param timeout 待機する最大時間（秒）
+ * @return 成功した場合はtrue、タイムアウトまたは失敗した場合はfalse
+ */
+bool shm_channel_begin_write(const char* segment, const char* key, uint32_t dtype, size_t elements,
+                             ShmChannelRef* ref, double timeout = SHM_WAIT_TIMEOUT_SEC);
+
+/**
+ * shm_channel_begin_write()で確保したバッファをフレームとして公開する
+ * @param ref 書き込んだバッファへの参照
+ * @param elements 書き込んだ要素数
+ */
+void shm_channel_end_write(const ShmChannelRef& ref, size_t elements);
+
+/**
+ * 未読のフレームが公開されるまで待機し、最新のフレームのバッファを参照する
+ * 読み終えたら shm_channel_release() で返却すること
+ * @param segment 共有メモリセグメントの名前
+ * @param key チャネル名
+ * @param ref 参照したバッファへの参照
+ * @param timeout 待機する最大時間（秒）
+ * @return 成功した場合はtrue、タイムアウトまたは失敗した場合はfalse
+ */
+bool shm_channel_acquire(const char* segment, const char* key, ShmChannelRef* ref,
+                         double timeout = SHM_WAIT_TIMEOUT_SEC);
+
+/**
+ * shm_channel_acquire()で参照したバッファを返却し、待機中の書き込み側に通知する
+ * @param ref 読み込んだバッファへの参照
+ * @param bytes コピーしたバイト数
+ */
+void shm_channel_release(const ShmChannelRef& ref, size_t bytes);
+
+// 非同期書き込み（ペイロードへのコピーと公開をプラグインのバックグラウンドスレッドで行う）
+// 書き込み先は呼び出し時に確保し、コピー元は呼び出し時にジョブ専用のバッファへコピーする。
+// 公開されるまで、このプロセスからの同じエントリへの書き込み（shm_begin_write など）と削除は待機する。
+
+/**
+ * double配列の非同期書き込みを開始する（同じエントリへの書き込みが処理中であれば終わるまで待つ）
+ * @param segment 共有メモリセグメントの名前
+ * @param key セグメント内のエントリ名
+ * @param src 書き込む配列の先頭（呼び出し時にコピーするため、戻った後は変更してよい）
+ * @param elements 要素数
+ * @param step 要素間のストライド
+ * @return 完了の待機に使うハンドル（正の値）、失敗した場合は0
+ */
+long shm_write_async(const char* segment, const char* key, const double* src, size_t elements, long step);
+
+/**
+ * 非同期書き込みが完了するまで待機し、ハンドルを解放する
+ * @param handle shm_write_async() が返したハンドル
+ * @return 成功した場合はtrue、ハンドルが不正な場合はfalse
+ */
+bool shm_wait_async(long handle);
+
+// 差分転送（反復ごとに値が変わったブロックだけを書き込む）
+//   <key>:         float64 の通常のエントリ（readSharedMemory などでもそのまま読める）
+//   <key>.blocks:  int64 [ブロックの要素数, 要素数, 公開時の <key> の世代番号, ブロック数,
+//                         ブロックごとの世代番号..., ブロックごとのチェックサム...]
+// 書き込み側はブロックのチェックサムが前回と異なるブロックだけをコピーし、その世代番号を
+// 公開後の <key> の世代番号に進める。読み込み側は前回読んだ時より世代番号が進んだブロックだけを
+// コピーする（Python側の DeltaArray）。チェックサムはビット列の重み付き和（mod 2^64）で、
+// ブロック内の1要素だけの変更は必ず検出される。
+#define SHM_DELTA_SUFFIX ".blocks"
+static const size_t SHM_DELTA_BLOCK_ELEMENTS = 512;    // 4 KiB（1ページ）
+static const uint64_t SHM_DELTA_CHECKSUM_MULTIPLIER = 0x9E3779B97F4A7C15ULL;
+
+enum ShmDeltaWord {
+    SHM_DELTA_BLOCK = 0,
+    SHM_DELTA_ELEMENTS = 1,
+    SHM_DELTA_GENERATION = 2,
+    SHM_DELTA_BLOCKS = 3,
+    SHM_DELTA_WORDS = 4
+};
+
+/**
+ * double配列を差分転送で書き込む（前回から変わったブロックだけをコピーする）
+ * 要素数やブロックの大きさが変わった場合、または他の書き込みで <key> が更新されていた場合は全体を書き込む
+ * @param segment 共有メモリセグメントの名前
+ * @param key セグメント内のエントリ名（SHM_DELTA_SUFFIX が付くため SHM_NAME_LEN - 7 文字未満）
+ * @param src 書き込む配列の先頭
+ * @param elements 要素数
+ * @param step 要素間のストライド
+ * @param block_elements 1ブロックの要素数
+ * @return 書き込んだブロック数、失敗した場合は-1
+ */
+long shm_write_delta(const char* segment, const char* key, const double* src, size_t elements, long step,
+                     size_t block_elements = SHM_DELTA_BLOCK_ELEMENTS);
+
+// MPI並列実行（ff-mpirun）での分割配列
+// セグメントは書き込み側が1プロセスであることを前提とするため、各ランクは自分専用のセグメント
+// <segment>.r<ランク> に書き込み、同じセグメントを複数のランクが奪い合わないようにする。
+//   <key>:       float64 このランクが担当する部分（大域配列の [offset, offset + 要素数)）
+//   <key>.part:  int64 [ランク, ランク数, offset, 要素数, 大域配列の要素数]
+// 2つのエントリは1回の通知でまとめて公開する。Python側（RankSegments）は各ランクのセグメントから
+// 部分を大域配列の位置に直接集め（gather）、逆方向には部分ごとに書き込む（scatter）。
+// ランクとランク数はMPIの起動プログラムが設定する環境変数から取得する。
+#define SHM_RANK_SEPARATOR ".r"
+#define SHM_PARTITION_SUFFIX ".part"
+
+enum ShmPartitionWord {
+    SHM_PARTITION_RANK = 0,
+    SHM_PARTITION_RANKS = 1,
+    SHM_PARTITION_OFFSET = 2,
+    SHM_PARTITION_ELEMENTS = 3,
+    SHM_PARTITION_GLOBAL = 4,
+    SHM_PARTITION_WORDS = 5
+};
+
+/**
+ * MPIのランクとランク数を環境変数（OpenMPI / MPICH / MVAPICH / Slurm）から取得する
+ * @param rank ランク（MPIで起動されていない場合は0）
+ * @param ranks ランク数（MPIで起動されていない場合は1）
+ * @return MPIで起動されている場合はtrue
+ */
+bool shm_mpi_rank(long* rank, long* ranks);
+
+/**
+ * ランク専用のセグメント名（<segment>.r<rank>）を返す
+ * @param segment 共有メモリセグメントの名前
+ * @param rank ランク
+ */
+std::string shm_rank_segment(const char* segment, long rank);
+
+/**
+ * このランクが担当する部分をランク専用のセグメントに書き込む
+ * @param segment 共有メモリセグメントの名前（ランクの接尾辞は付けない）
+ * @param key セグメント内のエントリ名（SHM_PARTITION_SUFFIX が付くため SHM_NAME_LEN - 5 文字未満）
+ * @param src 書き込む配列の先頭
+ * @param elements 要素数
+ * @param step 要素間のストライド
+ * @param offset 大域配列での開始位置
+ * @param global_elements 大域配列の要素数
+ * @return 成功した場合はtrue、失敗した場合はfalse
+ */
+bool shm_write_partition(const char* segment, const char* key, const double* src, size_t elements, long step,
+                         size_t offset, size_t global_elements);
+
+/**
+ * SPSCリングバッファを作成する
+ * @param name 共有メモリの名前
+ * @param slot_elements 1スロットあたりの最大要素数
+ * @param slot_count スロット数（2の冪）
+ * @return 成功した場合はtrue、失敗した場合はfalse
+ */
+bool ring_create(const char* name, long slot_elements, long slot_count);
+
+/**
+ * リングバッファにdouble配列を1スロット分追加する（満杯の場合はブロックせずに失敗）
+ * @param name 共有メモリの名前
+ * @param src 追加する配列の先頭
+ * @param elements 要素数
+ * @param step 要素間のストライド
+ * @return 成功した場合はtrue、満杯または失敗した場合はfalse
+ */
+bool ring_push(const char* name, const double* src, size_t elements, long step);
+
+/**
+ * リングバッファの先頭スロットを参照する（空の場合はブロックせずにNULL）
+ * 読み終えたら ring_consume() でスロットを返却すること
+ * @param name 共有メモリの名前
+ * @param elements 先頭スロットの要素数
+ * @return 先頭スロットのデータ、空または失敗した場合はNULL
+ */
+const double* ring_front(const char* name, size_t* elements);
+
+/**
+ * ring_front()で参照した先頭スロットを返却する
+ * @param name 共有メモリの名前
+ */
+void ring_consume(const char* name);
+
+#endif // SHM_TRANSPORT_HPP
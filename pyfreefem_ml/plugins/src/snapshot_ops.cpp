@@ -0,0 +1,123 @@
+// FreeFEM++ plugin for shared memory operations
+// 非定常計算の履歴を追記専用のスナップショットファイルに保存し、番号で読み戻す演算子
+//
+// ファイルの形式と先読みの手順は shm_snapshot.hpp を参照。セグメントと違いディスク上のファイルのため、
+// RAMより大きな履歴も保存でき、随伴計算では後ろ向きに読み戻してもディスクの帯域で読み込める。
+// ファイルはプロセス内で開いたままにし、snapshotClose で閉じる（終了時は自動的に閉じられる）。
+//
+//   snapshotAppend(path, u[])      スナップショットを追記し、その番号を返す（失敗した場合は-1）
+//   snapshotRead(path, i, u[])     i番目を u に読み込む（1: 成功, 0: 失敗）
+//   snapshotCount(path)            書き込み済みのスナップショット数（ファイルがなければ0、不正なら-1）
+//   snapshotClose(path)            ファイルを閉じる
+#include <iostream>
+#include <map>
+#include <string>
+#include <vector>
+
+#include "ff++.hpp"
+#include "AFunction.hpp"
+#include "shm_implementation.hpp"
+#include "shm_snapshot.hpp"
+#include "shm_copy.hpp"
+
+using namespace std;
+
+// プロセス内で開いているスナップショットファイル（パス -> ファイル）
+static map<string, SnapshotStore*> snapshot_stores;
+
+static void close_snapshot_store(map<string, SnapshotStore*>::iterator it) {
+    snapshot_close(it->second);
+    delete it->second;
+    snapshot_stores.erase(it);
+}
+
+// 開いているファイルを返す（開いていなければ開く）
+// 書き込みには読み込み専用で開いたファイルを開き直す
+static SnapshotStore* snapshot_store(const string& path, bool writable, uint64_t elements) {
+    map<string, SnapshotStore*>::iterator it = snapshot_stores.find(path);
+    if (it != snapshot_stores.end()) {
+        if (!writable || it->second->writable) {
+            return it->second;
+        }
+        close_snapshot_store(it);
+    }
+    SnapshotStore* store = new SnapshotStore();
+    if (!snapshot_open(path, writable, elements, store)) {
+        delete store;
+        return NULL;
+    }
+    snapshot_stores[path] = store;
+    return store;
+}
+
+// スナップショットを追記する
+long shm_snapshot_append(string* const& path, KN<double>* const& u) {
+    uint64_t elements = static_cast<uint64_t>(u->N());
+    SnapshotStore* store = snapshot_store(*path, true, elements);
+    if (!store) {
+        return -1L;
+    }
+    if (store->header.elements != elements) {
+        cerr << "スナップショットの要素数が一致しません: " << *path << " (ファイル: " << store->header.elements
+             << ", 配列: " << elements << ")" << endl;
+        return -1L;
+    }
+
+    // ストライドがある配列（部分配列など）は連続な領域に詰めてから書き込む
+    const double* src = *u;
+    vector<double> packed;
+    if (u->step != 1 && elements > 0) {
+        packed.resize(elements);
+        shm_gather_f64(&packed[0], src, elements, u->step);
+        src = &packed[0];
+    }
+    return snapshot_append(store, src);
+}
+
+// index 番目のスナップショットを読み込む
+long shm_snapshot_read(string* const& path, long const& index, KN<double>* const& u) {
+    SnapshotStore* store = snapshot_store(*path, false, 0);
+    if (!store) {
+        return 0L;
+    }
+    const double* data = snapshot_data(store, index);
+    if (!data) {
+        return 0L;
+    }
+    size_t elements = static_cast<size_t>(store->header.elements);
+    u->resize(elements);
+    shm_scatter_f64(*u, u->step, data, elements);
+    return 1L;
+}
+
+// 書き込み済みのスナップショット数
+long shm_snapshot_count(string* const& path) {
+    map<string, SnapshotStore*>::iterator it = snapshot_stores.find(*path);
+    if (it == snapshot_stores.end() && access(path->c_str(), F_OK) != 0) {
+        return 0L;
+    }
+    SnapshotStore* store = snapshot_store(*path, false, 0);
+    if (!store || !snapshot_read_header(store)) {
+        return -1L;
+    }
+    return static_cast<long>(store->header.count);
+}
+
+// ファイルを閉じる
+long shm_snapshot_close(string* const& path) {
+    map<string, SnapshotStore*>::iterator it = snapshot_stores.find(*path);
+    if (it == snapshot_stores.end()) {
+        cerr << "スナップショットファイルは開かれていません: " << *path << endl;
+        return 0L;
+    }
+    close_snapshot_store(it);
+    return 1L;
+}
+
+// スナップショットの演算子を登録する（shm_implementation.cpp の初期化関数から呼ばれる）
+void register_snapshot_operations() {
+    Global.Add("snapshotAppend", "(", new OneOperator2_<long, string*, KN<double>*>(shm_snapshot_append));
+    Global.Add("snapshotRead", "(", new OneOperator3_<long, string*, long, KN<double>*>(shm_snapshot_read));
+    Global.Add("snapshotCount", "(", new OneOperator1_<long, string*>(shm_snapshot_count));
+    Global.Add("snapshotClose", "(", new OneOperator1_<long, string*>(shm_snapshot_close));
+}
@@ -0,0 +1,165 @@
+// FreeFEM++ plugin for shared memory operations
+// 疎行列（matrix / Matrice_Creuse）をCSR形式でセグメントに格納する演算子
+//
+// 行列 <key> はセグメント内の次の4つのエントリとして格納する
+// （Python側の SharedMemoryManager.write_sparse_matrix / view_sparse_matrix と同一）
+//   <key>.indptr   int32    行ポインタ（行数 + 1）
+//   <key>.indices  int32    列番号（非零要素数）
+//   <key>.data     float64  値（非零要素数）
+//   <key>          int64    [行数, 列数, 非零要素数, 対称形式]
+// 4つのエントリは1回のバッチ書き込みでまとめて確保・公開し、<key> を最後に公開するため、
+// 読み込み側は <key> を待てば行列全体がそろっている。読み込み側は行ポインタの単調性と
+// 列番号の範囲を確認してから行列を組み立てる。
+// 対称形式はFreeFEMのHashMatrix::halfの値で、0以外の場合は片側の三角部分だけを格納する。
+#include <climits>
+#include <iostream>
+#include <cstring>
+#include <string>
+
+#include "ff++.hpp"
+#include "AFunction.hpp"
+#include "shm_implementation.hpp"
+#include "shm_transport.hpp"
+
+using namespace std;
+
+static const size_t SPARSE_HEADER_WORDS = 4;
+
+static string sparse_entry_name(const string& key, const char* part) {
+    return key + "." + part;
+}
+
+// 書き込み済みのエントリを参照する（型と要素数を確認する）
+static bool acquire_sparse_part(const char* segment, const string& name, uint32_t dtype,
+                                size_t elements, ShmEntryRef* ref) {
+    if (!shm_acquire_entry(segment, name.c_str(), ref, 0.0)) {
+        return false;
+    }
+    if (ref->entry->dtype != dtype || shm_entry_elements(*ref) != elements) {
+        cerr << "疎行列のエントリの形式が不正です: " << name << " (期待値: " << shm_dtype_name(dtype)
+             << " x " << elements << ", 実際: " << shm_dtype_name(ref->entry->dtype) << " x "
+             << shm_entry_elements(*ref) << ")" << endl;
+        return false;
+    }
+    return true;
+}
+
+// 疎行列をCSR形式で書き込む
+long shm_write_sparse_matrix(string* const& segment, string* const& key, Matrice_Creuse<double>* const& A) {
+    HashMatrix<int, double>* hm = A ? A->pHM() : NULL;
+    if (!hm) {
+        cerr << "行列が定義されていません: " << *key << endl;
+        return 0L;
+    }
+    if (key->size() + strlen(".indices") >= SHM_NAME_LEN) {
+        cerr << "行列名が長すぎます: " << *key << endl;
+        return 0L;
+    }
+
+    // 行ポインタ p・列番号 j・値 aij の形式に変換する（FreeFEM側の格納形式も変わる）
+    hm->CSR();
+    size_t rows = static_cast<size_t>(hm->n);
+    size_t nnz = hm->nnz;
+    int64_t header[SPARSE_HEADER_WORDS] = {
+        static_cast<int64_t>(hm->n), static_cast<int64_t>(hm->m),
+        static_cast<int64_t>(nnz), static_cast<int64_t>(hm->half)
+    };
+
+    // 3つの配列とヘッダーをまとめて確保し、ヘッダーを最後に公開する
+    string indptr_key = sparse_entry_name(*key, "indptr");
+    string indices_key = sparse_entry_name(*key, "indices");
+    string data_key = sparse_entry_name(*key, "data");
+    ShmBatchItem items[4] = {
+        { indptr_key.c_str(), SHM_DTYPE_INT32, rows + 1 },
+        { indices_key.c_str(), SHM_DTYPE_INT32, nnz },
+        { data_key.c_str(), SHM_DTYPE_FLOAT64, nnz },
+        { key->c_str(), SHM_DTYPE_INT64, SPARSE_HEADER_WORDS }
+    };
+    const void* sources[4] = { hm->p, hm->j, hm->aij, header };
+    ShmEntryRef refs[4];
+    if (!shm_begin_write_batch(segment->c_str(), items, 4, refs)) {
+        return 0L;
+    }
+    for (size_t i = 0; i < 4; i++) {
+        if (items[i].elements > 0) {
+            memcpy(shm_entry_data(refs[i]), sources[i], items[i].elements * shm_dtype_size(items[i].dtype));
+        }
+    }
+    shm_end_write_batch(refs, items, 4);
+    return 1L;
+}
+
+// CSR形式の疎行列を読み込み、行列を置き換える
+long shm_read_sparse_matrix(string* const& segment, string* const& key, Matrice_Creuse<double>* const& A) {
+    const char* seg = segment->c_str();
+
+    // ヘッダーが書き込まれるまで待機する
+    ShmEntryRef ref;
+    if (!shm_acquire_entry(seg, key->c_str(), &ref)) {
+        return 0L;
+    }
+    if (ref.entry->dtype != SHM_DTYPE_INT64 || shm_entry_elements(ref) < SPARSE_HEADER_WORDS) {
+        cerr << "疎行列ではありません: " << *key << endl;
+        return 0L;
+    }
+    int64_t header[SPARSE_HEADER_WORDS];
+    memcpy(header, shm_entry_data(ref), sizeof(header));
+    shm_end_read(ref, sizeof(header));
+    if (header[0] < 0 || header[1] < 0 || header[2] < 0
+        || header[0] > INT_MAX || header[1] > INT_MAX || header[2] > INT_MAX) {
+        cerr << "疎行列の大きさが不正です: " << *key << endl;
+        return 0L;
+    }
+    size_t rows = static_cast<size_t>(header[0]);
+    size_t nnz = static_cast<size_t>(header[2]);
+
+    ShmEntryRef indptr_ref, indices_ref, data_ref;
+    if (!acquire_sparse_part(seg, sparse_entry_name(*key, "indptr"), SHM_DTYPE_INT32, rows + 1, &indptr_ref)
+        || !acquire_sparse_part(seg, sparse_entry_name(*key, "indices"), SHM_DTYPE_INT32, nnz, &indices_ref)
+        || !acquire_sparse_part(seg, sparse_entry_name(*key, "data"), SHM_DTYPE_FLOAT64, nnz, &data_ref)) {
+        return 0L;
+    }
+    const int32_t* indptr = static_cast<const int32_t*>(shm_entry_data(indptr_ref));
+    const int32_t* indices = static_cast<const int32_t*>(shm_entry_data(indices_ref));
+    const double* data = static_cast<const double*>(shm_entry_data(data_ref));
+    // 行ポインタが 0 から nnz まで単調に増え、列番号が [0, 列数) に収まることを確認する
+    if (indptr[0] != 0 || static_cast<size_t>(indptr[rows]) != nnz) {
+        cerr << "疎行列の行ポインタが不正です: " << *key << endl;
+        return 0L;
+    }
+    for (size_t row = 0; row < rows; row++) {
+        if (indptr[row + 1] < indptr[row]) {
+            cerr << "疎行列の行ポインタが単調ではありません: " << *key << " (行 " << row << ")" << endl;
+            return 0L;
+        }
+    }
+    int32_t cols = static_cast<int32_t>(header[1]);
+    for (size_t k = 0; k < nnz; k++) {
+        if (indices[k] < 0 || indices[k] >= cols) {
+            cerr << "疎行列の列番号が範囲外です: " << *key << " (" << indices[k] << ", 列数: " << cols << ")" << endl;
+            return 0L;
+        }
+    }
+
+    HashMatrix<int, double>* hm = new HashMatrix<int, double>(static_cast<int>(header[0]), static_cast<int>(header[1]),
+                                                              static_cast<int>(nnz), static_cast<int>(header[3]));
+    for (size_t row = 0; row < rows; row++) {
+        for (int32_t k = indptr[row]; k < indptr[row + 1]; k++) {
+            (*hm)(static_cast<int>(row), indices[k]) = data[k];
+        }
+    }
+    A->A.master(hm);
+
+    shm_end_read(indptr_ref, (rows + 1) * sizeof(int32_t));
+    shm_end_read(indices_ref, nnz * sizeof(int32_t));
+    shm_end_read(data_ref, nnz * sizeof(double));
+    return 1L;
+}
+
+// 疎行列の演算子を登録する（shm_implementation.cpp の初期化関数から呼ばれる）
+void register_sparse_matrix_operations() {
+    Global.Add("shmWriteMatrix", "(",
+               new OneOperator3_<long, string*, string*, Matrice_Creuse<double>*>(shm_write_sparse_matrix));
+    Global.Add("shmReadMatrix", "(",
+               new OneOperator3_<long, string*, string*, Matrice_Creuse<double>*>(shm_read_sparse_matrix));
+}
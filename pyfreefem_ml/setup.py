@@ -76,7 +76,7 @@ setup(
     ],
     python_requires=">=3.10",
     install_requires=[
-        "numpy>=1.20.0",
+        "numpy>=1.22.0",  # get_array_view の DLPack（ndarray.__dlpack__）に必要
         # その他の依存関係を追加
     ],
     entry_points={
@@ -0,0 +1,677 @@
+#!/usr/bin/env python3
+# -*- coding: utf-8 -*-
+
+"""
+共有メモリセグメントのバイナリレイアウト
+
+plugins/src/shm_layout.hpp と同一のレイアウトをPython側から読み書きします。
+
+セグメント構成:
+    [SegmentHeader (64バイト)] [SegmentEntry (128バイト) x MAX_ENTRIES]
+    [SegmentStats (320バイト) x STATS_SIDES] [SegmentArena (256バイト)] [ペイロード...]
+
+エントリ表は名前のハッシュ値（FNV-1a 64bit）で開番地法により引くため、
+変数の検索はJSONの再解析なしにO(1)で行えます。
+
+ペイロードは2の冪の大きさのブロック単位で割り当てます。削除した変数や、
+大きくなった変数の古いブロックは大きさごとの空きリスト（SegmentArena）に戻り、
+次の割り当てでO(1)で再利用されます。空きリストはFreeFEM側と共有するため、
+操作は ArenaLock で保護します。エントリの確保・削除と data_end / segment_size の
+更新も同じロックで行い、entry_count と generation は不可分に増減します。
+
+転送統計（SegmentStats）は記録元（FreeFEM/Python）ごとに分かれており、
+各側は自分のブロックだけを更新します。
+"""
+
+import os
+import time
+import ctypes
+import struct
+import platform
+import numpy as np
+
+SEGMENT_MAGIC = 0x53464650  # "PFFS"
+SEGMENT_VERSION = 3
+MAX_ENTRIES = 256
+NAME_LEN = 48
+MAX_NDIM = 4
+ALIGNMENT = 64
+STATS_BUCKETS = 32
+ARENA_CLASSES = 30  # ブロックの大きさの種類（64バイトから32GiBまで）
+ARENA_LOCK_TIMEOUT = 5.0  # アリーナのロックを待つ最大時間（秒、shm_layout.hpp と同じ）
+
+# 転送統計の記録元（shm_layout.hpp の ShmStatsSide と同じ値）
+STATS_FREEFEM = 0
+STATS_PYTHON = 1
+STATS_SIDES = 2
+
+# データ型（shm_layout.hpp の ShmDType と同じ値）
+DTYPE_NONE = 0
+DTYPE_FLOAT64 = 1
+DTYPE_FLOAT32 = 2
+DTYPE_INT64 = 3
+DTYPE_INT32 = 4
+DTYPE_UINT8 = 5
+DTYPE_STRING = 6
+DTYPE_DELETED = 255  # 削除済みエントリ（検索は次の要素へ進み、登録時に再利用する）
+
+_NUMPY_DTYPES = {
+    DTYPE_FLOAT64: np.dtype(np.float64),
+    DTYPE_FLOAT32: np.dtype(np.float32),
+    DTYPE_INT64: np.dtype(np.int64),
+    DTYPE_INT32: np.dtype(np.int32),
+    DTYPE_UINT8: np.dtype(np.uint8),
+    DTYPE_STRING: np.dtype(np.uint8),
+}
+
+# セグメントのマッピング方法（shm_layout.hpp の ShmMapFlags と同じ値）
+MAP_HUGEPAGE = 1
+MAP_POPULATE = 2
+HUGEPAGE_SIZE = 2 * 1024 * 1024
+
+# ヘッダーのうちseq/waitersより前の部分。seq/waitersは他プロセスが並行して
+# 更新するため、ヘッダーの読み書き（_store_header）には含めない（shm_sync.py を参照）
+# 書き込みは初期化だけで、その後は変更する1つの値だけを書く（下の *_OFFSET）
+_HEADER = struct.Struct('<IIQIIQQQ')
+_ENTRY = struct.Struct('<48sQII4QQQQQ')
+_STATS = struct.Struct(f'<8Q{STATS_BUCKETS}Q')
+_ARENA = struct.Struct(f'<IIQ{ARENA_CLASSES}Q')
+_NEXT = struct.Struct('<Q')
+
+HEADER_SIZE = 64
+SEGMENT_SIZE_OFFSET = 8   # SegmentHeader::segment_size（アリーナのロックを保持して更新）
+ENTRY_COUNT_OFFSET = 16   # SegmentHeader::entry_count（不可分に増減）
+DATA_END_OFFSET = 32      # SegmentHeader::data_end（アリーナのロックを保持して更新）
+GENERATION_OFFSET = 40    # SegmentHeader::generation（不可分に増加）
+ENTRY_DTYPE_OFFSET = 56   # SegmentEntry::dtype
+SEQ_OFFSET = _HEADER.size       # SegmentHeader::seq
+WAITERS_OFFSET = SEQ_OFFSET + 4  # SegmentHeader::waiters
+MAP_FLAGS_OFFSET = SEQ_OFFSET + 8  # SegmentHeader::map_flags, numa_node
+_MAP_OPTIONS = struct.Struct('<II')
+ENTRY_SIZE = _ENTRY.size
+STATS_OFFSET = HEADER_SIZE + MAX_ENTRIES * ENTRY_SIZE
+STATS_SIZE = _STATS.size
+ARENA_OFFSET = STATS_OFFSET + STATS_SIDES * STATS_SIZE
+ARENA_SIZE = _ARENA.size
+
+assert SEQ_OFFSET == 48 and ENTRY_SIZE == 128 and STATS_SIZE == 320 and ARENA_SIZE == 256
+
+
+def align(value):
+    """64バイト境界に切り上げ"""
+    return (value + ALIGNMENT - 1) & ~(ALIGNMENT - 1)
+
+
+TABLE_SIZE = align(ARENA_OFFSET + ARENA_SIZE)
+
+
+def block_class(nbytes):
+    """nbytes を格納するブロックの大きさの種類（ALIGNMENT << c >= nbytes となる最小の c）"""
+    c = max(nbytes - 1, 0) // ALIGNMENT
+    return min(c.bit_length(), ARENA_CLASSES - 1)
+
+
+def block_size(nbytes):
+    """nbytes を格納するブロックのバイト数（最大の種類を超える場合は64バイト境界に切り上げた大きさ）"""
+    return max(ALIGNMENT << block_class(nbytes), align(nbytes))
+
+
+def name_hash(name):
+    """変数名のハッシュ（FNV-1a 64bit、C++側と同一）"""
+    h = 0xcbf29ce484222325
+    for byte in name.encode('utf-8'):
+        h ^= byte
+        h = (h * 0x100000001b3) & 0xffffffffffffffff
+    return h
+
+
+def dtype_code(dtype):
+    """NumPyのdtypeをレイアウトのデータ型コードに変換"""
+    dtype = np.dtype(dtype)
+    for code, np_dtype in _NUMPY_DTYPES.items():
+        if code != DTYPE_STRING and np_dtype == dtype:
+            return code
+    raise TypeError(f"共有メモリに格納できないデータ型です: {dtype}")
+
+
+def numpy_dtype(code):
+    """レイアウトのデータ型コードをNumPyのdtypeに変換"""
+    return _NUMPY_DTYPES[code]
+
+
+def stats_bucket(ns):
+    """レイテンシのヒストグラムの区間（floor(log2(ns))、上限は最後の区間）"""
+    return min(max(int(ns).bit_length() - 1, 0), STATS_BUCKETS - 1)
+
+
+def stats_percentile(histogram, latency_max_ns, q):
+    """ヒストグラムから分位点を求める（該当する区間の上端、記録が無ければ0）"""
+    total = sum(histogram)
+    if total == 0:
+        return 0
+    rank = int(q * (total - 1)) + 1
+    seen = 0
+    for i, count in enumerate(histogram):
+        seen += count
+        if seen >= rank:
+            return min(2 << i, latency_max_ns)
+    return latency_max_ns
+
+
+def segment_size_for(nbytes):
+    """1エントリだけを持つセグメントに必要なバイト数"""
+    return TABLE_SIZE + block_size(nbytes)
+
+
+def retire(path):
+    """削除する前に共有メモリオブジェクト先頭のmagicを消す
+
+    FreeFEM側はキャッシュしたマッピングのmagicが変わったときだけ名前の指すオブジェクトを
+    確かめ直すため、同じ名前で作り直す前にこれを呼ぶ（セグメントとリングバッファで共通）。
+    """
+    try:
+        fd = os.open(path, os.O_WRONLY)
+    except FileNotFoundError:
+        return
+    try:
+        if os.fstat(fd).st_size >= 4:
+            os.pwrite(fd, bytes(4), 0)
+    finally:
+        os.close(fd)
+
+
+# 比較交換とストア（libatomic、クラス内では名前が変換されるためここで取り出す）
+_atomic_cas = _atomic_store = _atomic_load_8 = _atomic_store_8 = None
+_atomic_fetch_add_4 = _atomic_fetch_add_8 = _atomic_exchange_8 = None
+if platform.system() == 'Linux':
+    try:
+        _libatomic = ctypes.CDLL('libatomic.so.1')
+        _atomic_cas = _libatomic.__atomic_compare_exchange_4
+        _atomic_cas.restype = ctypes.c_bool
+        _atomic_store = _libatomic.__atomic_store_4
+        _atomic_fetch_add_4 = _libatomic.__atomic_fetch_add_4
+        _atomic_fetch_add_4.argtypes = [ctypes.c_void_p, ctypes.c_uint32, ctypes.c_int]
+        _atomic_fetch_add_4.restype = ctypes.c_uint32
+        _atomic_fetch_add_8 = _libatomic.__atomic_fetch_add_8
+        _atomic_fetch_add_8.argtypes = [ctypes.c_void_p, ctypes.c_uint64, ctypes.c_int]
+        _atomic_fetch_add_8.restype = ctypes.c_uint64
+        _atomic_exchange_8 = _libatomic.__atomic_exchange_8
+        _atomic_exchange_8.argtypes = [ctypes.c_void_p, ctypes.c_uint64, ctypes.c_int]
+        _atomic_exchange_8.restype = ctypes.c_uint64
+        _atomic_load_8 = _libatomic.__atomic_load_8
+        _atomic_load_8.argtypes = [ctypes.c_void_p, ctypes.c_int]
+        _atomic_load_8.restype = ctypes.c_uint64
+        _atomic_store_8 = _libatomic.__atomic_store_8
+        _atomic_store_8.argtypes = [ctypes.c_void_p, ctypes.c_uint64, ctypes.c_int]
+        _atomic_store_8.restype = None
+    except (OSError, AttributeError):
+        _atomic_cas = _atomic_store = _atomic_load_8 = _atomic_store_8 = None
+        _atomic_fetch_add_4 = _atomic_fetch_add_8 = _atomic_exchange_8 = None
+
+# ストアの順序が保証される（TSO）CPU。libatomic がなくても通常の読み書きで公開できる
+TSO_MACHINE = platform.machine().lower() in ('x86_64', 'amd64', 'i386', 'i686')
+_MEMORY_ORDER_RELAXED = 0
+_MEMORY_ORDER_ACQUIRE = 2
+_MEMORY_ORDER_RELEASE = 3
+_MEMORY_ORDER_SEQ_CST = 5
+
+
+def _libatomic_missing():
+    return RuntimeError("libatomic（libatomic.so.1）を読み込めないため、共有メモリのヘッダーを"
+                        "FreeFEM側と不可分に更新できません。libatomic をインストールしてください")
+
+
+def fetch_add(buffer, offset, delta, size=8):
+    """バッファ上の size バイトの符号なし整数に delta を不可分に加える（C++側の __atomic_fetch_add と同じ）
+
+    Returns:
+        int: 加える前の値
+    """
+    func, ctype = (_atomic_fetch_add_8, ctypes.c_uint64) if size == 8 else (_atomic_fetch_add_4, ctypes.c_uint32)
+    if func is None:
+        raise _libatomic_missing()
+    word = ctype.from_buffer(buffer, offset)
+    try:
+        return func(ctypes.addressof(word), delta % (1 << (8 * size)), _MEMORY_ORDER_RELAXED)
+    finally:
+        # mmapのエクスポートを残すとresize/closeできなくなるため必ず解放する
+        del word
+
+
+def store_release_4(buffer, offset, value):
+    """バッファ上の4バイトの値を release で書き込む"""
+    if _atomic_store is None:
+        raise _libatomic_missing()
+    word = ctypes.c_uint32.from_buffer(buffer, offset)
+    try:
+        _atomic_store(ctypes.byref(word), ctypes.c_uint32(value), _MEMORY_ORDER_RELEASE)
+    finally:
+        del word
+
+
+def seq_cst_available():
+    """load_seq_cst / exchange_seq_cst を使えるかどうか"""
+    return _atomic_load_8 is not None and _atomic_exchange_8 is not None
+
+
+def load_seq_cst(buffer, offset):
+    """バッファ上の64bit語を seq_cst で読み込む（C++側の __atomic_thread_fence(__ATOMIC_SEQ_CST) と対になる）"""
+    if _atomic_load_8 is None:
+        raise _libatomic_missing()
+    word = ctypes.c_uint64.from_buffer(buffer, offset)
+    try:
+        return _atomic_load_8(ctypes.addressof(word), _MEMORY_ORDER_SEQ_CST)
+    finally:
+        del word
+
+
+def exchange_seq_cst(buffer, offset, value):
+    """バッファ上の64bit語を seq_cst の交換で書き込む
+
+    後続の読み込みがこのストアより先に実行されないため、ストアの順序が保証されるx86でも
+    通常の書き込みでは代用できません（libatomic がなければ RuntimeError）。
+
+    Returns:
+        int: 書き込む前の値
+    """
+    if _atomic_exchange_8 is None:
+        raise _libatomic_missing()
+    word = ctypes.c_uint64.from_buffer(buffer, offset)
+    try:
+        return _atomic_exchange_8(ctypes.addressof(word), value, _MEMORY_ORDER_SEQ_CST)
+    finally:
+        del word
+
+
+class AtomicWord:
+    """共有メモリ上の8バイト境界の64bit語を acquire で読み、release で書く
+
+    C++側の std::atomic<uint64_t> の load(memory_order_acquire) / store(memory_order_release)
+    と対になり、語を公開する前の書き込み（スロットのデータなど）が相手側から先に見えます。
+    libatomic を用い、読み込めない場合はストアの順序が保証されるx86でのみ通常の読み書きで代用します
+    （それ以外のCPUでは RuntimeError）。使い終えたら release_buffer() でバッファの参照を解放してください。
+    """
+
+    def __init__(self, buffer, offset):
+        if offset % 8:
+            raise ValueError(f"64bit語は8バイト境界に置く必要があります: {offset}")
+        if _atomic_load_8 is None and not TSO_MACHINE:
+            raise RuntimeError(f"libatomic（libatomic.so.1）を読み込めないため、このCPU（{platform.machine()}）"
+                               "では共有メモリの語を順序付きで公開できません。libatomic をインストールしてください")
+        self._word = ctypes.c_uint64.from_buffer(buffer, offset)
+        self._address = ctypes.addressof(self._word)
+
+    def load(self):
+        """acquire で読み込む"""
+        if _atomic_load_8 is None:
+            return self._word.value
+        return _atomic_load_8(self._address, _MEMORY_ORDER_ACQUIRE)
+
+    def store(self, value):
+        """release で書き込む"""
+        if _atomic_store_8 is None:
+            self._word.value = value
+        else:
+            _atomic_store_8(self._address, value, _MEMORY_ORDER_RELEASE)
+
+    def release_buffer(self):
+        """バッファの参照を解放（mmapを閉じられるようにする）"""
+        self._word = None
+        self._address = None
+
+
+class ArenaLock:
+    """アリーナのロック（shm_layout.hpp の shm_arena_lock と同じ語を比較交換で取る）
+
+    比較交換には libatomic を用います。読み込めない環境では FreeFEM側と不可分に
+    ロックを取れないため、RuntimeError になります。ARENA_LOCK_TIMEOUT 秒以内に
+    取れない場合は、ロックを保持したプロセスが終了したとみなして TimeoutError になります。
+    """
+
+    _ACQUIRE = 2
+    _RELEASE = 3
+    _RELAXED = 0
+
+    def __init__(self, buffer, timeout=None):
+        self.buffer = buffer
+        self.timeout = ARENA_LOCK_TIMEOUT if timeout is None else timeout
+
+    def __enter__(self):
+        if _atomic_cas is None or _atomic_store is None:
+            raise RuntimeError("libatomic（libatomic.so.1）を読み込めないため、共有メモリの領域を"
+                               "FreeFEM側と不可分に割り当てられません。libatomic をインストールしてください")
+        spins = 0
+        deadline = None
+        while not self._try_lock():
+            spins += 1
+            if spins >= 64:
+                now = time.monotonic()
+                if deadline is None:
+                    deadline = now + self.timeout
+                elif now > deadline:
+                    raise TimeoutError("アリーナのロックを取得できません（保持していたプロセスが終了した"
+                                       "可能性があります。セグメントを作り直してください）")
+                time.sleep(0)
+        return self
+
+    def __exit__(self, *exc):
+        word = ctypes.c_uint32.from_buffer(self.buffer, ARENA_OFFSET)
+        try:
+            _atomic_store(ctypes.byref(word), ctypes.c_uint32(0), self._RELEASE)
+        finally:
+            # mmapのエクスポートを残すとresize/closeできなくなるため必ず解放する
+            del word
+
+    def _try_lock(self):
+        word = ctypes.c_uint32.from_buffer(self.buffer, ARENA_OFFSET)
+        try:
+            expected = ctypes.c_uint32(0)
+            return _atomic_cas(ctypes.byref(word), ctypes.byref(expected), ctypes.c_uint32(1),
+                               self._ACQUIRE, self._RELAXED)
+        finally:
+            del word
+
+
+class Entry:
+    """エントリ表の1要素"""
+
+    __slots__ = ('index', 'name', 'name_hash', 'dtype', 'ndim', 'shape',
+                 'offset', 'nbytes', 'capacity', 'generation')
+
+    def __init__(self, index, raw):
+        (name, self.name_hash, self.dtype, self.ndim, s0, s1, s2, s3,
+         self.offset, self.nbytes, self.capacity, self.generation) = raw
+        self.index = index
+        self.name = name.split(b'\0', 1)[0].decode('utf-8')
+        self.shape = (s0, s1, s2, s3)[:self.ndim]
+
+    def pack(self):
+        shape = tuple(self.shape) + (0,) * (MAX_NDIM - len(self.shape))
+        return (self.name.encode('utf-8'), self.name_hash, self.dtype, self.ndim) + shape + \
+            (self.offset, self.nbytes, self.capacity, self.generation)
+
+
+class SegmentLayout:
+    """書き込み可能なバッファ（mmapなど）上のセグメントを操作するクラス"""
+
+    def __init__(self, buffer):
+        """
+        Args:
+            buffer: セグメント全体をマッピングした書き込み可能なバッファ
+        """
+        self.buffer = buffer
+
+    # ==== ヘッダー ====
+
+    def _header(self):
+        return list(_HEADER.unpack_from(self.buffer, 0))
+
+    def _store_header(self, values):
+        _HEADER.pack_into(self.buffer, 0, *values)
+
+    def is_valid(self):
+        """有効なセグメントかどうか"""
+        magic, version, _, _, max_entries = _HEADER.unpack_from(self.buffer, 0)[:5]
+        return magic == SEGMENT_MAGIC and version == SEGMENT_VERSION and max_entries == MAX_ENTRIES
+
+    def init(self, segment_size):
+        """セグメントを初期化（既に有効な場合は何もしない）"""
+        if self.is_valid():
+            return
+        self.buffer[0:TABLE_SIZE] = bytes(TABLE_SIZE)
+        self._store_header([0, SEGMENT_VERSION, segment_size, 0, MAX_ENTRIES,
+                            TABLE_SIZE, TABLE_SIZE, 0])
+        # magicは最後に公開する
+        struct.pack_into('<I', self.buffer, 0, SEGMENT_MAGIC)
+
+    @property
+    def segment_size(self):
+        return self._header()[2]
+
+    @property
+    def entry_count(self):
+        return self._header()[3]
+
+    @property
+    def generation(self):
+        return self._header()[7]
+
+    @property
+    def map_flags(self):
+        """マッピング方法（MAP_HUGEPAGE / MAP_POPULATE の組み合わせ）"""
+        return _MAP_OPTIONS.unpack_from(self.buffer, MAP_FLAGS_OFFSET)[0]
+
+    @property
+    def numa_node(self):
+        """ページを割り当てるNUMAノード（指定なしの場合はNone）"""
+        node = _MAP_OPTIONS.unpack_from(self.buffer, MAP_FLAGS_OFFSET)[1]
+        return node - 1 if node else None
+
+    def set_map_options(self, flags, numa_node=None):
+        """マッピング方法を記録（セグメントを作成した側が初期化直後に呼ぶ）"""
+        _MAP_OPTIONS.pack_into(self.buffer, MAP_FLAGS_OFFSET, flags,
+                               0 if numa_node is None else numa_node + 1)
+
+    # ==== 転送統計 ====
+
+    def read_stats(self, side):
+        """転送統計を読み込み
+
+        Args:
+            side (int): 記録元（STATS_FREEFEM または STATS_PYTHON）
+
+        Returns:
+            dict: 呼び出し回数・バイト数・時間（ナノ秒）とレイテンシの分布
+        """
+        values = _STATS.unpack_from(self.buffer, STATS_OFFSET + side * STATS_SIZE)
+        histogram = list(values[8:])
+        return {
+            'write_calls': values[0],
+            'read_calls': values[1],
+            'bytes_written': values[2],
+            'bytes_read': values[3],
+            'wait_ns': values[4],
+            'copy_ns': values[5],
+            'latency_min_ns': values[6],
+            'latency_max_ns': values[7],
+            'latency_p99_ns': stats_percentile(histogram, values[7], 0.99),
+            'latency_hist': histogram,
+        }
+
+    def record_transfer(self, side, write, nbytes, wait_ns, copy_ns, latency_ns):
+        """1回の読み書きを転送統計に記録（アトミックではないため、自分の記録元にだけ使う）"""
+        offset = STATS_OFFSET + side * STATS_SIZE
+        values = list(_STATS.unpack_from(self.buffer, offset))
+        if write:
+            values[0] += 1
+            values[2] += nbytes
+        else:
+            values[1] += 1
+            values[3] += nbytes
+        values[4] += wait_ns
+        values[5] += copy_ns
+        if values[6] == 0 or latency_ns < values[6]:
+            values[6] = latency_ns
+        values[7] = max(values[7], latency_ns)
+        values[8 + stats_bucket(latency_ns)] += 1
+        _STATS.pack_into(self.buffer, offset, *values)
+
+    def add_wait(self, side, wait_ns):
+        """読み書きとは別に発生した待機時間を記録"""
+        offset = STATS_OFFSET + side * STATS_SIZE + 32
+        value = struct.unpack_from('<Q', self.buffer, offset)[0]
+        struct.pack_into('<Q', self.buffer, offset, value + wait_ns)
+
+    # ==== エントリ表 ====
+
+    def _entry_at(self, index):
+        return Entry(index, _ENTRY.unpack_from(self.buffer, HEADER_SIZE + index * ENTRY_SIZE))
+
+    def store_entry(self, entry):
+        """エントリを書き戻す"""
+        _ENTRY.pack_into(self.buffer, HEADER_SIZE + entry.index * ENTRY_SIZE, *entry.pack())
+
+    def _dtype_at(self, index):
+        return struct.unpack_from('<I', self.buffer, HEADER_SIZE + index * ENTRY_SIZE + ENTRY_DTYPE_OFFSET)[0]
+
+    def find(self, name):
+        """名前でエントリを検索（見つからない場合はNone）"""
+        h = name_hash(name)
+        for probe in range(MAX_ENTRIES):
+            index = (h + probe) & (MAX_ENTRIES - 1)
+            dtype = self._dtype_at(index)
+            if dtype == DTYPE_NONE:
+                return None
+            if dtype == DTYPE_DELETED:
+                continue
+            entry = self._entry_at(index)
+            if entry.name_hash == h and entry.name == name:
+                return entry
+        return None
+
+    def find_or_insert(self, name, dtype):
+        """名前でエントリを検索し、無ければ空きエントリ（削除済みのものを優先）を確保
+
+        既存のエントリはロックなしで引き、新しく確保する場合だけ ArenaLock を取って探し直します
+        （FreeFEM側の shm_find_or_insert_entry と同じ手順）。
+        """
+        if len(name.encode('utf-8')) >= NAME_LEN:
+            raise ValueError(f"変数名が長すぎます（最大{NAME_LEN - 1}バイト）: {name}")
+        entry = self.find(name)
+        if entry is not None:
+            return entry
+        with ArenaLock(self.buffer):
+            return self._insert(name, dtype)
+
+    def _insert(self, name, dtype):
+        """空きエントリを確保（ロックを保持して呼ぶ）"""
+        h = name_hash(name)
+        vacant = None
+        for probe in range(MAX_ENTRIES):
+            index = (h + probe) & (MAX_ENTRIES - 1)
+            current = self._dtype_at(index)
+            if current == DTYPE_DELETED:
+                if vacant is None:
+                    vacant = index
+                continue
+            if current == DTYPE_NONE:
+                if vacant is None:
+                    vacant = index
+                break
+            entry = self._entry_at(index)
+            if entry.name_hash == h and entry.name == name:
+                return entry
+        if vacant is None:
+            raise MemoryError(f"エントリ表が満杯です（最大{MAX_ENTRIES}個）")
+        # ロックなしで検索している側の探索を途切れさせないよう、dtype は最後に書き換える
+        entry = Entry(vacant, (name.encode('utf-8'), h, self._dtype_at(vacant), 0, 0, 0, 0, 0, 0, 0, 0, 0))
+        self.store_entry(entry)
+        store_release_4(self.buffer, HEADER_SIZE + vacant * ENTRY_SIZE + ENTRY_DTYPE_OFFSET, dtype)
+        entry.dtype = dtype
+        fetch_add(self.buffer, ENTRY_COUNT_OFFSET, 1, size=4)
+        return entry
+
+    def delete(self, entry):
+        """エントリを削除し、ペイロードのブロックを空きリストに戻す（エントリの確保と同じくロックを保持する）"""
+        with ArenaLock(self.buffer):
+            if entry.offset != 0:
+                self._push_block(entry.offset, entry.capacity)
+            store_release_4(self.buffer, HEADER_SIZE + entry.index * ENTRY_SIZE + ENTRY_DTYPE_OFFSET, DTYPE_DELETED)
+            tombstone = Entry(entry.index, (b'', 0, DTYPE_DELETED, 0, 0, 0, 0, 0, 0, 0, 0, 0))
+            self.store_entry(tombstone)
+            fetch_add(self.buffer, ENTRY_COUNT_OFFSET, -1, size=4)
+        fetch_add(self.buffer, GENERATION_OFFSET, 1)
+
+    def entries(self):
+        """使用中の全エントリ"""
+        return [self._entry_at(i) for i in range(MAX_ENTRIES)
+                if self._dtype_at(i) not in (DTYPE_NONE, DTYPE_DELETED)]
+
+    # ==== アリーナ ====
+
+    def _arena(self):
+        return list(_ARENA.unpack_from(self.buffer, ARENA_OFFSET))
+
+    def free_bytes(self):
+        """空きリストにあるブロックの合計バイト数"""
+        return self._arena()[2]
+
+    def _push_block(self, offset, size):
+        """ブロックを空きリストに戻す（ロックを保持して呼ぶ）"""
+        c = block_class(size)
+        if ALIGNMENT << c != size:
+            # 最大の種類を超える大きさのブロックは再利用しない
+            return
+        arena = self._arena()
+        _NEXT.pack_into(self.buffer, offset, arena[3 + c])
+        arena[3 + c] = offset
+        arena[2] += size
+        _ARENA.pack_into(self.buffer, ARENA_OFFSET, *arena)
+
+    def _pop_block(self, size):
+        """size バイトのブロックを割り当てる（空きリストに無ければデータ領域の末尾から。ロックを保持して呼ぶ）
+
+        Returns:
+            int: ブロックの位置（セグメントに収まらない場合はNone）
+        """
+        c = block_class(size)
+        arena = self._arena()
+        offset = arena[3 + c]
+        if offset != 0 and ALIGNMENT << c == size:
+            arena[3 + c] = _NEXT.unpack_from(self.buffer, offset)[0]
+            arena[2] -= size
+            _ARENA.pack_into(self.buffer, ARENA_OFFSET, *arena)
+            return offset
+        header = self._header()
+        offset = align(header[6])
+        if offset + size > header[2]:
+            return None
+        struct.pack_into('<Q', self.buffer, DATA_END_OFFSET, offset + size)
+        return offset
+
+    # ==== ペイロード ====
+
+    def required_size(self, nbytes):
+        """新たにnbytes（ブロックの大きさの合計）を割り当てた場合に必要なセグメントサイズ"""
+        return align(self._header()[6]) + nbytes
+
+    def grow_to(self, segment_size):
+        """拡張後のセグメントサイズをヘッダーに記録（縮小はしない。data_end と同じくロックを保持して更新する）"""
+        with ArenaLock(self.buffer):
+            if segment_size > self.segment_size:
+                struct.pack_into('<Q', self.buffer, SEGMENT_SIZE_OFFSET, segment_size)
+
+    def reserve(self, entry, nbytes):
+        """エントリのペイロード領域を確保（容量が足りていれば再利用し、
+        足りなければ新しいブロックを割り当てて古いブロックを空きリストに戻す）"""
+        if entry.capacity >= nbytes and entry.offset != 0:
+            return
+        capacity = block_size(nbytes)
+        with ArenaLock(self.buffer):
+            offset = self._pop_block(capacity)
+            if offset is not None and entry.offset != 0:
+                self._push_block(entry.offset, entry.capacity)
+        if offset is None:
+            header = self._header()
+            raise MemoryError(f"共有メモリの容量不足です (必要: {align(header[6]) + capacity}, "
+                              f"利用可能: {header[2]})")
+        entry.offset = offset
+        entry.capacity = capacity
+        # 確保した領域を他の書き込みから見えるようにエントリ表に記録する
+        self.store_entry(entry)
+
+    def publish(self, entry, shape, nbytes):
+        """書き込み完了後に形状とサイズを確定し、世代番号を進める"""
+        entry.ndim = len(shape)
+        entry.shape = tuple(shape)
+        entry.nbytes = nbytes
+        entry.generation += 1
+        self.store_entry(entry)
+        fetch_add(self.buffer, GENERATION_OFFSET, 1)
+
+    def payload(self, entry, count=None):
+        """エントリのペイロードを指すNumPy配列（コピーなし）"""
+        dtype = numpy_dtype(entry.dtype)
+        if count is None:
+            count = entry.nbytes // dtype.itemsize
+        return np.frombuffer(self.buffer, dtype=dtype, count=count, offset=entry.offset)
@@ -8,119 +8,137 @@ PyFreeFEM共有メモリマネージャー
 
 import os
 import sys
-import json
-import time
+import mmap
 import struct
+import time
 import platform
 import numpy as np
 from pathlib import Path
 
-# Linuxの場合のみsysv_ipcをインポート
-if platform.system() == 'Linux':
-    import sysv_ipc
+from . import shm_layout
+from . import shm_mapping
+from . import shm_sync
 
 class SharedMemoryManager:
-    """共有メモリを管理するクラス"""
+    """共有メモリを管理するクラス
+
+    POSIX共有メモリ (/dev/shm/<name>) をマッピングし、FreeFEMプラグイン
+    (shm_implementation.cpp) と同じバイナリレイアウト (shm_layout) で
+    名前付き変数を読み書きします。
+    """
     
-    def __init__(self, name, size=1024*1024, create=True):
+    def __init__(self, name, size=1024*1024, create=True, hugepages=False, populate=False, numa_node=None):
         """初期化処理
         
+        マッピング方法（hugepages / populate / numa_node）はセグメントを新しく作成した場合に
+        ヘッダーに記録され、FreeFEM側を含む以後のマッピング・拡張にも適用されます。
+        既存のセグメントに接続した場合は、作成時に記録された方法に従います。
+        
         Args:
             name (str): 共有メモリの名前
             size (int): 共有メモリのサイズ (バイト単位)
             create (bool): メモリセグメントを新規作成するかどうか
+            hugepages (bool): 透過的ヒュージページ（madvise(MADV_HUGEPAGE)）を使うかどうか
+            populate (bool): マッピング時にページを割り当てておくかどうか
+            numa_node (int, optional): ページを割り当てるNUMAノード（mbind）
         """
         # 非Linuxプラットフォームでは機能しないが、インポートエラーは防止
         if platform.system() != 'Linux':
             raise RuntimeError("共有メモリ機能はLinux環境でのみサポートされています")
             
         self.name = name
-        self.size = size
-        
-        # キーを生成（名前からハッシュ値を生成）
-        self.key = self._generate_key_from_name(name)
+        self.path = os.path.join('/dev/shm', name)
         
-        # ヘッダーサイズ（メタデータ用）
-        self.header_size = 1024  # 最初の1KBはヘッダー情報用に予約
+        # エントリ表を含むヘッダー領域のサイズ
+        self.header_size = shm_layout.TABLE_SIZE
         
         # データ領域の開始位置
         self.data_offset = self.header_size
         
-        # メタデータの初期化
-        self.metadata = {}
+        map_flags = ((shm_layout.MAP_HUGEPAGE if hugepages else 0)
+                     | (shm_layout.MAP_POPULATE if populate else 0))
+        if numa_node is not None and not 0 <= numa_node < shm_mapping.MAX_NUMA_NODES:
+            raise ValueError(f"NUMAノードの指定が不正です: {numa_node}")
         
         try:
             if create:
-                # 共有メモリセグメントを作成
-                self.memory = sysv_ipc.SharedMemory(
-                    self.key, 
-                    sysv_ipc.IPC_CREAT | 0o666, 
-                    size=self.size
-                )
-                self._init_header()
+                size = shm_mapping.round_size(size, map_flags)
+                # 共有メモリセグメントを作成（既存のものは縮めない）
+                fd = os.open(self.path, os.O_CREAT | os.O_RDWR, 0o666)
+                current = os.fstat(fd).st_size
+                if current < size:
+                    os.ftruncate(fd, size)
+                else:
+                    size = current
             else:
                 # 既存の共有メモリセグメントに接続
-                self.memory = sysv_ipc.SharedMemory(self.key)
-                self._load_header()
+                fd = os.open(self.path, os.O_RDWR)
+                size = os.fstat(fd).st_size
+            
+            # 拡張の検出（fstat）のためにファイル記述子は保持しておく
+            self._fd = fd
+            try:
+                self.memory = mmap.mmap(fd, size, mmap.MAP_SHARED, mmap.PROT_READ | mmap.PROT_WRITE)
+            except Exception:
+                os.close(fd)
+                raise
+            self.size = size
+            # read_mesh で読み込んだメッシュ（変数名 -> (ハッシュ, 配列)）
+            self._meshes = {}
+            # write_params で書き込んだパラメータブロック（変数名 -> (オフセット, 世代番号, 各パラメータの配置)）
+            self._param_blocks = {}
+            
+            self.layout = shm_layout.SegmentLayout(self.memory)
+            if create and not self.layout.is_valid():
+                self.layout.init(self.size)
+                self.layout.set_map_options(map_flags, numa_node)
+            elif not self.layout.is_valid():
+                raise ValueError("共有メモリのフォーマットが不正です")
+            self._apply_mapping(0)
                 
-            print(f"共有メモリセグメント '{name}' (ID: {self.key}) に接続しました")
+            print(f"共有メモリセグメント '{name}' ({self.path}) に接続しました")
         
         except Exception as e:
             raise RuntimeError(f"共有メモリの初期化に失敗しました: {str(e)}")
     
-    def _generate_key_from_name(self, name):
-        """名前からIPCキーを生成する
-        
-        Args:
-            name (str): 共有メモリの名前
+    def _apply_mapping(self, start):
+        """ヘッダーに記録されたマッピング方法をマッピングの start バイト目以降に適用"""
+        flags = self.layout.map_flags
+        node = self.layout.numa_node
+        if flags or node is not None:
+            shm_mapping.apply(self.memory, start, flags, node, self.name)
+    
+    def _refresh(self):
+        """他プロセスがセグメントを拡張していればマッピングを追従させる
         
-        Returns:
-            int: 生成されたキー値
+        ヘッダーのサイズがマッピングを超えていない限り何もしない（システムコールなし）。
         """
-        # 単純なハッシュ関数 (より堅牢な実装では、一貫性のあるハッシュ関数を使用)
-        hash_value = 0
-        for char in name:
-            hash_value = (hash_value * 31 + ord(char)) & 0x7fffffff
-        
-        # キーが0の場合は使用できないため、1を加算
-        if hash_value == 0:
-            hash_value = 1
-            
-        return hash_value
-    
-    def _init_header(self):
-        """ヘッダー情報を初期化"""
-        self.metadata = {
-            'version': '1.0',
-            'create_time': time.time(),
-            'name': self.name,
-            'variables': {}
-        }
-        self._save_header()
+        advertised = self.layout.segment_size
+        if advertised <= self.size:
+            return
+        # ファイルを縮めないよう、実サイズとヘッダーの大きい方に合わせる
+        new_size = max(advertised, os.fstat(self._fd).st_size)
+        self._resize(new_size)
+        self._apply_mapping(self.size)
+        self.size = new_size
     
-    def _save_header(self):
-        """ヘッダー情報を保存"""
-        header_json = json.dumps(self.metadata).encode('utf-8')
-        
-        # ヘッダーサイズを超えないようにチェック
-        if len(header_json) >= self.header_size:
-            raise ValueError(f"ヘッダー情報が大きすぎます ({len(header_json)} バイト > {self.header_size} バイト)")
-        
-        # ヘッダー情報の長さを保存 (最初の4バイト)
-        self.memory.write(struct.pack('I', len(header_json)), 0)
-        
-        # ヘッダー情報自体を保存 (4バイト目以降)
-        self.memory.write(header_json, 4)
+    def _resize(self, new_size):
+        """マッピングを new_size バイトに変更"""
+        try:
+            self.memory.resize(new_size)
+        except BufferError as e:
+            raise RuntimeError(
+                f"共有メモリを直接指す配列（get_array_view など）を参照中のため、"
+                f"セグメント '{self.name}' のマッピングを拡張できません。参照を破棄してください") from e
     
-    def _load_header(self):
-        """ヘッダー情報を読み込み"""
-        # ヘッダー情報の長さを読み込み
-        header_len_bytes = self.memory.read(4, 0)
-        header_len = struct.unpack('I', header_len_bytes)[0]
-        
-        # ヘッダー情報を読み込み
-        header_json = self.memory.read(header_len, 4)
-        self.metadata = json.loads(header_json.decode('utf-8'))
+    def _grow(self, required):
+        """セグメントをrequiredバイト以上に拡張（現在の2倍以上に幾何級数的に拡張）"""
+        new_size = shm_mapping.round_size(max(required, self.size * 2), self.layout.map_flags)
+        new_size = max(new_size, os.fstat(self._fd).st_size)
+        self._resize(new_size)
+        self._apply_mapping(self.size)
+        self.size = new_size
+        self.layout.grow_to(new_size)
     
     def _get_var_info(self, key):
         """変数情報を取得
@@ -129,61 +147,95 @@ class SharedMemoryManager:
             key (str): 変数名
             
         Returns:
-            dict: 変数情報（存在しない場合はNone）
+            shm_layout.Entry: 変数情報（存在しない場合はNone）
         """
-        self._load_header()  # 最新のメタデータを読み込み
-        return self.metadata['variables'].get(key)
+        self._refresh()
+        return self.layout.find(key)
+    
+    @staticmethod
+    def _type_name(entry):
+        """エントリの種類名（エラーメッセージ用）"""
+        if entry.dtype == shm_layout.DTYPE_STRING:
+            return 'string'
+        if entry.ndim == 0:
+            return 'int' if entry.dtype in (shm_layout.DTYPE_INT64, shm_layout.DTYPE_INT32) else 'double'
+        return 'array'
+    
+    def _check_type(self, key, entry, expected):
+        """型チェック"""
+        actual = self._type_name(entry)
+        if actual != expected:
+            raise TypeError(f"型の不一致: '{key}' は {actual} 型として登録されています")
     
-    def _register_var(self, key, var_type, offset, size):
-        """変数を登録
+    def _get_entry(self, key, expected):
+        """読み込み用にエントリを取得"""
+        entry = self._get_var_info(key)
+        
+        if entry is None:
+            raise KeyError(f"変数 '{key}' は共有メモリ内に存在しません")
+        
+        self._check_type(key, entry, expected)
+        return entry
+    
+    def _write_entry(self, key, expected, dtype, shape, data):
+        """エントリを確保してデータを書き込み
         
         Args:
             key (str): 変数名
-            var_type (str): データ型
-            offset (int): オフセット位置
-            size (int): サイズ（バイト）
+            expected (str): 種類名（'int', 'double', 'string', 'array'）
+            dtype (int): shm_layoutのデータ型コード
+            shape (tuple): 形状（スカラーの場合は空）
+            data (bytes-like): 書き込むデータ
         """
-        self._load_header()  # 最新のメタデータを読み込み
-        
-        self.metadata['variables'][key] = {
-            'type': var_type,
-            'offset': offset,
-            'size': size,
-            'update_time': time.time()
-        }
-        
-        self._save_header()
+        self._write_entries([(key, expected, dtype, shape, data)])
     
-    def _allocate_memory(self, size):
-        """メモリ領域を確保
+    def _write_entries(self, items):
+        """複数のエントリを確保してデータを書き込み、1回の通知でまとめて公開
         
         Args:
-            size (int): 必要なバイトサイズ
-            
-        Returns:
-            int: 割り当てられたオフセット位置
+            items (list): (変数名, 種類名, データ型コード, 形状, データ) のタプルのリスト
+                （各要素の意味は _write_entry と同じ）
         """
-        self._load_header()  # 最新のメタデータを読み込み
-        
-        # 変数情報から使用済みの最大オフセットを特定
-        max_offset = self.data_offset
-        for var in self.metadata['variables'].values():
-            var_end = var['offset'] + var['size']
-            if var_end > max_offset:
-                max_offset = var_end
-        
-        # 新しいオフセット位置（メモリ内の次の利用可能なスペース）
-        new_offset = max_offset
-        
-        # メモリ境界を考慮し8バイト境界に合わせる
-        if new_offset % 8 != 0:
-            new_offset += 8 - (new_offset % 8)
+        start = time.perf_counter_ns()
+        keys = [item[0] for item in items]
+        if len(set(keys)) != len(keys):
+            raise ValueError(f"同じ変数名が複数回指定されています: {keys}")
         
-        # メモリ容量を超えていないか確認
-        if new_offset + size > self.size:
-            raise MemoryError(f"共有メモリの容量不足です (必要: {new_offset + size}, 利用可能: {self.size})")
+        self._refresh()
+        # 容量不足の場合は残りのエントリの分までまとめて拡張し、拡張を1回で済ませる
+        remaining = sum(shm_layout.block_size(len(item[4])) for item in items)
+        entries = []
+        for key, expected, dtype, shape, data in items:
+            entry = self.layout.find_or_insert(key, dtype)
+            if entry.generation:
+                self._check_type(key, entry, expected)
+            
+            nbytes = len(data)
+            try:
+                self.layout.reserve(entry, nbytes)
+            except MemoryError:
+                # 容量不足の場合はセグメントを拡張してから再確保する
+                self._grow(self.layout.required_size(remaining))
+                self.layout.reserve(entry, nbytes)
+            remaining -= shm_layout.block_size(nbytes)
+            entry.dtype = dtype
+            entries.append(entry)
         
-        return new_offset
+        ready = time.perf_counter_ns()
+        total = 0
+        for entry, (_, _, _, shape, data) in zip(entries, items):
+            nbytes = len(data)
+            self.memory[entry.offset:entry.offset + nbytes] = data
+            self.layout.publish(entry, shape, nbytes)
+            total += nbytes
+        end = time.perf_counter_ns()
+        self.layout.record_transfer(shm_layout.STATS_PYTHON, True, total, 0, end - ready, end - start)
+        shm_sync.notify(self.memory)
+    
+    def _record_read(self, start, ready, nbytes):
+        """読み込み1回分を転送統計に記録"""
+        end = time.perf_counter_ns()
+        self.layout.record_transfer(shm_layout.STATS_PYTHON, False, nbytes, 0, end - ready, end - start)
     
     def write_int(self, key, value):
         """整数値を書き込み
@@ -192,22 +244,7 @@ class SharedMemoryManager:
             key (str): 変数名
             value (int): 整数値
         """
-        var_info = self._get_var_info(key)
-        
-        if var_info is None:
-            # 新規登録の場合
-            offset = self._allocate_memory(4)
-            self._register_var(key, 'int', offset, 4)
-        else:
-            # 更新の場合
-            offset = var_info['offset']
-            
-            # 型チェック
-            if var_info['type'] != 'int':
-                raise TypeError(f"型の不一致: '{key}' は {var_info['type']} 型として登録されています")
-        
-        # 値を書き込み
-        self.memory.write(struct.pack('i', value), offset)
+        self._write_entry(key, 'int', shm_layout.DTYPE_INT64, (), struct.pack('<q', value))
     
     def read_int(self, key):
         """整数値を読み込み
@@ -218,18 +255,12 @@ class SharedMemoryManager:
         Returns:
             int: 読み込んだ整数値
         """
-        var_info = self._get_var_info(key)
-        
-        if var_info is None:
-            raise KeyError(f"変数 '{key}' は共有メモリ内に存在しません")
-        
-        # 型チェック
-        if var_info['type'] != 'int':
-            raise TypeError(f"型の不一致: '{key}' は {var_info['type']} 型として登録されています")
-        
-        # 値を読み込み
-        data = self.memory.read(4, var_info['offset'])
-        return struct.unpack('i', data)[0]
+        start = time.perf_counter_ns()
+        entry = self._get_entry(key, 'int')
+        ready = time.perf_counter_ns()
+        value = int(self.layout.payload(entry, count=1)[0])
+        self._record_read(start, ready, entry.nbytes)
+        return value
     
     def write_double(self, key, value):
         """浮動小数点値を書き込み
@@ -238,22 +269,7 @@ class SharedMemoryManager:
             key (str): 変数名
             value (float): 浮動小数点値
         """
-        var_info = self._get_var_info(key)
-        
-        if var_info is None:
-            # 新規登録の場合
-            offset = self._allocate_memory(8)
-            self._register_var(key, 'double', offset, 8)
-        else:
-            # 更新の場合
-            offset = var_info['offset']
-            
-            # 型チェック
-            if var_info['type'] != 'double':
-                raise TypeError(f"型の不一致: '{key}' は {var_info['type']} 型として登録されています")
-        
-        # 値を書き込み
-        self.memory.write(struct.pack('d', value), offset)
+        self._write_entry(key, 'double', shm_layout.DTYPE_FLOAT64, (), struct.pack('<d', value))
     
     def read_double(self, key):
         """浮動小数点値を読み込み
@@ -264,18 +280,12 @@ class SharedMemoryManager:
         Returns:
             float: 読み込んだ浮動小数点値
         """
-        var_info = self._get_var_info(key)
-        
-        if var_info is None:
-            raise KeyError(f"変数 '{key}' は共有メモリ内に存在しません")
-        
-        # 型チェック
-        if var_info['type'] != 'double':
-            raise TypeError(f"型の不一致: '{key}' は {var_info['type']} 型として登録されています")
-        
-        # 値を読み込み
-        data = self.memory.read(8, var_info['offset'])
-        return struct.unpack('d', data)[0]
+        start = time.perf_counter_ns()
+        entry = self._get_entry(key, 'double')
+        ready = time.perf_counter_ns()
+        value = float(self.layout.payload(entry, count=1)[0])
+        self._record_read(start, ready, entry.nbytes)
+        return value
     
     def write_string(self, key, value):
         """文字列を書き込み
@@ -286,32 +296,7 @@ class SharedMemoryManager:
         """
         # 文字列をUTF-8でエンコード
         encoded = value.encode('utf-8')
-        size = len(encoded)
-        
-        var_info = self._get_var_info(key)
-        
-        if var_info is None:
-            # 新規登録の場合
-            offset = self._allocate_memory(size + 4)  # サイズ情報用に4バイト追加
-            self._register_var(key, 'string', offset, size + 4)
-        else:
-            # 更新の場合
-            offset = var_info['offset']
-            
-            # 型チェック
-            if var_info['type'] != 'string':
-                raise TypeError(f"型の不一致: '{key}' は {var_info['type']} 型として登録されています")
-            
-            # サイズが大きくなった場合は再割り当て
-            if size + 4 > var_info['size']:
-                offset = self._allocate_memory(size + 4)
-                self._register_var(key, 'string', offset, size + 4)
-        
-        # サイズを書き込み
-        self.memory.write(struct.pack('I', size), offset)
-        
-        # 文字列データを書き込み
-        self.memory.write(encoded, offset + 4)
+        self._write_entry(key, 'string', shm_layout.DTYPE_STRING, (len(encoded),), encoded)
     
     def read_string(self, key):
         """文字列を読み込み
@@ -322,68 +307,315 @@ class SharedMemoryManager:
         Returns:
             str: 読み込んだ文字列
         """
-        var_info = self._get_var_info(key)
+        start = time.perf_counter_ns()
+        entry = self._get_entry(key, 'string')
+        ready = time.perf_counter_ns()
+        value = bytes(self.memory[entry.offset:entry.offset + entry.nbytes]).decode('utf-8')
+        self._record_read(start, ready, entry.nbytes)
+        return value
+    
+    # パラメータブロック <key> は次の形式のuint8エントリとして格納する（param_ops.cpp と同一）
+    #   [magic, 個数] [名前 (40バイト), 種類, 文字列長, 値, 文字列の容量] x 個数 [文字列領域]
+    _PARAM_MAGIC = 0x534d5250
+    _PARAM_HEADER = struct.Struct('<II')
+    _PARAM_RECORD = struct.Struct('<40sII8sQ')
+    _PARAM_NAME_LEN = 40
+    _PARAM_DOUBLE = 1
+    _PARAM_INT = 2
+    _PARAM_STRING = 3
+    # 文字列に確保する最小の容量（これを超えない限りその場で書き換えられる）
+    _PARAM_STRING_CAPACITY = 64
+
+    @classmethod
+    def _param_value(cls, name, value):
+        """パラメータの種類とエンコード済みの値"""
+        if isinstance(value, (bool, int, np.integer)):
+            return cls._PARAM_INT, struct.pack('<q', int(value))
+        if isinstance(value, (float, np.floating)):
+            return cls._PARAM_DOUBLE, struct.pack('<d', float(value))
+        if isinstance(value, str):
+            return cls._PARAM_STRING, value.encode('utf-8')
+        raise TypeError(f"パラメータ '{name}' の型はサポートされていません: {type(value).__name__}")
+
+    def _build_params(self, key, values):
+        """パラメータブロックを作り直して書き込み、各パラメータの配置を返す"""
+        count = len(values)
+        strings = self._PARAM_HEADER.size + count * self._PARAM_RECORD.size
+        records = []
+        for name, (kind, encoded) in values.items():
+            capacity = 0
+            if kind == self._PARAM_STRING:
+                capacity = (max(2 * len(encoded), self._PARAM_STRING_CAPACITY) + 7) & ~7
+            records.append((name, kind, capacity, strings))
+            strings += capacity
         
-        if var_info is None:
-            raise KeyError(f"変数 '{key}' は共有メモリ内に存在しません")
+        block = bytearray(strings)
+        self._PARAM_HEADER.pack_into(block, 0, self._PARAM_MAGIC, count)
+        layout = []
+        for index, (name, kind, capacity, position) in enumerate(records):
+            encoded = values[name][1]
+            record = self._PARAM_HEADER.size + index * self._PARAM_RECORD.size
+            if kind == self._PARAM_STRING:
+                block[position:position + len(encoded)] = encoded
+                value = struct.pack('<Q', position)
+            else:
+                value = encoded
+            self._PARAM_RECORD.pack_into(block, record, name.encode('utf-8'), kind, len(encoded) if capacity else 0,
+                                         value, capacity)
+            layout.append((name, kind, record, position, capacity))
+        self._write_entry(key, 'array', shm_layout.DTYPE_UINT8, (len(block),), block)
+        return tuple(layout)
+
+    def write_params(self, key, params):
+        """名前付きのスカラーをまとめたパラメータブロックを書き込み
+        
+        FreeFEM側は shmGetParams(segment, key, "dt,n,mode", dt, n, mode) で
+        すべての値を1回で変数に読み込みます。コマンドライン引数（key=value と getARGV）や
+        スカラーごとの変数は不要です。2回目以降は名前と種類が同じで文字列が容量に収まれば
+        ブロックを作り直さずに値だけをその場で書き換えるため、反復ごとに呼び出しても
+        セグメント内の領域は確保されません。
+        
+        Args:
+            key (str): 変数名
+            params (dict): パラメータ名 -> 値（int / bool は int、float は real、str は string）
+        """
+        values = {}
+        for name, value in params.items():
+            encoded = name.encode('utf-8')
+            if not encoded or len(encoded) >= self._PARAM_NAME_LEN or ',' in name:
+                raise ValueError(f"パラメータ名が不正です（1〜{self._PARAM_NAME_LEN - 1}バイト、カンマは不可）: '{name}'")
+            values[name] = self._param_value(name, value)
         
-        # 型チェック
-        if var_info['type'] != 'string':
-            raise TypeError(f"型の不一致: '{key}' は {var_info['type']} 型として登録されています")
+        self._refresh()
+        entry = self.layout.find(key)
+        cached = self._param_blocks.get(key)
+        if (entry is None or cached is None or cached[:2] != (entry.offset, entry.generation)
+                or not self._update_params(entry, cached[2], values)):
+            layout = self._build_params(key, values)
+            entry = self.layout.find(key)
+            self._param_blocks[key] = (entry.offset, entry.generation, layout)
+            return
         
-        # サイズを読み込み
-        size_data = self.memory.read(4, var_info['offset'])
-        size = struct.unpack('I', size_data)[0]
+        self.layout.publish(entry, entry.shape, entry.nbytes)
+        self._param_blocks[key] = (entry.offset, entry.generation, cached[2])
+        shm_sync.notify(self.memory)
+
+    def _update_params(self, entry, layout, values):
+        """配置が変わらない場合に値だけをその場で書き換える（書き換えられない場合はFalse）"""
+        if len(layout) != len(values):
+            return False
+        for name, kind, record, position, capacity in layout:
+            value = values.get(name)
+            if value is None or value[0] != kind:
+                return False
+            if kind == self._PARAM_STRING and len(value[1]) > capacity:
+                return False
         
-        # 文字列データを読み込み
-        data = self.memory.read(size, var_info['offset'] + 4)
-        return data.decode('utf-8')
-    
-    def write_array(self, key, array):
+        start = time.perf_counter_ns()
+        total = 0
+        for name, kind, record, position, capacity in layout:
+            encoded = values[name][1]
+            offset = entry.offset + record + self._PARAM_NAME_LEN + 4
+            if kind == self._PARAM_STRING:
+                self.memory[entry.offset + position:entry.offset + position + len(encoded)] = encoded
+                struct.pack_into('<I', self.memory, offset, len(encoded))
+            else:
+                self.memory[offset + 4:offset + 12] = encoded
+            total += len(encoded)
+        end = time.perf_counter_ns()
+        self.layout.record_transfer(shm_layout.STATS_PYTHON, True, total, 0, end - start, end - start)
+        return True
+
+    def read_params(self, key):
+        """パラメータブロックを読み込み
+        
+        Args:
+            key (str): 変数名
+            
+        Returns:
+            dict: パラメータ名 -> 値（int / float / str）
+        """
+        start = time.perf_counter_ns()
+        entry = self._get_entry(key, 'array')
+        if entry.dtype != shm_layout.DTYPE_UINT8 or entry.nbytes < self._PARAM_HEADER.size:
+            raise TypeError(f"型の不一致: '{key}' はパラメータブロックではありません")
+        magic, count = self._PARAM_HEADER.unpack_from(self.memory, entry.offset)
+        if magic != self._PARAM_MAGIC or entry.nbytes < self._PARAM_HEADER.size + count * self._PARAM_RECORD.size:
+            raise TypeError(f"型の不一致: '{key}' はパラメータブロックではありません")
+        ready = time.perf_counter_ns()
+        
+        params = {}
+        for index in range(count):
+            record = entry.offset + self._PARAM_HEADER.size + index * self._PARAM_RECORD.size
+            name, kind, length, value, _ = self._PARAM_RECORD.unpack_from(self.memory, record)
+            name = name.rstrip(b'\0').decode('utf-8')
+            if kind == self._PARAM_DOUBLE:
+                params[name] = struct.unpack('<d', value)[0]
+            elif kind == self._PARAM_INT:
+                params[name] = struct.unpack('<q', value)[0]
+            elif kind == self._PARAM_STRING:
+                position = entry.offset + struct.unpack('<Q', value)[0]
+                params[name] = bytes(self.memory[position:position + length]).decode('utf-8')
+            else:
+                raise ValueError(f"パラメータの種類が不正です: {key}/{name} ({kind})")
+        self._record_read(start, ready, entry.nbytes)
+        return params
+
+    def write_array(self, key, array, dtype=np.float64):
         """配列を書き込み
         
         Args:
             key (str): 変数名
             array (numpy.ndarray): 書き込む配列
+            dtype (numpy.dtype): 共有メモリ上のデータ型（デフォルトはdouble）
         """
         # NumPy配列に変換
-        if not isinstance(array, np.ndarray):
-            array = np.array(array, dtype=np.float64)
-        elif array.dtype != np.float64:
-            array = array.astype(np.float64)
+        array = np.ascontiguousarray(array, dtype=dtype)
+        if array.ndim == 0 or array.ndim > shm_layout.MAX_NDIM:
+            raise ValueError(f"配列の次元数は1〜{shm_layout.MAX_NDIM}である必要があります: {array.ndim}")
+        
+        self._write_entry(key, 'array', shm_layout.dtype_code(array.dtype), array.shape,
+                          memoryview(array).cast('B'))
+    
+    def write_arrays(self, arrays, dtype=np.float64):
+        """複数の配列をまとめて書き込み、1回の通知で公開
+        
+        FreeFEM側の shmReadBatch(segment, "a,b,c", a, b, c) は全配列がそろうまで待機するため、
+        関連する配列（密度・変位・感度など）を1回の受け渡しで送ることができます。
         
-        # 配列のサイズを計算
-        size = array.size * 8  # double型は8バイト
+        Args:
+            arrays (dict or list): 変数名から配列への辞書、または (変数名, 配列) のリスト
+            dtype (numpy.dtype): 共有メモリ上のデータ型（デフォルトはdouble）
+        """
+        items = []
+        for key, array in (arrays.items() if isinstance(arrays, dict) else arrays):
+            array = np.ascontiguousarray(array, dtype=dtype)
+            if array.ndim == 0 or array.ndim > shm_layout.MAX_NDIM:
+                raise ValueError(f"配列の次元数は1〜{shm_layout.MAX_NDIM}である必要があります: "
+                                 f"'{key}' ({array.ndim})")
+            items.append((key, 'array', shm_layout.dtype_code(array.dtype), array.shape,
+                          memoryview(array).cast('B')))
+        if items:
+            self._write_entries(items)
+    
+    def write_int_array(self, key, array):
+        """整数配列（int32）を書き込み
+        
+        Args:
+            key (str): 変数名
+            array (numpy.ndarray): 書き込む配列
+        """
+        self.write_array(key, array, dtype=np.int32)
+    
+    def read_array(self, key, dtype=None, out=None):
+        """配列を読み込み
         
-        var_info = self._get_var_info(key)
+        Args:
+            key (str): 変数名
+            dtype (numpy.dtype, optional): 変換後のデータ型（省略時は格納時の型）
+            out (numpy.ndarray, optional): 結果を書き込む配列（要素数が一致すること、形状は out に従う）
+            
+        Returns:
+            numpy.ndarray: 読み込んだ配列（out を指定した場合は out）
+        """
+        start = time.perf_counter_ns()
+        entry = self._get_entry(key, 'array')
+        ready = time.perf_counter_ns()
         
-        if var_info is None:
-            # 新規登録の場合
-            offset = self._allocate_memory(size + 12)  # サイズと次元数の情報用に12バイト追加
-            self._register_var(key, 'array', offset, size + 12)
+        # 配列データを読み込み
+        array = self.layout.payload(entry).reshape(entry.shape)
+        if out is not None:
+            if out.size != array.size:
+                raise ValueError(f"出力先の要素数が一致しません: '{key}' ({array.size} != {out.size})")
+            out[...] = array.reshape(out.shape)
+            self._record_read(start, ready, entry.nbytes)
+            return out
+        if dtype is not None and array.dtype != np.dtype(dtype):
+            array = array.astype(dtype)
         else:
-            # 更新の場合
-            offset = var_info['offset']
+            array = array.copy()
+        self._record_read(start, ready, entry.nbytes)
+        return array
+    
+    def read_arrays(self, keys, dtype=None, timeout=None):
+        """複数の配列をまとめて読み込み
+        
+        Args:
+            keys (list): 変数名のリスト
+            dtype (numpy.dtype, optional): 変換後のデータ型（省略時は格納時の型）
+            timeout (float, optional): 指定した場合、すべての変数が書き込まれるまで最大この秒数だけ待機する
             
-            # 型チェック
-            if var_info['type'] != 'array':
-                raise TypeError(f"型の不一致: '{key}' は {var_info['type']} 型として登録されています")
+        Returns:
+            dict: 変数名から読み込んだ配列への辞書（keys と同じ順序）
+        """
+        keys = list(keys)
+        if timeout is not None:
+            def ready():
+                return all(entry is not None and entry.generation > 0
+                           for entry in (self.layout.find(key) for key in keys))
             
-            # サイズが大きくなった場合は再割り当て
-            if size + 12 > var_info['size']:
-                offset = self._allocate_memory(size + 12)
-                self._register_var(key, 'array', offset, size + 12)
+            wait_start = time.perf_counter_ns()
+            found = shm_sync.wait_until(self.memory, ready, timeout)
+            self._record_wait(time.perf_counter_ns() - wait_start)
+            if not found:
+                missing = [key for key in keys if self.layout.find(key) is None]
+                raise TimeoutError(f"変数の待機中にタイムアウトしました: {missing or keys}")
         
-        # 配列のサイズと次元数を書き込み
-        self.memory.write(struct.pack('I', array.size), offset)
-        self.memory.write(struct.pack('I', array.ndim), offset + 4)
-        self.memory.write(struct.pack('I', array.shape[0]), offset + 8)
+        start = time.perf_counter_ns()
+        self._refresh()
+        entries = []
+        for key in keys:
+            entry = self.layout.find(key)
+            if entry is None:
+                raise KeyError(f"変数 '{key}' は共有メモリ内に存在しません")
+            self._check_type(key, entry, 'array')
+            entries.append(entry)
+        ready_ns = time.perf_counter_ns()
         
-        # 配列データを書き込み
-        self.memory.write(array.tobytes(), offset + 12)
+        arrays = {}
+        total = 0
+        for key, entry in zip(keys, entries):
+            array = self.layout.payload(entry).reshape(entry.shape)
+            if dtype is not None and array.dtype != np.dtype(dtype):
+                arrays[key] = array.astype(dtype)
+            else:
+                arrays[key] = array.copy()
+            total += entry.nbytes
+        self._record_read(start, ready_ns, total)
+        return arrays
     
-    def read_array(self, key):
-        """配列を読み込み
+    def get_array_view(self, key, readonly=False):
+        """共有メモリを直接指す配列を取得（コピーなし）
+        
+        データ型と形状はエントリの情報から決まります。返される配列は NumPy の
+        DLPack に対応しているため、``torch.from_dlpack(view)`` でもコピーせずに参照できます。
+        
+        配列は書き込み側が同じエントリを書き直すと内容が変わり、エントリの領域が
+        移動すると古い領域を指したままになります（エントリの世代番号で確認できます）。
+        古い領域は空きリストに戻り、他の変数に再利用されることがあります。
+        また、参照している間は同じ SharedMemoryManager でマッピングを拡張できないため、
+        使い終えたら参照（PyTorchのテンソルを含む）を破棄してください。
+        
+        Args:
+            key (str): 変数名
+            readonly (bool): Trueの場合は書き込みできない配列を返す
+                （読み込み専用の配列はNumPyのバージョンによってはDLPackで渡せない）
+            
+        Returns:
+            numpy.ndarray: エントリのデータを指す配列
+        """
+        start = time.perf_counter_ns()
+        entry = self._get_entry(key, 'array')
+        ready = time.perf_counter_ns()
+        
+        view = self.layout.payload(entry).reshape(entry.shape)
+        if readonly:
+            view.flags.writeable = False
+        self._record_read(start, ready, 0)
+        return view
+    
+    def read_int_array(self, key):
+        """整数配列を読み込み
         
         Args:
             key (str): 変数名
@@ -391,44 +623,972 @@ class SharedMemoryManager:
         Returns:
             numpy.ndarray: 読み込んだ配列
         """
-        var_info = self._get_var_info(key)
+        entry = self._get_entry(key, 'array')
+        if entry.dtype not in (shm_layout.DTYPE_INT32, shm_layout.DTYPE_INT64):
+            raise TypeError(f"型の不一致: '{key}' は整数配列ではありません")
+        return self.read_array(key)
+    
+    # 疎行列 <key> は <key>.indptr, <key>.indices, <key>.data と
+    # ヘッダー <key> = [行数, 列数, 非零要素数, 対称形式] として格納する（sparse_matrix_ops.cpp と同一）
+    _SPARSE_PARTS = ('indptr', 'indices', 'data')
+
+    def write_sparse_matrix(self, key, matrix):
+        """CSR形式の疎行列を書き込み（FreeFEM側は shmReadMatrix で読み込む）
         
-        if var_info is None:
-            raise KeyError(f"変数 '{key}' は共有メモリ内に存在しません")
+        Args:
+            key (str): 変数名
+            matrix: scipy.sparse の行列、または (indptr, indices, data, shape) のタプル
+        """
+        if hasattr(matrix, 'tocsr'):
+            matrix = matrix.tocsr()
+            indptr, indices, data, shape = matrix.indptr, matrix.indices, matrix.data, matrix.shape
+        else:
+            indptr, indices, data, shape = matrix
+        indptr = np.asarray(indptr)
+        nnz = len(indices)
+        if len(shape) != 2 or len(indptr) != shape[0] + 1 or len(data) != nnz:
+            raise ValueError(f"CSR形式の配列の大きさが一致しません: {key}")
+        if nnz > np.iinfo(np.int32).max or max(shape) > np.iinfo(np.int32).max:
+            raise ValueError(f"疎行列が大きすぎます（int32の範囲を超えています）: {key}")
+        if len(key) + len('.indices') >= shm_layout.NAME_LEN:
+            raise ValueError(f"行列名が長すぎます: {key}")
         
-        # 型チェック
-        if var_info['type'] != 'array':
-            raise TypeError(f"型の不一致: '{key}' は {var_info['type']} 型として登録されています")
+        # 4つのエントリをまとめて確保し、ヘッダーを最後に公開して行列全体の公開を表す
+        items = []
+        for name, array, dtype in ((f"{key}.indptr", indptr, np.int32), (f"{key}.indices", indices, np.int32),
+                                   (f"{key}.data", data, np.float64),
+                                   (key, [shape[0], shape[1], nnz, 0], np.int64)):
+            array = np.ascontiguousarray(array, dtype=dtype).reshape(-1)
+            items.append((name, 'array', shm_layout.dtype_code(array.dtype), array.shape,
+                          memoryview(array).cast('B')))
+        self._write_entries(items)
+    
+    def read_csr(self, key, copy=True):
+        """CSR形式の疎行列を配列のまま読み込み
         
-        # サイズと次元数を読み込み
-        size_data = self.memory.read(4, var_info['offset'])
-        ndim_data = self.memory.read(4, var_info['offset'] + 4)
-        shape_data = self.memory.read(4, var_info['offset'] + 8)
+        Args:
+            key (str): 変数名
+            copy (bool): Falseの場合は共有メモリを直接指す配列を返す
+            
+        Returns:
+            tuple: (indptr, indices, data, shape, half)
+                halfはFreeFEMの対称形式（0以外の場合は片側の三角部分だけが格納されている）
+        """
+        start = time.perf_counter_ns()
+        header = self._get_entry(key, 'array')
+        if header.dtype != shm_layout.DTYPE_INT64 or header.nbytes < 32:
+            raise TypeError(f"型の不一致: '{key}' は疎行列ではありません")
+        rows, cols, nnz, half = (int(v) for v in self.layout.payload(header, 4))
         
-        size = struct.unpack('I', size_data)[0]
-        ndim = struct.unpack('I', ndim_data)[0]
-        shape = (struct.unpack('I', shape_data)[0],)
+        expected = {'indptr': rows + 1, 'indices': nnz, 'data': nnz}
+        arrays = []
+        for part in self._SPARSE_PARTS:
+            entry = self._get_entry(f"{key}.{part}", 'array')
+            array = self.layout.payload(entry)
+            if array.size != expected[part]:
+                raise ValueError(f"疎行列のエントリの大きさが不正です: {key}.{part}")
+            arrays.append(array.copy() if copy else array)
+        ready = time.perf_counter_ns()
+        if copy:
+            self._record_read(start, ready, sum(a.nbytes for a in arrays))
+        return arrays[0], arrays[1], arrays[2], (rows, cols), half
+    
+    def view_sparse_matrix(self, key):
+        """共有メモリを直接指す scipy.sparse.csr_matrix を取得（コピーなし）
         
-        # 配列データを読み込み
-        data = self.memory.read(size * 8, var_info['offset'] + 12)
-        array = np.frombuffer(data, dtype=np.float64)
+        行列を参照している間は同じ SharedMemoryManager でマッピングを拡張できないため、
+        使い終えたら参照を破棄してください。対称形式の行列は格納されている三角部分だけを表します。
+        
+        Args:
+            key (str): 変数名
+            
+        Returns:
+            scipy.sparse.csr_matrix: 疎行列
+        """
+        from scipy.sparse import csr_matrix
+        indptr, indices, data, shape, _ = self.read_csr(key, copy=False)
+        return csr_matrix((data, indices, indptr), shape=shape, copy=False)
+    
+    def read_sparse_matrix(self, key):
+        """疎行列を読み込み（対称形式の場合は全体に展開したコピーを返す）
+        
+        Args:
+            key (str): 変数名
+            
+        Returns:
+            scipy.sparse.csr_matrix: 疎行列
+        """
+        from scipy.sparse import csr_matrix, diags
+        indptr, indices, data, shape, half = self.read_csr(key)
+        matrix = csr_matrix((data, indices, indptr), shape=shape, copy=False)
+        if half:
+            matrix = (matrix + matrix.T - diags(matrix.diagonal())).tocsr()
+        return matrix
+    
+    # メッシュ <key> は <key>.vertices, <key>.elements, <key>.labels と
+    # ヘッダー <key> = [次元, 頂点数, 要素数, ハッシュ] として格納する（mesh_ops.cpp と同一）
+    _MESH_HEADER_WORDS = 4
+
+    def read_mesh(self, key):
+        """FreeFEM側が shmWriteMesh / shmWriteFEFunction で書き込んだメッシュを読み込み
+        
+        前回読み込んだ時からハッシュが変わっていなければ、コピーせずに前回の配列を返します
+        （配列は共有されるため読み込み専用です）。
+        
+        Args:
+            key (str): メッシュの変数名
+            
+        Returns:
+            tuple: (vertices, elements, labels)
+                vertices は (頂点数, 次元) のfloat64、elements は (要素数, 次元 + 1) のint32
+                （0始まりの頂点番号）、labels は要素ごとのint32のラベル
+        """
+        start = time.perf_counter_ns()
+        header = self._get_entry(key, 'array')
+        if header.dtype != shm_layout.DTYPE_INT64 or header.nbytes < 8 * self._MESH_HEADER_WORDS:
+            raise TypeError(f"型の不一致: '{key}' はメッシュではありません")
+        dim, nv, nt, mesh_hash = (int(v) for v in self.layout.payload(header, self._MESH_HEADER_WORDS))
+        
+        cached = self._meshes.get(key)
+        if cached is not None and cached[0] == (dim, nv, nt, mesh_hash):
+            self._record_read(start, time.perf_counter_ns(), 0)
+            return cached[1]
+        
+        shapes = {'vertices': (nv, dim), 'elements': (nt, dim + 1), 'labels': (nt,)}
+        arrays = []
+        for part, shape in shapes.items():
+            entry = self._get_entry(f"{key}.{part}", 'array')
+            array = self.layout.payload(entry)
+            if array.size != int(np.prod(shape)):
+                raise ValueError(f"メッシュのエントリの大きさが不正です: {key}.{part}")
+            array = array.reshape(shape).copy()
+            array.flags.writeable = False
+            arrays.append(array)
+        ready = time.perf_counter_ns()
+        self._record_read(start, ready, sum(a.nbytes for a in arrays))
+        mesh = tuple(arrays)
+        self._meshes[key] = ((dim, nv, nt, mesh_hash), mesh)
+        return mesh
+    
+    def list_variables(self):
+        """登録されている変数名の一覧"""
+        return [entry.name for entry in self.layout.entries()]
+    
+    def check_variable_exists(self, key):
+        """変数が存在するかどうか"""
+        return self._get_var_info(key) is not None
+    
+    def delete_variable(self, key):
+        """変数を削除（FreeFEM側は shmDelete）
         
-        return array.reshape(shape)
+        領域はセグメント内の空きリストに戻り、同じ大きさの種類の次の書き込みで
+        再利用されます。長時間の実行で一時的な変数を繰り返し作る場合に、
+        セグメントが拡張され続けるのを防げます。
+        
+        Args:
+            key (str): 変数名
+        """
+        self._refresh()
+        entry = self.layout.find(key)
+        if entry is None:
+            raise KeyError(f"変数が見つかりません: {key}")
+        # 空きリストへの連結はブロックの先頭に書き込むため、サイズを確認した後に
+        # 他プロセスが拡張して割り当てたブロックであればマッピングを追従させる
+        if entry.offset + entry.capacity > self.size:
+            self._refresh()
+        self._meshes.pop(key, None)
+        self._param_blocks.pop(key, None)
+        self.layout.delete(entry)
+        shm_sync.notify(self.memory)
+    
+    @property
+    def sequence(self):
+        """通知シーケンス（いずれかの変数が書き込まれるたびに増加）"""
+        return shm_sync.load_seq(self.memory)
+    
+    def wait_for_update(self, seen=None, timeout=shm_sync.WAIT_TIMEOUT):
+        """いずれかの変数が書き込まれるまで待機
+        
+        Args:
+            seen (int, optional): 最後に確認したシーケンス値（省略時は現在の値）
+            timeout (float, optional): タイムアウト時間（秒）
+            
+        Returns:
+            int: 新しいシーケンス値（タイムアウトした場合はNone）
+        """
+        if seen is None:
+            seen = self.sequence
+        start = time.perf_counter_ns()
+        seq = shm_sync.wait_for_update(self.memory, seen, timeout)
+        self._refresh()
+        self._record_wait(time.perf_counter_ns() - start)
+        return seq
+    
+    def wait_for_variable(self, key, timeout=30, check_interval=None):
+        """変数が書き込まれるまで待機（ポーリングではなく通知シーケンスで待機）
+        
+        Args:
+            key (str): 変数名
+            timeout (float, optional): タイムアウト時間（秒）
+            check_interval (float, optional): 互換性のための引数（未使用）
+            
+        Returns:
+            bool: 変数が書き込まれればTrue、タイムアウトならFalse
+        """
+        def ready():
+            entry = self.layout.find(key)
+            return entry is not None and entry.generation > 0
+        
+        start = time.perf_counter_ns()
+        found = shm_sync.wait_until(self.memory, ready, timeout)
+        self._refresh()
+        self._record_wait(time.perf_counter_ns() - start)
+        return found
+    
+    def _record_wait(self, wait_ns):
+        """通知の待機時間をPython側の転送統計に加算"""
+        if wait_ns > 0:
+            self.layout.add_wait(shm_layout.STATS_PYTHON, wait_ns)
+    
+    @property
+    def stats(self):
+        """転送統計（マッピングから直接読むため追加のプロセス間通信は発生しない）
+        
+        Returns:
+            dict: 'freefem' と 'python' の各記録元の統計（shm_layout.SegmentLayout.read_stats を参照）
+        """
+        self._refresh()
+        return {
+            'freefem': self.layout.read_stats(shm_layout.STATS_FREEFEM),
+            'python': self.layout.read_stats(shm_layout.STATS_PYTHON),
+        }
     
     def cleanup(self):
         """リソースのクリーンアップ"""
         try:
-            if hasattr(self, 'memory'):
-                self.memory.detach()
-                print(f"共有メモリセグメント '{self.name}' (ID: {self.key}) を解放しました")
+            if hasattr(self, 'memory') and not self.memory.closed:
+                self.memory.close()
+                os.close(self._fd)
+                print(f"共有メモリセグメント '{self.name}' ({self.path}) を解放しました")
         except Exception as e:
             print(f"共有メモリの解放中にエラーが発生しました: {str(e)}")
     
     def destroy(self):
         """共有メモリセグメントを完全に削除"""
         try:
-            if hasattr(self, 'memory'):
-                self.memory.remove()
-                print(f"共有メモリセグメント '{self.name}' (ID: {self.key}) を削除しました")
+            self.cleanup()
+            shm_layout.retire(self.path)
+            os.unlink(self.path)
+            print(f"共有メモリセグメント '{self.name}' ({self.path}) を削除しました")
         except Exception as e:
-            print(f"共有メモリの削除中にエラーが発生しました: {str(e)}") 
\ No newline at end of file
+            print(f"共有メモリの削除中にエラーが発生しました: {str(e)}")
+
+
+class RingBuffer:
+    """FreeFEMプラグインのringPush/ringPopと対になるSPSCリングバッファ
+
+    POSIX共有メモリ (/dev/shm) 上に固定サイズのスロットを並べ、キャッシュライン
+    境界に置いたhead/tailインデックスだけで同期します。高速パスではシステムコールを
+    発行しません。レイアウトは shm_implementation.cpp の RingBufferHeader と同一です。
+
+    head/tailはC++側の std::atomic と同じく acquire で読み、release で書きます
+    （shm_layout.AtomicWord）。スロットのデータは head の公開より先に、
+    読み終えたスロットの解放は tail の公開より先に相手側から見えるため、
+    aarch64 などストアの順序が保証されないCPUでも正しく動作します。
+    """
+
+    MAGIC = 0x52494e47  # "RING"
+    VERSION = 1
+    CACHE_LINE = 64
+    HEADER_SIZE = 3 * CACHE_LINE
+    HEAD_OFFSET = CACHE_LINE
+    TAIL_OFFSET = 2 * CACHE_LINE
+    SLOT_HEADER_SIZE = 16
+
+    def __init__(self, name, slot_elements=None, slot_count=None, create=True):
+        """初期化処理
+
+        Args:
+            name (str): 共有メモリの名前（FreeFEM側と同じ名前、先頭の'/'は不要）
+            slot_elements (int): 1スロットあたりの最大要素数（double）
+            slot_count (int): スロット数（2の冪）
+            create (bool): リングバッファを新規作成するかどうか
+        """
+        if platform.system() != 'Linux':
+            raise RuntimeError("共有メモリ機能はLinux環境でのみサポートされています")
+
+        self.name = name
+        self.path = os.path.join('/dev/shm', name)
+
+        if create:
+            if not slot_elements or not slot_count:
+                raise ValueError("作成時にはslot_elementsとslot_countの指定が必要です")
+            if slot_count & (slot_count - 1):
+                raise ValueError(f"スロット数は2の冪である必要があります: {slot_count}")
+            stride = self._slot_stride(slot_elements)
+            size = self.HEADER_SIZE + stride * slot_count
+            fd = os.open(self.path, os.O_CREAT | os.O_RDWR, 0o666)
+        else:
+            fd = os.open(self.path, os.O_RDWR)
+            size = os.fstat(fd).st_size
+
+        try:
+            if create and os.fstat(fd).st_size < size:
+                os.ftruncate(fd, size)
+            self.memory = mmap.mmap(fd, size, mmap.MAP_SHARED, mmap.PROT_READ | mmap.PROT_WRITE)
+        finally:
+            os.close(fd)
+
+        magic, version = struct.unpack_from('II', self.memory, 0)
+        if magic == self.MAGIC:
+            if version != self.VERSION:
+                raise RuntimeError(f"未対応のリングバッファバージョンです: {version}")
+            _, _, elements, count, stride = struct.unpack_from('IIQQQ', self.memory, 0)
+            if create and (elements != slot_elements or count != slot_count):
+                raise ValueError(f"既存のリングバッファと構成が一致しません: {name}")
+        elif create:
+            elements, count = slot_elements, slot_count
+            stride = self._slot_stride(slot_elements)
+            struct.pack_into('IIQQQ', self.memory, 0, 0, self.VERSION, elements, count, stride)
+            struct.pack_into('Q', self.memory, self.HEAD_OFFSET, 0)
+            struct.pack_into('Q', self.memory, self.TAIL_OFFSET, 0)
+            # magicは最後に公開する
+            struct.pack_into('I', self.memory, 0, self.MAGIC)
+        else:
+            raise RuntimeError(f"リングバッファではありません: {name}")
+
+        self.slot_elements = elements
+        self.slot_count = count
+        self.slot_stride = stride
+
+        # head/tailは acquire/release の語として保持する
+        try:
+            self._head = shm_layout.AtomicWord(self.memory, self.HEAD_OFFSET)
+            self._tail = shm_layout.AtomicWord(self.memory, self.TAIL_OFFSET)
+        except RuntimeError:
+            self.memory.close()
+            raise
+
+    @classmethod
+    def _slot_stride(cls, slot_elements):
+        """1スロットのバイト数（キャッシュライン境界に切り上げ）"""
+        size = cls.SLOT_HEADER_SIZE + slot_elements * 8
+        return (size + cls.CACHE_LINE - 1) & ~(cls.CACHE_LINE - 1)
+
+    def _slot_offset(self, index):
+        return self.HEADER_SIZE + (index & (self.slot_count - 1)) * self.slot_stride
+
+    def __len__(self):
+        return self._head.load() - self._tail.load()
+
+    def push(self, array):
+        """配列を1スロット分追加（満杯の場合はFalseを返しブロックしない）
+
+        Args:
+            array (numpy.ndarray): 追加する配列
+
+        Returns:
+            bool: 追加できた場合はTrue
+        """
+        array = np.ascontiguousarray(array, dtype=np.float64).ravel()
+        if array.size > self.slot_elements:
+            raise ValueError(f"配列がスロットより大きいです: {array.size} > {self.slot_elements}")
+
+        head = self._head.load()
+        if head - self._tail.load() >= self.slot_count:
+            return False
+
+        offset = self._slot_offset(head)
+        payload = np.frombuffer(self.memory, dtype=np.float64, count=array.size,
+                                offset=offset + self.SLOT_HEADER_SIZE)
+        payload[:] = array
+        struct.pack_into('Q', self.memory, offset, array.size)
+
+        # スロットの書き込みが先に見えるように release で公開する
+        self._head.store(head + 1)
+        return True
+
+    def pop(self, out=None):
+        """配列を1スロット分取り出し（空の場合はNoneを返しブロックしない）
+
+        Args:
+            out (numpy.ndarray, optional): 結果を書き込む配列（省略時は新規確保）
+
+        Returns:
+            numpy.ndarray or None: 取り出した配列
+        """
+        tail = self._tail.load()
+        # head を acquire で読むため、以後のスロットの読み込みは公開済みのデータを見る
+        if tail == self._head.load():
+            return None
+
+        offset = self._slot_offset(tail)
+        elements = struct.unpack_from('Q', self.memory, offset)[0]
+        payload = np.frombuffer(self.memory, dtype=np.float64, count=elements,
+                                offset=offset + self.SLOT_HEADER_SIZE)
+        if out is None:
+            result = payload.copy()
+        else:
+            result = out[:elements]
+            result[:] = payload
+
+        # スロットを読み終えてから release で解放する
+        self._tail.store(tail + 1)
+        return result
+
+    def close(self):
+        """マッピングを解放"""
+        if hasattr(self, 'memory'):
+            for word in (getattr(self, '_head', None), getattr(self, '_tail', None)):
+                if word is not None:
+                    word.release_buffer()
+            self._head = self._tail = None
+            self.memory.close()
+
+    def destroy(self):
+        """リングバッファを完全に削除"""
+        self.close()
+        try:
+            shm_layout.retire(self.path)
+            os.unlink(self.path)
+        except FileNotFoundError:
+            pass
+
+
+class BufferedChannel:
+    """FreeFEMプラグインのchannelWrite/channelReadと対になる多重バッファのチャネル
+
+    SharedMemoryManager のセグメント内に2面または3面のバッファ（エントリ '<key>.i'）と
+    制御用のint64エントリ '<key>' = [面数, 公開済みフレーム数, 読み込み中のフレーム,
+    読み終えたフレーム] を置きます。書き込み側は読み込み側が参照していないバッファに
+    次のフレームを書き込むため、FreeFEMの求解とPython側の学習を重ねて実行できます。
+    読み込み側は常に最新のフレームを受け取ります（読み飛ばされたフレームは破棄されます）。
+    プロトコルの詳細は shm_transport.hpp を参照してください。
+
+    制御用の語は libatomic の seq_cst の読み込みと交換で読み書きします。読み込み中の
+    フレームの宣言と公開済みフレーム数の再確認が、書き込み側のフェンスと確認の組
+    （shm_channel_begin_write）とすれ違わないため、参照中のバッファは書き換えられません。
+    x86でも通常の読み書きでは代用できないため、libatomic がない環境では RuntimeError になります。
+    """
+
+    MAX_BUFFERS = 3
+    _BUFFERS, _PUBLISHED, _ACQUIRED, _CONSUMED = range(4)
+
+    def __init__(self, shm, key, buffers=None):
+        """初期化処理
+
+        Args:
+            shm (SharedMemoryManager): チャネルを置くセグメント
+            key (str): チャネル名（FreeFEM側と同じ名前）
+            buffers (int, optional): 作成する場合のバッファの面数（2または3）。
+                省略時は既存のチャネルに接続する
+        """
+        self.shm = shm
+        self.key = key
+
+        entry = shm._get_var_info(key)
+        if buffers is not None:
+            if not 2 <= buffers <= self.MAX_BUFFERS:
+                raise ValueError(f"バッファの面数は2から{self.MAX_BUFFERS}である必要があります: {buffers}")
+            if len(key) + 3 > shm_layout.NAME_LEN:
+                raise ValueError(f"チャネル名が長すぎます: {key}")
+            if entry is None or not entry.generation:
+                shm.write_array(key, [buffers, 0, 0, 0], dtype=np.int64)
+                entry = shm._get_var_info(key)
+        elif entry is None:
+            raise KeyError(f"チャネル '{key}' は共有メモリ内に存在しません")
+
+        if entry.dtype != shm_layout.DTYPE_INT64 or entry.nbytes < 32:
+            raise TypeError(f"型の不一致: '{key}' は多重バッファのチャネルではありません")
+        if not shm_layout.seq_cst_available():
+            raise RuntimeError("libatomic（libatomic.so.1）を読み込めないため、チャネルの制御用の語を"
+                               "FreeFEM側と順序付きで読み書きできません。libatomic をインストールしてください")
+        self._offset = entry.offset
+        self.buffers = self._load(self._BUFFERS)
+        if buffers is not None and self.buffers != buffers:
+            raise ValueError(f"既存のチャネルと構成が一致しません: {key}")
+        self._frame = None
+        self._generation = 0
+
+    # マッピングは write_array で拡張されうるため、語は操作ごとに参照する
+    def _load(self, word):
+        return shm_layout.load_seq_cst(self.shm.memory, self._offset + 8 * word)
+
+    def _store(self, word, value):
+        shm_layout.exchange_seq_cst(self.shm.memory, self._offset + 8 * word, value)
+
+    def _buffer_key(self, frame):
+        return f"{self.key}.{frame % self.buffers}"
+
+    @property
+    def published(self):
+        """公開済みのフレーム数"""
+        return self._load(self._PUBLISHED)
+
+    def write(self, array, dtype=np.float64, timeout=shm_sync.WAIT_TIMEOUT):
+        """配列を次のフレームとして書き込み
+
+        読み込み側が同じバッファを参照している場合だけ、返却されるまで待機します。
+
+        Args:
+            array (numpy.ndarray): 書き込む配列
+            dtype (numpy.dtype): 共有メモリ上のデータ型（デフォルトはdouble）
+            timeout (float, optional): 待機する最大時間（秒）
+
+        Returns:
+            bool: 書き込めた場合はTrue、タイムアウトした場合はFalse
+        """
+        frame = self.published + 1
+        index = frame % self.buffers
+
+        def available():
+            held = self._load(self._ACQUIRED)
+            return held == 0 or held % self.buffers != index
+
+        if not shm_sync.wait_until(self.shm.memory, available, timeout):
+            return False
+        self.shm.write_array(self._buffer_key(frame), array, dtype=dtype)
+        self._store(self._PUBLISHED, frame)
+        shm_sync.notify(self.shm.memory)
+        return True
+
+    def acquire(self, timeout=shm_sync.WAIT_TIMEOUT):
+        """未読のフレームが公開されるまで待機し、最新のフレームを指す配列を取得（コピーなし）
+
+        返された配列は release() を呼ぶまで有効です。参照中は同じ
+        SharedMemoryManager で他の読み書きを行わないでください（マッピングを拡張できません）。
+
+        Args:
+            timeout (float, optional): 待機する最大時間（秒）
+
+        Returns:
+            numpy.ndarray or None: フレームのデータ（タイムアウトした場合はNone）
+        """
+        if self._frame is not None:
+            raise RuntimeError(f"チャネル '{self.key}' のフレームは返却されていません")
+
+        def ready():
+            return self._load(self._PUBLISHED) > self._load(self._CONSUMED)
+
+        if not shm_sync.wait_until(self.shm.memory, ready, timeout):
+            return None
+
+        # 読み込み中のフレームを宣言してから公開済みフレーム数を再確認する
+        # （交換は seq_cst のため、再確認の読み込みが宣言より先に実行されることはない）
+        while True:
+            frame = self.published
+            self._store(self._ACQUIRED, frame)
+            if self.published < frame + self.buffers - 1:
+                break
+
+        entry = self.shm._get_entry(self._buffer_key(frame), 'array')
+        self._frame = frame
+        self._generation = entry.generation
+        return self.shm.layout.payload(entry).reshape(entry.shape)
+
+    def release(self):
+        """acquire() で取得したフレームを返却
+
+        Returns:
+            bool: 参照中にフレームが書き換えられていなければTrue
+        """
+        frame = self._frame
+        if frame is None:
+            return True
+        intact = self.shm.layout.find(self._buffer_key(frame)).generation == self._generation
+        self._store(self._CONSUMED, frame)
+        self._store(self._ACQUIRED, 0)
+        self._frame = None
+        shm_sync.notify(self.shm.memory)
+        return intact
+
+    def read(self, timeout=shm_sync.WAIT_TIMEOUT):
+        """最新のフレームを読み込み（コピーを返す）
+
+        Args:
+            timeout (float, optional): 待機する最大時間（秒）
+
+        Returns:
+            numpy.ndarray or None: フレームのデータ（タイムアウトした場合はNone）
+        """
+        while True:
+            start = time.perf_counter_ns()
+            view = self.acquire(timeout)
+            if view is None:
+                return None
+            ready = time.perf_counter_ns()
+            array = view.copy()
+            del view
+            if self.release():
+                self.shm._record_read(start, ready, array.nbytes)
+                return array
+
+
+class DeltaArray:
+    """FreeFEMプラグインのshmWriteDeltaと対になる差分転送の配列
+
+    配列 '<key>' を固定長のブロックに分け、ブロックごとの世代番号とチェックサムを
+    int64エントリ '<key>.blocks' = [ブロックの要素数, 要素数, 公開時の '<key>' の世代番号,
+    ブロック数, 世代番号..., チェックサム...] に置きます。書き込み側はチェックサムが変わった
+    ブロックだけをコピーし、読み込み側は前回より世代番号が進んだブロックだけをコピーするため、
+    反復ごとに一部しか変わらない場（密度分布など）の転送量を減らせます。
+    '<key>' 自体は通常のdouble配列のエントリなので、read_array などでもそのまま読めます。
+    レイアウトの詳細は shm_transport.hpp を参照してください。
+
+    注意: 読み込み中に書き込まれたブロックは、世代番号を確認して読み直します。
+    チェックサムはブロック内の1要素だけの変更を必ず検出しますが、複数要素の変更が
+    打ち消し合う場合（確率は約2^-64）は検出できません。
+    """
+
+    SUFFIX = '.blocks'
+    BLOCK_ELEMENTS = 512
+    CHECKSUM_MULTIPLIER = 0x9E3779B97F4A7C15
+    HEADER_WORDS = 4
+    _BLOCK, _ELEMENTS, _GENERATION, _BLOCKS = range(HEADER_WORDS)
+
+    def __init__(self, shm, key, block_elements=BLOCK_ELEMENTS):
+        """初期化処理
+
+        Args:
+            shm (SharedMemoryManager): 配列を置くセグメント
+            key (str): 変数名（FreeFEM側と同じ名前）
+            block_elements (int): write() で使う1ブロックの要素数
+        """
+        if len(key) + len(self.SUFFIX) >= shm_layout.NAME_LEN:
+            raise ValueError(f"差分転送の変数名が長すぎます: {key}")
+        if block_elements < 1:
+            raise ValueError(f"ブロックの要素数は1以上である必要があります: {block_elements}")
+        self.shm = shm
+        self.key = key
+        self.block_elements = int(block_elements)
+        self._meta_key = key + self.SUFFIX
+        self.array = None
+        self.copied_blocks = 0
+        self._seen = None
+        self._block = None
+
+    @classmethod
+    def checksums(cls, array, block_elements):
+        """ブロックごとのチェックサム（shm_transport.cpp の delta_block_checksum と同一）
+
+        Args:
+            array (numpy.ndarray): double配列
+            block_elements (int): 1ブロックの要素数
+
+        Returns:
+            numpy.ndarray: uint64のチェックサム（ブロック数）
+        """
+        bits = np.ascontiguousarray(array, dtype=np.float64).reshape(-1).view(np.uint64)
+        blocks = -(-bits.size // block_elements)
+        padded = np.zeros(blocks * block_elements, dtype=np.uint64)
+        padded[:bits.size] = bits
+        weights = (2 * np.arange(block_elements, dtype=np.uint64) + 1) * np.uint64(cls.CHECKSUM_MULTIPLIER)
+        return (padded.reshape(blocks, block_elements) * weights).sum(axis=1, dtype=np.uint64)
+
+    @staticmethod
+    def _copy_blocks(dst, src, dirty, block):
+        """指定したブロックだけを src から dst にコピーし、コピーした要素数を返す"""
+        whole = dst.size // block
+        head = dirty[dirty < whole]
+        if head.size:
+            dst[:whole * block].reshape(whole, block)[head] = src[:whole * block].reshape(whole, block)[head]
+        copied = head.size * block
+        if head.size < dirty.size:
+            dst[whole * block:] = src[whole * block:]
+            copied += dst.size - whole * block
+        return copied
+
+    def _entries(self):
+        """配列とブロック情報のエントリを取得（どちらかが無ければNone）"""
+        self.shm._refresh()
+        data = self.shm.layout.find(self.key)
+        meta = self.shm.layout.find(self._meta_key)
+        if data is None or meta is None or not meta.generation:
+            return data, None
+        if data.dtype != shm_layout.DTYPE_FLOAT64:
+            raise TypeError(f"型の不一致: '{self.key}' はdouble配列ではありません")
+        if meta.dtype != shm_layout.DTYPE_INT64 or meta.nbytes < 8 * self.HEADER_WORDS:
+            raise TypeError(f"型の不一致: '{self._meta_key}' は差分転送のブロック情報ではありません")
+        return data, meta
+
+    def _words(self, meta):
+        return self.shm.layout.payload(meta)
+
+    def write(self, array):
+        """配列を書き込み（前回の書き込みから変わったブロックだけをコピーする）
+
+        要素数やブロックの大きさが変わった場合、または他の書き込みで変数が更新されていた
+        場合は全体を書き込みます。配列は1次元として格納されます。
+
+        Args:
+            array (numpy.ndarray): 書き込む配列
+
+        Returns:
+            int: 書き込んだブロック数
+        """
+        array = np.ascontiguousarray(array, dtype=np.float64).reshape(-1)
+        block = self.block_elements
+        sums = self.checksums(array, block)
+        blocks = sums.size
+
+        start = time.perf_counter_ns()
+        data, meta = self._entries()
+        generation = (data.generation if data is not None else 0) + 1
+        words = self._words(meta) if meta is not None else None
+        if (words is None or words.size != self.HEADER_WORDS + 2 * blocks
+                or data.nbytes != array.nbytes
+                or int(words[self._BLOCK]) != block or int(words[self._ELEMENTS]) != array.size
+                or int(words[self._GENERATION]) != data.generation):
+            values = np.empty(self.HEADER_WORDS + 2 * blocks, dtype=np.int64)
+            values[:self.HEADER_WORDS] = [block, array.size, generation, blocks]
+            values[self.HEADER_WORDS:self.HEADER_WORDS + blocks] = generation
+            values[self.HEADER_WORDS + blocks:] = sums.view(np.int64)
+            self.shm._write_entries([
+                (self.key, 'array', shm_layout.DTYPE_FLOAT64, array.shape, memoryview(array).cast('B')),
+                (self._meta_key, 'array', shm_layout.DTYPE_INT64, values.shape, memoryview(values).cast('B')),
+            ])
+            return blocks
+
+        ready = time.perf_counter_ns()
+        generations = words[self.HEADER_WORDS:self.HEADER_WORDS + blocks]
+        stored = words[self.HEADER_WORDS + blocks:].view(np.uint64)
+        dirty = np.flatnonzero(stored != sums)
+        copied = self._copy_blocks(self.shm.layout.payload(data), array, dirty, block)
+        generations[dirty] = generation
+        stored[dirty] = sums[dirty]
+        words[self._GENERATION] = generation
+
+        self.shm.layout.publish(data, array.shape, array.nbytes)
+        self.shm.layout.publish(meta, (words.size,), meta.nbytes)
+        end = time.perf_counter_ns()
+        self.shm.layout.record_transfer(shm_layout.STATS_PYTHON, True, 8 * copied, 0, end - ready, end - start)
+        shm_sync.notify(self.shm.memory)
+        return int(dirty.size)
+
+    def read(self, timeout=None):
+        """配列を読み込み（前回の読み込みから世代番号が進んだブロックだけをコピーする）
+
+        返される配列はこのオブジェクトが保持するもので、次の read() で更新されます。
+        保持し続ける場合はコピーしてください。コピーしたブロック数は copied_blocks に入ります。
+
+        Args:
+            timeout (float, optional): 指定した場合、変数が書き込まれるまで最大この秒数だけ待機する
+
+        Returns:
+            numpy.ndarray: 読み込んだ配列（1次元）
+        """
+        if timeout is not None:
+            def written():
+                return self._entries()[1] is not None
+
+            if not shm_sync.wait_until(self.shm.memory, written, timeout):
+                raise TimeoutError(f"変数の待機中にタイムアウトしました: {self.key}")
+
+        start = time.perf_counter_ns()
+        while True:
+            data, meta = self._entries()
+            if meta is None:
+                raise KeyError(f"変数 '{self.key}' は差分転送で書き込まれていません")
+            words = self._words(meta)
+            generation = data.generation
+            block, elements, recorded, blocks = (int(value) for value in words[:self.HEADER_WORDS])
+            generations = words[self.HEADER_WORDS:self.HEADER_WORDS + blocks]
+
+            # 書き込み中（ブロック情報だけが先に進んでいる）の場合は公開されるまで待つ
+            if recorded > generation or (blocks and int(generations.max()) > generation):
+                def published():
+                    return self.shm.layout.find(self.key).generation != generation
+
+                if not shm_sync.wait_until(self.shm.memory, published, shm_sync.WAIT_TIMEOUT):
+                    raise TimeoutError(f"差分転送の書き込みが完了しません: {self.key}")
+                continue
+
+            ready = time.perf_counter_ns()
+            payload = self.shm.layout.payload(data)
+            consistent = (recorded == generation and elements == payload.size and block > 0
+                          and blocks == -(-elements // block))
+            seen = generations.copy() if consistent else None
+            if (seen is not None and self._seen is not None and self._block == block
+                    and self._seen.size == blocks and self.array is not None and self.array.size == elements):
+                dirty = np.flatnonzero(seen > self._seen)
+                copied = self._copy_blocks(self.array, payload, dirty, block)
+                self.copied_blocks = int(dirty.size)
+            else:
+                # 初回、構成の変更後、または差分転送以外で更新された場合は全体をコピーする
+                self.array = payload.copy()
+                copied = payload.size
+                self.copied_blocks = -(-payload.size // (block if consistent else self.block_elements))
+
+            if self.shm.layout.find(self.key).generation == generation:
+                self._seen = seen
+                self._block = block
+                self.shm._record_read(start, ready, 8 * copied)
+                return self.array
+            # 読み込み中に書き換えられた場合は全体を読み直す
+            self._seen = None
+
+
+class RankSegments:
+    """FreeFEMプラグインのshmWritePartition/shmReadPartitionと対になるランクごとのセグメント
+
+    MPI並列実行（ff-mpirun）では、各ランクが自分専用のセグメント '<name>.r<ランク>' に
+    大域配列のうち担当する部分 '<key>' と、int64エントリ '<key>.part' = [ランク, ランク数,
+    開始位置, 要素数, 大域配列の要素数] を書き込みます。同じセグメントを複数のランクが
+    奪い合わないため、FreeFEM側の書き込みはランク間で同期しません。
+
+    gather() は各ランクの部分を大域配列の位置に直接コピーし、scatter() は大域配列を
+    部分ごとに各ランクのセグメントへ書き込みます。ランク0を経由して集める必要はありません。
+    部分が重なる場合（領域分割の重なり）は、ランク番号の大きい方の値が残ります。
+    create=False の場合、各ランクのセグメントは最初に必要になったときに接続するため、
+    FreeFEM側より先に作成して partitions()/gather() の timeout で待つことができます。
+    """
+
+    RANK_SEPARATOR = '.r'
+    SUFFIX = '.part'
+    WORDS = 5
+    _RANK, _RANKS, _OFFSET, _ELEMENTS, _GLOBAL = range(WORDS)
+    # セグメントが作成されるのを待つ間の接続の再試行間隔（秒）
+    OPEN_INTERVAL = 0.01
+
+    def __init__(self, name, ranks, size=1024*1024, create=False):
+        """初期化処理
+
+        Args:
+            name (str): セグメントの名前（FreeFEM側と同じ名前、ランクの接尾辞は付けない）
+            ranks (int): ランク数
+            size (int): 作成する場合の各セグメントのサイズ（バイト単位）
+            create (bool): セグメントを作成するかどうか（scatter() で先に書き込む場合）
+        """
+        if ranks < 1:
+            raise ValueError(f"ランク数は1以上である必要があります: {ranks}")
+        self.name = name
+        self.size = size
+        # 未接続のランクは None（create=False の場合は _segment() で接続する）
+        self.segments = [SharedMemoryManager(self.segment_name(name, rank), size, True) if create else None
+                         for rank in range(ranks)]
+
+    @classmethod
+    def segment_name(cls, name, rank):
+        """ランク専用のセグメント名"""
+        return f"{name}{cls.RANK_SEPARATOR}{rank}"
+
+    def __len__(self):
+        return len(self.segments)
+
+    def _segment(self, rank, deadline=None):
+        """ランクのセグメントを取得（未接続なら接続し、deadline までは作成を待って再試行）
+
+        Args:
+            rank (int): ランク番号
+            deadline (float, optional): 再試行を打ち切る time.monotonic() の時刻（省略時は1回だけ試す）
+
+        Returns:
+            SharedMemoryManager: ランクのセグメント
+        """
+        shm = self.segments[rank]
+        while shm is None:
+            try:
+                shm = SharedMemoryManager(self.segment_name(self.name, rank), self.size, create=False)
+            except RuntimeError:
+                # 未作成か、FreeFEM側がヘッダーを初期化している途中
+                if deadline is None:
+                    raise
+                remaining = deadline - time.monotonic()
+                if remaining <= 0:
+                    raise TimeoutError(f"ランク {rank} のセグメント "
+                                       f"'{self.segment_name(self.name, rank)}' が作成されていません")
+                time.sleep(min(self.OPEN_INTERVAL, remaining))
+            else:
+                self.segments[rank] = shm
+        return shm
+
+    def partitions(self, key, timeout=None):
+        """各ランクが書き込んだ部分の位置を取得
+
+        Args:
+            key (str): 変数名
+            timeout (float, optional): 各ランクの書き込みを待つ最大時間（秒、省略時は待機しない）
+
+        Returns:
+            tuple: ([(開始位置, 要素数), ...]（ランク順）, 大域配列の要素数)
+        """
+        ranges = []
+        global_elements = None
+        for rank in range(len(self.segments)):
+            part_key = key + self.SUFFIX
+            deadline = None if timeout is None else time.monotonic() + timeout
+            shm = self._segment(rank, deadline)
+            if timeout is not None and not shm.wait_for_variable(part_key, max(deadline - time.monotonic(), 0.0)):
+                raise TimeoutError(f"ランク {rank} の '{key}' が書き込まれていません")
+            words = shm.read_array(part_key)
+            if words.dtype != np.int64 or words.size < self.WORDS:
+                raise TypeError(f"型の不一致: '{part_key}' は分割配列の情報ではありません")
+            if words[self._RANK] != rank or words[self._RANKS] != len(self.segments):
+                raise ValueError(f"ランクの情報が一致しません: {self.segment_name(self.name, rank)} "
+                                 f"(ランク {words[self._RANK]} / {words[self._RANKS]})")
+            if global_elements is None:
+                global_elements = int(words[self._GLOBAL])
+            elif words[self._GLOBAL] != global_elements:
+                raise ValueError(f"ランクごとの大域配列の要素数が一致しません: '{key}' "
+                                 f"({global_elements} != {words[self._GLOBAL]})")
+            ranges.append((int(words[self._OFFSET]), int(words[self._ELEMENTS])))
+        return ranges, global_elements
+
+    def gather(self, key, out=None, timeout=None):
+        """全ランクの部分を大域配列に集める
+
+        Args:
+            key (str): 変数名
+            out (numpy.ndarray, optional): 結果を書き込む1次元のdouble配列（大域配列の要素数）
+            timeout (float, optional): 各ランクの書き込みを待つ最大時間（秒）
+
+        Returns:
+            numpy.ndarray: 大域配列（out を指定した場合は out）
+        """
+        ranges, global_elements = self.partitions(key, timeout)
+        if out is None:
+            out = np.empty(global_elements, dtype=np.float64)
+        elif out.shape != (global_elements,):
+            raise ValueError(f"出力先の形状が大域配列と一致しません: {out.shape} != ({global_elements},)")
+        for shm, (offset, elements) in zip(self.segments, ranges):
+            shm.read_array(key, out=out[offset:offset + elements])
+        return out
+
+    def scatter(self, key, array, partitions):
+        """大域配列を部分ごとに各ランクのセグメントへ書き込む
+
+        Args:
+            key (str): 変数名（FreeFEM側は shmReadPartition で自分の部分を読み込む）
+            array (numpy.ndarray): 大域配列
+            partitions (list): ランクごとの (開始位置, 要素数)
+        """
+        if len(key) + len(self.SUFFIX) >= shm_layout.NAME_LEN:
+            raise ValueError(f"分割配列の変数名が長すぎます: {key}")
+        if len(partitions) != len(self.segments):
+            raise ValueError(f"部分の数がランク数と一致しません: {len(partitions)} != {len(self.segments)}")
+        array = np.ascontiguousarray(array, dtype=np.float64).reshape(-1)
+        for rank, (offset, elements) in enumerate(partitions):
+            shm = self._segment(rank)
+            if offset < 0 or elements < 0 or offset + elements > array.size:
+                raise ValueError(f"ランク {rank} の範囲が大域配列を超えています: [{offset}, {offset + elements})")
+            part = array[offset:offset + elements]
+            words = np.array([rank, len(self.segments), offset, elements, array.size], dtype=np.int64)
+            shm._write_entries([
+                (key, 'array', shm_layout.DTYPE_FLOAT64, part.shape, memoryview(part).cast('B')),
+                (key + self.SUFFIX, 'array', shm_layout.DTYPE_INT64, words.shape, memoryview(words).cast('B')),
+            ])
+
+    def cleanup(self):
+        """すべてのセグメントのマッピングを解放"""
+        for shm in self.segments:
+            if shm is not None:
+                shm.cleanup()
+
+    def destroy(self):
+        """すべてのセグメントを削除（未接続のランクも作成済みであれば削除する）"""
+        for rank in range(len(self.segments)):
+            try:
+                shm = self._segment(rank)
+            except RuntimeError:
+                continue
+            shm.destroy()
@@ -0,0 +1,121 @@
+#!/usr/bin/env python3
+# -*- coding: utf-8 -*-
+
+"""
+セグメントのマッピング方法（ヒュージページ・事前割り当て・NUMAノード）の適用
+
+plugins/src/shm_mapping.hpp と同じ手順をPython側から実装します。
+
+方法はセグメントを作成した側がヘッダー（shm_layout の map_flags / numa_node）に記録し、
+セグメントをマッピング・拡張するすべてのプロセスが自分のマッピングに同じ手順を適用します。
+
+1. MAP_HUGEPAGE: madvise(MADV_HUGEPAGE)（/dev/shm の tmpfs では
+   /sys/kernel/mm/transparent_hugepage/shmem_enabled が advise 以上の場合に有効）
+2. NUMAノード: mbind(MPOL_BIND)（tmpfs ではファイル側に方針が記録されるため、
+   FreeFEM側が最初に触れたページも指定したノードに割り当てられる）
+3. MAP_POPULATE: マッピング直後に全ページを割り当てる
+
+いずれも失敗しても転送自体は行えるため、警告を表示して続行します。
+"""
+
+import os
+import ctypes
+import mmap
+import platform
+import numpy as np
+
+from . import shm_layout
+
+MAX_NUMA_NODES = 1024   # shm_mapping.hpp の SHM_MAX_NUMA_NODES と同じ値
+
+_MPOL_BIND = 2
+
+# アーキテクチャごとの SYS_mbind 番号
+_SYS_MBIND = {
+    'x86_64': 237,
+    'amd64': 237,
+    'aarch64': 235,
+    'arm64': 235,
+}.get(platform.machine().lower())
+
+_libc = None
+if platform.system() == 'Linux' and _SYS_MBIND is not None:
+    try:
+        _libc = ctypes.CDLL(None, use_errno=True)
+        _libc.syscall.restype = ctypes.c_long
+    except OSError:
+        _libc = None
+
+
+def granularity(flags):
+    """マッピングの大きさの単位（ヒュージページを使う場合は2 MiB）"""
+    return shm_layout.HUGEPAGE_SIZE if flags & shm_layout.MAP_HUGEPAGE else mmap.PAGESIZE
+
+
+def round_size(size, flags):
+    """サイズをマッピングの単位に切り上げ"""
+    unit = granularity(flags)
+    return (size + unit - 1) // unit * unit
+
+
+def _bind(memory, start, length, node):
+    """mbindで [start, start + length) を指定したNUMAノードに割り当てる"""
+    if _libc is None:
+        raise OSError("このプラットフォームではNUMAノードを指定できません")
+    mask = (ctypes.c_ulong * (MAX_NUMA_NODES // (8 * ctypes.sizeof(ctypes.c_ulong))))()
+    bits = 8 * ctypes.sizeof(ctypes.c_ulong)
+    mask[node // bits] |= 1 << (node % bits)
+    base = ctypes.c_char.from_buffer(memory, start)
+    try:
+        result = _libc.syscall(_SYS_MBIND, ctypes.c_void_p(ctypes.addressof(base)), ctypes.c_ulong(length),
+                               _MPOL_BIND, mask, ctypes.c_ulong(MAX_NUMA_NODES + 1), 0)
+    finally:
+        del base
+    if result != 0:
+        errno = ctypes.get_errno()
+        raise OSError(errno, os.strerror(errno))
+
+
+def _populate(memory, start, length):
+    """ページを割り当てる（読み込みのページフォルトでもtmpfsのページは割り当てられる）"""
+    advice = getattr(mmap, 'MADV_POPULATE_WRITE', None)
+    if advice is not None:
+        try:
+            memory.madvise(advice, start, length)
+            return
+        except OSError:
+            pass
+    pages = np.frombuffer(memory, dtype=np.uint8, count=length, offset=start)
+    pages[::mmap.PAGESIZE].sum()
+    del pages
+
+
+def apply(memory, start, flags, numa_node, name=''):
+    """マッピングの start バイト目以降にマッピング方法を適用
+
+    Args:
+        memory (mmap.mmap): セグメントのマッピング
+        start (int): 適用を始める位置（ページ境界に切り下げる）
+        flags (int): MAP_HUGEPAGE / MAP_POPULATE の組み合わせ
+        numa_node (int, optional): ページを割り当てるNUMAノード
+        name (str): 警告に表示するセグメント名
+    """
+    start = start // mmap.PAGESIZE * mmap.PAGESIZE
+    length = len(memory) - start
+    if length <= 0:
+        return
+
+    if flags & shm_layout.MAP_HUGEPAGE:
+        try:
+            memory.madvise(mmap.MADV_HUGEPAGE, start, length)
+        except (AttributeError, OSError) as e:
+            print(f"警告: ヒュージページを設定できません: {name} ({e})")
+
+    if numa_node is not None:
+        try:
+            _bind(memory, start, length, numa_node)
+        except OSError as e:
+            print(f"警告: NUMAノード {numa_node} に割り当てられません: {name} ({e})")
+
+    if flags & shm_layout.MAP_POPULATE:
+        _populate(memory, start, length)
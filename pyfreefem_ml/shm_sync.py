@@ -0,0 +1,147 @@
+#!/usr/bin/env python3
+# -*- coding: utf-8 -*-
+
+"""
+セグメントヘッダーの通知シーケンスによる待機/通知
+
+plugins/src/shm_sync.hpp と同じプロトコルをPython側から実装します。
+
+- 書き込み側: データとエントリを書き終えた後に notify() で seq を進め、
+  待機者がいる場合だけ futex で起こします。
+- 読み込み側: wait_until() で条件を確認し、満たされなければ seq が変わるまで
+  短くスピンしてから futex で待機します。タイムアウトは time.monotonic() 基準です。
+
+Pythonからはアトミックな加算ができないため、waiters の更新が他プロセスと
+競合すると通知を取りこぼす可能性があります。そのためfutexでの待機は
+MAX_BLOCK 秒ごとに区切り、条件を再確認します。
+"""
+
+import ctypes
+import platform
+import struct
+import time
+
+from . import shm_layout
+
+SPIN_ITERATIONS = 200   # ブロックする前のスピン回数
+WAIT_TIMEOUT = 10.0     # 既定のタイムアウト（秒、shm_sync.hpp と同じ）
+MAX_BLOCK = 0.05        # 1回のfutex待機の上限（秒）
+
+_FUTEX_WAIT = 0
+_FUTEX_WAKE = 1
+_INT_MAX = 0x7fffffff
+
+# アーキテクチャごとの SYS_futex 番号
+_SYS_FUTEX = {
+    'x86_64': 202,
+    'amd64': 202,
+    'aarch64': 98,
+    'arm64': 98,
+    'i386': 240,
+    'i686': 240,
+    'armv7l': 240,
+}.get(platform.machine().lower())
+
+
+class _Timespec(ctypes.Structure):
+    _fields_ = [('tv_sec', ctypes.c_long), ('tv_nsec', ctypes.c_long)]
+
+
+_libc = None
+if platform.system() == 'Linux' and _SYS_FUTEX is not None:
+    try:
+        _libc = ctypes.CDLL(None, use_errno=True)
+        _libc.syscall.restype = ctypes.c_long
+    except OSError:
+        _libc = None
+
+
+def load_seq(buffer):
+    """現在の通知シーケンス"""
+    return struct.unpack_from('<I', buffer, shm_layout.SEQ_OFFSET)[0]
+
+
+def _load_waiters(buffer):
+    return struct.unpack_from('<I', buffer, shm_layout.WAITERS_OFFSET)[0]
+
+
+def _add_waiters(buffer, delta):
+    value = (_load_waiters(buffer) + delta) & 0xffffffff
+    struct.pack_into('<I', buffer, shm_layout.WAITERS_OFFSET, value)
+
+
+def _futex(buffer, op, value, timeout=None):
+    """seq のアドレスに対してfutexを発行（mmapのアドレスはctypes経由で取得）"""
+    word = ctypes.c_uint32.from_buffer(buffer, shm_layout.SEQ_OFFSET)
+    try:
+        ts = None
+        if timeout is not None:
+            ts = _Timespec(int(timeout), int((timeout - int(timeout)) * 1e9))
+        _libc.syscall(_SYS_FUTEX, ctypes.byref(word), op, ctypes.c_uint32(value),
+                      ctypes.byref(ts) if ts is not None else None, None, 0)
+    finally:
+        # mmapのエクスポートを残すとresize/closeできなくなるため必ず解放する
+        del word
+
+
+def notify(buffer):
+    """書き込みの完了を通知（データとエントリの更新後に呼ぶ）"""
+    seq = (load_seq(buffer) + 1) & 0xffffffff
+    struct.pack_into('<I', buffer, shm_layout.SEQ_OFFSET, seq)
+    if _libc is not None and _load_waiters(buffer) != 0:
+        _futex(buffer, _FUTEX_WAKE, _INT_MAX)
+
+
+def wait_until(buffer, ready, timeout=WAIT_TIMEOUT):
+    """ready() が真になるまで待機
+
+    Args:
+        buffer: セグメント先頭をマッピングしたバッファ
+        ready (callable): 待機条件（ヘッダーとエントリ表だけを参照すること）
+        timeout (float): タイムアウト時間（秒）
+
+    Returns:
+        bool: 条件が満たされればTrue、タイムアウトならFalse
+    """
+    deadline = time.monotonic() + timeout
+    while True:
+        seen = load_seq(buffer)
+        if ready():
+            return True
+
+        # 書き込み側が直後に通知する場合に備えて短くスピンする
+        changed = False
+        for _ in range(SPIN_ITERATIONS):
+            if load_seq(buffer) != seen:
+                changed = True
+                break
+        if changed:
+            continue
+
+        remaining = deadline - time.monotonic()
+        if remaining <= 0:
+            return ready()
+
+        block = min(remaining, MAX_BLOCK)
+        if _libc is None:
+            time.sleep(min(block, 0.001))
+            continue
+
+        # waiters を増やしてから seq を再確認することで通知の取りこぼしを防ぐ
+        _add_waiters(buffer, 1)
+        try:
+            if load_seq(buffer) == seen:
+                _futex(buffer, _FUTEX_WAIT, seen, block)
+        finally:
+            _add_waiters(buffer, -1)
+
+
+def wait_for_update(buffer, seen, timeout=WAIT_TIMEOUT):
+    """通知シーケンスが seen から変わるまで待機
+
+    Returns:
+        int: 新しいシーケンス値（タイムアウトした場合はNone）
+    """
+    if wait_until(buffer, lambda: load_seq(buffer) != seen, timeout):
+        return load_seq(buffer)
+    return None
@@ -0,0 +1,221 @@
+#!/usr/bin/env python3
+# -*- coding: utf-8 -*-
+
+"""
+追記専用のスナップショットファイル
+
+非定常計算の履歴（数千ステップ分の配列）をディスク上の1つのファイルに保存し、
+番号で読み戻します。plugins/src/shm_snapshot.hpp と同じ形式・同じ手順を実装し、
+FreeFEM側の snapshotAppend / snapshotRead と同じファイルを読み書きできます。
+
+ファイルは64バイトのヘッダーの後、DATA_OFFSET から同じ要素数のfloat64配列を
+stride バイトおき（ALIGNMENT の倍数）に並べます。追記はデータを書き込んでから
+ヘッダーの count を更新するため、読み込み側が途中まで書かれた内容を見ることはありません
+（書き込み側は1つ）。
+
+読み込みはファイル全体のマッピングを通して行い、読む向きに合わせて
+前向きは MADV_SEQUENTIAL、後ろ向きは MADV_RANDOM を設定し、これから読む
+PREFETCH_BYTES 分を MADV_WILLNEED で先読みします。読み終えたスナップショットは
+MADV_DONTNEED と POSIX_FADV_DONTNEED でページキャッシュから外すため、RAMより大きな
+履歴も後ろ向きに（随伴計算の順に）ディスクの帯域で読み戻せます。
+"""
+
+import os
+import mmap
+import struct
+import numpy as np
+
+from . import shm_layout
+
+# ファイル形式（shm_snapshot.hpp と同一）
+MAGIC = 0x4e534650         # "PFSN"
+VERSION = 1
+DATA_OFFSET = 4096
+ALIGNMENT = 4096
+PREFETCH_BYTES = 32 << 20
+# magic, version, dtype, reserved0, elements, stride, count, data_offset, reserved[2]
+HEADER = struct.Struct('<IIIIQQQQ16x')
+_COUNT_OFFSET = 32
+
+
+def snapshot_stride(elements):
+    """スナップショットの間隔（バイト）"""
+    nbytes = max(elements * 8, 1)
+    return (nbytes + ALIGNMENT - 1) // ALIGNMENT * ALIGNMENT
+
+
+class SnapshotStore:
+    """
+    追記専用のスナップショットファイル
+
+    使用例::
+
+        with SnapshotStore("history.snap", elements=u.size) as store:
+            for step in range(nsteps):
+                ...
+                store.append(u)
+        with SnapshotStore("history.snap") as store:
+            for i in reversed(range(len(store))):
+                u = store.read(i)
+    """
+
+    def __init__(self, path, elements=None):
+        """
+        ファイルを開く
+
+        Args:
+            path (str): ファイルのパス
+            elements (int, optional): 1つのスナップショットの要素数。
+                指定した場合は書き込み用に開き、ファイルがなければ作成する
+                （既存のファイルとは要素数が一致する必要がある）。
+                省略した場合は読み込み専用で開く
+        """
+        self.path = str(path)
+        self.writable = elements is not None
+        self._map = None
+        self._mapped = 0
+        self._last = -1
+        self._direction = 0
+        self._fd = os.open(self.path, os.O_RDWR | os.O_CREAT if self.writable else os.O_RDONLY, 0o644)
+        try:
+            if self.writable and os.fstat(self._fd).st_size == 0:
+                self.elements = int(elements)
+                self.stride = snapshot_stride(self.elements)
+                self.data_offset = DATA_OFFSET
+                self.count = 0
+                os.pwrite(self._fd, HEADER.pack(MAGIC, VERSION, shm_layout.DTYPE_FLOAT64, 0, self.elements,
+                                                self.stride, 0, self.data_offset), 0)
+            else:
+                self._read_header()
+                if self.writable and self.elements != int(elements):
+                    raise ValueError(f"スナップショットの要素数が一致しません: {self.path} "
+                                     f"(ファイル: {self.elements}, 配列: {elements})")
+        except Exception:
+            os.close(self._fd)
+            raise
+
+    def __enter__(self):
+        return self
+
+    def __exit__(self, exc_type, exc_value, traceback):
+        self.close()
+
+    def _read_header(self):
+        """ヘッダーを読み直す（他のプロセスが追記した count を反映する）"""
+        data = os.pread(self._fd, HEADER.size, 0)
+        if len(data) != HEADER.size:
+            raise ValueError(f"スナップショットファイルの形式が不正です: {self.path}")
+        magic, version, dtype, _, elements, stride, count, data_offset = HEADER.unpack(data)
+        if (magic != MAGIC or version != VERSION or dtype != shm_layout.DTYPE_FLOAT64
+                or stride < elements * 8 or stride % ALIGNMENT or data_offset % ALIGNMENT):
+            raise ValueError(f"スナップショットファイルの形式が不正です: {self.path}")
+        self.elements, self.stride, self.count, self.data_offset = elements, stride, count, data_offset
+
+    def __len__(self):
+        """書き込み済みのスナップショット数"""
+        if not self.writable:
+            self._read_header()
+        return self.count
+
+    def append(self, array):
+        """
+        スナップショットを1つ追記
+
+        Args:
+            array (array_like): 要素数 elements の配列（float64に変換して書き込む）
+
+        Returns:
+            int: 追記したスナップショットの番号
+        """
+        if not self.writable:
+            raise RuntimeError(f"スナップショットファイルは読み込み専用で開かれています: {self.path}")
+        data = np.ascontiguousarray(array, dtype='<f8')
+        if data.size != self.elements:
+            raise ValueError(f"スナップショットの要素数が一致しません: {self.path} "
+                             f"(ファイル: {self.elements}, 配列: {data.size})")
+        offset = self.data_offset + self.count * self.stride
+        view = memoryview(data).cast('B')
+        written = 0
+        while written < len(view):
+            written += os.pwrite(self._fd, view[written:], offset + written)
+        os.ftruncate(self._fd, offset + self.stride)
+        # データの後に count を更新する（読み込み側は count までしか読まない）
+        os.pwrite(self._fd, struct.pack('<Q', self.count + 1), _COUNT_OFFSET)
+        self.count += 1
+        return self.count - 1
+
+    def _advise(self, begin, end, advice):
+        """マッピング内の [begin, end) を含むページに madvise を適用する"""
+        begin = begin // mmap.PAGESIZE * mmap.PAGESIZE
+        end = min(end, self._mapped)
+        if begin < end:
+            self._map.madvise(advice, begin, end - begin)
+
+    def _prefetch(self, index):
+        """index 番目を読む前に、向きに合わせて先読みと読み終えた分の解放を行う"""
+        direction = -1 if 0 <= self._last and index < self._last else 1
+        if direction != self._direction:
+            self._advise(0, self._mapped, mmap.MADV_SEQUENTIAL if direction > 0 else mmap.MADV_RANDOM)
+            self._direction = direction
+
+        window = max(PREFETCH_BYTES // self.stride, 1)
+        first, last = (index, min(index + window, self.count - 1)) if direction > 0 else (max(index - window, 0), index)
+        self._advise(self.data_offset + first * self.stride, self.data_offset + (last + 1) * self.stride,
+                     mmap.MADV_WILLNEED)
+
+        # 読み終えたスナップショットはマッピングとページキャッシュの両方から外す
+        if 0 <= self._last != index:
+            begin = self.data_offset + self._last * self.stride
+            self._advise(begin, begin + self.stride, mmap.MADV_DONTNEED)
+            if hasattr(os, 'posix_fadvise'):
+                os.posix_fadvise(self._fd, begin, self.stride, os.POSIX_FADV_DONTNEED)
+        self._last = index
+
+    def view(self, index):
+        """
+        index 番目のスナップショットを指す読み込み専用の配列（コピーなし）
+
+        次に別の番号を読むとページキャッシュから外されるため、使い続ける場合は read() を使用してください。
+        """
+        if index < 0:
+            index += len(self)
+        if not 0 <= index < self.count:
+            self._read_header()
+        if not 0 <= index < self.count:
+            raise IndexError(f"スナップショットの番号が範囲外です: {self.path} ({index}, 個数: {self.count})")
+
+        required = self.data_offset + self.count * self.stride
+        if required > self._mapped:
+            # 古いマッピングは、返した配列がすべて破棄された時点で解放される
+            self._map = mmap.mmap(self._fd, required, mmap.MAP_SHARED, mmap.PROT_READ)
+            self._mapped = required
+            self._direction = 0
+
+        self._prefetch(index)
+        return np.frombuffer(self._map, dtype='<f8', count=self.elements,
+                             offset=self.data_offset + index * self.stride)
+
+    def read(self, index, out=None):
+        """
+        index 番目のスナップショットを読み込み
+
+        Args:
+            index (int): 番号（負の値は末尾から数える）
+            out (numpy.ndarray, optional): 読み込み先の配列（要素数 elements のfloat64）
+
+        Returns:
+            numpy.ndarray: 読み込んだ配列（out を指定した場合は out）
+        """
+        data = self.view(index)
+        if out is None:
+            return data.copy()
+        np.copyto(out, data)
+        return out
+
+    def close(self):
+        """ファイルを閉じる（view() で返した配列が残っている間はマッピングは解放されない）"""
+        self._map = None
+        self._mapped = 0
+        if self._fd >= 0:
+            os.close(self._fd)
+            self._fd = -1
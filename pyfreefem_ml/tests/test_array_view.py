@@ -0,0 +1,98 @@
+#!/usr/bin/env python
+# -*- coding: utf-8 -*-
+
+"""
+test_array_view.py
+共有メモリを直接指す配列（get_array_view）のテスト
+"""
+
+import os
+import sys
+import uuid
+import platform
+import unittest
+import numpy as np
+from pathlib import Path
+
+# プロジェクトルートをパスに追加
+project_root = Path(__file__).parent.parent
+sys.path.insert(0, str(project_root))
+
+from pyfreefem_ml.shm_manager import SharedMemoryManager
+
+
+@unittest.skipUnless(platform.system() == 'Linux' and os.path.isdir('/dev/shm'),
+                     "POSIX共有メモリが必要です")
+class TestArrayView(unittest.TestCase):
+    """get_array_view のテストケース"""
+
+    def setUp(self):
+        """テスト準備"""
+        self.name = f"test_view_{uuid.uuid4().hex[:8]}"
+        self.shm = SharedMemoryManager(self.name, size=64 * 1024)
+
+    def tearDown(self):
+        """テスト後のクリーンアップ"""
+        self.shm.destroy()
+
+    def test_view_aliases_segment(self):
+        """ビューがセグメントを直接指し、書き込みが双方向に反映されること"""
+        data = np.arange(10, dtype=np.float64)
+        self.shm.write_array('u', data)
+        view = self.shm.get_array_view('u')
+        np.testing.assert_array_equal(view, data)
+
+        # 同じ大きさの書き直しは同じ領域に行われる
+        self.shm.write_array('u', 2 * data)
+        np.testing.assert_array_equal(view, 2 * data)
+
+        view[0] = -1.0
+        self.assertEqual(self.shm.read_array('u')[0], -1.0)
+        del view
+
+    def test_dtype_and_shape_from_entry(self):
+        """データ型と形状がエントリの情報から決まること"""
+        self.shm.write_int_array('idx', np.arange(6).reshape(2, 3))
+        view = self.shm.get_array_view('idx')
+        self.assertEqual(view.dtype, np.int32)
+        self.assertEqual(view.shape, (2, 3))
+        del view
+
+    def test_readonly(self):
+        """読み込み専用のビューには書き込めないこと"""
+        self.shm.write_array('u', np.ones(4))
+        view = self.shm.get_array_view('u', readonly=True)
+        with self.assertRaises(ValueError):
+            view[0] = 0.0
+        del view
+
+    def test_dlpack_without_copy(self):
+        """DLPackで受け渡した配列もセグメントを指すこと"""
+        self.shm.write_array('u', np.arange(8, dtype=np.float64))
+        view = self.shm.get_array_view('u')
+        self.assertTrue(hasattr(view, '__dlpack__'))
+        imported = np.from_dlpack(view)
+        self.assertTrue(np.shares_memory(imported, view))
+        view[3] = 42.0
+        self.assertEqual(imported[3], 42.0)
+        del imported, view
+
+    def test_growth_blocked_while_referenced(self):
+        """参照中は拡張できずにエラーになり、参照を破棄すれば拡張できること"""
+        self.shm.write_array('u', np.ones(4))
+        view = self.shm.get_array_view('u')
+        big = np.zeros(64 * 1024)
+        with self.assertRaises(RuntimeError):
+            self.shm.write_array('big', big)
+        del view
+        self.shm.write_array('big', big)
+        self.assertEqual(self.shm.read_array('big').size, big.size)
+
+    def test_missing_key(self):
+        """存在しない変数はKeyErrorになること"""
+        with self.assertRaises(KeyError):
+            self.shm.get_array_view('missing')
+
+
+if __name__ == '__main__':
+    unittest.main()
@@ -0,0 +1,93 @@
+#!/usr/bin/env python
+# -*- coding: utf-8 -*-
+
+"""
+test_batch_arrays.py
+複数配列の一括書き込み・読み込み（write_arrays / read_arrays）のテスト
+"""
+
+import os
+import sys
+import uuid
+import platform
+import unittest
+import numpy as np
+from pathlib import Path
+
+# プロジェクトルートをパスに追加
+project_root = Path(__file__).parent.parent
+sys.path.insert(0, str(project_root))
+
+from pyfreefem_ml.shm_manager import SharedMemoryManager
+
+
+@unittest.skipUnless(platform.system() == 'Linux' and os.path.isdir('/dev/shm'),
+                     "POSIX共有メモリが必要です")
+class TestBatchArrays(unittest.TestCase):
+    """複数配列の一括転送のテストケース"""
+
+    def setUp(self):
+        """テスト準備"""
+        self.name = f"test_batch_{uuid.uuid4().hex[:8]}"
+        self.shm = SharedMemoryManager(self.name, size=64 * 1024)
+        self.reader = SharedMemoryManager(self.name, create=False)
+
+    def tearDown(self):
+        """テスト後のクリーンアップ"""
+        self.reader.cleanup()
+        self.shm.destroy()
+
+    def test_batch_is_published_with_one_notification(self):
+        """一括書き込みは1回の通知・1回の転送統計として記録されること"""
+        fields = {
+            'rho': np.linspace(0.0, 1.0, 50),
+            'ux': np.random.rand(4, 5),
+            'uy': np.random.rand(20),
+        }
+        seq = self.shm.sequence
+        self.shm.write_arrays(fields)
+        self.assertEqual(self.shm.sequence, seq + 1)
+
+        arrays = self.reader.read_arrays(['rho', 'ux', 'uy'])
+        self.assertEqual(list(arrays), ['rho', 'ux', 'uy'])
+        for key, value in fields.items():
+            np.testing.assert_array_equal(arrays[key], value)
+
+        stats = self.shm.stats['python']
+        self.assertEqual(stats['write_calls'], 1)
+        self.assertEqual(stats['read_calls'], 1)
+        self.assertEqual(stats['bytes_written'], sum(v.nbytes for v in fields.values()))
+
+    def test_batch_grows_segment_once(self):
+        """容量を超える一括書き込みでもすべての配列が読めること"""
+        fields = [(f"f{i}", np.full(20000, float(i))) for i in range(4)]
+        self.shm.write_arrays(fields, dtype=np.float32)
+        self.assertGreaterEqual(self.shm.size, 4 * 20000 * 4)
+
+        arrays = self.reader.read_arrays([key for key, _ in fields], dtype=np.float64)
+        for key, value in fields:
+            self.assertEqual(arrays[key].dtype, np.float64)
+            np.testing.assert_array_equal(arrays[key], value)
+        self.assertEqual(self.reader.size, self.shm.size)
+
+    def test_invalid_batches(self):
+        """不正な一括転送はエラーになること"""
+        with self.assertRaises(ValueError):
+            self.shm.write_arrays([('a', np.ones(3)), ('a', np.zeros(3))])
+        with self.assertRaises(ValueError):
+            self.shm.write_arrays({'a': np.ones(3), 'b': np.float64(1.0)})
+        self.assertFalse(self.shm.check_variable_exists('a'))
+
+        self.shm.write_arrays({'a': np.ones(3)})
+        with self.assertRaises(KeyError):
+            self.reader.read_arrays(['a', 'missing'])
+        with self.assertRaises(TimeoutError):
+            self.reader.read_arrays(['a', 'missing'], timeout=0.05)
+
+        self.shm.write_int('n', 1)
+        with self.assertRaises(TypeError):
+            self.reader.read_arrays(['a', 'n'])
+
+
+if __name__ == '__main__':
+    unittest.main()
@@ -0,0 +1,205 @@
+#!/usr/bin/env python
+# -*- coding: utf-8 -*-
+
+"""
+test_binary_file_io.py
+バイナリファイル形式（file_io.write_binary_array / load_binary_array）のテスト
+"""
+
+import io
+import os
+import re
+import sys
+import stat
+import shutil
+import threading
+import platform
+import tempfile
+import unittest
+import numpy as np
+from pathlib import Path
+
+# プロジェクトルートをパスに追加
+project_root = Path(__file__).parent.parent
+sys.path.insert(0, str(project_root))
+
+from pyfreefem_ml import file_io
+from pyfreefem_ml.file_io import (FreeFEMFileIO, write_binary_array, load_binary_array,
+                                  encode_binary_array, decode_binary_array,
+                                  write_binary_stream, read_binary_stream)
+
+PLUGIN_SOURCE = project_root / "plugins" / "src" / "shm_binary_file.hpp"
+
+# readBinaryFile で入力を読み、2倍した値を形状付きで writeBinaryFile する疑似FreeFEM
+FAKE_FREEFEM = """#!{python}
+import sys
+sys.path.insert(0, {package_parent!r})
+from pyfreefem_ml.file_io import write_binary_array, load_binary_array
+
+x = load_binary_array('input.bin')
+write_binary_array('output.bin', (2 * x).reshape(2, -1))
+"""
+
+
+class TestBinaryFormat(unittest.TestCase):
+    """バイナリファイル形式のテストケース"""
+
+    def setUp(self):
+        """テスト準備"""
+        self.temp_dir = tempfile.mkdtemp()
+        self.path = os.path.join(self.temp_dir, "array.bin")
+
+    def tearDown(self):
+        """テスト後のクリーンアップ"""
+        shutil.rmtree(self.temp_dir, ignore_errors=True)
+
+    def test_constants_match_cpp_source(self):
+        """C++の演算子とヘッダーの定数が一致すること"""
+        source = PLUGIN_SOURCE.read_text(encoding='utf-8')
+        for name, value in {'BINARY_FILE_MAGIC': file_io.BINARY_MAGIC,
+                            'BINARY_FILE_VERSION': file_io.BINARY_VERSION,
+                            'BINARY_FILE_VERSION_COMPRESSED': file_io.BINARY_VERSION_COMPRESSED,
+                            'BINARY_CODEC_ZLIB_SHUFFLE': file_io.BINARY_CODEC_ZLIB_SHUFFLE,
+                            'BINARY_SAMPLE_BYTES': file_io.BINARY_SAMPLE_BYTES}.items():
+            match = re.search(rf'\b{name}\s*=\s*(0x[0-9a-fA-F]+|\d+)', source)
+            self.assertIsNotNone(match, f"{name} がソースに見つかりません")
+            self.assertEqual(int(match.group(1), 0), value, name)
+        match = re.search(r'sizeof\(BinaryFileHeader\)\s*==\s*(\d+)', source)
+        self.assertEqual(int(match.group(1)), file_io.BINARY_HEADER_SIZE)
+        match = re.search(r'BINARY_BLOCK_ELEMENTS\s*=\s*1\s*<<\s*(\d+)', source)
+        self.assertIsNotNone(match)
+        self.assertEqual(1 << int(match.group(1)), file_io.BINARY_BLOCK_ELEMENTS)
+
+    def test_compressed_round_trip(self):
+        """圧縮形式で複数ブロックにまたがる配列がそのまま読み込め、滑らかな値は小さくなること"""
+        n = 2 * file_io.BINARY_BLOCK_ELEMENTS + 123
+        smooth = np.sin(np.linspace(0.0, 10.0, n))
+        write_binary_array(self.path, smooth, compress=True)
+        self.assertLess(os.path.getsize(self.path), smooth.nbytes)
+        loaded = load_binary_array(self.path)
+        self.assertNotIsInstance(loaded, np.memmap)
+        np.testing.assert_array_equal(loaded, smooth)
+
+        # 乱数（ほとんど圧縮できない面を含む）や特殊な値もビット単位で一致する
+        noisy = np.random.default_rng(1).standard_normal((4, 1000))
+        noisy[0, :4] = [np.nan, np.inf, -0.0, 5e-324]
+        decoded = decode_binary_array(encode_binary_array(noisy, compress=True))
+        self.assertEqual(decoded.shape, noisy.shape)
+        self.assertEqual(decoded.tobytes(), noisy.tobytes())
+
+        empty = decode_binary_array(encode_binary_array(np.zeros(0), compress=True))
+        self.assertEqual(empty.shape, (0,))
+
+    def test_stream_through_pipe(self):
+        """パイプ越しに書き込んだ配列を先頭から順に読み込めること"""
+        array = np.arange(3 * file_io.BINARY_BLOCK_ELEMENTS, dtype=np.float64).reshape(3, -1)
+        for compress in (False, True):
+            read_fd, write_fd = os.pipe()
+            with open(read_fd, 'rb') as reader, open(write_fd, 'wb') as writer:
+                thread = threading.Thread(target=lambda: (write_binary_stream(writer, array, compress),
+                                                          writer.close()))
+                thread.start()
+                result = read_binary_stream(reader)
+                thread.join()
+            np.testing.assert_array_equal(result, array)
+
+    def test_truncated_compressed(self):
+        """途中で切れた圧縮形式のデータはエラーになること"""
+        data = encode_binary_array(np.linspace(0.0, 1.0, 10000), compress=True)
+        with self.assertRaises(ValueError):
+            read_binary_stream(io.BytesIO(data[:-5]))
+
+    def test_round_trip_keeps_shape_and_values(self):
+        """値と形状がそのまま読み込めること"""
+        array = np.random.default_rng(0).standard_normal((3, 5, 2))
+        write_binary_array(self.path, array)
+        self.assertEqual(os.path.getsize(self.path), file_io.BINARY_HEADER_SIZE + array.nbytes)
+        self.assertFalse(os.path.exists(self.path + '.tmp'))
+
+        loaded = load_binary_array(self.path)
+        self.assertIsInstance(loaded, np.memmap)
+        np.testing.assert_array_equal(loaded, array)
+        copied = load_binary_array(self.path, copy=True)
+        self.assertNotIsInstance(copied, np.memmap)
+        np.testing.assert_array_equal(copied, array)
+
+        np.testing.assert_array_equal(decode_binary_array(encode_binary_array(array)), array)
+
+    def test_header_layout(self):
+        """ヘッダーがリトルエンディアンの固定形式であること"""
+        data = encode_binary_array(np.arange(6.0).reshape(2, 3))
+        self.assertEqual(data[:4], b'PFFB')
+        header = np.frombuffer(data, dtype=file_io.BINARY_HEADER_DTYPE, count=1)[0]
+        self.assertEqual(header['ndim'], 2)
+        self.assertEqual(list(header['shape']), [2, 3, 0, 0])
+        self.assertEqual(header['data_offset'], 64)
+        self.assertEqual(header['nbytes'], 48)
+
+    def test_invalid_files(self):
+        """形式の異なるファイルはエラーになること"""
+        with open(self.path, 'w') as f:
+            f.write("1.0 2.0 3.0\n" * 10)
+        with self.assertRaises(ValueError):
+            load_binary_array(self.path)
+
+        write_binary_array(self.path, np.arange(10.0))
+        with open(self.path, 'r+b') as f:
+            f.truncate(file_io.BINARY_HEADER_SIZE + 8)
+        with self.assertRaises(ValueError):
+            load_binary_array(self.path)
+
+        with self.assertRaises(ValueError):
+            encode_binary_array(np.zeros((1, 1, 1, 1, 2)))
+
+
+@unittest.skipIf(platform.system() == 'Windows', "疑似FreeFEMの実行にはPOSIX環境が必要です")
+class TestBinaryRunScript(unittest.TestCase):
+    """疑似FreeFEMを用いた run_script(binary=True) のテストケース"""
+
+    def setUp(self):
+        """テスト準備"""
+        self.temp_dir = tempfile.mkdtemp()
+        self.executable = os.path.join(self.temp_dir, "FreeFem++")
+        with open(self.executable, 'w') as f:
+            f.write(FAKE_FREEFEM.format(python=sys.executable,
+                                        package_parent=str(project_root.parent.absolute())))
+        os.chmod(self.executable, os.stat(self.executable).st_mode | stat.S_IXUSR)
+        self.script = os.path.join(self.temp_dir, "script.edp")
+        Path(self.script).write_text("// 疑似FreeFEMでは使用しない\n")
+        self.cwd = os.getcwd()
+        os.chdir(self.temp_dir)
+
+    def tearDown(self):
+        """テスト後のクリーンアップ"""
+        os.chdir(self.cwd)
+        shutil.rmtree(self.temp_dir, ignore_errors=True)
+
+    def test_binary_run_script(self):
+        """入出力がバイナリファイルで受け渡され、形状がヘッダーから復元されること"""
+        io = FreeFEMFileIO(freefem_path=self.executable, working_dir=self.temp_dir)
+        x = np.linspace(0.0, 1.0, 8)
+        success, result, stdout, stderr = io.run_script(self.script, input_data=x,
+                                                        input_file='input.bin',
+                                                        output_file='output.bin',
+                                                        binary=True)
+        self.assertTrue(success, stderr)
+        self.assertEqual(result.shape, (2, 4))
+        np.testing.assert_array_equal(result, (2 * x).reshape(2, 4))
+
+    def test_compressed_run_script(self):
+        """compress=True の入力が圧縮形式で書き込まれ、スクリプト側で読み込めること"""
+        io = FreeFEMFileIO(freefem_path=self.executable, working_dir=self.temp_dir)
+        x = np.linspace(0.0, 1.0, 8)
+        success, result, stdout, stderr = io.run_script(self.script, input_data=x,
+                                                        input_file='input.bin',
+                                                        output_file='output.bin',
+                                                        compress=True)
+        self.assertTrue(success, stderr)
+        with open('input.bin', 'rb') as f:
+            header = np.frombuffer(f.read(file_io.BINARY_HEADER_SIZE), dtype=file_io.BINARY_HEADER_DTYPE)[0]
+        self.assertEqual(header['version'], file_io.BINARY_VERSION_COMPRESSED)
+        np.testing.assert_array_equal(result, (2 * x).reshape(2, 4))
+
+
+if __name__ == '__main__':
+    unittest.main()
@@ -0,0 +1,113 @@
+#!/usr/bin/env python
+# -*- coding: utf-8 -*-
+
+"""
+test_buffered_channel.py
+多重バッファのチャネル（BufferedChannel）のテスト
+"""
+
+import os
+import sys
+import uuid
+import platform
+import unittest
+from unittest import mock
+import numpy as np
+from pathlib import Path
+
+# プロジェクトルートをパスに追加
+project_root = Path(__file__).parent.parent
+sys.path.insert(0, str(project_root))
+
+from pyfreefem_ml import shm_layout
+from pyfreefem_ml.shm_manager import SharedMemoryManager, BufferedChannel
+
+
+@unittest.skipUnless(platform.system() == 'Linux' and os.path.isdir('/dev/shm'),
+                     "POSIX共有メモリが必要です")
+class TestBufferedChannel(unittest.TestCase):
+    """多重バッファのチャネルのテストケース"""
+
+    def setUp(self):
+        """テスト準備"""
+        self.name = f"test_channel_{uuid.uuid4().hex[:8]}"
+        self.shm = SharedMemoryManager(self.name, size=64 * 1024)
+        self.reader = SharedMemoryManager(self.name, create=False)
+
+    def tearDown(self):
+        """テスト後のクリーンアップ"""
+        self.reader.cleanup()
+        self.shm.destroy()
+
+    def test_reader_gets_latest_frame(self):
+        """読み込み側は最新のフレームだけを受け取ること"""
+        writer = BufferedChannel(self.shm, 'u', buffers=3)
+        consumer = BufferedChannel(self.reader, 'u')
+        self.assertEqual(consumer.buffers, 3)
+
+        for i in range(1, 4):
+            self.assertTrue(writer.write(np.full(5, float(i))))
+        np.testing.assert_array_equal(consumer.read(), np.full(5, 3.0))
+        self.assertIsNone(consumer.read(timeout=0.05))
+
+        self.assertTrue(writer.write(np.arange(4.0)))
+        np.testing.assert_array_equal(consumer.read(), np.arange(4.0))
+
+    def test_writer_avoids_held_buffer(self):
+        """書き込み側は読み込み中のバッファだけを避けること"""
+        writer = BufferedChannel(self.shm, 'u', buffers=2)
+        consumer = BufferedChannel(self.reader, 'u')
+
+        self.assertTrue(writer.write(np.ones(8)))
+        view = consumer.acquire()
+        np.testing.assert_array_equal(view, np.ones(8))
+
+        # もう一方のバッファには書き込めるが、その次は参照中のバッファになる
+        self.assertTrue(writer.write(np.full(8, 2.0)))
+        self.assertFalse(writer.write(np.full(8, 3.0), timeout=0.05))
+        np.testing.assert_array_equal(view, np.ones(8))
+
+        del view
+        self.assertTrue(consumer.release())
+        self.assertTrue(writer.write(np.full(8, 3.0)))
+        np.testing.assert_array_equal(consumer.read(), np.full(8, 3.0))
+        self.assertEqual(writer.published, 3)
+
+    def test_configuration_errors(self):
+        """チャネルの構成の誤りはエラーになること"""
+        BufferedChannel(self.shm, 'u', buffers=2)
+        with self.assertRaises(ValueError):
+            BufferedChannel(self.shm, 'u', buffers=3)
+        with self.assertRaises(ValueError):
+            BufferedChannel(self.shm, 'v', buffers=4)
+        with self.assertRaises(KeyError):
+            BufferedChannel(self.reader, 'missing')
+
+        self.shm.write_array('plain', np.zeros(4))
+        with self.assertRaises(TypeError):
+            BufferedChannel(self.reader, 'plain')
+
+    def test_requires_seq_cst_atomics(self):
+        """libatomic がない場合はx86でも通常の読み書きで代用せずRuntimeErrorになること"""
+        BufferedChannel(self.shm, 'u', buffers=2)
+        with mock.patch.object(shm_layout, '_atomic_exchange_8', None), \
+                mock.patch.object(shm_layout, 'TSO_MACHINE', True):
+            with self.assertRaises(RuntimeError):
+                BufferedChannel(self.reader, 'u')
+
+    def test_control_words_are_shared(self):
+        """制御用の語の読み書きが相手側のマッピングから見え、拡張後も参照を残さないこと"""
+        writer = BufferedChannel(self.shm, 'u', buffers=2)
+        consumer = BufferedChannel(self.reader, 'u')
+        self.assertTrue(writer.write(np.ones(4)))
+        self.assertIsNotNone(consumer.acquire())
+        self.assertEqual(writer._load(BufferedChannel._ACQUIRED), 1)
+        self.assertTrue(consumer.release())
+        self.assertEqual(writer._load(BufferedChannel._ACQUIRED), 0)
+        # 制御用の語の参照が残っていればマッピングを拡張できない
+        self.shm.write_array('big', np.zeros(64 * 1024))
+        self.assertTrue(writer.write(np.full(4, 2.0)))
+
+
+if __name__ == '__main__':
+    unittest.main()
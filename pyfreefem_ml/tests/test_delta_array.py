@@ -0,0 +1,135 @@
+#!/usr/bin/env python
+# -*- coding: utf-8 -*-
+
+"""
+test_delta_array.py
+差分転送（DeltaArray）のテスト
+"""
+
+import os
+import re
+import sys
+import uuid
+import platform
+import unittest
+import numpy as np
+from pathlib import Path
+
+# プロジェクトルートをパスに追加
+project_root = Path(__file__).parent.parent
+sys.path.insert(0, str(project_root))
+
+from pyfreefem_ml.shm_manager import SharedMemoryManager, DeltaArray
+
+TRANSPORT_HEADER = project_root / "plugins" / "src" / "shm_transport.hpp"
+
+
+class TestDeltaConstants(unittest.TestCase):
+    """プラグインとの定数の一致のテストケース"""
+
+    def test_constants_match_cpp_header(self):
+        """C++ヘッダーと差分転送の定数が一致すること"""
+        source = TRANSPORT_HEADER.read_text(encoding='utf-8')
+        match = re.search(r'#define\s+SHM_DELTA_SUFFIX\s+"([^"]+)"', source)
+        self.assertIsNotNone(match)
+        self.assertEqual(match.group(1), DeltaArray.SUFFIX)
+        for name, value in {'SHM_DELTA_BLOCK_ELEMENTS': DeltaArray.BLOCK_ELEMENTS,
+                            'SHM_DELTA_CHECKSUM_MULTIPLIER': DeltaArray.CHECKSUM_MULTIPLIER,
+                            'SHM_DELTA_WORDS': DeltaArray.HEADER_WORDS}.items():
+            match = re.search(rf'\b{name}\s*=\s*(0x[0-9A-Fa-f]+|\d+)', source)
+            self.assertIsNotNone(match, f"{name} がヘッダーに見つかりません")
+            self.assertEqual(int(match.group(1), 0), value, name)
+
+    def test_checksum_detects_single_change(self):
+        """ブロック内の1要素の変更でチェックサムが変わること"""
+        x = np.linspace(0.0, 1.0, 10)
+        base = DeltaArray.checksums(x, 4)
+        self.assertEqual(base.shape, (3,))
+        for i in range(x.size):
+            y = x.copy()
+            y[i] = -y[i] - 1.0
+            changed = DeltaArray.checksums(y, 4) != base
+            self.assertEqual(list(np.flatnonzero(changed)), [i // 4])
+
+
+@unittest.skipUnless(platform.system() == 'Linux' and os.path.isdir('/dev/shm'),
+                     "POSIX共有メモリが必要です")
+class TestDeltaArray(unittest.TestCase):
+    """差分転送の配列のテストケース"""
+
+    def setUp(self):
+        """テスト準備"""
+        self.name = f"test_delta_{uuid.uuid4().hex[:8]}"
+        self.shm = SharedMemoryManager(self.name, size=64 * 1024)
+        self.reader = SharedMemoryManager(self.name, create=False)
+
+    def tearDown(self):
+        """テスト後のクリーンアップ"""
+        self.reader.cleanup()
+        self.shm.destroy()
+
+    def test_only_changed_blocks_are_copied(self):
+        """変更したブロックだけが書き込まれ、読み込み側にコピーされること"""
+        writer = DeltaArray(self.shm, 'rho', block_elements=100)
+        consumer = DeltaArray(self.reader, 'rho')
+        x = np.arange(1050, dtype=np.float64)
+
+        self.assertEqual(writer.write(x), 11)
+        np.testing.assert_array_equal(consumer.read(), x)
+        self.assertEqual(consumer.copied_blocks, 11)
+
+        self.assertEqual(writer.write(x), 0)
+        np.testing.assert_array_equal(consumer.read(), x)
+        self.assertEqual(consumer.copied_blocks, 0)
+
+        x[150] = -1.0
+        x[1049] = -2.0
+        self.assertEqual(writer.write(x), 2)
+        result = consumer.read()
+        np.testing.assert_array_equal(result, x)
+        self.assertEqual(consumer.copied_blocks, 2)
+
+        # 保持している配列がそのまま更新される
+        x[0] = 5.0
+        writer.write(x)
+        self.assertIs(consumer.read(), result)
+        np.testing.assert_array_equal(result, x)
+
+        # 本体は通常の配列として読める
+        np.testing.assert_array_equal(self.reader.read_array('rho'), x)
+
+    def test_reconfiguration_rewrites_everything(self):
+        """要素数の変更や通常の書き込みの後は全体が転送されること"""
+        writer = DeltaArray(self.shm, 'u', block_elements=64)
+        consumer = DeltaArray(self.reader, 'u')
+        writer.write(np.zeros(200))
+        consumer.read()
+
+        self.assertEqual(writer.write(np.ones(300)), 5)
+        np.testing.assert_array_equal(consumer.read(), np.ones(300))
+        self.assertEqual(consumer.copied_blocks, 5)
+
+        # 差分転送以外の書き込みはブロック情報を無効にする
+        self.shm.write_array('u', np.full(300, 2.0))
+        np.testing.assert_array_equal(consumer.read(), np.full(300, 2.0))
+        self.assertEqual(writer.write(np.full(300, 2.0)), 5)
+        np.testing.assert_array_equal(consumer.read(), np.full(300, 2.0))
+
+    def test_errors(self):
+        """存在しない変数や不正な構成はエラーになること"""
+        with self.assertRaises(KeyError):
+            DeltaArray(self.reader, 'missing').read()
+        with self.assertRaises(TimeoutError):
+            DeltaArray(self.reader, 'missing').read(timeout=0.05)
+        with self.assertRaises(ValueError):
+            DeltaArray(self.shm, 'x' * 45)
+        with self.assertRaises(ValueError):
+            DeltaArray(self.shm, 'v', block_elements=0)
+
+        self.shm.write_array('plain', np.zeros(4))
+        with self.assertRaises(KeyError):
+            DeltaArray(self.reader, 'plain').read()
+
+
+if __name__ == '__main__':
+    unittest.main()
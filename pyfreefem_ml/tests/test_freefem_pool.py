@@ -0,0 +1,145 @@
+#!/usr/bin/env python
+# -*- coding: utf-8 -*-
+
+"""
+test_freefem_pool.py
+常駐ワーカーのプール（FreeFEMWorkerPool）のテスト
+
+FreeFEMの代わりに、ワーカー側のプロトコル（shmWaitCommand/shmPostResult）を
+Pythonで再現した実行ファイルを起動して、Python側の動作を確認します。
+"""
+
+import os
+import sys
+import stat
+import shutil
+import platform
+import tempfile
+import unittest
+import numpy as np
+from pathlib import Path
+
+# プロジェクトルートをパスに追加
+project_root = Path(__file__).parent.parent
+sys.path.insert(0, str(project_root))
+
+from pyfreefem_ml.freefem_pool import FreeFEMWorkerPool
+from pyfreefem_ml.errors import FreeFEMExecutionError
+
+WORKER_SCRIPT = project_root / "plugins" / "scripts" / "samples" / "worker.edp"
+
+# 'x' を受け取り、'delay' 秒待ってから [2 * x, プロセスID] を 'y' に書き込む疑似ワーカー
+FAKE_WORKER = """#!{python}
+import os
+import sys
+import time
+sys.path.insert(0, {package_parent!r})
+import numpy as np
+from pyfreefem_ml.shm_manager import SharedMemoryManager
+from pyfreefem_ml import shm_sync
+
+shm = SharedMemoryManager(os.environ['FF_SHM_NAME'], create=False)
+
+def pending():
+    command = shm.layout.find('__worker_cmd')
+    done = shm.layout.find('__worker_done')
+    return command is not None and command.generation > (done.generation if done else 0)
+
+while shm_sync.wait_until(shm.memory, pending, 30):
+    command_id, op = (int(v) for v in shm.read_int_array('__worker_cmd'))
+    if op == 2:
+        break
+    x = shm.read_double('x')
+    time.sleep(shm.read_double('delay'))
+    shm.write_array('y', [2 * x, os.getpid()])
+    status = -1 if x < 0 else 0
+    shm.write_array('__worker_done', [command_id, status], dtype=np.int64)
+"""
+
+
+class TestWorkStealing(unittest.TestCase):
+    """ジョブの割り当て（ワークスティーリング）のテストケース"""
+
+    def test_every_job_is_taken_once(self):
+        """すべてのジョブが1回ずつ割り当てられ、空いたワーカーが残りを奪うこと"""
+        pool = FreeFEMWorkerPool(str(WORKER_SCRIPT), workers=3)
+        pool._ranges = [[0, 3], [3, 6], [6, 10]]
+
+        # ワーカー0だけが処理を進めると、自分の範囲の後に他の範囲を奪う
+        taken = []
+        while True:
+            job = pool._next_job(0)
+            if job is None:
+                break
+            taken.append(job)
+        self.assertEqual(sorted(taken), list(range(10)))
+        self.assertEqual(taken[:3], [0, 1, 2])
+        self.assertIsNone(pool._next_job(1))
+
+
+@unittest.skipUnless(platform.system() == 'Linux' and os.path.isdir('/dev/shm'),
+                     "POSIX共有メモリが必要です")
+class TestFreeFEMWorkerPool(unittest.TestCase):
+    """疑似ワーカーを用いたFreeFEMWorkerPoolのテストケース"""
+
+    def setUp(self):
+        """テスト準備"""
+        self.temp_dir = tempfile.mkdtemp()
+        self.executable = os.path.join(self.temp_dir, "FreeFem++")
+        with open(self.executable, 'w') as f:
+            f.write(FAKE_WORKER.format(python=sys.executable,
+                                       package_parent=str(project_root.parent.absolute())))
+        os.chmod(self.executable, os.stat(self.executable).st_mode | stat.S_IXUSR)
+
+    def tearDown(self):
+        """テスト後のクリーンアップ"""
+        shutil.rmtree(self.temp_dir, ignore_errors=True)
+
+    def _pool(self, workers=2):
+        return FreeFEMWorkerPool(str(WORKER_SCRIPT), workers=workers, freefem_path=self.executable,
+                                 timeout=30)
+
+    def test_results_fill_preallocated_array(self):
+        """各ジョブの結果が出力先の対応する行に書き込まれ、全ワーカーが処理すること"""
+        # 前半のジョブだけ遅くして、後半を担当するワーカーに奪わせる
+        jobs = [{'x': float(i), 'delay': 0.05 if i < 6 else 0.0} for i in range(12)]
+        out = np.zeros((len(jobs), 2))
+        with self._pool() as pool:
+            paths = [worker.shm.path for worker in pool.workers]
+            pids = {worker.process.pid for worker in pool.workers}
+            result = pool.map(jobs, 'y', out=out)
+
+        self.assertIs(result, out)
+        np.testing.assert_array_equal(out[:, 0], 2 * np.arange(len(jobs)))
+        self.assertEqual(set(out[:6, 1].astype(int)), pids)
+        for path in paths:
+            self.assertFalse(os.path.exists(path))
+
+    def test_workers_are_pinned(self):
+        """ワーカーのプロセスがそれぞれ1つのコアに固定されること"""
+        with self._pool() as pool:
+            for worker in pool.workers:
+                self.assertEqual(len(os.sched_getaffinity(worker.process.pid)), 1)
+
+    def test_output_allocated_from_shape(self):
+        """出力先を省略した場合は形状から確保されること"""
+        with self._pool() as pool:
+            result = pool.map([{'x': 1.0, 'delay': 0.0}], 'y', output_shape=(2,))
+        self.assertEqual(result.shape, (1, 2))
+        self.assertEqual(result[0, 0], 2.0)
+
+    def test_failure_is_raised(self):
+        """失敗したジョブの例外が送出されること"""
+        with self._pool() as pool:
+            with self.assertRaises(FreeFEMExecutionError):
+                pool.map([{'x': -1.0, 'delay': 0.0}], 'y', output_shape=(2,))
+
+    def test_mismatched_output(self):
+        """出力先の行数がジョブ数と異なる場合はエラーになること"""
+        pool = self._pool()
+        with self.assertRaises(ValueError):
+            pool.map([{'x': 1.0, 'delay': 0.0}], 'y', out=np.zeros((2, 2)))
+
+
+if __name__ == '__main__':
+    unittest.main()
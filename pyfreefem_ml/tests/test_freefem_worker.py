@@ -0,0 +1,136 @@
+#!/usr/bin/env python
+# -*- coding: utf-8 -*-
+
+"""
+test_freefem_worker.py
+常駐ワーカー（FreeFEMWorker）とコマンドチャネルのテスト
+
+FreeFEMの代わりに、ワーカー側のプロトコル（shmWaitCommand/shmPostResult）を
+Pythonで再現した実行ファイルを起動して、Python側の動作を確認します。
+"""
+
+import os
+import re
+import sys
+import stat
+import shutil
+import platform
+import tempfile
+import unittest
+import numpy as np
+from pathlib import Path
+
+# プロジェクトルートをパスに追加
+project_root = Path(__file__).parent.parent
+sys.path.insert(0, str(project_root))
+
+from pyfreefem_ml import freefem_worker
+from pyfreefem_ml.freefem_worker import FreeFEMWorker
+from pyfreefem_ml.errors import FreeFEMExecutionError
+
+TRANSPORT_HEADER = project_root / "plugins" / "src" / "shm_transport.hpp"
+WORKER_SCRIPT = project_root / "plugins" / "scripts" / "samples" / "worker.edp"
+
+# samples/worker.edp と同じ処理を行う疑似ワーカー（引数は無視する）
+FAKE_WORKER = """#!{python}
+import os
+import sys
+sys.path.insert(0, {package_parent!r})
+import numpy as np
+from pyfreefem_ml.shm_manager import SharedMemoryManager
+from pyfreefem_ml import shm_sync
+
+shm = SharedMemoryManager(os.environ['FF_SHM_NAME'], create=False)
+
+def pending():
+    command = shm.layout.find('__worker_cmd')
+    done = shm.layout.find('__worker_done')
+    return command is not None and command.generation > (done.generation if done else 0)
+
+while shm_sync.wait_until(shm.memory, pending, 30):
+    command_id, op = (int(v) for v in shm.read_int_array('__worker_cmd'))
+    if op == 2:
+        break
+    if shm.check_variable_exists('crash'):
+        os._exit(3)
+    shm.write_array('y', 2 * shm.read_array('x'))
+    shm.write_int('pid', os.getpid())
+    status = -1 if shm.check_variable_exists('reject') else 0
+    shm.write_array('__worker_done', [command_id, status], dtype=np.int64)
+"""
+
+
+class TestWorkerConstants(unittest.TestCase):
+    """プラグインとの定数の一致のテストケース"""
+
+    def test_constants_match_cpp_header(self):
+        """C++ヘッダーとコマンドチャネルの定数が一致すること"""
+        source = TRANSPORT_HEADER.read_text(encoding='utf-8')
+        for name, value in {'SHM_WORKER_COMMAND_KEY': freefem_worker.WORKER_COMMAND_KEY,
+                            'SHM_WORKER_RESULT_KEY': freefem_worker.WORKER_RESULT_KEY}.items():
+            match = re.search(rf'#define\s+{name}\s+"([^"]+)"', source)
+            self.assertIsNotNone(match, f"{name} がヘッダーに見つかりません")
+            self.assertEqual(match.group(1), value, name)
+        for name, value in {'SHM_WORKER_RUN': freefem_worker.WORKER_RUN,
+                            'SHM_WORKER_STOP': freefem_worker.WORKER_STOP}.items():
+            match = re.search(rf'\b{name}\s*=\s*(\d+)', source)
+            self.assertIsNotNone(match, f"{name} がヘッダーに見つかりません")
+            self.assertEqual(int(match.group(1)), value, name)
+
+
+@unittest.skipUnless(platform.system() == 'Linux' and os.path.isdir('/dev/shm'),
+                     "POSIX共有メモリが必要です")
+class TestFreeFEMWorker(unittest.TestCase):
+    """疑似ワーカーを用いたFreeFEMWorkerのテストケース"""
+
+    def setUp(self):
+        """テスト準備"""
+        self.temp_dir = tempfile.mkdtemp()
+        self.executable = os.path.join(self.temp_dir, "FreeFem++")
+        with open(self.executable, 'w') as f:
+            f.write(FAKE_WORKER.format(python=sys.executable,
+                                       package_parent=str(project_root.parent.absolute())))
+        os.chmod(self.executable, os.stat(self.executable).st_mode | stat.S_IXUSR)
+
+    def tearDown(self):
+        """テスト後のクリーンアップ"""
+        shutil.rmtree(self.temp_dir, ignore_errors=True)
+
+    def _worker(self):
+        return FreeFEMWorker(str(WORKER_SCRIPT), freefem_path=self.executable, timeout=30)
+
+    def test_repeated_calls_reuse_process(self):
+        """同じプロセスで複数回の処理を行い、停止時に共有メモリが削除されること"""
+        with self._worker() as worker:
+            path = worker.shm.path
+            pid = worker.process.pid
+            for i in range(1, 4):
+                x = np.linspace(0.0, 1.0, 10) * i
+                self.assertEqual(worker.call({'x': x}), 0)
+                np.testing.assert_array_equal(worker.shm.read_array('y'), 2 * x)
+                self.assertEqual(worker.shm.read_int('pid'), pid)
+            process = worker.process
+
+        self.assertEqual(process.returncode, 0)
+        self.assertFalse(os.path.exists(path))
+
+    def test_negative_status_keeps_worker(self):
+        """負の状態値は例外になり、ワーカーは動作を続けること"""
+        with self._worker() as worker:
+            with self.assertRaises(FreeFEMExecutionError):
+                worker.call({'x': np.ones(3), 'reject': 1})
+            self.assertTrue(worker.is_alive())
+
+    def test_worker_exit_is_reported(self):
+        """処理中にワーカーが終了した場合は終了コード付きの例外になること"""
+        worker = self._worker().start()
+        path = worker.shm.path
+        with self.assertRaises(FreeFEMExecutionError) as context:
+            worker.call({'x': np.ones(3), 'crash': 1})
+        self.assertEqual(context.exception.details['return_code'], 3)
+        self.assertFalse(worker.is_alive())
+        self.assertFalse(os.path.exists(path))
+
+
+if __name__ == '__main__':
+    unittest.main()
@@ -0,0 +1,90 @@
+#!/usr/bin/env python
+# -*- coding: utf-8 -*-
+
+"""
+test_mesh_export.py
+メッシュの読み込み（read_mesh）のテスト
+
+FreeFEM側の shmWriteMesh と同じ形式のエントリをPythonから書き込み、読み込み側を確認します。
+"""
+
+import os
+import sys
+import uuid
+import platform
+import unittest
+import numpy as np
+from pathlib import Path
+
+# プロジェクトルートをパスに追加
+project_root = Path(__file__).parent.parent
+sys.path.insert(0, str(project_root))
+
+from pyfreefem_ml.shm_manager import SharedMemoryManager
+
+VERTICES = np.array([[0.0, 0.0], [1.0, 0.0], [1.0, 1.0], [0.0, 1.0]])
+ELEMENTS = np.array([[0, 1, 2], [0, 2, 3]])
+LABELS = np.array([1, 2])
+
+
+@unittest.skipUnless(platform.system() == 'Linux' and os.path.isdir('/dev/shm'),
+                     "POSIX共有メモリが必要です")
+class TestReadMesh(unittest.TestCase):
+    """read_mesh のテストケース"""
+
+    def setUp(self):
+        """テスト準備"""
+        self.name = f"test_mesh_{uuid.uuid4().hex[:8]}"
+        self.shm = SharedMemoryManager(self.name, size=64 * 1024)
+
+    def tearDown(self):
+        """テスト後のクリーンアップ"""
+        self.shm.destroy()
+
+    def _write_mesh(self, key, vertices, elements, labels, mesh_hash):
+        """shmWriteMesh と同じエントリを書き込む"""
+        self.shm.write_array(f"{key}.vertices", vertices.reshape(-1))
+        self.shm.write_int_array(f"{key}.elements", elements.reshape(-1))
+        self.shm.write_int_array(f"{key}.labels", labels)
+        self.shm.write_array(key, [vertices.shape[1], len(vertices), len(elements), mesh_hash],
+                             dtype=np.int64)
+
+    def test_read_mesh(self):
+        """頂点座標・接続・ラベルが要素ごとの形状で読み込まれること"""
+        self._write_mesh('Th', VERTICES, ELEMENTS, LABELS, 12345)
+        vertices, elements, labels = self.shm.read_mesh('Th')
+        np.testing.assert_array_equal(vertices, VERTICES)
+        np.testing.assert_array_equal(elements, ELEMENTS)
+        np.testing.assert_array_equal(labels, LABELS)
+        self.assertEqual(elements.dtype, np.int32)
+        self.assertFalse(vertices.flags.writeable)
+
+    def test_unchanged_hash_reuses_arrays(self):
+        """ハッシュが変わらなければ前回の配列が返り、変われば読み直されること"""
+        self._write_mesh('Th', VERTICES, ELEMENTS, LABELS, 1)
+        first = self.shm.read_mesh('Th')
+        self.assertIs(self.shm.read_mesh('Th'), first)
+
+        moved = VERTICES.copy()
+        moved[2] = [2.0, 1.0]
+        self._write_mesh('Th', moved, ELEMENTS, LABELS, 2)
+        vertices, _, _ = self.shm.read_mesh('Th')
+        np.testing.assert_array_equal(vertices, moved)
+
+    def test_not_a_mesh(self):
+        """メッシュでない変数はTypeErrorになること"""
+        self.shm.write_array('u', np.ones(4))
+        with self.assertRaises(TypeError):
+            self.shm.read_mesh('u')
+
+    def test_inconsistent_entries(self):
+        """ヘッダーとエントリの大きさが一致しない場合はエラーになること"""
+        self._write_mesh('Th', VERTICES, ELEMENTS, LABELS, 1)
+        self.shm.write_int_array('Th.labels', [1])
+        self.shm.write_array('Th', [2, 4, 2, 3], dtype=np.int64)
+        with self.assertRaises(ValueError):
+            self.shm.read_mesh('Th')
+
+
+if __name__ == '__main__':
+    unittest.main()
@@ -0,0 +1,116 @@
+#!/usr/bin/env python
+# -*- coding: utf-8 -*-
+
+"""
+test_param_block.py
+パラメータブロック（write_params / read_params）のテスト
+
+FreeFEM側の shmGetParams が読み込むブロックの形式と、反復ごとのその場での更新を確認します。
+"""
+
+import os
+import re
+import sys
+import uuid
+import platform
+import unittest
+from pathlib import Path
+
+# プロジェクトルートをパスに追加
+project_root = Path(__file__).parent.parent
+sys.path.insert(0, str(project_root))
+
+from pyfreefem_ml.shm_manager import SharedMemoryManager
+
+PARAM_OPS = project_root / 'plugins' / 'src' / 'param_ops.cpp'
+
+
+class TestParamBlockFormat(unittest.TestCase):
+    """ブロックの形式が param_ops.cpp と一致するかのテストケース"""
+
+    def test_constants_match(self):
+        """マジック・名前長・種類の値が一致すること"""
+        source = PARAM_OPS.read_text(encoding='utf-8')
+        self.assertEqual(int(re.search(r'PARAM_MAGIC = (0x[0-9a-f]+);', source).group(1), 16),
+                         SharedMemoryManager._PARAM_MAGIC)
+        self.assertEqual(int(re.search(r'PARAM_NAME_LEN = (\d+);', source).group(1)),
+                         SharedMemoryManager._PARAM_NAME_LEN)
+        for kind in ('DOUBLE', 'INT', 'STRING'):
+            value = int(re.search(rf'PARAM_{kind} = (\d+)', source).group(1))
+            self.assertEqual(value, getattr(SharedMemoryManager, f'_PARAM_{kind}'))
+
+    def test_record_sizes(self):
+        """ヘッダーとレコードの大きさが static_assert と一致すること"""
+        source = PARAM_OPS.read_text(encoding='utf-8')
+        header = int(re.search(r'sizeof\(ParamBlockHeader\) == (\d+)', source).group(1))
+        record = int(re.search(r'sizeof\(ParamRecord\) == (\d+)', source).group(1))
+        self.assertEqual(SharedMemoryManager._PARAM_HEADER.size, header)
+        self.assertEqual(SharedMemoryManager._PARAM_RECORD.size, record)
+
+
+@unittest.skipUnless(platform.system() == 'Linux' and os.path.isdir('/dev/shm'),
+                     "POSIX共有メモリが必要です")
+class TestParamBlock(unittest.TestCase):
+    """write_params / read_params のテストケース"""
+
+    def setUp(self):
+        """テスト準備"""
+        self.name = f"test_params_{uuid.uuid4().hex[:8]}"
+        self.shm = SharedMemoryManager(self.name, size=64 * 1024)
+
+    def tearDown(self):
+        """テスト後のクリーンアップ"""
+        self.shm.destroy()
+
+    def test_roundtrip(self):
+        """int / float / str / bool が種類を保って読み込まれること"""
+        params = {'dt': 0.01, 'n': 40, 'mode': 'implicit', 'verbose': True}
+        self.shm.write_params('params', params)
+        self.assertEqual(self.shm.read_params('params'),
+                         {'dt': 0.01, 'n': 40, 'mode': 'implicit', 'verbose': 1})
+
+    def test_update_in_place(self):
+        """名前と種類が同じなら同じ領域が書き換えられ、世代番号だけが進むこと"""
+        self.shm.write_params('params', {'dt': 0.1, 'n': 1, 'mode': 'a'})
+        entry = self.shm.layout.find('params')
+        for step in range(2, 10):
+            self.shm.write_params('params', {'dt': 0.1 * step, 'n': step, 'mode': 'b' * step})
+        updated = self.shm.layout.find('params')
+        self.assertEqual((updated.offset, updated.nbytes), (entry.offset, entry.nbytes))
+        self.assertEqual(updated.generation, entry.generation + 8)
+        self.assertEqual(self.shm.read_params('params'), {'dt': 0.1 * 9, 'n': 9, 'mode': 'b' * 9})
+
+    def test_layout_change_rebuilds_block(self):
+        """種類の変更・パラメータの追加・容量を超える文字列ではブロックが作り直されること"""
+        self.shm.write_params('params', {'n': 1, 'mode': 'a'})
+        self.shm.write_params('params', {'n': 1.5, 'mode': 'a'})
+        self.assertEqual(self.shm.read_params('params'), {'n': 1.5, 'mode': 'a'})
+        self.shm.write_params('params', {'n': 2, 'mode': 'a', 'tol': 1e-8})
+        self.shm.write_params('params', {'n': 3, 'mode': 'x' * 1000, 'tol': 1e-8})
+        self.assertEqual(self.shm.read_params('params'), {'n': 3, 'mode': 'x' * 1000, 'tol': 1e-8})
+
+    def test_invalid_params(self):
+        """サポートされない型と不正な名前はエラーになること"""
+        with self.assertRaises(TypeError):
+            self.shm.write_params('params', {'x': [1, 2]})
+        with self.assertRaises(ValueError):
+            self.shm.write_params('params', {'a,b': 1})
+        with self.assertRaises(ValueError):
+            self.shm.write_params('params', {'x' * 40: 1})
+
+    def test_not_a_param_block(self):
+        """パラメータブロックでない変数はTypeErrorになること"""
+        self.shm.write_array('u', [1.0, 2.0])
+        with self.assertRaises(TypeError):
+            self.shm.read_params('u')
+
+    def test_delete_and_rewrite(self):
+        """削除した後も書き込み直せること"""
+        self.shm.write_params('params', {'n': 1})
+        self.shm.delete_variable('params')
+        self.shm.write_params('params', {'n': 2})
+        self.assertEqual(self.shm.read_params('params'), {'n': 2})
+
+
+if __name__ == '__main__':
+    unittest.main()
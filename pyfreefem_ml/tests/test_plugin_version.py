@@ -0,0 +1,88 @@
+#!/usr/bin/env python
+# -*- coding: utf-8 -*-
+
+"""
+test_plugin_version.py
+プラグインの確認（find_plugin / check_plugin_availability）のテスト
+
+ファイルに埋め込まれたバージョンを読み取り、FreeFEMを起動せずに判定できることを確認します。
+"""
+
+import os
+import re
+import sys
+import tempfile
+import unittest
+from unittest import mock
+from pathlib import Path
+
+# プロジェクトルートをパスに追加
+project_root = Path(__file__).parent.parent
+sys.path.insert(0, str(project_root))
+
+from pyfreefem_ml import freefem_runner
+from pyfreefem_ml.freefem_runner import FreeFEMRunner, read_plugin_version
+
+PLUGIN_SRC = project_root / 'plugins' / 'src'
+
+
+class TestPluginVersion(unittest.TestCase):
+    """プラグインのバージョンのテストケース"""
+
+    def setUp(self):
+        """テスト準備"""
+        self.dir = tempfile.TemporaryDirectory()
+        self.runner = FreeFEMRunner(freefem_path="FreeFem++")
+        self.runner._is_wsl_environment = lambda: False
+
+    def tearDown(self):
+        """テスト後のクリーンアップ"""
+        self.dir.cleanup()
+
+    def _write_plugin(self, name, version, suffix='.so'):
+        """バージョンの文字列を埋め込んだダミーのプラグインを作成"""
+        path = os.path.join(self.dir.name, name + suffix)
+        with open(path, 'wb') as f:
+            f.write(b'\x7fELF' + b'\0' * 64)
+            if version is not None:
+                f.write(freefem_runner.SHM_PLUGIN_VERSION_TAG + str(version).encode() + b'\0')
+            f.write(b'\0' * 64)
+        return path
+
+    def test_version_matches_cpp(self):
+        """埋め込まれる文字列とバージョンが shm_implementation.cpp / shm_layout.hpp と一致すること"""
+        source = (PLUGIN_SRC / 'shm_implementation.cpp').read_text(encoding='utf-8')
+        tag = re.search(r'pyfreefem_shm_plugin_version\[\] = "([^"]+/)(\d+)";', source)
+        self.assertEqual(tag.group(1).encode(), freefem_runner.SHM_PLUGIN_VERSION_TAG)
+        layout = (PLUGIN_SRC / 'shm_layout.hpp').read_text(encoding='utf-8')
+        version = int(re.search(r'SHM_SEGMENT_VERSION = (\d+);', layout).group(1))
+        self.assertEqual(int(tag.group(2)), version)
+        self.assertEqual(version, freefem_runner.SEGMENT_VERSION)
+
+    def test_read_plugin_version(self):
+        """埋め込まれたバージョンが読み取れ、ない場合はNoneになること"""
+        self.assertEqual(read_plugin_version(self._write_plugin('a', 7)), 7)
+        self.assertIsNone(read_plugin_version(self._write_plugin('b', None)))
+
+    def test_find_plugin(self):
+        """plugin_dir と FFPP_LOADPATH から見つかること"""
+        path = self._write_plugin('mmap-semaphore', freefem_runner.SEGMENT_VERSION)
+        self.assertEqual(self.runner.find_plugin('mmap-semaphore', self.dir.name), path)
+        with mock.patch.dict(os.environ, {'FFPP_LOADPATH': self.dir.name}):
+            self.assertEqual(self.runner.find_plugin('mmap-semaphore'), path)
+        self.assertIsNone(self.runner.find_plugin('no-such-plugin', self.dir.name))
+
+    def test_availability_without_freefem(self):
+        """ファイルが見つかればFreeFEMを起動せず、バージョンの不一致はFalseになること"""
+        self._write_plugin('mmap-semaphore', freefem_runner.SEGMENT_VERSION)
+        self._write_plugin('other', None)
+        with mock.patch.object(self.runner, 'run_script') as run_script:
+            self.assertTrue(self.runner.check_plugin_availability('mmap-semaphore', self.dir.name))
+            self.assertTrue(self.runner.check_plugin_availability('other', self.dir.name))
+            self._write_plugin('mmap-semaphore', freefem_runner.SEGMENT_VERSION - 1)
+            self.assertFalse(self.runner.check_plugin_availability('mmap-semaphore', self.dir.name))
+            run_script.assert_not_called()
+
+
+if __name__ == '__main__':
+    unittest.main()
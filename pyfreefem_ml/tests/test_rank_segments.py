@@ -0,0 +1,153 @@
+#!/usr/bin/env python
+# -*- coding: utf-8 -*-
+
+"""
+test_rank_segments.py
+ランクごとのセグメントによる分割配列（RankSegments）のテスト
+"""
+
+import os
+import re
+import sys
+import uuid
+import platform
+import threading
+import unittest
+import numpy as np
+from pathlib import Path
+
+# プロジェクトルートをパスに追加
+project_root = Path(__file__).parent.parent
+sys.path.insert(0, str(project_root))
+
+from pyfreefem_ml.shm_manager import SharedMemoryManager, RankSegments
+
+TRANSPORT_HEADER = project_root / "plugins" / "src" / "shm_transport.hpp"
+
+
+class TestPartitionConstants(unittest.TestCase):
+    """プラグインとの定数の一致のテストケース"""
+
+    def test_constants_match_cpp_header(self):
+        """C++ヘッダーと分割配列の定数が一致すること"""
+        source = TRANSPORT_HEADER.read_text(encoding='utf-8')
+        for name, value in {'SHM_RANK_SEPARATOR': RankSegments.RANK_SEPARATOR,
+                            'SHM_PARTITION_SUFFIX': RankSegments.SUFFIX}.items():
+            match = re.search(rf'#define\s+{name}\s+"([^"]+)"', source)
+            self.assertIsNotNone(match, f"{name} がヘッダーに見つかりません")
+            self.assertEqual(match.group(1), value, name)
+        for name, value in {'SHM_PARTITION_RANK': RankSegments._RANK,
+                            'SHM_PARTITION_RANKS': RankSegments._RANKS,
+                            'SHM_PARTITION_OFFSET': RankSegments._OFFSET,
+                            'SHM_PARTITION_ELEMENTS': RankSegments._ELEMENTS,
+                            'SHM_PARTITION_GLOBAL': RankSegments._GLOBAL,
+                            'SHM_PARTITION_WORDS': RankSegments.WORDS}.items():
+            match = re.search(rf'\b{name}\s*=\s*(\d+)', source)
+            self.assertIsNotNone(match, f"{name} がヘッダーに見つかりません")
+            self.assertEqual(int(match.group(1)), value, name)
+
+    def test_segment_name(self):
+        """ランク専用のセグメント名にランク番号が付くこと"""
+        self.assertEqual(RankSegments.segment_name('sim', 3), 'sim.r3')
+
+
+@unittest.skipUnless(platform.system() == 'Linux' and os.path.isdir('/dev/shm'),
+                     "POSIX共有メモリが必要です")
+class TestRankSegments(unittest.TestCase):
+    """RankSegments のテストケース"""
+
+    def setUp(self):
+        """テスト準備"""
+        self.name = f"test_rank_{uuid.uuid4().hex[:8]}"
+        self.ranks = RankSegments(self.name, 3, size=64 * 1024, create=True)
+
+    def tearDown(self):
+        """テスト後のクリーンアップ"""
+        self.ranks.destroy()
+
+    def test_scatter_gather_roundtrip(self):
+        """部分ごとに書き込んだ配列が大域配列の位置に集まること"""
+        data = np.linspace(0.0, 1.0, 10)
+        partitions = [(0, 4), (4, 3), (7, 3)]
+        self.ranks.scatter('u', data, partitions)
+
+        ranges, global_elements = self.ranks.partitions('u')
+        self.assertEqual(ranges, partitions)
+        self.assertEqual(global_elements, data.size)
+        np.testing.assert_array_equal(self.ranks.gather('u'), data)
+
+        # 各ランクのセグメントには自分の部分だけが入っている
+        rank1 = SharedMemoryManager(RankSegments.segment_name(self.name, 1), create=False)
+        np.testing.assert_array_equal(rank1.read_array('u'), data[4:7])
+        rank1.cleanup()
+
+    def test_gather_into_preallocated(self):
+        """出力先を指定した場合はその配列に直接書き込まれること"""
+        data = np.arange(6, dtype=np.float64)
+        self.ranks.scatter('u', data, [(0, 2), (2, 2), (4, 2)])
+        out = np.zeros(6)
+        self.assertIs(self.ranks.gather('u', out=out), out)
+        np.testing.assert_array_equal(out, data)
+        with self.assertRaises(ValueError):
+            self.ranks.gather('u', out=np.zeros(5))
+
+    def test_inconsistent_partitions(self):
+        """ランクごとの大域配列の要素数が異なる場合はエラーになること"""
+        self.ranks.scatter('u', np.ones(6), [(0, 2), (2, 2), (4, 2)])
+        self.ranks.segments[2].write_array('u.part', [2, 3, 4, 2, 7], dtype=np.int64)
+        with self.assertRaises(ValueError):
+            self.ranks.gather('u')
+
+    def test_invalid_scatter(self):
+        """範囲外の部分やランク数と異なる部分の数はエラーになること"""
+        with self.assertRaises(ValueError):
+            self.ranks.scatter('u', np.ones(4), [(0, 2), (2, 2)])
+        with self.assertRaises(ValueError):
+            self.ranks.scatter('u', np.ones(4), [(0, 2), (2, 2), (3, 2)])
+
+    def test_missing_rank_times_out(self):
+        """書き込まれていないランクを待つとタイムアウトすること"""
+        with self.assertRaises(TimeoutError):
+            self.ranks.partitions('missing', timeout=0.05)
+
+
+@unittest.skipUnless(platform.system() == 'Linux' and os.path.isdir('/dev/shm'),
+                     "POSIX共有メモリが必要です")
+class TestRankSegmentsBeforeCreation(unittest.TestCase):
+    """ランクのセグメントが作成される前に接続する場合のテストケース"""
+
+    def setUp(self):
+        """テスト準備（セグメントはまだ作成しない）"""
+        self.name = f"test_rank_{uuid.uuid4().hex[:8]}"
+        self.reader = RankSegments(self.name, 2)
+
+    def tearDown(self):
+        """テスト後のクリーンアップ"""
+        self.reader.destroy()
+
+    def test_gather_waits_for_segments(self):
+        """セグメントより先に作成しても、timeout の間に書き込まれた部分を集められること"""
+        data = np.arange(5, dtype=np.float64)
+
+        def write():
+            writer = RankSegments(self.name, 2, size=64 * 1024, create=True)
+            writer.scatter('u', data, [(0, 3), (3, 2)])
+            writer.cleanup()
+
+        timer = threading.Timer(0.05, write)
+        timer.start()
+        try:
+            np.testing.assert_array_equal(self.reader.gather('u', timeout=5.0), data)
+        finally:
+            timer.join()
+
+    def test_missing_segment_times_out(self):
+        """作成されないセグメントを待つとタイムアウトすること"""
+        with self.assertRaises(TimeoutError):
+            self.reader.partitions('u', timeout=0.05)
+        with self.assertRaises(RuntimeError):
+            self.reader.partitions('u')
+
+
+if __name__ == '__main__':
+    unittest.main()
@@ -0,0 +1,94 @@
+#!/usr/bin/env python
+# -*- coding: utf-8 -*-
+
+"""
+test_ring_buffer.py
+SPSCリングバッファ（RingBuffer）のテスト
+"""
+
+import os
+import sys
+import uuid
+import platform
+import unittest
+from unittest import mock
+import numpy as np
+from pathlib import Path
+
+# プロジェクトルートをパスに追加
+project_root = Path(__file__).parent.parent
+sys.path.insert(0, str(project_root))
+
+from pyfreefem_ml import shm_layout
+from pyfreefem_ml.shm_manager import RingBuffer
+
+
+@unittest.skipUnless(platform.system() == 'Linux' and os.path.isdir('/dev/shm'),
+                     "POSIX共有メモリが必要です")
+class TestRingBuffer(unittest.TestCase):
+    """リングバッファのテストケース"""
+
+    def setUp(self):
+        """テスト準備"""
+        self.name = f"test_ring_{uuid.uuid4().hex[:8]}"
+        self.ring = RingBuffer(self.name, slot_elements=8, slot_count=4)
+
+    def tearDown(self):
+        """テスト後のクリーンアップ"""
+        self.ring.destroy()
+
+    def test_push_pop_order(self):
+        """追加した順に取り出せること"""
+        for i in range(3):
+            self.assertTrue(self.ring.push(np.full(i + 1, float(i))))
+        self.assertEqual(len(self.ring), 3)
+
+        for i in range(3):
+            np.testing.assert_array_equal(self.ring.pop(), np.full(i + 1, float(i)))
+        self.assertIsNone(self.ring.pop())
+
+    def test_full_ring_rejects_push(self):
+        """満杯の場合はブロックせずにFalseを返すこと"""
+        for _ in range(4):
+            self.assertTrue(self.ring.push(np.ones(8)))
+        self.assertFalse(self.ring.push(np.ones(8)))
+
+        self.ring.pop()
+        self.assertTrue(self.ring.push(np.ones(8)))
+
+    def test_wraparound_and_attach(self):
+        """インデックスが一周しても別インスタンスから正しく読めること"""
+        consumer = RingBuffer(self.name, create=False)
+        try:
+            out = np.empty(8)
+            for i in range(10):
+                self.assertTrue(self.ring.push(np.arange(8) + i))
+                result = consumer.pop(out)
+                np.testing.assert_array_equal(result, np.arange(8) + i)
+        finally:
+            consumer.close()
+
+    def test_oversized_array(self):
+        """スロットより大きな配列はエラーになること"""
+        with self.assertRaises(ValueError):
+            self.ring.push(np.zeros(9))
+
+    def test_requires_ordered_publication(self):
+        """libatomic がない場合、ストアの順序が保証されないCPUでは開けないこと"""
+        with mock.patch.object(shm_layout, '_atomic_load_8', None), \
+                mock.patch.object(shm_layout, 'TSO_MACHINE', False):
+            with self.assertRaises(RuntimeError):
+                RingBuffer(self.name, create=False)
+        with mock.patch.object(shm_layout, '_atomic_load_8', None), \
+                mock.patch.object(shm_layout, '_atomic_store_8', None), \
+                mock.patch.object(shm_layout, 'TSO_MACHINE', True):
+            consumer = RingBuffer(self.name, create=False)
+            try:
+                self.assertTrue(self.ring.push(np.arange(4.0)))
+                np.testing.assert_array_equal(consumer.pop(), np.arange(4.0))
+            finally:
+                consumer.close()
+
+
+if __name__ == '__main__':
+    unittest.main()
@@ -0,0 +1,344 @@
+#!/usr/bin/env python
+# -*- coding: utf-8 -*-
+
+"""
+test_shm_layout.py
+共有メモリセグメントのバイナリレイアウト（shm_layout）のテスト
+"""
+
+import os
+import re
+import mmap
+import sys
+import uuid
+import struct
+import platform
+import unittest
+from unittest import mock
+import numpy as np
+from pathlib import Path
+
+# プロジェクトルートをパスに追加
+project_root = Path(__file__).parent.parent
+sys.path.insert(0, str(project_root))
+
+from pyfreefem_ml import shm_layout
+from pyfreefem_ml.shm_manager import SharedMemoryManager
+
+LAYOUT_HEADER = project_root / "plugins" / "src" / "shm_layout.hpp"
+
+
+class TestSegmentLayout(unittest.TestCase):
+    """バッファ上でのレイアウト操作のテストケース"""
+
+    def setUp(self):
+        """テスト準備"""
+        self.buffer = bytearray(shm_layout.TABLE_SIZE + 4096)
+        self.layout = shm_layout.SegmentLayout(self.buffer)
+        self.layout.init(len(self.buffer))
+
+    def test_constants_match_cpp_header(self):
+        """C++ヘッダーと定数が一致すること"""
+        source = LAYOUT_HEADER.read_text(encoding='utf-8')
+        expected = {
+            'SHM_SEGMENT_MAGIC': shm_layout.SEGMENT_MAGIC,
+            'SHM_SEGMENT_VERSION': shm_layout.SEGMENT_VERSION,
+            'SHM_MAX_ENTRIES': shm_layout.MAX_ENTRIES,
+            'SHM_NAME_LEN': shm_layout.NAME_LEN,
+            'SHM_MAX_NDIM': shm_layout.MAX_NDIM,
+            'SHM_ALIGNMENT': shm_layout.ALIGNMENT,
+            'SHM_STATS_BUCKETS': shm_layout.STATS_BUCKETS,
+            'SHM_ARENA_CLASSES': shm_layout.ARENA_CLASSES,
+            'SHM_STATS_PYTHON': shm_layout.STATS_PYTHON,
+            'SHM_STATS_SIDES': shm_layout.STATS_SIDES,
+            'SHM_DTYPE_FLOAT64': shm_layout.DTYPE_FLOAT64,
+            'SHM_DTYPE_INT32': shm_layout.DTYPE_INT32,
+            'SHM_DTYPE_STRING': shm_layout.DTYPE_STRING,
+            'SHM_DTYPE_DELETED': shm_layout.DTYPE_DELETED,
+            'SHM_MAP_HUGEPAGE': shm_layout.MAP_HUGEPAGE,
+            'SHM_MAP_POPULATE': shm_layout.MAP_POPULATE,
+        }
+        for name, value in expected.items():
+            match = re.search(rf'\b{name}\s*=\s*(0x[0-9a-fA-F]+|\d+)', source)
+            self.assertIsNotNone(match, f"{name} がヘッダーに見つかりません")
+            self.assertEqual(int(match.group(1), 0), value, name)
+
+    def test_name_hash_is_fnv1a(self):
+        """ハッシュがFNV-1a 64bitであること"""
+        self.assertEqual(shm_layout.name_hash(''), 0xcbf29ce484222325)
+        self.assertEqual(shm_layout.name_hash('a'), 0xaf63dc4c8601ec8c)
+
+    def test_insert_find_and_payload_alignment(self):
+        """エントリの登録・検索とペイロードの64バイト境界配置"""
+        names = [f"field_{i}" for i in range(10)]
+        for i, name in enumerate(names):
+            entry = self.layout.find_or_insert(name, shm_layout.DTYPE_FLOAT64)
+            self.layout.reserve(entry, 8 * (i + 1))
+            self.layout.publish(entry, (i + 1,), 8 * (i + 1))
+
+        self.assertEqual(self.layout.entry_count, len(names))
+        for i, name in enumerate(names):
+            entry = self.layout.find(name)
+            self.assertEqual(entry.shape, (i + 1,))
+            self.assertEqual(entry.offset % shm_layout.ALIGNMENT, 0)
+            self.assertEqual(entry.generation, 1)
+        self.assertIsNone(self.layout.find('missing'))
+
+    def test_reserve_reuses_capacity(self):
+        """容量内の再書き込みでは領域が再利用されること"""
+        entry = self.layout.find_or_insert('x', shm_layout.DTYPE_FLOAT64)
+        self.layout.reserve(entry, 100)
+        offset = entry.offset
+        self.layout.reserve(entry, 64)
+        self.assertEqual(entry.offset, offset)
+
+    def test_block_sizes(self):
+        """ペイロードが2の冪の大きさのブロックに割り当てられること"""
+        sizes = [shm_layout.block_size(n) for n in (0, 1, 64, 65, 1000, 4096, 4097)]
+        self.assertEqual(sizes, [64, 64, 64, 128, 1024, 4096, 8192])
+
+    def test_grown_block_is_reused(self):
+        """大きくなった変数の古いブロックが次の割り当てで再利用されること"""
+        x = self.layout.find_or_insert('x', shm_layout.DTYPE_FLOAT64)
+        self.layout.reserve(x, 8)
+        first = x.offset
+        self.layout.reserve(x, 1000)
+        self.assertNotEqual(x.offset, first)
+        self.assertEqual(self.layout.free_bytes(), 64)
+
+        y = self.layout.find_or_insert('y', shm_layout.DTYPE_FLOAT64)
+        self.layout.reserve(y, 40)
+        self.assertEqual(y.offset, first)
+        self.assertEqual(self.layout.free_bytes(), 0)
+
+    def test_delete_recycles_block_and_slot(self):
+        """削除と再作成を繰り返してもデータ領域とエントリ表が増え続けないこと"""
+        keep = self.layout.find_or_insert('keep', shm_layout.DTYPE_INT64)
+        self.layout.reserve(keep, 8)
+        self.layout.publish(keep, (), 8)
+        for i in range(3 * shm_layout.MAX_ENTRIES):
+            name = f"tmp_{i % 100}"
+            entry = self.layout.find_or_insert(name, shm_layout.DTYPE_INT32)
+            self.layout.reserve(entry, 2000)
+            self.layout.publish(entry, (500,), 2000)
+            self.layout.delete(self.layout.find(name))
+
+        self.assertEqual(self.layout.entry_count, 1)
+        self.assertEqual(self.layout.free_bytes(), 2048)
+        self.assertEqual(self.layout.find('keep').offset, keep.offset)
+        self.assertIsNone(self.layout.find('tmp_5'))
+        self.assertEqual([e.name for e in self.layout.entries()], ['keep'])
+
+    def test_table_fills_after_deletions(self):
+        """削除済みのエントリも登録に使え、探索がその先の変数まで続くこと"""
+        names = [f"v{i}" for i in range(shm_layout.MAX_ENTRIES)]
+        for name in names:
+            self.layout.find_or_insert(name, shm_layout.DTYPE_INT64)
+        with self.assertRaises(MemoryError):
+            self.layout.find_or_insert('overflow', shm_layout.DTYPE_INT64)
+
+        for name in names[::2]:
+            self.layout.delete(self.layout.find(name))
+        for name in names[1::2]:
+            self.assertIsNotNone(self.layout.find(name), name)
+        for name in names[::2]:
+            self.layout.find_or_insert(name + 'b', shm_layout.DTYPE_INT64)
+        self.assertEqual(self.layout.entry_count, shm_layout.MAX_ENTRIES)
+
+    def test_arena_lock_is_released(self):
+        """アリーナのロックが取得中だけ立ち、解放されること"""
+        def word():
+            return int.from_bytes(self.buffer[shm_layout.ARENA_OFFSET:shm_layout.ARENA_OFFSET + 4], 'little')
+
+        with shm_layout.ArenaLock(self.buffer):
+            self.assertEqual(word(), 1)
+        self.assertEqual(word(), 0)
+
+    def test_arena_lock_times_out(self):
+        """ロックを保持したまま終了したプロセスがあっても、期限でTimeoutErrorになること"""
+        self.assertEqual(float(re.search(r'SHM_ARENA_LOCK_TIMEOUT_SEC = ([\d.]+);',
+                                         LAYOUT_HEADER.read_text(encoding='utf-8')).group(1)),
+                         shm_layout.ARENA_LOCK_TIMEOUT)
+        struct.pack_into('<I', self.buffer, shm_layout.ARENA_OFFSET, 1)
+        with self.assertRaises(TimeoutError):
+            with shm_layout.ArenaLock(self.buffer, timeout=0.05):
+                pass
+        struct.pack_into('<I', self.buffer, shm_layout.ARENA_OFFSET, 0)
+
+    def test_arena_lock_requires_libatomic(self):
+        """libatomic がない場合は通常の読み書きで代用せずRuntimeErrorになること"""
+        with mock.patch.object(shm_layout, '_atomic_cas', None):
+            with self.assertRaises(RuntimeError):
+                with shm_layout.ArenaLock(self.buffer):
+                    pass
+
+    def test_publish_keeps_concurrent_header_fields(self):
+        """公開・削除が他の側の data_end / segment_size の更新を書き戻さないこと"""
+        entry = self.layout.find_or_insert('x', shm_layout.DTYPE_FLOAT64)
+        self.layout.reserve(entry, 64)
+        # 公開の途中で FreeFEM側がブロックを割り当て、セグメントを拡張した状態を再現する
+        struct.pack_into('<Q', self.buffer, shm_layout.DATA_END_OFFSET, shm_layout.TABLE_SIZE + 1024)
+        struct.pack_into('<Q', self.buffer, shm_layout.SEGMENT_SIZE_OFFSET, len(self.buffer) * 2)
+        generation = self.layout.generation
+        self.layout.publish(entry, (8,), 64)
+        self.layout.delete(self.layout.find('x'))
+        data_end = struct.unpack_from('<Q', self.buffer, shm_layout.DATA_END_OFFSET)[0]
+        self.assertEqual(data_end, shm_layout.TABLE_SIZE + 1024)
+        self.assertEqual(self.layout.segment_size, len(self.buffer) * 2)
+        self.assertEqual(self.layout.generation, generation + 2)
+        self.assertEqual(self.layout.entry_count, 0)
+
+    def test_insert_and_delete_take_arena_lock(self):
+        """新しいエントリの確保と削除はアリーナのロックを取り、既存のエントリの検索は取らないこと"""
+        entry = self.layout.find_or_insert('x', shm_layout.DTYPE_FLOAT64)
+        struct.pack_into('<I', self.buffer, shm_layout.ARENA_OFFSET, 1)
+        try:
+            with mock.patch.object(shm_layout, 'ARENA_LOCK_TIMEOUT', 0.05):
+                self.assertEqual(self.layout.find_or_insert('x', shm_layout.DTYPE_FLOAT64).index, entry.index)
+                with self.assertRaises(TimeoutError):
+                    self.layout.find_or_insert('y', shm_layout.DTYPE_FLOAT64)
+                with self.assertRaises(TimeoutError):
+                    self.layout.delete(entry)
+        finally:
+            struct.pack_into('<I', self.buffer, shm_layout.ARENA_OFFSET, 0)
+        self.assertIsNone(self.layout.find('y'))
+        self.assertEqual(self.layout.entry_count, 1)
+
+    def test_stats_record_and_percentile(self):
+        """転送統計の記録と分位点の計算"""
+        for latency in [100] * 99 + [5000]:
+            self.layout.record_transfer(shm_layout.STATS_PYTHON, True, 80, 0, 10, latency)
+        self.layout.record_transfer(shm_layout.STATS_PYTHON, False, 16, 0, 5, 100)
+        self.layout.add_wait(shm_layout.STATS_PYTHON, 1000)
+
+        stats = self.layout.read_stats(shm_layout.STATS_PYTHON)
+        self.assertEqual(stats['write_calls'], 100)
+        self.assertEqual(stats['read_calls'], 1)
+        self.assertEqual(stats['bytes_written'], 8000)
+        self.assertEqual(stats['bytes_read'], 16)
+        self.assertEqual(stats['wait_ns'], 1000)
+        self.assertEqual(stats['copy_ns'], 1005)
+        self.assertEqual(stats['latency_min_ns'], 100)
+        self.assertEqual(stats['latency_max_ns'], 5000)
+        self.assertEqual(stats['latency_hist'][shm_layout.stats_bucket(100)], 100)
+        # 99パーセンタイルは100nsの区間 [64, 128) の上端
+        self.assertEqual(stats['latency_p99_ns'], 128)
+
+        # FreeFEM側の統計は変更されないこと
+        self.assertEqual(self.layout.read_stats(shm_layout.STATS_FREEFEM)['write_calls'], 0)
+
+    def test_capacity_overflow(self):
+        """容量不足の場合はMemoryErrorになること"""
+        entry = self.layout.find_or_insert('big', shm_layout.DTYPE_FLOAT64)
+        with self.assertRaises(MemoryError):
+            self.layout.reserve(entry, 8192)
+
+
+@unittest.skipUnless(platform.system() == 'Linux' and os.path.isdir('/dev/shm'),
+                     "POSIX共有メモリが必要です")
+class TestSharedMemoryManagerLayout(unittest.TestCase):
+    """SharedMemoryManagerのテストケース"""
+
+    def setUp(self):
+        """テスト準備"""
+        self.name = f"test_layout_{uuid.uuid4().hex[:8]}"
+        self.shm = SharedMemoryManager(self.name, size=64 * 1024)
+
+    def tearDown(self):
+        """テスト後のクリーンアップ"""
+        self.shm.destroy()
+
+    def test_many_fields_share_one_mapping(self):
+        """複数の変数を1つのセグメントで読み書きできること"""
+        coords = np.random.rand(20, 2)
+        density = np.linspace(0.0, 1.0, 50)
+        labels = np.arange(7, dtype=np.int32)
+
+        self.shm.write_array('coords', coords)
+        self.shm.write_array('density', density)
+        self.shm.write_int_array('labels', labels)
+        self.shm.write_int('iteration', 42)
+        self.shm.write_double('volume', 0.4)
+        self.shm.write_string('status', 'ok')
+
+        reader = SharedMemoryManager(self.name, create=False)
+        try:
+            np.testing.assert_array_equal(reader.read_array('coords'), coords)
+            np.testing.assert_array_equal(reader.read_array('density'), density)
+            np.testing.assert_array_equal(reader.read_int_array('labels'), labels)
+            self.assertEqual(reader.read_int('iteration'), 42)
+            self.assertEqual(reader.read_double('volume'), 0.4)
+            self.assertEqual(reader.read_string('status'), 'ok')
+            self.assertEqual(sorted(reader.list_variables()),
+                             sorted(['coords', 'density', 'labels', 'iteration', 'volume', 'status']))
+        finally:
+            reader.cleanup()
+
+    def test_growth_is_followed_by_reader(self):
+        """容量を超える書き込みでセグメントが拡張され、既存の読み手が追従すること"""
+        reader = SharedMemoryManager(self.name, create=False)
+        try:
+            self.shm.write_array('small', np.ones(16))
+            np.testing.assert_array_equal(reader.read_array('small'), np.ones(16))
+
+            large = np.arange(100000, dtype=np.float64)
+            self.shm.write_array('large', large)
+            self.assertGreaterEqual(self.shm.size, 2 * 64 * 1024)
+
+            np.testing.assert_array_equal(reader.read_array('large'), large)
+            self.assertEqual(reader.size, self.shm.size)
+        finally:
+            reader.cleanup()
+
+    def test_transfer_stats(self):
+        """読み書きがPython側の転送統計に記録されること"""
+        self.shm.write_array('x', np.zeros(100))
+        self.shm.read_array('x')
+        self.shm.read_array('x')
+
+        stats = self.shm.stats
+        self.assertEqual(stats['python']['write_calls'], 1)
+        self.assertEqual(stats['python']['read_calls'], 2)
+        self.assertEqual(stats['python']['bytes_written'], 800)
+        self.assertEqual(stats['python']['bytes_read'], 1600)
+        self.assertGreater(stats['python']['latency_max_ns'], 0)
+        self.assertEqual(stats['freefem']['write_calls'], 0)
+
+    def test_delete_variable(self):
+        """削除した変数は読めず、同じ大きさの書き込みで領域が再利用されること"""
+        self.shm.write_array('a', np.ones(100))
+        offset = self.shm.layout.find('a').offset
+        self.shm.delete_variable('a')
+        with self.assertRaises(KeyError):
+            self.shm.read_array('a')
+        with self.assertRaises(KeyError):
+            self.shm.delete_variable('a')
+
+        self.shm.write_array('b', np.zeros(90))
+        self.assertEqual(self.shm.layout.find('b').offset, offset)
+        self.assertEqual(self.shm.list_variables(), ['b'])
+
+    def test_type_mismatch(self):
+        """型が異なる読み込みはTypeErrorになること"""
+        self.shm.write_int('n', 1)
+        with self.assertRaises(TypeError):
+            self.shm.read_double('n')
+        with self.assertRaises(TypeError):
+            self.shm.write_string('n', 'x')
+
+    def test_destroy_clears_magic(self):
+        """削除する前にmagicが消え、古いマッピングからは無効なセグメントに見えること"""
+        self.shm.write_int('n', 1)
+        with open(self.shm.path, 'r+b') as f:
+            stale = shm_layout.SegmentLayout(mmap.mmap(f.fileno(), 0))
+        self.assertTrue(stale.is_valid())
+        self.shm.destroy()
+        self.assertFalse(os.path.exists(self.shm.path))
+        self.assertFalse(stale.is_valid())
+        stale.buffer.close()
+        # 存在しないオブジェクトには何もしない
+        shm_layout.retire(self.shm.path)
+
+
+if __name__ == '__main__':
+    unittest.main()
@@ -0,0 +1,99 @@
+#!/usr/bin/env python
+# -*- coding: utf-8 -*-
+
+"""
+test_shm_mapping.py
+セグメントのマッピング方法（ヒュージページ・事前割り当て・NUMAノード）のテスト
+"""
+
+import os
+import re
+import sys
+import uuid
+import platform
+import unittest
+import numpy as np
+from pathlib import Path
+
+# プロジェクトルートをパスに追加
+project_root = Path(__file__).parent.parent
+sys.path.insert(0, str(project_root))
+
+from pyfreefem_ml import shm_layout
+from pyfreefem_ml import shm_mapping
+from pyfreefem_ml.shm_manager import SharedMemoryManager
+
+MAPPING_HEADER = project_root / "plugins" / "src" / "shm_mapping.hpp"
+
+
+class TestMapOptions(unittest.TestCase):
+    """ヘッダーへのマッピング方法の記録のテストケース"""
+
+    def test_constants_match_cpp_header(self):
+        """C++ヘッダーと定数が一致すること"""
+        source = MAPPING_HEADER.read_text(encoding='utf-8')
+        match = re.search(r'\bSHM_MAX_NUMA_NODES\s*=\s*(\d+)', source)
+        self.assertIsNotNone(match)
+        self.assertEqual(int(match.group(1)), shm_mapping.MAX_NUMA_NODES)
+
+    def test_options_roundtrip(self):
+        """記録したマッピング方法が読み出せ、初期化で消えないこと"""
+        buffer = bytearray(shm_layout.TABLE_SIZE)
+        layout = shm_layout.SegmentLayout(buffer)
+        layout.init(len(buffer))
+        self.assertEqual(layout.map_flags, 0)
+        self.assertIsNone(layout.numa_node)
+
+        layout.set_map_options(shm_layout.MAP_HUGEPAGE | shm_layout.MAP_POPULATE, 0)
+        layout.init(len(buffer))
+        self.assertEqual(layout.map_flags, shm_layout.MAP_HUGEPAGE | shm_layout.MAP_POPULATE)
+        self.assertEqual(layout.numa_node, 0)
+
+    def test_round_size(self):
+        """ヒュージページを使う場合は2 MiB単位に切り上げること"""
+        self.assertEqual(shm_mapping.round_size(1, shm_layout.MAP_HUGEPAGE), shm_layout.HUGEPAGE_SIZE)
+        self.assertEqual(shm_mapping.round_size(1, 0), shm_mapping.granularity(0))
+
+
+@unittest.skipUnless(platform.system() == 'Linux' and os.path.isdir('/dev/shm'),
+                     "POSIX共有メモリが必要です")
+class TestSegmentMapping(unittest.TestCase):
+    """マッピング方法を指定したセグメントのテストケース"""
+
+    def setUp(self):
+        """テスト準備"""
+        self.name = f"test_mapping_{uuid.uuid4().hex[:8]}"
+
+    def tearDown(self):
+        """テスト後のクリーンアップ"""
+        try:
+            os.unlink(os.path.join('/dev/shm', self.name))
+        except FileNotFoundError:
+            pass
+
+    def test_options_are_shared_with_readers(self):
+        """作成時の指定が記録され、接続した側と拡張後も同じ方法が使われること"""
+        shm = SharedMemoryManager(self.name, size=64 * 1024, hugepages=True, populate=True, numa_node=0)
+        self.assertEqual(shm.size % shm_layout.HUGEPAGE_SIZE, 0)
+
+        # 後から作成を指定しても、既存のセグメントの方法は変わらない
+        other = SharedMemoryManager(self.name, create=True)
+        self.assertEqual(other.layout.map_flags, shm_layout.MAP_HUGEPAGE | shm_layout.MAP_POPULATE)
+        self.assertEqual(other.layout.numa_node, 0)
+
+        data = np.arange(600000, dtype=np.float64)
+        shm.write_array('big', data)
+        self.assertEqual(shm.size % shm_layout.HUGEPAGE_SIZE, 0)
+        np.testing.assert_array_equal(other.read_array('big'), data)
+
+        other.cleanup()
+        shm.cleanup()
+
+    def test_invalid_numa_node(self):
+        """不正なNUMAノードはエラーになること"""
+        with self.assertRaises(ValueError):
+            SharedMemoryManager(self.name, numa_node=-1)
+
+
+if __name__ == '__main__':
+    unittest.main()
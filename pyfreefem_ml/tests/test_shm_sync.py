@@ -0,0 +1,120 @@
+#!/usr/bin/env python
+# -*- coding: utf-8 -*-
+
+"""
+test_shm_sync.py
+通知シーケンスによる待機/通知（shm_sync）のテスト
+"""
+
+import os
+import sys
+import time
+import uuid
+import platform
+import unittest
+import multiprocessing
+import numpy as np
+from pathlib import Path
+
+# プロジェクトルートをパスに追加
+project_root = Path(__file__).parent.parent
+sys.path.insert(0, str(project_root))
+
+from pyfreefem_ml import shm_layout
+from pyfreefem_ml import shm_sync
+from pyfreefem_ml.shm_manager import SharedMemoryManager
+
+
+def _delayed_writer(name, key, delay):
+    """別プロセスから遅れて変数を書き込む"""
+    time.sleep(delay)
+    writer = SharedMemoryManager(name, create=False)
+    writer.write_array(key, np.arange(4, dtype=np.float64))
+    writer.cleanup()
+
+
+class TestSequenceWord(unittest.TestCase):
+    """バッファ上での通知シーケンスのテストケース"""
+
+    def setUp(self):
+        """テスト準備"""
+        self.buffer = bytearray(shm_layout.TABLE_SIZE)
+        shm_layout.SegmentLayout(self.buffer).init(len(self.buffer))
+
+    def test_offsets_match_cpp_header(self):
+        """seq/waitersがヘッダーの予約領域の先頭に置かれていること"""
+        source = (project_root / "plugins" / "src" / "shm_layout.hpp").read_text(encoding='utf-8')
+        self.assertRegex(source, r'uint64_t generation;[^\n]*\n\s*uint32_t seq;[^\n]*\n\s*uint32_t waiters;')
+        self.assertEqual(shm_layout.SEQ_OFFSET, 48)
+        self.assertEqual(shm_layout.WAITERS_OFFSET, 52)
+
+    def test_notify_increments_sequence(self):
+        """notifyでシーケンスが進み、ヘッダーの他の値を壊さないこと"""
+        layout = shm_layout.SegmentLayout(self.buffer)
+        self.assertEqual(shm_sync.load_seq(self.buffer), 0)
+        shm_sync.notify(self.buffer)
+        shm_sync.notify(self.buffer)
+        self.assertEqual(shm_sync.load_seq(self.buffer), 2)
+        self.assertTrue(layout.is_valid())
+
+        layout.grow_to(len(self.buffer) * 2)
+        self.assertEqual(shm_sync.load_seq(self.buffer), 2)
+
+    def test_wait_returns_immediately_when_ready(self):
+        """条件が満たされていれば待機しないこと"""
+        start = time.monotonic()
+        self.assertTrue(shm_sync.wait_until(self.buffer, lambda: True, timeout=5))
+        self.assertLess(time.monotonic() - start, 0.1)
+
+    def test_wait_times_out(self):
+        """通知がなければタイムアウトすること"""
+        start = time.monotonic()
+        self.assertIsNone(shm_sync.wait_for_update(self.buffer, 0, timeout=0.2))
+        self.assertGreaterEqual(time.monotonic() - start, 0.2)
+
+
+@unittest.skipIf(platform.system() != 'Linux', "共有メモリはLinuxでのみサポート")
+class TestCrossProcessWait(unittest.TestCase):
+    """プロセス間での待機/通知のテストケース"""
+
+    def setUp(self):
+        """テスト準備"""
+        self.name = f"pyff_sync_{uuid.uuid4().hex[:8]}"
+        self.shm = SharedMemoryManager(self.name, size=64 * 1024)
+
+    def tearDown(self):
+        """テスト後処理"""
+        self.shm.destroy()
+
+    def test_wait_for_variable(self):
+        """別プロセスが書き込んだ時点で待機が解除されること"""
+        writer = multiprocessing.get_context('fork').Process(
+            target=_delayed_writer, args=(self.name, 'result', 0.2))
+        writer.start()
+        try:
+            self.assertTrue(self.shm.wait_for_variable('result', timeout=5))
+            np.testing.assert_array_equal(self.shm.read_array('result'), np.arange(4))
+        finally:
+            writer.join()
+        self.assertEqual(shm_sync._load_waiters(self.shm.memory), 0)
+
+    def test_wait_for_update(self):
+        """書き込みごとにシーケンスが進むこと"""
+        seen = self.shm.sequence
+        writer = multiprocessing.get_context('fork').Process(
+            target=_delayed_writer, args=(self.name, 'x', 0.1))
+        writer.start()
+        try:
+            self.assertEqual(self.shm.wait_for_update(seen, timeout=5), seen + 1)
+        finally:
+            writer.join()
+
+    def test_existing_variable_does_not_block(self):
+        """書き込み済みの変数は何度でも待機なしで取得できること"""
+        self.shm.write_double('alpha', 1.5)
+        for _ in range(3):
+            self.assertTrue(self.shm.wait_for_variable('alpha', timeout=0.1))
+
+
+if __name__ == '__main__':
+    unittest.main()
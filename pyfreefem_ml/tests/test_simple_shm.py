@@ -3,6 +3,7 @@
 """
 共有メモリの基本テスト
 sysv_ipc機能を使用した共有メモリの作成・読み書きをテストします
+（sysv_ipc はパッケージの依存関係ではないため、インストールされていなければファイルで代替します）
 """
 
 import os
@@ -10,7 +11,10 @@ import sys
 import json
 import time
 import struct
-import sysv_ipc
+try:
+    import sysv_ipc
+except ImportError:
+    sysv_ipc = None
 import numpy as np
 import subprocess
 import tempfile
@@ -59,6 +63,9 @@ def safe_shm_create(key, size_request, max_tries=10):
     if wsl_env:
         print("WSL環境を検出しました。代替手段を使用します。")
         return use_file_based_shm(key, size_request)
+    if sysv_ipc is None:
+        print("sysv_ipc がインストールされていません。代替手段を使用します。")
+        return use_file_based_shm(key, size_request)
     
     for attempt in range(max_tries):
         try:
@@ -0,0 +1,123 @@
+#!/usr/bin/env python
+# -*- coding: utf-8 -*-
+
+"""
+test_snapshot_store.py
+スナップショットファイル（SnapshotStore）のテスト
+
+FreeFEM側の snapshotAppend / snapshotRead と同じ形式で追記し、前向き・後ろ向きに読み戻せることを確認します。
+"""
+
+import os
+import re
+import sys
+import tempfile
+import unittest
+import numpy as np
+from pathlib import Path
+
+# プロジェクトルートをパスに追加
+project_root = Path(__file__).parent.parent
+sys.path.insert(0, str(project_root))
+
+from pyfreefem_ml import snapshot_store
+from pyfreefem_ml.snapshot_store import SnapshotStore
+
+SNAPSHOT_HPP = project_root / 'plugins' / 'src' / 'shm_snapshot.hpp'
+
+
+class TestSnapshotFormat(unittest.TestCase):
+    """ファイル形式が shm_snapshot.hpp と一致するかのテストケース"""
+
+    def test_constants_match(self):
+        """マジック・バージョン・配置の定数が一致すること"""
+        source = SNAPSHOT_HPP.read_text(encoding='utf-8')
+        self.assertEqual(int(re.search(r'SNAPSHOT_FILE_MAGIC = (0x[0-9a-f]+);', source).group(1), 16),
+                         snapshot_store.MAGIC)
+        for name, value in (('FILE_VERSION', snapshot_store.VERSION), ('DATA_OFFSET', snapshot_store.DATA_OFFSET),
+                            ('ALIGNMENT', snapshot_store.ALIGNMENT)):
+            self.assertEqual(int(re.search(rf'SNAPSHOT_{name} = (\d+);', source).group(1)), value)
+        self.assertEqual(int(re.search(r'sizeof\(SnapshotFileHeader\) == (\d+)', source).group(1)),
+                         snapshot_store.HEADER.size)
+
+
+class TestSnapshotStore(unittest.TestCase):
+    """SnapshotStore のテストケース"""
+
+    def setUp(self):
+        """テスト準備"""
+        self.dir = tempfile.TemporaryDirectory()
+        self.path = os.path.join(self.dir.name, 'history.snap')
+
+    def tearDown(self):
+        """テスト後のクリーンアップ"""
+        self.dir.cleanup()
+
+    def _write_history(self, steps, elements):
+        """step * 1000 + 要素番号 の値を持つ履歴を書き込む"""
+        with SnapshotStore(self.path, elements=elements) as store:
+            for step in range(steps):
+                self.assertEqual(store.append(step * 1000.0 + np.arange(elements)), step)
+
+    def test_replay_backwards(self):
+        """後ろ向き・前向き・負の番号で読み戻せること"""
+        self._write_history(20, 700)
+        with SnapshotStore(self.path) as store:
+            self.assertEqual(len(store), 20)
+            for step in reversed(range(20)):
+                np.testing.assert_array_equal(store.read(step), step * 1000.0 + np.arange(700))
+            for step in range(0, 20, 3):
+                self.assertEqual(store.read(step)[5], step * 1000.0 + 5)
+            self.assertEqual(store.read(-1)[0], 19000.0)
+            with self.assertRaises(IndexError):
+                store.read(20)
+
+    def test_stride_is_page_aligned(self):
+        """スナップショットがページ境界に並び、ファイルの大きさが stride の倍数になること"""
+        self._write_history(3, 700)
+        stride = snapshot_store.snapshot_stride(700)
+        self.assertEqual(stride, 8192)
+        self.assertEqual(os.path.getsize(self.path), snapshot_store.DATA_OFFSET + 3 * stride)
+
+    def test_reopen_appends(self):
+        """開き直して追記でき、読み込み側は新しい count を反映すること"""
+        self._write_history(2, 16)
+        reader = SnapshotStore(self.path)
+        self.assertEqual(len(reader), 2)
+        with SnapshotStore(self.path, elements=16) as store:
+            self.assertEqual(store.append(np.full(16, -1.0)), 2)
+        self.assertEqual(reader.read(2)[0], -1.0)
+        reader.close()
+
+    def test_read_into_out(self):
+        """out に読み込めること"""
+        self._write_history(2, 16)
+        out = np.zeros(16)
+        with SnapshotStore(self.path) as store:
+            self.assertIs(store.read(1, out=out), out)
+        self.assertEqual(out[3], 1003.0)
+
+    def test_mismatched_elements(self):
+        """要素数の異なる追記・開き直しはValueErrorになること"""
+        self._write_history(1, 16)
+        with SnapshotStore(self.path, elements=16) as store:
+            with self.assertRaises(ValueError):
+                store.append(np.zeros(8))
+        with self.assertRaises(ValueError):
+            SnapshotStore(self.path, elements=8)
+
+    def test_invalid_file(self):
+        """形式の異なるファイルはValueErrorになり、読み込み専用では追記できないこと"""
+        with open(self.path, 'wb') as f:
+            f.write(b'garbage')
+        with self.assertRaises(ValueError):
+            SnapshotStore(self.path)
+        os.unlink(self.path)
+        self._write_history(1, 4)
+        with SnapshotStore(self.path) as store:
+            with self.assertRaises(RuntimeError):
+                store.append(np.zeros(4))
+
+
+if __name__ == '__main__':
+    unittest.main()
@@ -0,0 +1,103 @@
+#!/usr/bin/env python
+# -*- coding: utf-8 -*-
+
+"""
+test_sparse_matrix.py
+疎行列（CSR形式）の共有メモリ転送のテスト
+"""
+
+import os
+import sys
+import uuid
+import platform
+import unittest
+import numpy as np
+from pathlib import Path
+
+# プロジェクトルートをパスに追加
+project_root = Path(__file__).parent.parent
+sys.path.insert(0, str(project_root))
+
+from pyfreefem_ml.shm_manager import SharedMemoryManager
+
+try:
+    import scipy.sparse
+    HAS_SCIPY = True
+except ImportError:
+    HAS_SCIPY = False
+
+# [[1, 0, 2, 0], [0, 0, 0, 0], [0, 3, 0, 4]]
+INDPTR = np.array([0, 2, 2, 4])
+INDICES = np.array([0, 2, 1, 3])
+DATA = np.array([1.0, 2.0, 3.0, 4.0])
+SHAPE = (3, 4)
+
+
+@unittest.skipUnless(platform.system() == 'Linux' and os.path.isdir('/dev/shm'),
+                     "POSIX共有メモリが必要です")
+class TestSparseMatrix(unittest.TestCase):
+    """疎行列の読み書きのテストケース"""
+
+    def setUp(self):
+        """テスト準備"""
+        self.name = f"test_sparse_{uuid.uuid4().hex[:8]}"
+        self.shm = SharedMemoryManager(self.name, size=64 * 1024)
+        self.reader = SharedMemoryManager(self.name, create=False)
+
+    def tearDown(self):
+        """テスト後のクリーンアップ"""
+        self.reader.cleanup()
+        self.shm.destroy()
+
+    def test_csr_arrays_round_trip(self):
+        """CSR形式の配列がそのまま読み書きできること"""
+        self.shm.write_sparse_matrix('K', (INDPTR, INDICES, DATA, SHAPE))
+
+        indptr, indices, data, shape, half = self.reader.read_csr('K')
+        np.testing.assert_array_equal(indptr, INDPTR)
+        np.testing.assert_array_equal(indices, INDICES)
+        np.testing.assert_array_equal(data, DATA)
+        self.assertEqual(indptr.dtype, np.int32)
+        self.assertEqual(shape, SHAPE)
+        self.assertEqual(half, 0)
+
+    @unittest.skipUnless(HAS_SCIPY, "scipyが必要です")
+    def test_view_shares_memory(self):
+        """view_sparse_matrix は共有メモリを直接指すこと"""
+        self.shm.write_sparse_matrix('K', scipy.sparse.csr_matrix((DATA, INDICES, INDPTR), shape=SHAPE))
+
+        view = self.reader.view_sparse_matrix('K')
+        np.testing.assert_array_equal(view.toarray(), [[1, 0, 2, 0], [0, 0, 0, 0], [0, 3, 0, 4]])
+
+        # 同じ大きさの値を書き込むと領域が再利用され、ビューに反映される
+        self.shm.write_array('K.data', DATA * 10)
+        self.assertEqual(view[2, 3], 40.0)
+        del view
+
+    @unittest.skipUnless(HAS_SCIPY, "scipyが必要です")
+    def test_symmetric_storage_is_expanded(self):
+        """対称形式（下三角のみ）の行列は読み込み時に全体に展開されること"""
+        full = np.array([[4.0, 1.0, 0.0], [1.0, 5.0, 2.0], [0.0, 2.0, 6.0]])
+        lower = scipy.sparse.csr_matrix(np.tril(full))
+        self.shm.write_sparse_matrix('S', lower)
+        self.shm.write_array('S', [3, 3, lower.nnz, 1], dtype=np.int64)
+
+        np.testing.assert_array_equal(self.reader.read_sparse_matrix('S').toarray(), full)
+        np.testing.assert_array_equal(self.reader.view_sparse_matrix('S').toarray(), np.tril(full))
+
+    def test_invalid_matrices(self):
+        """不正な疎行列はエラーになること"""
+        with self.assertRaises(ValueError):
+            self.shm.write_sparse_matrix('K', (INDPTR[:-1], INDICES, DATA, SHAPE))
+        with self.assertRaises(ValueError):
+            self.shm.write_sparse_matrix('K', (INDPTR, INDICES, DATA[:-1], SHAPE))
+
+        self.shm.write_array('dense', np.zeros(4))
+        with self.assertRaises(TypeError):
+            self.reader.read_csr('dense')
+        with self.assertRaises(KeyError):
+            self.reader.read_csr('missing')
+
+
+if __name__ == '__main__':
+    unittest.main()
@@ -0,0 +1,146 @@
+#!/usr/bin/env python
+# -*- coding: utf-8 -*-
+
+"""
+test_transport_tuning.py
+転送方式の計測と選択（transport_tuning）のテスト
+
+計測結果からの見積もり・方式の選択と、~/.ff++ への保存・再利用を確認します。
+"""
+
+import os
+import json
+import sys
+import tempfile
+import unittest
+from unittest import mock
+from pathlib import Path
+
+# プロジェクトルートをパスに追加
+project_root = Path(__file__).parent.parent
+sys.path.insert(0, str(project_root))
+
+from pyfreefem_ml import transport_tuning
+from pyfreefem_ml.transport_tuning import TransportProfile
+from pyfreefem_ml.file_io import FreeFEMFileIO
+
+
+def _profile():
+    """posix は遅延が小さく、file は帯域が大きいホストの計測結果"""
+    return TransportProfile({
+        'posix': [(1024, 2000.0), (1 << 20, 400000.0)],
+        'file': [(1024, 50000.0), (1 << 20, 200000.0)],
+        'zfile': [(1024, 60000.0), (1 << 20, 900000.0)],
+    })
+
+
+class TestTransportProfile(unittest.TestCase):
+    """TransportProfile のテストケース"""
+
+    def test_transfer_time(self):
+        """計測点の間は補間し、範囲外は遅延・帯域で見積もること"""
+        profile = _profile()
+        self.assertEqual(profile.transfer_time('posix', 16), 2000.0)
+        self.assertEqual(profile.transfer_time('posix', 1024), 2000.0)
+        middle = (1024 + (1 << 20)) // 2
+        self.assertAlmostEqual(profile.transfer_time('posix', middle), 201000.0, delta=1.0)
+        self.assertEqual(profile.transfer_time('posix', 4 << 20), 1600000.0)
+        self.assertIsNone(profile.transfer_time('ring', 1024))
+
+    def test_fastest_by_size(self):
+        """配列の大きさごとに最も速い方式を選び、選択肢に従うこと"""
+        profile = _profile()
+        self.assertEqual(profile.fastest(4096), 'posix')
+        self.assertEqual(profile.fastest(64 << 20), 'file')
+        self.assertEqual(profile.fastest(64 << 20, ('posix', 'zfile')), 'posix')
+        self.assertIsNone(profile.fastest(4096, ('ring',)))
+
+    def test_latency_and_bandwidth(self):
+        """最小の大きさの時間と最大の大きさの帯域"""
+        profile = _profile()
+        self.assertEqual(profile.latency('posix'), 2000.0)
+        self.assertAlmostEqual(profile.bandwidth('file'), (1 << 20) / 200000.0)
+
+    def test_dict_roundtrip(self):
+        """to_dict / from_dict で復元でき、不正な形式はValueErrorになること"""
+        profile = TransportProfile.from_dict(json.loads(json.dumps(_profile().to_dict())))
+        self.assertEqual(profile.timings, _profile().timings)
+        self.assertTrue(profile.matches())
+        with self.assertRaises(ValueError):
+            TransportProfile.from_dict({'timings': {}})
+
+
+class TestProfileCache(unittest.TestCase):
+    """計測結果の保存と再利用のテストケース"""
+
+    def setUp(self):
+        """テスト準備"""
+        self.dir = tempfile.TemporaryDirectory()
+        self.path = os.path.join(self.dir.name, '.ff++', transport_tuning.CALIBRATION_FILE)
+
+    def tearDown(self):
+        """テスト後のクリーンアップ"""
+        self.dir.cleanup()
+
+    def test_default_path_under_ffpp(self):
+        """保存先が ~/.ff++ の下になること"""
+        with mock.patch.dict(os.environ, {'HOME': self.dir.name}):
+            self.assertEqual(transport_tuning.default_cache_path(), self.path)
+
+    def test_save_and_read(self):
+        """保存した結果が読み込めること"""
+        self.assertIsNone(transport_tuning.read_profile(self.path))
+        self.assertTrue(transport_tuning.save_profile(_profile(), self.path))
+        self.assertEqual(transport_tuning.read_profile(self.path).timings, _profile().timings)
+
+    def test_other_host_is_ignored(self):
+        """別のホスト・セグメントの形式で計測した結果は使わないこと"""
+        signature = dict(transport_tuning.host_signature(), segment_version=0)
+        transport_tuning.save_profile(TransportProfile(_profile().timings, signature), self.path)
+        self.assertIsNone(transport_tuning.read_profile(self.path))
+
+    def test_load_calibrates_once(self):
+        """保存された結果がなければ計測して保存し、次からは計測しないこと"""
+        with mock.patch.object(transport_tuning, 'calibrate', return_value=_profile()) as calibrate:
+            self.assertEqual(transport_tuning.load_profile(self.path).fastest(4096), 'posix')
+            self.assertEqual(transport_tuning.load_profile(self.path).fastest(4096), 'posix')
+            self.assertEqual(calibrate.call_count, 1)
+            transport_tuning.load_profile(self.path, refresh=True)
+            self.assertEqual(calibrate.call_count, 2)
+        os.unlink(self.path)
+        self.assertIsNone(transport_tuning.load_profile(self.path, calibrate_missing=False))
+
+    def test_calibrate_files(self):
+        """同じプロセス内の計測で方式ごとの転送時間が得られること"""
+        profile = transport_tuning.calibrate(('file', 'zfile'), sizes=(4096, 65536), bench=False,
+                                             directory=self.dir.name, target_bytes=1 << 16)
+        self.assertEqual(profile.method, 'loopback')
+        self.assertEqual(set(profile.transports), {'file', 'zfile'})
+        self.assertEqual([n for n, _ in profile.timings['file']], [4096, 65536])
+        self.assertIn(profile.fastest(4096), ('file', 'zfile'))
+        with self.assertRaises(ValueError):
+            transport_tuning.calibrate(('sysv',), bench=False)
+
+
+class TestCompressChoice(unittest.TestCase):
+    """run_script(compress='auto') の選択のテストケース"""
+
+    def _run(self, **kwargs):
+        """実行せずに、選ばれた binary / compress を返す"""
+        profile = TransportProfile({'file': [(1024, 50000.0)], 'zfile': [(1024, 10000.0)]})
+        file_io = FreeFEMFileIO(transport_profile=profile)
+        with mock.patch.object(file_io, '_run_script_normal', return_value=(True, None, '', '')) as run:
+            file_io.run_script('script.edp', input_data=[0.0] * 128, compress='auto', **kwargs)
+        return run.call_args[0][5:7]
+
+    def test_auto_keeps_text_format(self):
+        """テキスト形式のスクリプトではバイナリ形式に切り替えないこと"""
+        self.assertEqual(self._run(), (False, False))
+
+    def test_auto_compresses_binary_input(self):
+        """バイナリ形式では zfile が速い大きさの入力を圧縮すること"""
+        self.assertEqual(self._run(binary=True), (True, True))
+
+
+if __name__ == '__main__':
+    unittest.main()
@@ -0,0 +1,268 @@
+#!/usr/bin/env python3
+# -*- coding: utf-8 -*-
+
+"""
+転送方式の計測と選択
+
+ベンチマーク（plugins/bench/bench_transfer.py）の転送方式をこのホストで計測し、
+配列の大きさごとに最も速い方式を選びます。計測結果は ~/.ff++/transport_calibration.json に
+保存し、ホスト名・カーネル・セグメントの形式が同じ間は再利用します（初回の計測には数秒かかります）。
+
+shm_bench（make -C plugins bench）がある場合はエコー側にC++の転送コアを使った往復時間の半分を、
+ない場合は同じプロセス内での書き込みと読み込みの時間を、1回の転送時間として記録します。
+
+計測する方式:
+    posix       セグメント内のエントリ
+    posix-huge  ヒュージページ・マッピング時の割り当てを指定したセグメント内のエントリ
+    channel     二重バッファのチャネル（BufferedChannel）
+    ring        SPSCリングバッファ（RingBuffer）
+    file        バイナリファイル
+    zfile       圧縮形式のバイナリファイル
+
+使用例::
+
+    profile = load_profile()
+    if profile is not None:
+        print(profile.fastest(array.nbytes, ('file', 'zfile')))
+"""
+
+import os
+import json
+import time
+import platform
+import tempfile
+import importlib.util
+from pathlib import Path
+
+from .shm_layout import SEGMENT_VERSION
+
+CALIBRATION_VERSION = 1
+CALIBRATION_FILE = 'transport_calibration.json'
+CALIBRATION_SIZES = (4 << 10, 64 << 10, 1 << 20, 16 << 20)
+CALIBRATION_TARGET_BYTES = 32 << 20      # 大きさごとに転送する合計の目安（bench_transfer は256M）
+SEGMENT_TRANSPORTS = ('posix', 'posix-huge')
+FILE_TRANSPORTS = ('file', 'zfile')
+
+BENCH_DIR = Path(__file__).resolve().parent / 'plugins' / 'bench'
+
+
+def default_cache_path():
+    """計測結果の保存先（~/.ff++/transport_calibration.json）"""
+    return os.path.join(os.path.expanduser('~'), '.ff++', CALIBRATION_FILE)
+
+
+def host_signature():
+    """計測結果を再利用できる条件（これが変わると計測し直す）"""
+    return {
+        'version': CALIBRATION_VERSION,
+        'host': platform.node(),
+        'system': platform.system(),
+        'kernel': platform.release(),
+        'segment_version': SEGMENT_VERSION,
+    }
+
+
+class TransportProfile:
+    """
+    転送方式ごとの計測結果
+
+    timings は方式名 -> [(大きさ [バイト], 1回の転送時間 [ns]), ...]（大きさの昇順）です。
+    計測した大きさの間は線形に補間し、最小より小さい配列は最小の大きさの時間（遅延）、
+    最大より大きい配列は最大の大きさでの帯域で見積もります。
+    """
+
+    def __init__(self, timings, signature=None, method='loopback', created=None):
+        self.timings = {name: sorted((int(n), float(t)) for n, t in points)
+                        for name, points in timings.items() if points}
+        self.signature = dict(signature or host_signature())
+        self.method = method
+        self.created = created if created is not None else time.time()
+
+    @property
+    def transports(self):
+        """計測された方式の一覧"""
+        return tuple(self.timings)
+
+    def transfer_time(self, transport, nbytes):
+        """nbytes バイトの配列を1回転送する見積もり時間 [ns]（計測されていない方式はNone）"""
+        points = self.timings.get(transport)
+        if not points:
+            return None
+        if nbytes <= points[0][0]:
+            return points[0][1]
+        for (n0, t0), (n1, t1) in zip(points, points[1:]):
+            if nbytes <= n1:
+                return t0 + (t1 - t0) * (nbytes - n0) / (n1 - n0)
+        n, t = points[-1]
+        return t * nbytes / n
+
+    def latency(self, transport):
+        """最小の大きさでの転送時間 [ns]"""
+        points = self.timings.get(transport)
+        return points[0][1] if points else None
+
+    def bandwidth(self, transport):
+        """最大の大きさでの帯域 [GB/s]"""
+        points = self.timings.get(transport)
+        return points[-1][0] / points[-1][1] if points else None
+
+    def fastest(self, nbytes, candidates=None):
+        """
+        nbytes バイトの配列で最も速い方式
+
+        Args:
+            nbytes (int): 配列の大きさ（バイト）
+            candidates (iterable, optional): 選択肢（省略時は計測されたすべての方式）
+
+        Returns:
+            str: 方式名（どの選択肢も計測されていない場合はNone）
+        """
+        best, best_time = None, None
+        for name in (candidates if candidates is not None else self.timings):
+            t = self.transfer_time(name, nbytes)
+            if t is not None and (best_time is None or t < best_time):
+                best, best_time = name, t
+        return best
+
+    def matches(self, signature=None):
+        """現在のホストで計測された結果かどうか"""
+        return self.signature == (signature or host_signature())
+
+    def to_dict(self):
+        """JSONに保存する形式"""
+        return {
+            'signature': self.signature,
+            'method': self.method,
+            'created': self.created,
+            'timings': {name: [list(point) for point in points] for name, points in self.timings.items()},
+        }
+
+    @classmethod
+    def from_dict(cls, data):
+        """to_dict() の形式から復元"""
+        try:
+            return cls(data['timings'], data['signature'], data.get('method', 'loopback'), data.get('created'))
+        except (KeyError, TypeError, ValueError) as e:
+            raise ValueError(f"計測結果の形式が不正です: {e}")
+
+
+def _load_bench_module():
+    """plugins/bench/bench_transfer.py を読み込む（パッケージには含まれないため、パスから読み込む）"""
+    path = BENCH_DIR / 'bench_transfer.py'
+    if not path.exists():
+        raise RuntimeError(f"ベンチマークが見つかりません: {path}")
+    spec = importlib.util.spec_from_file_location('pyfreefem_ml_bench_transfer', path)
+    module = importlib.util.module_from_spec(spec)
+    spec.loader.exec_module(module)
+    return module
+
+
+def calibrate(transports=None, sizes=CALIBRATION_SIZES, bench=None, directory=None,
+              target_bytes=CALIBRATION_TARGET_BYTES, debug=False):
+    """
+    転送方式を計測
+
+    Args:
+        transports (iterable, optional): 計測する方式（省略時はLinuxではすべて、それ以外ではファイルのみ）
+        sizes (iterable): 計測する配列の大きさ（バイト）
+        bench (str, optional): エコー側に使う shm_bench（省略時はビルドされていれば使う。
+            False を指定すると同じプロセス内で計測する）
+        directory (str, optional): file方式で使うディレクトリ（省略時は一時ディレクトリ）
+        target_bytes (int): 大きさごとに転送する合計の目安
+        debug (bool): 計測結果を表示するかどうか
+
+    Returns:
+        TransportProfile: 計測結果（失敗した方式は含まれない）
+    """
+    bench_module = _load_bench_module()
+    if transports is None:
+        transports = bench_module.TRANSPORTS if platform.system() == 'Linux' else FILE_TRANSPORTS
+    if bench is None:
+        bench = bench_module.DEFAULT_BENCH if bench_module.DEFAULT_BENCH.exists() else False
+    bench = bench or None
+    directory = directory or tempfile.gettempdir()
+    name = f"pyff_calibrate_{os.getpid()}"
+
+    timings = {}
+    for transport in transports:
+        if transport not in bench_module.TRANSPORT_CLASSES:
+            raise ValueError(f"未知の転送方式です: {transport}")
+        points = []
+        try:
+            for nbytes in sizes:
+                _, _, median_ns = bench_module.measure(bench, transport, name, nbytes, directory, target_bytes)
+                # エコー側がある場合は往復で2回転送している
+                points.append((nbytes, median_ns / 2 if bench else median_ns))
+        except Exception as e:
+            print(f"警告: 転送方式 '{transport}' を計測できませんでした: {e}")
+            continue
+        timings[transport] = points
+
+    profile = TransportProfile(timings, method='echo' if bench else 'loopback')
+    if debug:
+        for transport in profile.transports:
+            print(f"計測: {transport:<10} 遅延={profile.latency(transport) / 1e3:.2f} us, "
+                  f"帯域={profile.bandwidth(transport):.2f} GB/s")
+    return profile
+
+
+def save_profile(profile, path=None):
+    """
+    計測結果を保存（一時ファイルに書き込んでから置き換える）
+
+    Returns:
+        bool: 保存できたかどうか
+    """
+    path = path or default_cache_path()
+    try:
+        os.makedirs(os.path.dirname(path), exist_ok=True)
+        temp_path = f"{path}.{os.getpid()}.tmp"
+        with open(temp_path, 'w', encoding='utf-8') as f:
+            json.dump(profile.to_dict(), f, indent=1)
+        os.replace(temp_path, path)
+        return True
+    except OSError as e:
+        print(f"警告: 計測結果を保存できませんでした: {path} ({e})")
+        return False
+
+
+def read_profile(path=None):
+    """保存された計測結果を読み込む（ない・壊れている・別のホストの結果の場合はNone）"""
+    path = path or default_cache_path()
+    try:
+        with open(path, encoding='utf-8') as f:
+            profile = TransportProfile.from_dict(json.load(f))
+    except FileNotFoundError:
+        return None
+    except (OSError, ValueError) as e:
+        print(f"警告: 計測結果を読み込めません: {path} ({e})")
+        return None
+    return profile if profile.matches() else None
+
+
+def load_profile(path=None, refresh=False, calibrate_missing=True, **kwargs):
+    """
+    このホストの計測結果を取得
+
+    保存された結果があればそれを使い、なければ計測して保存します。
+
+    Args:
+        path (str, optional): 保存先（省略時は ~/.ff++/transport_calibration.json）
+        refresh (bool): 保存された結果を使わずに計測し直すかどうか
+        calibrate_missing (bool): 保存された結果がない場合に計測するかどうか
+        **kwargs: calibrate() に渡す引数
+
+    Returns:
+        TransportProfile: 計測結果（計測しない・できない場合はNone）
+    """
+    profile = None if refresh else read_profile(path)
+    if profile is not None or not (calibrate_missing or refresh):
+        return profile
+    try:
+        profile = calibrate(**kwargs)
+    except RuntimeError as e:
+        print(f"警告: 転送方式を計測できませんでした: {e}")
+        return None
+    if profile.timings:
+        save_profile(profile, path)
+    return profile